@@ -0,0 +1,65 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+using BenchClock = std::chrono::steady_clock;
+
+inline double elapsedMicroseconds(BenchClock::time_point start, BenchClock::time_point end) {
+    return std::chrono::duration<double, std::micro>(end - start).count();
+}
+
+/**
+ * Collects one sample per frame and prints mean / median / p99 / max.
+ */
+struct SampleStats {
+    std::vector<double> samples;
+
+    void reserve(size_t count) { samples.reserve(count); }
+    void add(double value) { samples.push_back(value); }
+
+    double mean() const {
+        if (samples.empty()) return 0.0;
+        double sum = 0.0;
+        for (double s : samples) sum += s;
+        return sum / samples.size();
+    }
+
+    double percentile(double p) const {
+        if (samples.empty()) return 0.0;
+        std::vector<double> sorted = samples;
+        std::sort(sorted.begin(), sorted.end());
+        size_t index = std::min(sorted.size() - 1, size_t(p * (sorted.size() - 1) + 0.5));
+        return sorted[index];
+    }
+
+    void print(const char* name, const char* unit) const {
+        printf("%-16s mean %10.2f %s  median %10.2f %s  p99 %10.2f %s  max %10.2f %s\n",
+               name, mean(), unit, percentile(0.5), unit, percentile(0.99), unit, percentile(1.0), unit);
+    }
+};
+
+/**
+ * Minimal "--name value" / "--flag" command line lookup shared by the benchmarks.
+ */
+inline const char* findArg(int argc, char** argv, const char* name) {
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], name) == 0) {
+            return i + 1 < argc ? argv[i + 1] : "";
+        }
+    }
+    return nullptr;
+}
+
+inline long argOr(int argc, char** argv, const char* name, long fallback) {
+    const char* value = findArg(argc, argv, name);
+    return value && *value ? strtol(value, nullptr, 10) : fallback;
+}
+
+inline bool hasFlag(int argc, char** argv, const char* name) {
+    return findArg(argc, argv, name) != nullptr;
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <webgpu/webgpu.h>
+
+#include "bench-utils.h"
+#include "../src/webgpu-handles.h"
+#include "../src/webgpu-renderer.h"
+#include "../src/webgpu-utils.h"
+
+/**
+ * Create the global device on the fallback (software) adapter, or on the
+ * default one when --hardware is passed. Returns false if none is available.
+ */
+inline bool initHeadlessWebGPU(int argc, char** argv) {
+    const bool hardware = hasFlag(argc, argv, "--hardware");
+
+    WGPURequestAdapterOptions adapterOpts = {};
+    adapterOpts.nextInChain = nullptr;
+    adapterOpts.compatibleSurface = nullptr;
+    adapterOpts.forceFallbackAdapter = !hardware;
+    if (!initWebGPU(&adapterOpts)) {
+        fprintf(stderr, "Could not get a %s WebGPU device\n", hardware ? "hardware" : "software");
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Block until the pipeline cache has no compilation in flight, so that the
+ * measured frames all draw. Prints the cache statistics.
+ */
+inline void waitForPipelines() {
+    while (pipelineCache.stats().pipelinesPending > 0) {
+        pollEvents(device);
+    }
+    pipelineCache.printStats();
+    bindGroupCache.printStats();
+    shaderLibrary.printStats();
+}
+
+/**
+ * Texture standing in for the swap chain in headless runs.
+ */
+struct OffscreenTarget {
+    Handle<WGPUTexture> texture;
+    Handle<WGPUTextureView> view;
+
+    OffscreenTarget(WGPUDevice device, uint32_t width, uint32_t height, WGPUTextureFormat format) {
+        WGPUTextureDescriptor targetDesc = {};
+        targetDesc.label = "offscreen-target";
+        targetDesc.usage = WGPUTextureUsage_RenderAttachment | WGPUTextureUsage_CopySrc;
+        targetDesc.dimension = WGPUTextureDimension_2D;
+        targetDesc.size = {width, height, 1};
+        targetDesc.format = format;
+        targetDesc.mipLevelCount = 1;
+        targetDesc.sampleCount = 1;
+        texture.reset(wgpuDeviceCreateTexture(device, &targetDesc));
+        view.reset(wgpuTextureCreateView(texture.get(), nullptr));
+    }
+
+    ~OffscreenTarget() {
+        view.reset();
+        if (texture) wgpuTextureDestroy(texture.get());
+    }
+};
+
+inline void submitCommand(Handle<WGPUCommandBuffer> const & command) {
+    WGPUCommandBuffer commandBuffer = command.get();
+    wgpuQueueSubmit(queue, 1, &commandBuffer);
+}
+
+/**
+ * Release the global renderer state so the process exits cleanly.
+ */
+inline void shutdownHeadlessWebGPU() {
+    waitForQueueIdle(device, queue);
+    gpuCulling = GpuCulling();
+    gpuProfiler = GpuProfiler();
+    instancedRenderer = InstancedRenderer();
+    sceneMesh = MeshStream();
+    spriteBatcher = SpriteBatcher();
+    uploadRing = UploadRing();
+    drawQueue = DrawQueue();
+    shaderLibrary.clear();
+    bindGroupCache.clear();
+    pipelineCache.clear();
+    deferredReleases.flush();
+    wgpuQueueRelease(queue);
+    wgpuDeviceRelease(device);
+    wgpuInstanceRelease(instance);
+}
@@ -0,0 +1,105 @@
+// Frames in flight benchmark. Renders the animated benchmark scene of
+// --instances triangles with 1, 2 and 3 frames in flight (or only --in-flight
+// N) and --cpu-us microseconds of simulated game logic per frame, without
+// ever waiting for the queue to be idle: the only thing holding the CPU back
+// is the frame pacer.
+//
+// Reports frames/sec and, per frame, the CPU time outside the wait and the
+// time the CPU waited for a free frame slot. With one frame in flight a frame
+// costs CPU + GPU time; with more the two overlap and the frame costs the
+// larger of them, the bottleneck being the GPU when the wait stays above 0.
+// Exits with 1 if more frames than allowed were ever in flight.
+//
+//   bench-frames-in-flight [--frames N] [--instances N] [--cpu-us N] [--in-flight N] [--hardware]
+
+#include "bench-webgpu.h"
+
+namespace {
+
+/**
+ * Stands in for game logic: keeps the CPU busy for `microseconds`.
+ */
+void simulateCpuWork(double microseconds) {
+    const auto start = BenchClock::now();
+    while (elapsedMicroseconds(start, BenchClock::now()) < microseconds) {
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const uint32_t frameCount = (uint32_t)argOr(argc, argv, "--frames", 300);
+    const uint32_t instanceCount = (uint32_t)argOr(argc, argv, "--instances", 200000);
+    const double cpuMicroseconds = (double)argOr(argc, argv, "--cpu-us", 2000);
+    const uint32_t onlyInFlight = (uint32_t)argOr(argc, argv, "--in-flight", 0);
+
+    if (!initHeadlessWebGPU(argc, argv)) {
+        return 1;
+    }
+    const WGPUTextureFormat colorFormat = WGPUTextureFormat_BGRA8Unorm;
+    initWebGPUPipeline(colorFormat);
+    waitForPipelines();
+    buildBenchmarkScene(instanceCount);
+
+    bool ok = true;
+    {
+        OffscreenTarget target(device, 800, 600, colorFormat);
+        printf("instances %u  simulated cpu %.0f us/frame  adapter %s\n", instanceCount, cpuMicroseconds,
+               hasFlag(argc, argv, "--hardware") ? "hardware" : "software");
+        printf("%10s %12s %12s %12s %12s %10s %10s\n", "in flight", "frames/sec", "frame ms", "cpu ms", "wait ms",
+               "waited %", "max pend");
+
+        double serialFramesPerSecond = 0.0;
+        for (uint32_t inFlight = 1; inFlight <= FramePacer::MaxFramesInFlight; ++inFlight) {
+            if (onlyInFlight != 0 && inFlight != onlyInFlight) {
+                continue;
+            }
+            framePacer.waitIdle(device);
+            framePacer.init(inFlight);
+
+            auto renderFrame = [&]() {
+                framePacer.beginFrame(device);
+                simulateCpuWork(cpuMicroseconds);
+                animateBenchmarkScene();
+                submitCommand(encodeFrame(target.view.get()));
+                endFrame();
+                pollEvents(device);
+            };
+            // Fill the pipeline before measuring
+            for (uint32_t i = 0; i < 10; ++i) {
+                renderFrame();
+            }
+
+            const FramePacer::Stats before = framePacer.stats();
+            const auto start = BenchClock::now();
+            for (uint32_t i = 0; i < frameCount; ++i) {
+                renderFrame();
+            }
+            const double totalMilliseconds = elapsedMicroseconds(start, BenchClock::now()) * 1e-3;
+            FramePacer::Stats const & after = framePacer.stats();
+
+            const double waitMilliseconds = (after.totalWaitMilliseconds - before.totalWaitMilliseconds) / frameCount;
+            const double frameMilliseconds = totalMilliseconds / frameCount;
+            const double framesPerSecond = 1000.0 / frameMilliseconds;
+            printf("%10u %12.1f %12.3f %12.3f %12.3f %9.1f%% %10u", inFlight, framesPerSecond, frameMilliseconds,
+                   frameMilliseconds - waitMilliseconds, waitMilliseconds,
+                   100.0 * double(after.framesWaited - before.framesWaited) / frameCount, framePacer.maxPendingFrames());
+            if (inFlight == 1) {
+                serialFramesPerSecond = framesPerSecond;
+            } else if (serialFramesPerSecond > 0.0) {
+                printf("  x%.2f", framesPerSecond / serialFramesPerSecond);
+            }
+            printf("\n");
+
+            if (framePacer.maxPendingFrames() > inFlight) {
+                printf("MISMATCH: %u frames were in flight, at most %u allowed\n", framePacer.maxPendingFrames(),
+                       inFlight);
+                ok = false;
+            }
+        }
+        framePacer.waitIdle(device);
+    }
+
+    shutdownHeadlessWebGPU();
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,85 @@
+// Instanced renderer scaling benchmark: sweeps the instance count and reports
+// frame time and bytes uploaded per frame while a share of the instances is
+// animated every frame.
+//
+// With --culling the instances are spread over four times the visible area
+// and go through the GPU culling pass and an indirect draw.
+//
+//   bench-instancing [--frames N] [--animated PERCENT] [--max-instances N] [--culling] [--hardware]
+
+#include <cmath>
+#include <random>
+
+#include "bench-webgpu.h"
+#include "../src/frame-stats.h"
+
+int main(int argc, char** argv) {
+    const uint32_t frameCount = (uint32_t)argOr(argc, argv, "--frames", 200);
+    const uint32_t animatedPercent = (uint32_t)argOr(argc, argv, "--animated", 100);
+    const uint32_t maxInstances = (uint32_t)argOr(argc, argv, "--max-instances", 1000000);
+    gpuCullingEnabled = hasFlag(argc, argv, "--culling");
+
+    if (!initHeadlessWebGPU(argc, argv)) {
+        return 1;
+    }
+
+    const WGPUTextureFormat colorFormat = WGPUTextureFormat_BGRA8Unorm;
+    initWebGPUPipeline(colorFormat);
+    waitForPipelines();
+
+    {
+        OffscreenTarget target(device, 800, 600, colorFormat);
+        std::mt19937 rng(42);
+        const float extent = gpuCullingEnabled ? 2.0f : 1.0f;
+        std::uniform_real_distribution<float> position(-extent, extent);
+
+        printf("%10s %12s %12s %12s %14s %8s %10s\n", "instances", "cpu ms", "frame ms", "p99 ms", "upload KB/frm", "writes", "visible");
+        for (uint32_t count = 1000; count <= maxInstances; count *= 10) {
+            instances.resize(count);
+            for (uint32_t i = 0; i < count; ++i) {
+                instances.transforms()[i] = InstanceTransform{position(rng), position(rng), 0.02f, 0.0f};
+                instances.colors()[i] = 0xFF000000 | (rng() & 0x00FFFFFF);
+            }
+            instances.markAllDirty();
+
+            // First frame uploads everything, keep it out of the measurements
+            submitCommand(encodeFrame(target.view.get()));
+            endFrame();
+            waitForQueueIdle(device, queue);
+
+            const uint32_t animatedCount = uint32_t(uint64_t(count) * animatedPercent / 100);
+            SampleStats cpuStats;
+            SampleStats frameStatsMs;
+            uint64_t uploadBytes = 0;
+            uint64_t uploadCalls = 0;
+            for (uint32_t frame = 0; frame < frameCount; ++frame) {
+                const auto t0 = BenchClock::now();
+                InstanceTransform* transforms = instances.transforms();
+                for (uint32_t i = 0; i < animatedCount; ++i) {
+                    transforms[i].rotation += 0.01f;
+                }
+                instances.markDirty(InstanceStore::TransformStream, 0, animatedCount);
+
+                Handle<WGPUCommandBuffer> command = encodeFrame(target.view.get());
+                submitCommand(command);
+                const auto t1 = BenchClock::now();
+                waitForQueueIdle(device, queue);
+                const auto t2 = BenchClock::now();
+
+                endFrame();
+                cpuStats.add(elapsedMicroseconds(t0, t1) * 1e-3);
+                frameStatsMs.add(elapsedMicroseconds(t0, t2) * 1e-3);
+                uploadBytes += frameStats.uploadBytes;
+                uploadCalls += frameStats.uploadCalls;
+            }
+
+            // The culling readback lags a few frames, it has settled by now
+            printf("%10u %12.3f %12.3f %12.3f %14.1f %8.1f %10u\n", count, cpuStats.mean(), frameStatsMs.mean(),
+                   frameStatsMs.percentile(0.99), uploadBytes / 1024.0 / frameCount, double(uploadCalls) / frameCount,
+                   gpuCullingEnabled ? frameStats.instancesVisible : count);
+        }
+    }
+
+    shutdownHeadlessWebGPU();
+    return 0;
+}
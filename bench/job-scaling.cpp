@@ -0,0 +1,150 @@
+// Job system scaling benchmark: runs a frame's worth of CPU work (scene
+// update, frustum culling, draw list building) for --instances objects on
+// 1 to N threads and reports the time per frame and the speedup over one
+// thread. The draw list must come out identical at every thread count.
+//
+//   bench-job-scaling [--instances N] [--frames N] [--max-threads N]
+
+#include <cmath>
+#include <random>
+
+#include "bench-utils.h"
+#include "../src/job-system.h"
+#include "../src/simd-math.h"
+
+namespace {
+
+// Scene in structure-of-arrays form, as the SIMD culling wants it
+struct Scene {
+    std::vector<float> x, y, angle, speed;
+    std::vector<float> minX, minY, minZ, maxX, maxY, maxZ;
+    std::vector<uint8_t> visible;
+    // Draw list building: each chunk compacts its visible objects, then the
+    // chunks are concatenated at offsets from a prefix sum
+    std::vector<uint32_t> chunkVisibleCounts;
+    std::vector<uint32_t> chunkIndices;
+    std::vector<uint32_t> drawList;
+    uint32_t drawCount = 0;
+};
+
+constexpr uint32_t ChunkSize = 4096;
+
+void buildScene(Scene& scene, uint32_t count) {
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> position(-2.0f, 2.0f);
+    std::uniform_real_distribution<float> speed(-0.02f, 0.02f);
+    for (auto* v : {&scene.x, &scene.y, &scene.angle, &scene.speed, &scene.minX, &scene.minY, &scene.minZ,
+                    &scene.maxX, &scene.maxY, &scene.maxZ}) {
+        v->resize(count);
+    }
+    for (uint32_t i = 0; i < count; ++i) {
+        scene.x[i] = position(rng);
+        scene.y[i] = position(rng);
+        scene.speed[i] = speed(rng);
+        scene.minZ[i] = -0.1f;
+        scene.maxZ[i] = 0.1f;
+    }
+    scene.visible.resize(count);
+    const uint32_t chunkCount = (count + ChunkSize - 1) / ChunkSize;
+    scene.chunkVisibleCounts.resize(chunkCount);
+    scene.chunkIndices.resize(count);
+    scene.drawList.resize(count);
+}
+
+void runFrame(Scene& scene, Frustum const & frustum) {
+    const uint32_t count = (uint32_t)scene.x.size();
+
+    // Update: move along a circle and refresh the bounding box
+    jobSystem.parallelFor(count, ChunkSize, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; ++i) {
+            scene.angle[i] += scene.speed[i];
+            const float px = scene.x[i] + 0.5f * std::cos(scene.angle[i]);
+            const float py = scene.y[i] + 0.5f * std::sin(scene.angle[i]);
+            scene.minX[i] = px - 0.05f;
+            scene.maxX[i] = px + 0.05f;
+            scene.minY[i] = py - 0.05f;
+            scene.maxY[i] = py + 0.05f;
+        }
+    });
+
+    // Cull and compact per chunk
+    jobSystem.parallelFor(count, ChunkSize, [&](uint32_t begin, uint32_t end) {
+        const AabbArrays boxes = {&scene.minX[begin], &scene.minY[begin], &scene.minZ[begin],
+                                  &scene.maxX[begin], &scene.maxY[begin], &scene.maxZ[begin]};
+        cullAabbs(frustum, boxes, end - begin, &scene.visible[begin]);
+        uint32_t written = 0;
+        for (uint32_t i = begin; i < end; ++i) {
+            if (scene.visible[i]) {
+                scene.chunkIndices[begin + written++] = i;
+            }
+        }
+        scene.chunkVisibleCounts[begin / ChunkSize] = written;
+    });
+
+    // Prefix sum on the main thread (one value per chunk), then parallel copy
+    std::vector<uint32_t> offsets(scene.chunkVisibleCounts.size());
+    uint32_t total = 0;
+    for (size_t c = 0; c < offsets.size(); ++c) {
+        offsets[c] = total;
+        total += scene.chunkVisibleCounts[c];
+    }
+    const uint32_t chunkCount = (uint32_t)offsets.size();
+    jobSystem.parallelFor(chunkCount, 1, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t c = begin; c < end; ++c) {
+            std::copy_n(&scene.chunkIndices[c * ChunkSize], scene.chunkVisibleCounts[c], &scene.drawList[offsets[c]]);
+        }
+    });
+    scene.drawCount = total;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const uint32_t instanceCount = (uint32_t)argOr(argc, argv, "--instances", 1000000);
+    const uint32_t frameCount = (uint32_t)argOr(argc, argv, "--frames", 100);
+    const uint32_t maxThreads = (uint32_t)argOr(argc, argv, "--max-threads", JobSystem::hardwareThreads());
+
+    // The visible area is the [-1, 1] square, a quarter of the scene
+    const Frustum frustum = frustumFromMatrix(mat4Orthographic(-1.0f, 1.0f, -1.0f, 1.0f, -1.0f, 1.0f));
+
+    printf("instances %u  frames %u  simd %s\n", instanceCount, frameCount, simdMathBackend());
+    printf("%8s %12s %12s %10s %12s %12s\n", "threads", "ms/frame", "p99 ms", "speedup", "stolen/frm", "draws");
+
+    bool consistent = true;
+    double singleThreadMs = 0.0;
+    uint32_t referenceDrawCount = 0;
+    uint64_t referenceChecksum = 0;
+    for (uint32_t threads = 1; threads <= maxThreads; ++threads) {
+        jobSystem.init(threads - 1);
+        // Same starting state for every thread count
+        Scene scene;
+        buildScene(scene, instanceCount);
+        runFrame(scene, frustum);
+        jobSystem.resetStats();
+
+        SampleStats frameStats;
+        for (uint32_t frame = 0; frame < frameCount; ++frame) {
+            const auto t0 = BenchClock::now();
+            runFrame(scene, frustum);
+            frameStats.add(elapsedMicroseconds(t0, BenchClock::now()) * 1e-3);
+        }
+
+        uint64_t checksum = 0;
+        for (uint32_t i = 0; i < scene.drawCount; ++i) {
+            checksum = checksum * 31 + scene.drawList[i];
+        }
+        if (threads == 1) {
+            singleThreadMs = frameStats.mean();
+            referenceDrawCount = scene.drawCount;
+            referenceChecksum = checksum;
+        } else if (scene.drawCount != referenceDrawCount || checksum != referenceChecksum) {
+            printf("MISMATCH: draw list differs from the single thread run\n");
+            consistent = false;
+        }
+
+        printf("%8u %12.3f %12.3f %9.2fx %12.1f %12u\n", threads, frameStats.mean(), frameStats.percentile(0.99),
+               singleThreadMs / frameStats.mean(), double(jobSystem.stats().jobsStolen) / frameCount, scene.drawCount);
+    }
+    jobSystem.shutdown();
+    return consistent ? 0 : 1;
+}
@@ -0,0 +1,315 @@
+// Material batching benchmark. Draws --draws quads, each with one of
+// --pipelines pipelines and one of --materials materials (a bind group over
+// the material's uniform buffer) picked at random, three ways:
+//   - per draw: a bind group created for every draw, draws in random order
+//   - cached: bind groups from bindGroupCache, draws in random order
+//   - sorted: bind groups from bindGroupCache, draws sorted by DrawQueue
+// and reports the CPU time to record the pass, the frame time, the state
+// changes per frame and the cache hits. It then stops drawing and checks that
+// the unused bind groups are evicted.
+//
+//   bench-material-batching [--draws N] [--materials N] [--pipelines N] [--frames N] [--hardware]
+
+#include <cmath>
+#include <random>
+#include <set>
+#include <utility>
+
+#include "bench-webgpu.h"
+#include "../src/frame-stats.h"
+
+namespace {
+
+// Each draw fills one cell of a `columns` wide grid, picked by its instance
+const char* MaterialShader = R"(
+override brightness: f32 = 1.0;
+override columns: f32 = 32.0;
+
+struct Material {
+    color: vec4f,
+};
+@group(0) @binding(0) var<uniform> material: Material;
+
+@vertex
+fn vs_main(@location(0) corner: vec2f, @builtin(instance_index) cell: u32) -> @builtin(position) vec4f {
+    let size = 2.0 / columns;
+    let xy = vec2f(f32(cell % u32(columns)), f32(cell / u32(columns)));
+    return vec4f(-1.0 + (xy + corner * 0.8) * size, 0.0, 1.0);
+}
+
+@fragment
+fn fs_main() -> @location(0) vec4f {
+    return vec4f(material.color.rgb * brightness, 1.0);
+}
+)";
+
+struct MaterialUniforms {
+    float color[4];
+};
+
+struct Draw {
+    uint32_t pipeline;
+    uint32_t material;
+};
+
+enum class Mode { PerDraw, Cached, Sorted };
+
+struct FrameResult {
+    FrameStats stats;
+    uint32_t bindGroupsCreated = 0;
+    double encodeMicroseconds = 0.0;
+    double frameMicroseconds = 0.0;
+};
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const uint32_t drawCount = (uint32_t)argOr(argc, argv, "--draws", 2048);
+    const uint32_t materialCount = (uint32_t)argOr(argc, argv, "--materials", 64);
+    const uint32_t pipelineCount = (uint32_t)argOr(argc, argv, "--pipelines", 8);
+    const uint32_t frameCount = (uint32_t)argOr(argc, argv, "--frames", 100);
+    const uint32_t columns = (uint32_t)std::ceil(std::sqrt(double(drawCount)));
+
+    if (!initHeadlessWebGPU(argc, argv)) {
+        return 1;
+    }
+    const WGPUTextureFormat colorFormat = WGPUTextureFormat_BGRA8Unorm;
+    initWebGPUPipeline(colorFormat);
+
+    WGPUBindGroupLayoutEntry layoutEntry{};
+    layoutEntry.binding = 0;
+    layoutEntry.visibility = WGPUShaderStage_Fragment;
+    layoutEntry.buffer.type = WGPUBufferBindingType_Uniform;
+    layoutEntry.buffer.minBindingSize = sizeof(MaterialUniforms);
+    WGPUBindGroupLayoutDescriptor layoutDesc{};
+    layoutDesc.label = "material-layout";
+    layoutDesc.entryCount = 1;
+    layoutDesc.entries = &layoutEntry;
+    WGPUBindGroupLayout materialLayout = bindGroupCache.getBindGroupLayout(layoutDesc);
+    // Every material asks again, as material code would: hits from now on
+    for (uint32_t i = 0; i < materialCount; ++i) {
+        bindGroupCache.getBindGroupLayout(layoutDesc);
+    }
+    WGPUPipelineLayoutDescriptor pipelineLayoutDesc{};
+    pipelineLayoutDesc.bindGroupLayoutCount = 1;
+    pipelineLayoutDesc.bindGroupLayouts = &materialLayout;
+    WGPUPipelineLayout pipelineLayout = bindGroupCache.getPipelineLayout(pipelineLayoutDesc);
+
+    WGPUShaderModule module = pipelineCache.getShaderModule(MaterialShader, "material.wgsl");
+    WGPUVertexAttribute attribute{};
+    attribute.format = WGPUVertexFormat_Float32x2;
+    attribute.offset = 0;
+    attribute.shaderLocation = 0;
+    WGPUVertexBufferLayout vertexBufferLayout{};
+    vertexBufferLayout.arrayStride = 2 * sizeof(float);
+    vertexBufferLayout.stepMode = WGPUVertexStepMode_Vertex;
+    vertexBufferLayout.attributeCount = 1;
+    vertexBufferLayout.attributes = &attribute;
+
+    std::vector<CachedRenderPipeline const *> pipelines;
+    for (uint32_t i = 0; i < pipelineCount; ++i) {
+        // Pipelines differ by a constant, enough for the cache to keep them apart
+        WGPUConstantEntry brightness{};
+        brightness.key = "brightness";
+        brightness.value = 0.5 + 0.5 * i / std::max(pipelineCount - 1, 1u);
+        WGPUConstantEntry columnCount{};
+        columnCount.key = "columns";
+        columnCount.value = columns;
+        WGPUColorTargetState colorTarget{};
+        colorTarget.format = colorFormat;
+        colorTarget.writeMask = WGPUColorWriteMask_All;
+        WGPUFragmentState fragment{};
+        fragment.module = module;
+        fragment.entryPoint = "fs_main";
+        fragment.constantCount = 1;
+        fragment.constants = &brightness;
+        fragment.targetCount = 1;
+        fragment.targets = &colorTarget;
+        WGPURenderPipelineDescriptor pipelineDesc{};
+        pipelineDesc.label = "material-pipeline";
+        pipelineDesc.layout = pipelineLayout;
+        pipelineDesc.vertex.module = module;
+        pipelineDesc.vertex.entryPoint = "vs_main";
+        pipelineDesc.vertex.constantCount = 1;
+        pipelineDesc.vertex.constants = &columnCount;
+        pipelineDesc.vertex.bufferCount = 1;
+        pipelineDesc.vertex.buffers = &vertexBufferLayout;
+        pipelineDesc.fragment = &fragment;
+        pipelineDesc.primitive.topology = WGPUPrimitiveTopology_TriangleList;
+        pipelineDesc.primitive.frontFace = WGPUFrontFace_CCW;
+        pipelineDesc.primitive.cullMode = WGPUCullMode_None;
+        pipelineDesc.multisample.count = 1;
+        pipelineDesc.multisample.mask = 0xFFFFFFFF;
+        pipelines.push_back(pipelineCache.getRenderPipeline(pipelineDesc));
+    }
+    waitForPipelines();
+
+    bool ok = true;
+    {
+        OffscreenTarget target(device, 800, 600, colorFormat);
+
+        const float corners[12] = {0, 0, 1, 0, 0, 1, 1, 0, 1, 1, 0, 1};
+        WGPUBufferDescriptor vertexDesc{};
+        vertexDesc.label = "material-quad";
+        vertexDesc.usage = WGPUBufferUsage_Vertex | WGPUBufferUsage_CopyDst;
+        vertexDesc.size = sizeof(corners);
+        Handle<WGPUBuffer> vertexBuffer(wgpuDeviceCreateBuffer(device, &vertexDesc));
+        wgpuQueueWriteBuffer(queue, vertexBuffer.get(), 0, corners, sizeof(corners));
+
+        std::mt19937 random(7);
+        std::vector<Handle<WGPUBuffer>> materialBuffers;
+        for (uint32_t i = 0; i < materialCount; ++i) {
+            WGPUBufferDescriptor bufferDesc{};
+            bufferDesc.label = "material";
+            bufferDesc.usage = WGPUBufferUsage_Uniform | WGPUBufferUsage_CopyDst;
+            bufferDesc.size = sizeof(MaterialUniforms);
+            materialBuffers.emplace_back(wgpuDeviceCreateBuffer(device, &bufferDesc));
+            std::uniform_real_distribution<float> channel(0.2f, 1.0f);
+            const MaterialUniforms uniforms = {{channel(random), channel(random), channel(random), 1.0f}};
+            wgpuQueueWriteBuffer(queue, materialBuffers.back().get(), 0, &uniforms, sizeof(uniforms));
+        }
+
+        std::vector<Draw> draws(drawCount);
+        std::set<std::pair<uint32_t, uint32_t>> pairs;
+        std::set<uint32_t> pipelinesUsed;
+        for (Draw& draw : draws) {
+            draw.pipeline = random() % pipelineCount;
+            draw.material = random() % materialCount;
+            pairs.insert({draw.pipeline, draw.material});
+            pipelinesUsed.insert(draw.pipeline);
+        }
+
+        auto renderFrame = [&](Mode mode) {
+            FrameResult result;
+            frameStats = {};
+            std::vector<Handle<WGPUBindGroup>> created;
+            created.reserve(mode == Mode::PerDraw ? drawCount : 0);
+            const auto t0 = BenchClock::now();
+            WGPUCommandEncoderDescriptor encoderDesc{};
+            Handle<WGPUCommandEncoder> encoder(wgpuDeviceCreateCommandEncoder(device, &encoderDesc));
+            WGPURenderPassColorAttachment colorAttachment{};
+            colorAttachment.view = target.view.get();
+#ifndef WEBGPU_BACKEND_WGPU
+            colorAttachment.depthSlice = UINT32_MAX;
+#endif // NOT WEBGPU_BACKEND_WGPU
+            colorAttachment.loadOp = WGPULoadOp_Clear;
+            colorAttachment.storeOp = WGPUStoreOp_Store;
+            colorAttachment.clearValue = {0.0f, 0.0f, 0.0f, 1.0f};
+            WGPURenderPassDescriptor passDesc{};
+            passDesc.colorAttachmentCount = 1;
+            passDesc.colorAttachments = &colorAttachment;
+            Handle<WGPURenderPassEncoder> pass(wgpuCommandEncoderBeginRenderPass(encoder.get(), &passDesc));
+
+            drawQueue.setSorting(mode == Mode::Sorted);
+            for (uint32_t i = 0; i < drawCount; ++i) {
+                WGPUBindGroupEntry entry{};
+                entry.binding = 0;
+                entry.buffer = materialBuffers[draws[i].material].get();
+                entry.offset = 0;
+                entry.size = sizeof(MaterialUniforms);
+                WGPUBindGroupDescriptor bindGroupDesc{};
+                bindGroupDesc.label = "material";
+                bindGroupDesc.layout = materialLayout;
+                bindGroupDesc.entryCount = 1;
+                bindGroupDesc.entries = &entry;
+
+                DrawItem item;
+                item.pipeline = pipelines[draws[i].pipeline]->get();
+                if (mode == Mode::PerDraw) {
+                    created.emplace_back(wgpuDeviceCreateBindGroup(device, &bindGroupDesc));
+                    item.bindGroups[0] = created.back().get();
+                } else {
+                    item.bindGroups[0] = bindGroupCache.getBindGroup(bindGroupDesc);
+                }
+                item.vertexBuffer = vertexBuffer.get();
+                item.vertexSize = sizeof(corners);
+                item.count = 6;
+                item.firstInstance = i;
+                drawQueue.add(item);
+            }
+            drawQueue.encode(pass.get());
+            wgpuRenderPassEncoderEnd(pass.get());
+            Handle<WGPUCommandBuffer> command(wgpuCommandEncoderFinish(encoder.get(), nullptr));
+            const auto t1 = BenchClock::now();
+            submitCommand(command);
+            waitForQueueIdle(device, queue);
+            const auto t2 = BenchClock::now();
+
+            result.stats = frameStats;
+            result.bindGroupsCreated = uint32_t(created.size()) + frameStats.bindGroupMisses;
+            result.encodeMicroseconds = elapsedMicroseconds(t0, t1);
+            result.frameMicroseconds = elapsedMicroseconds(t0, t2);
+            for (Handle<WGPUBindGroup>& bindGroup : created) {
+                deferredReleases.retire(std::move(bindGroup));
+            }
+            bindGroupCache.endFrame();
+            deferredReleases.endFrame(queue);
+            deferredReleases.collect();
+            return result;
+        };
+
+        printf("draws %u  materials %u  pipelines %u  (%zu pipeline/material pairs)\n", drawCount, materialCount,
+               pipelineCount, pairs.size());
+        printf("%-9s %10s %10s %10s %10s %10s %8s %8s\n", "mode", "encode us", "frame us", "pipelines", "bindgroups",
+               "created", "hits", "misses");
+        const char* names[] = {"per draw", "cached", "sorted"};
+        FrameResult last[3];
+        double perDrawEncode = 0.0;
+        for (Mode mode : {Mode::PerDraw, Mode::Cached, Mode::Sorted}) {
+            // The first frame fills the cache
+            renderFrame(mode);
+            SampleStats encode;
+            SampleStats frame;
+            FrameResult result;
+            for (uint32_t i = 0; i < frameCount; ++i) {
+                result = renderFrame(mode);
+                encode.add(result.encodeMicroseconds);
+                frame.add(result.frameMicroseconds);
+            }
+            if (mode == Mode::PerDraw) {
+                perDrawEncode = encode.mean();
+            }
+            printf("%-9s %10.1f %10.1f %10u %10u %10u %8u %8u  (encode %.2fx)\n", names[int(mode)], encode.mean(),
+                   frame.mean(), result.stats.pipelineChanges, result.stats.bindGroupChanges, result.bindGroupsCreated,
+                   result.stats.bindGroupHits, result.stats.bindGroupMisses, perDrawEncode / encode.mean());
+            last[int(mode)] = result;
+
+            if (result.stats.drawCalls != drawCount) {
+                printf("MISMATCH: %s encoded %u draws of %u\n", names[int(mode)], result.stats.drawCalls, drawCount);
+                ok = false;
+            }
+            if (mode != Mode::PerDraw && (result.stats.bindGroupMisses != 0 || result.stats.bindGroupHits != drawCount)) {
+                printf("MISMATCH: %s created bind groups after the first frame\n", names[int(mode)]);
+                ok = false;
+            }
+        }
+
+        FrameStats const & sorted = last[int(Mode::Sorted)].stats;
+        FrameStats const & unsorted = last[int(Mode::Cached)].stats;
+        // Sorted, each pipeline is set once and each pair's bind group at most once
+        if (sorted.pipelineChanges != pipelinesUsed.size() || sorted.bindGroupChanges > pairs.size()
+                || sorted.pipelineChanges > unsorted.pipelineChanges
+                || sorted.bindGroupChanges > unsorted.bindGroupChanges) {
+            printf("MISMATCH: sorting set %u pipelines and %u bind groups for %zu pipelines and %zu pairs\n",
+                   sorted.pipelineChanges, sorted.bindGroupChanges, pipelinesUsed.size(), pairs.size());
+            ok = false;
+        }
+
+        // Nothing looked up any more: everything goes after EvictAfterFrames frames
+        const uint32_t cached = bindGroupCache.bindGroupCount();
+        for (uint32_t i = 0; i <= BindGroupCache::EvictAfterFrames; ++i) {
+            bindGroupCache.endFrame();
+        }
+        printf("bind groups cached %u, %u after %u frames unused\n", cached, bindGroupCache.bindGroupCount(),
+               BindGroupCache::EvictAfterFrames);
+        if (cached < materialCount || bindGroupCache.bindGroupCount() != 0) {
+            printf("MISMATCH: unused bind groups were not evicted\n");
+            ok = false;
+        }
+        drawQueue.setSorting(true);
+        bindGroupCache.printStats();
+    }
+
+    shutdownHeadlessWebGPU();
+    return ok ? 0 : 1;
+}
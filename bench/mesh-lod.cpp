@@ -0,0 +1,213 @@
+// Mesh level of detail benchmark. Builds the tiled terrain of
+// bench-mesh-stream with levels of detail and meshlets (src/mesh-builder.h),
+// checks the tables, then renders it headlessly at a few zooms:
+//   - full detail: every triangle of every chunk (?lodError=0&meshletCulling=0)
+//   - lod: the coarsest level within --error pixels, nothing culled
+//   - lod+cull: the same without the chunks and meshlets outside the view
+// and reports triangles and draws per frame, CPU encode time and frame time
+// (submit until the GPU is done) against full detail.
+//
+//   bench-mesh-lod [--tiles N] [--grid N] [--error PIXELS] [--frames N] [--width W] [--height H] [--hardware]
+
+#include <algorithm>
+
+#include "bench-webgpu.h"
+#include "terrain.h"
+#include "../src/frame-stats.h"
+
+namespace {
+
+/**
+ * Check what the app trusts once isValidMeshLods() passed: indices within
+ * the chunk's vertices, levels getting coarser, meshlets covering their
+ * level within the vertex and triangle limits and bounding its vertices.
+ */
+bool checkLods(std::vector<uint8_t> const & file) {
+    MeshFileHeader header;
+    memcpy(&header, file.data(), sizeof(header));
+    MeshChunk const * chunks = reinterpret_cast<MeshChunk const *>(file.data() + sizeof(MeshFileHeader));
+    MeshLod const * lods = reinterpret_cast<MeshLod const *>(chunks + header.chunkCount);
+    MeshMeshlet const * meshlets = reinterpret_cast<MeshMeshlet const *>(lods + header.lodCount);
+    uint8_t const * payload = file.data() + header.payloadOffset;
+
+    for (uint32_t c = 0; c < header.chunkCount; ++c) {
+        MeshChunk const & chunk = chunks[c];
+        if (!isValidMeshChunk(header, chunk) || !isValidMeshLods(header, chunk, lods, meshlets) || chunk.lodCount == 0) {
+            printf("MISMATCH: chunk %u tables are invalid\n", c);
+            return false;
+        }
+        MeshVertex const * vertices = reinterpret_cast<MeshVertex const *>(payload + chunk.vertexOffset);
+        uint32_t const * indices = reinterpret_cast<uint32_t const *>(payload + chunk.indexOffset);
+        for (uint32_t i = 0; i < chunk.indexCount; ++i) {
+            if (indices[i] >= chunk.vertexCount) {
+                printf("MISMATCH: chunk %u index %u is out of range\n", c, i);
+                return false;
+            }
+        }
+        for (uint32_t l = 0; l < chunk.lodCount; ++l) {
+            MeshLod const & lod = lods[chunk.firstLod + l];
+            MeshLod const * previous = l > 0 ? &lods[chunk.firstLod + l - 1] : nullptr;
+            if (previous && (lod.indexCount >= previous->indexCount || lod.error < previous->error)) {
+                printf("MISMATCH: chunk %u level %u is not coarser than the one before\n", c, l);
+                return false;
+            }
+            uint32_t covered = lod.firstIndex;
+            for (uint32_t m = lod.firstMeshlet; m < lod.firstMeshlet + lod.meshletCount; ++m) {
+                MeshMeshlet const & meshlet = meshlets[m];
+                std::vector<uint32_t> used(indices + meshlet.firstIndex,
+                                           indices + meshlet.firstIndex + meshlet.indexCount);
+                std::sort(used.begin(), used.end());
+                used.erase(std::unique(used.begin(), used.end()), used.end());
+                bool inside = true;
+                for (uint32_t v : used) {
+                    for (int k = 0; k < 3; ++k) {
+                        inside = inside && vertices[v].position[k] >= meshlet.boundsMin[k]
+                                 && vertices[v].position[k] <= meshlet.boundsMax[k];
+                    }
+                }
+                if (meshlet.firstIndex != covered || meshlet.indexCount % 3 != 0
+                        || meshlet.indexCount / 3 > MeshletMaxTriangles || used.size() > MeshletMaxVertices || !inside) {
+                    printf("MISMATCH: chunk %u level %u meshlet %u is malformed\n", c, l, m - lod.firstMeshlet);
+                    return false;
+                }
+                covered += meshlet.indexCount;
+            }
+            if (covered != lod.firstIndex + lod.indexCount) {
+                printf("MISMATCH: chunk %u level %u meshlets do not cover it\n", c, l);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+struct ModeResult {
+    uint32_t triangles = 0;
+    uint32_t fullDetailTriangles = 0;
+    uint32_t draws = 0;
+    SampleStats encode;
+    SampleStats frame;
+};
+
+ModeResult renderFrames(WGPUTextureView target, uint32_t frameCount) {
+    ModeResult result;
+    for (uint32_t i = 0; i < frameCount; ++i) {
+        const auto t0 = BenchClock::now();
+        Handle<WGPUCommandBuffer> command = encodeFrame(target);
+        const auto t1 = BenchClock::now();
+        submitCommand(command);
+        waitForQueueIdle(device, queue);
+        const auto t2 = BenchClock::now();
+        endFrame();
+        result.encode.add(elapsedMicroseconds(t0, t1) * 1e-3);
+        result.frame.add(elapsedMicroseconds(t0, t2) * 1e-3);
+        result.triangles = frameStats.meshTriangles;
+        result.fullDetailTriangles = frameStats.meshTrianglesFullDetail;
+        result.draws = frameStats.drawCalls;
+    }
+    return result;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const uint32_t tiles = (uint32_t)argOr(argc, argv, "--tiles", 8);
+    const uint32_t grid = (uint32_t)argOr(argc, argv, "--grid", 64);
+    const float maxErrorPixels = (float)argOr(argc, argv, "--error", 1);
+    const uint32_t frameCount = (uint32_t)argOr(argc, argv, "--frames", 50);
+    const uint32_t width = (uint32_t)argOr(argc, argv, "--width", 800);
+    const uint32_t height = (uint32_t)argOr(argc, argv, "--height", 600);
+
+    MeshBuildStats stats;
+    const std::vector<uint8_t> file = buildMeshFile(buildTerrainChunks(tiles, grid), MeshBuildOptions{}, &stats);
+    printf("build: %u chunks, %u levels, %u meshlets, %.1f KB in %.1f ms\n", stats.chunks, stats.lods,
+           stats.meshlets, file.size() / 1024.0, stats.buildMilliseconds);
+    printf("triangles: %llu full detail, %llu in all levels (+%.0f%% indices)\n",
+           (unsigned long long)stats.triangles, (unsigned long long)stats.lodTriangles,
+           100.0 * (stats.lodTriangles - stats.triangles) / stats.triangles);
+    printf("vertex cache misses/triangle (%u entries): %.3f -> %.3f\n", MeshBuildOptions{}.cacheSize,
+           stats.missRatioBefore, stats.missRatioAfter);
+
+    MeshFileHeader const & header = *reinterpret_cast<MeshFileHeader const *>(file.data());
+    MeshChunk const & first = *reinterpret_cast<MeshChunk const *>(file.data() + sizeof(MeshFileHeader));
+    MeshLod const * lods = reinterpret_cast<MeshLod const *>(file.data() + sizeof(MeshFileHeader)
+                                                              + header.chunkCount * sizeof(MeshChunk));
+    for (uint32_t l = 0; l < first.lodCount; ++l) {
+        MeshLod const & lod = lods[first.firstLod + l];
+        printf("  chunk 0 level %u: %6u triangles %4u meshlets error %.4f\n", l, lod.indexCount / 3,
+               lod.meshletCount, lod.error);
+    }
+
+    bool ok = checkLods(file);
+
+    if (!initHeadlessWebGPU(argc, argv)) {
+        return 1;
+    }
+    const WGPUTextureFormat colorFormat = WGPUTextureFormat_BGRA8Unorm;
+    initWebGPUPipeline(colorFormat);
+    waitForPipelines();
+
+    {
+        OffscreenTarget target(device, width, height, colorFormat);
+        sceneMesh.setViewportSize(width, height);
+        sceneMesh.append(file.data(), file.size());
+        if (!sceneMesh.complete()) {
+            printf("MISMATCH: the mesh was rejected\n");
+            ok = false;
+        }
+
+        struct Mode {
+            const char* name;
+            float maxErrorPixels;
+            bool cull;
+        };
+        const Mode modes[] = {{"full", 0.0f, false}, {"lod", maxErrorPixels, false}, {"lod+cull", maxErrorPixels, true}};
+
+        printf("%-6s %-9s %10s %8s %7s %10s %10s\n", "zoom", "mode", "triangles", "of full", "draws", "encode ms",
+               "frame ms");
+        // Zoomed out, levels of detail cut the triangles; zoomed in, culling does
+        for (float zoom : {0.25f, 1.0f, 4.0f, 16.0f}) {
+            // Off center so that zooming in leaves most chunks out of view
+            view.center[0] = zoom > 1.0f ? 0.3f : 0.0f;
+            view.center[1] = zoom > 1.0f ? 0.2f : 0.0f;
+            view.scale[0] = zoom * height / width;
+            view.scale[1] = zoom;
+
+            double fullFrameMs = 0.0;
+            for (Mode const & mode : modes) {
+                sceneMesh.setLodSelection(mode.maxErrorPixels, mode.cull);
+                // Warm up, then measure
+                renderFrames(target.view.get(), 3);
+                ModeResult result = renderFrames(target.view.get(), frameCount);
+                const double frameMs = result.frame.mean();
+                if (mode.maxErrorPixels == 0.0f) {
+                    fullFrameMs = frameMs;
+                }
+                printf("%-6g %-9s %10u %7.1f%% %7u %10.3f %10.3f (%.2fx)\n", zoom, mode.name, result.triangles,
+                       100.0 * result.triangles / std::max(result.fullDetailTriangles, 1u), result.draws,
+                       result.encode.mean(), frameMs, fullFrameMs / frameMs);
+
+                if (result.fullDetailTriangles != stats.triangles) {
+                    printf("MISMATCH: %u full detail triangles counted, %llu built\n", result.fullDetailTriangles,
+                           (unsigned long long)stats.triangles);
+                    ok = false;
+                }
+                if (mode.maxErrorPixels == 0.0f && result.triangles != stats.triangles) {
+                    printf("MISMATCH: full detail drew %u triangles of %llu\n", result.triangles,
+                           (unsigned long long)stats.triangles);
+                    ok = false;
+                }
+                if (result.triangles > result.fullDetailTriangles) {
+                    printf("MISMATCH: levels of detail drew more than full detail\n");
+                    ok = false;
+                }
+            }
+        }
+        sceneMesh.setLodSelection(1.0f, true);
+        sceneMesh.reset();
+        view = ViewUniforms{};
+    }
+
+    shutdownHeadlessWebGPU();
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,148 @@
+// Mesh streaming benchmark. Generates a tiled terrain .mesh file with levels
+// of detail (see src/mesh-format.h and src/mesh-builder.h) and writes it to
+// --out, which is also the sample asset of the web app (serve it next to
+// app-demo.html and open ?mesh=scene.mesh).
+//
+// Then loads it headlessly through MeshStream twice:
+//   - streamed in --slice KB pieces, as fetch() hands them over on a cold
+//     load, rendering a frame after each piece
+//   - in one piece, as read back from the IndexedDB cache on a warm load
+// and reports how much of the file had to arrive before the first chunk was
+// drawn, the time to first frame at --mbps for the cold case, and the CPU
+// cost of getting the bytes onto the GPU.
+//
+//   bench-mesh-stream [--tiles N] [--grid N] [--slice KB] [--mbps N] [--out FILE] [--hardware]
+
+#include <algorithm>
+#include <fstream>
+
+#include "bench-webgpu.h"
+#include "terrain.h"
+
+namespace {
+
+struct LoadResult {
+    bool complete = false;
+    uint32_t chunks = 0;
+    // File bytes received when the first frame showing part of the mesh was rendered
+    uint64_t firstFrameBytes = 0;
+    // CPU time from the first byte to that frame being submitted, and to the end
+    double firstFrameMicroseconds = 0.0;
+    double totalMicroseconds = 0.0;
+    uint32_t frames = 0;
+};
+
+LoadResult load(std::vector<uint8_t> const & file, size_t sliceSize, WGPUTextureView target) {
+    LoadResult result;
+    sceneMesh.reset();
+    const auto start = BenchClock::now();
+    for (size_t offset = 0; offset < file.size(); offset += sliceSize) {
+        const size_t size = std::min(sliceSize, file.size() - offset);
+        // Where fetch() data lands on the web: straight into the staging file
+        memcpy(sceneMesh.reserve(size), file.data() + offset, size);
+        sceneMesh.commit(size);
+        if (sceneMesh.failed()) {
+            return result;
+        }
+        // One frame per slice, like the browser rendering between network reads
+        submitCommand(encodeFrame(target));
+        endFrame();
+        ++result.frames;
+        if (result.firstFrameBytes == 0 && sceneMesh.drawable()) {
+            result.firstFrameBytes = sceneMesh.bytesReceived();
+            result.firstFrameMicroseconds = elapsedMicroseconds(start, BenchClock::now());
+        }
+    }
+    waitForQueueIdle(device, queue);
+    result.totalMicroseconds = elapsedMicroseconds(start, BenchClock::now());
+    result.complete = sceneMesh.complete();
+    result.chunks = sceneMesh.chunksReady();
+    sceneMesh.releaseFileBytes();
+    return result;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const uint32_t tiles = (uint32_t)argOr(argc, argv, "--tiles", 8);
+    const uint32_t grid = (uint32_t)argOr(argc, argv, "--grid", 64);
+    const size_t sliceSize = (size_t)argOr(argc, argv, "--slice", 64) * 1024;
+    const double mbps = (double)argOr(argc, argv, "--mbps", 50);
+    const char* outPath = findArg(argc, argv, "--out");
+
+    const auto buildStart = BenchClock::now();
+    MeshBuildStats buildStats;
+    const std::vector<uint8_t> file = buildMeshFile(buildTerrainChunks(tiles, grid), MeshBuildOptions{}, &buildStats);
+    printf("mesh: %u chunks of %u triangles with %u levels of detail, %.1f KB, generated in %.1f ms\n", tiles * tiles,
+           grid * grid * 2, buildStats.lods, file.size() / 1024.0,
+           elapsedMicroseconds(buildStart, BenchClock::now()) * 1e-3);
+
+    const std::string path = outPath && *outPath ? outPath : "scene.mesh";
+    std::ofstream out(path, std::ios::binary);
+    out.write(reinterpret_cast<char const *>(file.data()), std::streamsize(file.size()));
+    if (!out) {
+        fprintf(stderr, "Could not write %s\n", path.c_str());
+        return 1;
+    }
+    out.close();
+    printf("wrote %s\n", path.c_str());
+
+    if (!initHeadlessWebGPU(argc, argv)) {
+        return 1;
+    }
+    const WGPUTextureFormat colorFormat = WGPUTextureFormat_BGRA8Unorm;
+    initWebGPUPipeline(colorFormat);
+    waitForPipelines();
+
+    bool ok = true;
+    {
+        OffscreenTarget target(device, 800, 600, colorFormat);
+        sceneMesh.setViewportSize(800, 600);
+        // Network time of a cold load at the given bandwidth, the CPU side runs alongside it
+        const double bytesPerMicrosecond = mbps * 1e6 / 8.0 * 1e-6;
+
+        const LoadResult cold = load(file, sliceSize, target.view.get());
+        const LoadResult warm = load(file, file.size(), target.view.get());
+
+        printf("%-6s %10s %14s %16s %14s %12s\n", "load", "slices", "bytes to 1st", "1st frame ms", "cpu total ms",
+               "chunks");
+        const char* names[] = {"cold", "warm"};
+        LoadResult const * results[] = {&cold, &warm};
+        for (int i = 0; i < 2; ++i) {
+            LoadResult const & result = *results[i];
+            printf("%-6s %10u %13.1f%% %16.2f %14.2f %6u / %u\n", names[i], result.frames,
+                   100.0 * result.firstFrameBytes / file.size(), result.firstFrameMicroseconds * 1e-3,
+                   result.totalMicroseconds * 1e-3, result.chunks, tiles * tiles);
+            ok = ok && result.complete && result.chunks == tiles * tiles && result.firstFrameBytes > 0;
+        }
+        printf("cold at %.0f Mbit/s: first frame after ~%.1f ms of download, whole file %.1f ms\n", mbps,
+               cold.firstFrameBytes / bytesPerMicrosecond * 1e-3, file.size() / bytesPerMicrosecond * 1e-3);
+
+        // A truncated or corrupt file must be rejected, not drawn out of bounds
+        std::vector<uint8_t> corrupt = file;
+        reinterpret_cast<MeshChunk*>(corrupt.data() + sizeof(MeshFileHeader))->indexCount = 0x7FFFFFFF;
+        sceneMesh.reset();
+        sceneMesh.append(corrupt.data(), corrupt.size());
+        if (!sceneMesh.failed()) {
+            printf("MISMATCH: corrupt chunk table was accepted\n");
+            ok = false;
+        }
+        // Nor may a corrupt size make it allocate gigabytes for the payload
+        corrupt = file;
+        reinterpret_cast<MeshFileHeader*>(corrupt.data())->payloadSize = 0xFFFFFFF0;
+        sceneMesh.reset();
+        sceneMesh.append(corrupt.data(), sizeof(MeshFileHeader));
+        if (!sceneMesh.failed()) {
+            printf("MISMATCH: a 4 GB payload size was accepted\n");
+            ok = false;
+        }
+        sceneMesh.reset();
+    }
+
+    shutdownHeadlessWebGPU();
+    if (!ok) {
+        printf("mesh did not load completely\n");
+        return 1;
+    }
+    return 0;
+}
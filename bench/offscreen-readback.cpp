@@ -0,0 +1,236 @@
+// Offscreen render-to-texture with readback through FrameReadback (a ring
+// of map-read buffers, see src/frame-readback.h).
+//
+// Golden images: renders a single triangle and checks known pixels, which
+// validates the copy layout and channel order on any adapter. Then renders the
+// benchmark scene (--instances, fixed seed, not animated) and compares it
+// with --golden FILE (binary PPM), writing the file when it does not exist
+// or with --update-golden. Pixels differing by more than --tolerance in any
+// channel count as mismatched; more than 0.1% of them fails the run.
+//
+// Throughput: renders --frames frames of the animated scene as fast as
+// possible, once without readback and once reading back every --every-th
+// frame. When the ring is full the frame waits for the oldest readback,
+// with --drop it is not read back instead. Reports frames/sec for both,
+// readback latency and time spent waiting.
+//
+// Exits with 1 when a check fails.
+//
+//   bench-offscreen-readback [--frames N] [--every N] [--ring N] [--drop] [--instances N]
+//                            [--width W] [--height H] [--golden FILE] [--update-golden]
+//                            [--tolerance N] [--hardware]
+
+#include <cstdlib>
+#include <fstream>
+#include <string>
+
+#include "bench-webgpu.h"
+#include "../src/frame-readback.h"
+
+namespace {
+
+const WGPUTextureFormat colorFormat = WGPUTextureFormat_BGRA8Unorm;
+
+/**
+ * Packed RGB, the PPM layout, of a BGRA8 frame.
+ */
+std::vector<uint8_t> bgraToRgb(uint8_t const * pixels, uint32_t pixelCount) {
+    std::vector<uint8_t> rgb(size_t(pixelCount) * 3);
+    for (uint32_t i = 0; i < pixelCount; ++i) {
+        rgb[3 * i + 0] = pixels[4 * i + 2];
+        rgb[3 * i + 1] = pixels[4 * i + 1];
+        rgb[3 * i + 2] = pixels[4 * i + 0];
+    }
+    return rgb;
+}
+
+bool writePpm(std::string const & path, std::vector<uint8_t> const & rgb, uint32_t width, uint32_t height) {
+    std::ofstream out(path, std::ios::binary);
+    out << "P6\n" << width << " " << height << "\n255\n";
+    out.write(reinterpret_cast<char const *>(rgb.data()), std::streamsize(rgb.size()));
+    return (bool)out;
+}
+
+bool readPpm(std::string const & path, std::vector<uint8_t>& rgb, uint32_t& width, uint32_t& height) {
+    std::ifstream in(path, std::ios::binary);
+    std::string magic;
+    uint32_t maxValue = 0;
+    if (!(in >> magic >> width >> height >> maxValue) || magic != "P6" || maxValue != 255) {
+        return false;
+    }
+    in.get();
+    rgb.resize(size_t(width) * height * 3);
+    in.read(reinterpret_cast<char*>(rgb.data()), std::streamsize(rgb.size()));
+    return (bool)in;
+}
+
+/**
+ * Render one frame of the current scene and block until its pixels are back.
+ */
+std::vector<uint8_t> renderAndRead(OffscreenTarget& target, FrameReadback& readback) {
+    std::vector<uint8_t> rgb;
+    readback.setCallback([&](uint64_t, uint8_t const * pixels) {
+        rgb = bgraToRgb(pixels, readback.width() * readback.height());
+    });
+    submitCommand(encodeFrame(target.view.get()));
+    endFrame();
+    while (!readback.capture(queue, target.texture.get(), 0)) {
+        pollEvents(device);
+    }
+    while (readback.inFlight() > 0) {
+        pollEvents(device);
+    }
+    readback.setCallback(nullptr);
+    return rgb;
+}
+
+bool checkPixel(std::vector<uint8_t> const & rgb, uint32_t width, uint32_t x, uint32_t y, uint8_t r, uint8_t g,
+                uint8_t b) {
+    uint8_t const * pixel = &rgb[(size_t(y) * width + x) * 3];
+    if (pixel[0] != r || pixel[1] != g || pixel[2] != b) {
+        printf("MISMATCH: pixel (%u, %u) is %u %u %u, expected %u %u %u\n", x, y, pixel[0], pixel[1], pixel[2], r, g, b);
+        return false;
+    }
+    return true;
+}
+
+struct ThroughputResult {
+    double framesPerSecond = 0.0;
+    // Frames that waited for a readback buffer, and for how long in total
+    uint32_t waits = 0;
+    double waitMilliseconds = 0.0;
+};
+
+ThroughputResult runFrames(OffscreenTarget& target, FrameReadback* readback, uint32_t frameCount, uint32_t every,
+                           bool drop) {
+    ThroughputResult result;
+    const auto start = BenchClock::now();
+    for (uint32_t i = 0; i < frameCount; ++i) {
+        animateBenchmarkScene();
+        submitCommand(encodeFrame(target.view.get()));
+        if (readback && i % every == 0) {
+            if (!drop && readback->inFlight() == readback->ringSize()) {
+                const auto waitStart = BenchClock::now();
+                while (readback->inFlight() == readback->ringSize()) {
+                    pollEvents(device);
+                }
+                ++result.waits;
+                result.waitMilliseconds += elapsedMicroseconds(waitStart, BenchClock::now()) * 1e-3;
+            }
+            readback->capture(queue, target.texture.get(), i);
+        }
+        pollEvents(device);
+        endFrame();
+    }
+    // The batch is done once the last frame has been rendered and read back
+    waitForQueueIdle(device, queue);
+    while (readback && readback->inFlight() > 0) {
+        pollEvents(device);
+    }
+    result.framesPerSecond = frameCount / (elapsedMicroseconds(start, BenchClock::now()) * 1e-6);
+    return result;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const uint32_t frameCount = (uint32_t)argOr(argc, argv, "--frames", 500);
+    const uint32_t every = std::max(1L, argOr(argc, argv, "--every", 1));
+    const uint32_t ringSize = (uint32_t)argOr(argc, argv, "--ring", FrameReadback::DefaultRingSize);
+    const bool drop = hasFlag(argc, argv, "--drop");
+    const uint32_t instanceCount = (uint32_t)argOr(argc, argv, "--instances", 2000);
+    const uint32_t width = (uint32_t)argOr(argc, argv, "--width", 800);
+    const uint32_t height = (uint32_t)argOr(argc, argv, "--height", 600);
+    const char* goldenPath = findArg(argc, argv, "--golden");
+    const bool updateGolden = hasFlag(argc, argv, "--update-golden");
+    const int tolerance = (int)argOr(argc, argv, "--tolerance", 2);
+
+    if (!initHeadlessWebGPU(argc, argv)) {
+        return 1;
+    }
+    initWebGPUPipeline(colorFormat);
+    waitForPipelines();
+
+    bool ok = true;
+    {
+        OffscreenTarget target(device, width, height, colorFormat);
+        FrameReadback readback;
+        readback.init(device, width, height, ringSize);
+
+        // One red triangle at the origin covers the center and not the corners
+        instances.resize(1);
+        instances.setTransform(0, InstanceTransform{});
+        instances.setColor(0, 0xFF0000FF);
+        const std::vector<uint8_t> triangle = renderAndRead(target, readback);
+        ok = checkPixel(triangle, width, width / 2, height / 2, 255, 0, 0) && ok;
+        ok = checkPixel(triangle, width, 0, 0, 0, 0, 0) && ok;
+        ok = checkPixel(triangle, width, width - 1, height - 1, 0, 0, 0) && ok;
+        printf("known pixels: %s\n", ok ? "ok" : "failed");
+
+        buildBenchmarkScene(instanceCount);
+        const std::vector<uint8_t> scene = renderAndRead(target, readback);
+        if (goldenPath && *goldenPath) {
+            std::vector<uint8_t> golden;
+            uint32_t goldenWidth = 0;
+            uint32_t goldenHeight = 0;
+            if (updateGolden || !readPpm(goldenPath, golden, goldenWidth, goldenHeight)) {
+                if (writePpm(goldenPath, scene, width, height)) {
+                    printf("golden: wrote %s\n", goldenPath);
+                } else {
+                    fprintf(stderr, "Could not write %s\n", goldenPath);
+                    ok = false;
+                }
+            } else if (goldenWidth != width || goldenHeight != height) {
+                printf("MISMATCH: golden image is %ux%u, rendered %ux%u\n", goldenWidth, goldenHeight, width, height);
+                ok = false;
+            } else {
+                uint32_t mismatched = 0;
+                int maxDifference = 0;
+                for (size_t i = 0; i < scene.size(); i += 3) {
+                    int difference = 0;
+                    for (size_t c = 0; c < 3; ++c) {
+                        difference = std::max(difference, std::abs(int(scene[i + c]) - int(golden[i + c])));
+                    }
+                    maxDifference = std::max(maxDifference, difference);
+                    mismatched += difference > tolerance ? 1 : 0;
+                }
+                // Rasterization may differ slightly between adapters on triangle edges
+                const uint32_t allowed = width * height / 1000;
+                printf("golden: %u pixels differ by more than %d (max difference %d, %u allowed)\n", mismatched,
+                       tolerance, maxDifference, allowed);
+                if (mismatched > allowed) {
+                    printf("MISMATCH: rendered image differs from %s\n", goldenPath);
+                    ok = false;
+                }
+            }
+        }
+
+        uint64_t bytesRead = 0;
+        readback.setCallback([&](uint64_t, uint8_t const *) { bytesRead += uint64_t(width) * height * 4; });
+        const ThroughputResult plain = runFrames(target, nullptr, frameCount, every, drop);
+        const ThroughputResult captured = runFrames(target, &readback, frameCount, every, drop);
+        FrameReadback::Stats const & stats = readback.stats();
+
+        printf("frames %u  target %ux%u  %u instances  readback every %u frame(s), ring of %u, %s when full\n",
+               frameCount, width, height, instanceCount, every, readback.ringSize(), drop ? "drop" : "wait");
+        printf("%-16s %10.1f\n", "frames/sec", plain.framesPerSecond);
+        printf("%-16s %10.1f  (%.1f MB/s read back)\n", "with readback", captured.framesPerSecond,
+               captured.framesPerSecond / every * width * height * 4 / 1e6);
+        printf("%-16s %10.2f ms mean, %.2f ms max\n", "latency",
+               stats.framesRead ? stats.totalLatencyMilliseconds / stats.framesRead : 0.0, stats.maxLatencyMilliseconds);
+        printf("%-16s %10u frames, %.2f ms total\n", "waited", captured.waits, captured.waitMilliseconds);
+        printf("%-16s %10llu dropped, %llu map failures\n", "ring full", (unsigned long long)stats.ringFull,
+               (unsigned long long)stats.mapFailures);
+
+        // Every capture of the batch (2 single frames before it) must have arrived
+        if (stats.framesRead != stats.framesCaptured || stats.mapFailures > 0
+                || bytesRead != (stats.framesRead - 2) * uint64_t(width) * height * 4) {
+            printf("MISMATCH: %llu frames captured, %llu read back\n", (unsigned long long)stats.framesCaptured,
+                   (unsigned long long)stats.framesRead);
+            ok = false;
+        }
+    }
+
+    shutdownHeadlessWebGPU();
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,81 @@
+// Render bundle benchmark: CPU time to encode a frame of many small draws,
+// encoded directly every frame versus replayed from a render bundle.
+//
+// The scene is --draws draws of --instances / --draws instances each. With
+// --change-every N the instance count changes every N frames, which forces
+// the bundle to be re-recorded, to show what invalidation costs.
+//
+//   bench-render-bundles [--frames N] [--draws N] [--instances N] [--change-every N] [--hardware]
+
+#include <random>
+
+#include "bench-webgpu.h"
+#include "../src/frame-stats.h"
+
+int main(int argc, char** argv) {
+    const uint32_t frameCount = (uint32_t)argOr(argc, argv, "--frames", 500);
+    const uint32_t drawCount = (uint32_t)argOr(argc, argv, "--draws", 10000);
+    const uint32_t instanceCount = (uint32_t)argOr(argc, argv, "--instances", drawCount);
+    const uint32_t changeEvery = (uint32_t)argOr(argc, argv, "--change-every", 0);
+
+    if (!initHeadlessWebGPU(argc, argv)) {
+        return 1;
+    }
+
+    const WGPUTextureFormat colorFormat = WGPUTextureFormat_BGRA8Unorm;
+    initWebGPUPipeline(colorFormat);
+    waitForPipelines();
+
+    {
+        OffscreenTarget target(device, 800, 600, colorFormat);
+        std::mt19937 rng(42);
+        std::uniform_real_distribution<float> position(-1.0f, 1.0f);
+
+        instances.resize(instanceCount);
+        for (uint32_t i = 0; i < instanceCount; ++i) {
+            instances.transforms()[i] = InstanceTransform{position(rng), position(rng), 0.02f, 0.0f};
+            instances.colors()[i] = 0xFF000000 | (rng() & 0x00FFFFFF);
+        }
+        sceneDrawCount = drawCount;
+
+        printf("draws %u  instances %u  frames %u  change every %u\n", drawCount, instanceCount, frameCount, changeEvery);
+        printf("%-10s %12s %12s %12s %12s %10s\n", "mode", "encode us", "p50 us", "p99 us", "submit us", "records");
+        for (bool bundled : {false, true}) {
+            renderBundlesEnabled = bundled;
+            instances.resize(instanceCount);
+
+            // Upload everything (and record the bundle) outside the measurements
+            submitCommand(encodeFrame(target.view.get()));
+            endFrame();
+            waitForQueueIdle(device, queue);
+
+            SampleStats encodeStats;
+            SampleStats submitStats;
+            uint32_t bundlesRecorded = 0;
+            for (uint32_t frame = 0; frame < frameCount; ++frame) {
+                if (changeEvery > 0 && frame % changeEvery == changeEvery - 1) {
+                    // Toggle the last instance so the draw structure changes
+                    instances.resize(instances.size() == instanceCount ? instanceCount - 1 : instanceCount);
+                }
+                const auto t0 = BenchClock::now();
+                Handle<WGPUCommandBuffer> command = encodeFrame(target.view.get());
+                const auto t1 = BenchClock::now();
+                submitCommand(command);
+                const auto t2 = BenchClock::now();
+
+                encodeStats.add(elapsedMicroseconds(t0, t1));
+                submitStats.add(elapsedMicroseconds(t1, t2));
+                bundlesRecorded += frameStats.bundlesRecorded;
+                // Keep the GPU from falling behind so both modes see an idle queue
+                waitForQueueIdle(device, queue);
+                endFrame();
+            }
+
+            printf("%-10s %12.1f %12.1f %12.1f %12.1f %10u\n", bundled ? "bundle" : "direct", encodeStats.mean(),
+                   encodeStats.percentile(0.5), encodeStats.percentile(0.99), submitStats.mean(), bundlesRecorded);
+        }
+    }
+
+    shutdownHeadlessWebGPU();
+    return 0;
+}
@@ -0,0 +1,122 @@
+// Headless renderFrame() benchmark: renders the demo scene into an offscreen
+// texture on a (by default software) adapter and reports CPU encode time,
+// submit time and frames per second.
+//
+// It also checks that the number of live WebGPU handles does not grow over
+// the run and exits with an error if it does, e.g. to soak test 100k frames:
+//
+//   bench-render-frame --frames 100000
+//
+// With --trace the CPU trace of the run is written as Chrome trace JSON.
+//
+//   bench-render-frame [--frames N] [--warmup N] [--width W] [--height H] [--trace FILE] [--hardware]
+
+#include <iterator>
+
+#include "bench-webgpu.h"
+#include "../src/frame-stats.h"
+#include "../src/trace.h"
+
+int main(int argc, char** argv) {
+    const uint32_t frameCount = (uint32_t)argOr(argc, argv, "--frames", 1000);
+    const uint32_t warmupCount = (uint32_t)argOr(argc, argv, "--warmup", 50);
+    const uint32_t width = (uint32_t)argOr(argc, argv, "--width", 800);
+    const uint32_t height = (uint32_t)argOr(argc, argv, "--height", 600);
+    const bool hardware = hasFlag(argc, argv, "--hardware");
+    const char* tracePath = findArg(argc, argv, "--trace");
+
+    if (!initHeadlessWebGPU(argc, argv)) {
+        return 1;
+    }
+
+    const WGPUTextureFormat colorFormat = WGPUTextureFormat_BGRA8Unorm;
+    initWebGPUPipeline(colorFormat);
+    waitForPipelines();
+    instances.resize(1);
+    instances.setColor(0, 0xFF0000FF);
+
+    bool leaked = false;
+    {
+        OffscreenTarget target(device, width, height, colorFormat);
+
+        for (uint32_t i = 0; i < warmupCount; ++i) {
+            submitCommand(encodeFrame(target.view.get()));
+            endFrame();
+        }
+        waitForQueueIdle(device, queue);
+        deferredReleases.collect();
+
+        int64_t liveBefore[HandleTypeCount];
+        std::copy(std::begin(liveHandleCounts), std::end(liveHandleCounts), liveBefore);
+
+        SampleStats encodeStats;
+        SampleStats submitStats;
+        uint64_t uploadBytes = 0;
+        uint64_t uploadCalls = 0;
+        encodeStats.reserve(frameCount);
+        submitStats.reserve(frameCount);
+
+        const FramePacer::Stats pacingBefore = framePacer.stats();
+        const auto benchStart = BenchClock::now();
+        for (uint32_t i = 0; i < frameCount; ++i) {
+            // Waiting for a free frame slot is not encode time
+            framePacer.beginFrame(device);
+            const auto t0 = BenchClock::now();
+            Handle<WGPUCommandBuffer> command = encodeFrame(target.view.get());
+            const auto t1 = BenchClock::now();
+            {
+                TRACE_SCOPE("submit");
+                submitCommand(command);
+            }
+            const auto t2 = BenchClock::now();
+
+            encodeStats.add(elapsedMicroseconds(t0, t1));
+            submitStats.add(elapsedMicroseconds(t1, t2));
+            uploadBytes += frameStats.uploadBytes;
+            uploadCalls += frameStats.uploadCalls;
+            pollEvents(device);
+            endFrame();
+        }
+        // Frames per second include the GPU catching up with the last submit
+        waitForQueueIdle(device, queue);
+        const double totalSeconds = elapsedMicroseconds(benchStart, BenchClock::now()) * 1e-6;
+        // Let the last batches age out so the comparison below is exact
+        for (int i = 0; i < 4; ++i) {
+            deferredReleases.endFrame(queue);
+            waitForQueueIdle(device, queue);
+            deferredReleases.collect();
+        }
+
+        printf("frames %u  target %ux%u  adapter %s\n", frameCount, width, height, hardware ? "hardware" : "software");
+        encodeStats.print("encode", "us");
+        submitStats.print("submit", "us");
+        printf("%-16s %10.1f\n", "frames/sec", frameCount / totalSeconds);
+        FramePacer::Stats const & pacing = framePacer.stats();
+        printf("%-16s %10.3f ms  %llu of %u frames waited (%u in flight)\n", "cpu wait/frame",
+               (pacing.totalWaitMilliseconds - pacingBefore.totalWaitMilliseconds) / frameCount,
+               (unsigned long long)(pacing.framesWaited - pacingBefore.framesWaited), frameCount,
+               framePacer.framesInFlight());
+        printf("%-16s %10.1f bytes  %.2f write calls\n", "upload/frame",
+               double(uploadBytes) / frameCount, double(uploadCalls) / frameCount);
+        for (GpuProfiler::PassTiming const & timing : gpuProfiler.timings()) {
+            printf("%-16s %10.3f ms (%s, last %u frames)\n", timing.name, timing.averageMilliseconds,
+                   gpuProfiler.usesTimestamps() ? "gpu" : "cpu encode", GpuProfiler::HistorySize);
+        }
+
+        for (size_t i = 0; i < HandleTypeCount; ++i) {
+            if (liveHandleCounts[i] > liveBefore[i]) {
+                printf("LEAK: %s grew from %lld to %lld\n", handleTypeName(HandleType(i)),
+                       (long long)liveBefore[i], (long long)liveHandleCounts[i]);
+                leaked = true;
+            }
+        }
+        printLiveHandles();
+    }
+
+    if (tracePath && !writeChromeTrace(tracePath)) {
+        fprintf(stderr, "No trace written (tracing compiled out or file not writable)\n");
+    }
+
+    shutdownHeadlessWebGPU();
+    return leaked ? 1 : 0;
+}
@@ -0,0 +1,206 @@
+// Scene graph benchmark. Builds the benchmark scene graph of --nodes nodes
+// (groups of a root, 10 children and 100 grandchildren) and moves a given
+// percentage of them every frame, either grouped (whole subtrees turn, as
+// when objects move) or scattered (single random nodes, mostly leaves).
+//
+// For each change rate it compares the incremental update, which only
+// recomputes the dirty subtrees, with recomputing every world transform, and
+// reports the CPU time of the update, the nodes recomputed and the instance
+// bytes uploaded per frame (uploads go by chunks of InstanceStore::ChunkSize
+// instances, so scattered changes touch more of them).
+//
+// Every world transform is then checked against a reference computed node by
+// node from the local transforms, also after adding nodes that force the
+// graph to be sorted again and after a child is appended under a former
+// leaf. Exits with 1 on a mismatch.
+//
+//   bench-scene-graph [--nodes N] [--frames N] [--hardware]
+
+#include <cmath>
+
+#include "bench-webgpu.h"
+#include "../src/frame-stats.h"
+
+namespace {
+
+struct RunResult {
+    double updateMilliseconds = 0.0;
+    double nodesUpdated = 0.0;
+    double subtreesUpdated = 0.0;
+    double uploadKilobytes = 0.0;
+};
+
+/**
+ * Move `changedFraction` of the nodes one at a time, picked by hash.
+ */
+void scatterChanges(float changedFraction, uint32_t frame) {
+    const uint32_t count = uint32_t(changedFraction * sceneGraph.size() + 0.5f);
+    for (uint32_t i = 0; i < count; ++i) {
+        const SceneGraph::NodeId node = ((i + 1) * 2654435761u ^ frame * 40503u) % sceneGraph.size();
+        InstanceTransform local = sceneGraph.local(node);
+        local.rotation += 0.02f;
+        sceneGraph.setLocal(node, local);
+    }
+}
+
+/**
+ * Compare every world transform, and the instance drawing it, with one
+ * computed from the local transforms. Parents always have smaller ids than
+ * their children, so one pass in id order is enough.
+ */
+bool checkWorldTransforms(char const * when) {
+    const uint32_t count = sceneGraph.size();
+    std::vector<InstanceTransform> reference(count);
+    for (SceneGraph::NodeId node = 0; node < count; ++node) {
+        InstanceTransform const & local = sceneGraph.local(node);
+        const SceneGraph::NodeId parent = sceneGraph.parent(node);
+        if (parent == SceneGraph::NoNode) {
+            reference[node] = local;
+            continue;
+        }
+        InstanceTransform const & p = reference[parent];
+        const float c = std::cos(p.rotation);
+        const float s = std::sin(p.rotation);
+        reference[node] = {p.x + p.scale * (c * local.x - s * local.y), p.y + p.scale * (s * local.x + c * local.y),
+                           p.scale * local.scale, p.rotation + local.rotation};
+    }
+
+    const float tolerance = 1e-4f;
+    for (SceneGraph::NodeId node = 0; node < count; ++node) {
+        InstanceTransform const & world = sceneGraph.world(node);
+        InstanceTransform const & expected = reference[node];
+        if (std::fabs(world.x - expected.x) > tolerance || std::fabs(world.y - expected.y) > tolerance
+                || std::fabs(world.scale - expected.scale) > tolerance
+                || std::fabs(world.rotation - expected.rotation) > tolerance) {
+            printf("MISMATCH %s: node %u at (%f, %f, %f, %f), expected (%f, %f, %f, %f)\n", when, node, world.x,
+                   world.y, world.scale, world.rotation, expected.x, expected.y, expected.scale, expected.rotation);
+            return false;
+        }
+        const uint32_t instance = sceneGraph.instance(node);
+        if (instance != SceneGraph::NoInstance
+                && memcmp(&instances.transforms()[instance], &world, sizeof(InstanceTransform)) != 0) {
+            printf("MISMATCH %s: instance %u does not hold the world transform of node %u\n", when, instance, node);
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const uint32_t nodeCount = (uint32_t)argOr(argc, argv, "--nodes", 111 * 1000);
+    const uint32_t frameCount = (uint32_t)argOr(argc, argv, "--frames", 100);
+
+    if (!initHeadlessWebGPU(argc, argv)) {
+        return 1;
+    }
+    const WGPUTextureFormat colorFormat = WGPUTextureFormat_BGRA8Unorm;
+    initWebGPUPipeline(colorFormat);
+    waitForPipelines();
+
+    bool ok = true;
+    {
+        OffscreenTarget target(device, 800, 600, colorFormat);
+        const auto buildStart = BenchClock::now();
+        buildBenchmarkSceneGraph(nodeCount);
+        const SceneGraph::Stats first = sceneGraph.update(instances);
+        printf("graph: %u nodes built and updated in %.2f ms (%s)\n", sceneGraph.size(),
+               elapsedMicroseconds(buildStart, BenchClock::now()) * 1e-3, first.reordered ? "sorted" : "in order");
+        submitCommand(encodeFrame(target.view.get()));
+        endFrame();
+        waitForQueueIdle(device, queue);
+
+        uint32_t frame = 0;
+        auto run = [&](bool scattered, float changedFraction, bool full) {
+            RunResult result;
+            for (uint32_t i = 0; i < frameCount; ++i) {
+                const auto t0 = BenchClock::now();
+                if (scattered) {
+                    scatterChanges(changedFraction, frame);
+                } else {
+                    animateBenchmarkSceneGraph(changedFraction, frame);
+                }
+                ++frame;
+                if (full) {
+                    sceneGraph.markAllDirty();
+                }
+                const SceneGraph::Stats stats = sceneGraph.update(instances);
+                const auto t1 = BenchClock::now();
+                submitCommand(encodeFrame(target.view.get()));
+                endFrame();
+                pollEvents(device);
+
+                result.updateMilliseconds += elapsedMicroseconds(t0, t1) * 1e-3;
+                result.nodesUpdated += stats.nodesUpdated;
+                result.subtreesUpdated += stats.subtreesUpdated;
+                result.uploadKilobytes += frameStats.uploadBytes / 1024.0;
+            }
+            result.updateMilliseconds /= frameCount;
+            result.nodesUpdated /= frameCount;
+            result.subtreesUpdated /= frameCount;
+            result.uploadKilobytes /= frameCount;
+            return result;
+        };
+
+        const float percents[] = {0.1f, 0.5f, 1.0f, 2.0f, 5.0f, 10.0f, 25.0f, 50.0f, 100.0f};
+        printf("%-10s %8s %12s %10s %10s %10s %8s %12s %12s\n", "changes", "percent", "nodes/frm", "subtrees",
+               "incr ms", "full ms", "speedup", "incr KB/frm", "full KB/frm");
+        for (bool scattered : {false, true}) {
+            for (float percent : percents) {
+                const RunResult incremental = run(scattered, percent / 100.0f, false);
+                const RunResult full = run(scattered, percent / 100.0f, true);
+                printf("%-10s %8.1f %12.0f %10.0f %10.3f %10.3f %7.1fx %12.1f %12.1f\n",
+                       scattered ? "scattered" : "grouped", percent, incremental.nodesUpdated,
+                       incremental.subtreesUpdated, incremental.updateMilliseconds, full.updateMilliseconds,
+                       full.updateMilliseconds / std::max(incremental.updateMilliseconds, 1e-6),
+                       incremental.uploadKilobytes, full.uploadKilobytes);
+            }
+            ok = checkWorldTransforms(scattered ? "after scattered changes" : "after grouped changes") && ok;
+        }
+
+        // Children of existing parents land in the middle of the order
+        for (uint32_t i = 0; i < 100; ++i) {
+            const SceneGraph::NodeId parent = (i * 2654435761u) % sceneGraph.size();
+            sceneGraph.addNode(parent, InstanceTransform{0.5f, 0.0f, 0.5f, 0.1f * i}, 0xFFFFFFFF, i % 4 != 0);
+        }
+        scatterChanges(0.01f, frame++);
+        const auto sortStart = BenchClock::now();
+        const SceneGraph::Stats sorted = sceneGraph.update(instances);
+        printf("100 nodes added under existing parents: %s and updated in %.2f ms\n",
+               sorted.reordered ? "sorted" : "in order", elapsedMicroseconds(sortStart, BenchClock::now()) * 1e-3);
+        if (!sorted.reordered || instances.size() != sceneGraph.drawnCount()) {
+            printf("MISMATCH: expected a sort and %u instances, got %u\n", sceneGraph.drawnCount(), instances.size());
+            ok = false;
+        }
+        ok = checkWorldTransforms("after sorting") && ok;
+        scatterChanges(0.05f, frame++);
+        sceneGraph.update(instances);
+        ok = checkWorldTransforms("after changes to the sorted graph") && ok;
+
+        // A child appended in order under a node that was a leaf when last
+        // updated, which needs the parent's rotation
+        const SceneGraph::NodeId leaf =
+                sceneGraph.addNode(SceneGraph::NoNode, InstanceTransform{0.0f, 0.0f, 1.0f, 0.0f});
+        sceneGraph.update(instances);
+        sceneGraph.setLocal(leaf, InstanceTransform{0.0f, 0.0f, 1.0f, 1.5707963f});
+        sceneGraph.update(instances);
+        const SceneGraph::NodeId child = sceneGraph.addNode(leaf, InstanceTransform{1.0f, 0.0f, 1.0f, 0.0f});
+        const SceneGraph::Stats appended = sceneGraph.update(instances);
+        if (appended.reordered) {
+            printf("MISMATCH: a child appended under the last node sorted the graph\n");
+            ok = false;
+        }
+        ok = checkWorldTransforms("after a child was added to a leaf") && ok;
+        if (std::fabs(sceneGraph.world(child).x) > 1e-4f || std::fabs(sceneGraph.world(child).y - 1.0f) > 1e-4f) {
+            printf("MISMATCH: child of a node turned a quarter at (%f, %f), expected (0, 1)\n",
+                   sceneGraph.world(child).x, sceneGraph.world(child).y);
+            ok = false;
+        }
+
+        waitForQueueIdle(device, queue);
+    }
+
+    shutdownHeadlessWebGPU();
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,290 @@
+// Scene update stream benchmark. Builds the benchmark scene graph of --nodes
+// nodes, then streams changes to it the way a server would: each message
+// moves a percentage of the nodes (scattered, picked by hash, every 16th one
+// changing color too) and only carries the quantized differences from the
+// previous message.
+//
+// In process, for each change rate and number of messages coalesced into a
+// frame, it reports the bytes per node update and how that compares with
+// sending raw state (node id, transform and color, 24 bytes), the encode
+// time, and the decode time and rate of applying a frame's messages to the
+// graph. The same stream then goes over a loopback WebSocket for --seconds,
+// the client applying what arrived every 16.7 ms like the web app.
+//
+// After every run the client's local transforms and colors must equal what
+// the server sent. Exits with 1 on a mismatch or a rejected message.
+//
+// With --serve it is instead a stand-in server for the web app: it streams
+// --rate messages per second moving --percent of the nodes to each client
+// connecting to ws://<host>:PORT, starting with a keyframe and sending one
+// again every --keyframe-interval messages. Open the app with
+// ?instances=N&stream=ws://localhost:PORT, N being the same --nodes.
+//
+//   bench-scene-stream [--nodes N] [--frames N] [--seconds S]
+//   bench-scene-stream --serve PORT [--nodes N] [--rate HZ] [--percent P] [--keyframe-interval N]
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+#include "bench-utils.h"
+#include "websocket-lite.h"
+#include "../src/scene.h"
+#include "../src/scene-stream.h"
+
+namespace {
+
+// Node id, transform and color
+constexpr double RawBytesPerUpdate = 4.0 + sizeof(InstanceTransform) + 4.0;
+
+/**
+ * The server's copy of the scene and the encoder tracking what it sent.
+ */
+struct ServerScene {
+    std::vector<InstanceTransform> locals;
+    std::vector<uint32_t> colors;
+    std::vector<uint32_t> changed;
+    SceneStreamEncoder encoder;
+    uint32_t step = 0;
+
+    // From the global scene graph, which both sides build the same way
+    void init() {
+        const uint32_t count = sceneGraph.size();
+        locals.resize(count);
+        colors.resize(count);
+        for (SceneGraph::NodeId node = 0; node < count; ++node) {
+            locals[node] = sceneGraph.local(node);
+            colors[node] = sceneGraph.color(node);
+        }
+        encoder.reset(count);
+    }
+
+    std::vector<uint8_t> const & keyframe() {
+        encoder.beginMessage(true);
+        for (uint32_t node = 0; node < locals.size(); ++node) {
+            encoder.update(node, locals[node], colors[node]);
+        }
+        return encoder.finishMessage();
+    }
+
+    std::vector<uint8_t> const & changes(float changedFraction) {
+        const uint32_t count = (uint32_t)locals.size();
+        const uint32_t changes = uint32_t(changedFraction * count + 0.5f);
+        changed.clear();
+        for (uint32_t i = 0; i < changes; ++i) {
+            changed.push_back(((i + 1) * 2654435761u ^ step * 40503u) % count);
+        }
+        // In order, so that most node ids cost a byte
+        std::sort(changed.begin(), changed.end());
+        changed.erase(std::unique(changed.begin(), changed.end()), changed.end());
+
+        encoder.beginMessage(false);
+        for (uint32_t node : changed) {
+            InstanceTransform& local = locals[node];
+            local.rotation += 0.02f;
+            local.x += 0.002f * std::sin(0.1f * step + node);
+            if (node % 16 == 0) {
+                colors[node] = 0xFF000000 | (colors[node] + 0x00010203);
+            }
+            encoder.update(node, local, colors[node]);
+        }
+        ++step;
+        return encoder.finishMessage();
+    }
+};
+
+/**
+ * The client's graph must hold exactly what the server sent.
+ */
+bool checkStreamedState(ServerScene const & server, SceneStreamDecoder const & decoder, char const * when) {
+    if (decoder.stats().errors > 0) {
+        printf("MISMATCH %s: %llu messages rejected\n", when, (unsigned long long)decoder.stats().errors);
+        return false;
+    }
+    for (SceneGraph::NodeId node = 0; node < sceneGraph.size(); ++node) {
+        const InstanceTransform expected = server.encoder.sentLocal(node);
+        InstanceTransform const & local = sceneGraph.local(node);
+        if (memcmp(&local, &expected, sizeof expected) != 0 || sceneGraph.color(node) != server.encoder.sentColor(node)) {
+            printf("MISMATCH %s: node %u holds (%f, %f, %f, %f) %08X, server sent (%f, %f, %f, %f) %08X\n", when, node,
+                   local.x, local.y, local.scale, local.rotation, sceneGraph.color(node), expected.x, expected.y,
+                   expected.scale, expected.rotation, server.encoder.sentColor(node));
+            return false;
+        }
+    }
+    return true;
+}
+
+int serve(uint16_t port, float changedFraction, double rate, uint32_t keyframeInterval) {
+    ServerScene server;
+    server.init();
+    const int listenFd = webSocketListen(port);
+    if (listenFd < 0) {
+        printf("Could not listen on port %u\n", port);
+        return 1;
+    }
+    printf("Streaming %u nodes on ws://0.0.0.0:%u, %.0f messages/s moving %.1f%% of the nodes each\n",
+           sceneGraph.size(), port, rate, changedFraction * 100.0f);
+
+    for (;;) {
+        WebSocketConnection client = webSocketAccept(listenFd);
+        if (!client.valid()) {
+            continue;
+        }
+        printf("Client connected\n");
+        std::vector<uint8_t> const & first = server.keyframe();
+        bool connected = client.sendBinary(first.data(), first.size());
+        const auto interval = std::chrono::duration<double>(1.0 / rate);
+        auto next = BenchClock::now();
+        auto reportStart = next;
+        uint64_t messages = 0, bytes = 0, updates = 0;
+        while (connected) {
+            next += std::chrono::duration_cast<BenchClock::duration>(interval);
+            std::this_thread::sleep_until(next);
+            const bool keyframe = keyframeInterval > 0 && (messages + 1) % keyframeInterval == 0;
+            std::vector<uint8_t> const & message = keyframe ? server.keyframe() : server.changes(changedFraction);
+            connected = client.sendBinary(message.data(), message.size());
+            ++messages;
+            bytes += message.size();
+            updates += keyframe ? server.locals.size() : server.changed.size();
+
+            const double elapsed = elapsedMicroseconds(reportStart, BenchClock::now()) * 1e-6;
+            if (elapsed >= 5.0) {
+                printf("%.0f messages/s, %.0f updates/s, %.1f KB/s, %.2f bytes/update\n", messages / elapsed,
+                       updates / elapsed, bytes / elapsed / 1024.0, updates > 0 ? double(bytes) / updates : 0.0);
+                reportStart = BenchClock::now();
+                messages = bytes = updates = 0;
+            }
+        }
+        printf("Client disconnected\n");
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const uint32_t nodeCount = (uint32_t)argOr(argc, argv, "--nodes", 111 * 1000);
+    const uint32_t frameCount = (uint32_t)argOr(argc, argv, "--frames", 200);
+    const double seconds = (double)argOr(argc, argv, "--seconds", 2);
+
+    buildBenchmarkSceneGraph(nodeCount);
+    sceneGraph.update(instances);
+
+    if (const char* port = findArg(argc, argv, "--serve")) {
+        const char* percent = findArg(argc, argv, "--percent");
+        return serve((uint16_t)atoi(port), percent ? float(atof(percent) / 100.0) : 0.01f,
+                     (double)argOr(argc, argv, "--rate", 240), (uint32_t)argOr(argc, argv, "--keyframe-interval", 0));
+    }
+
+    bool ok = true;
+    ServerScene server;
+    server.init();
+    SceneStreamDecoder decoder;
+    {
+        std::vector<uint8_t> const & keyframe = server.keyframe();
+        decoder.receive(keyframe.data(), keyframe.size());
+        decoder.apply(sceneGraph);
+        sceneGraph.update(instances);
+        printf("keyframe: %u nodes in %zu bytes, %.2f bytes/node (raw %.0f)\n", sceneGraph.size(), keyframe.size(),
+               double(keyframe.size()) / sceneGraph.size(), RawBytesPerUpdate);
+        ok = checkStreamedState(server, decoder, "after the keyframe") && ok;
+    }
+
+    printf("%8s %8s %12s %10s %10s %10s %12s %12s %10s\n", "percent", "msg/frm", "updates/frm", "bytes/upd",
+           "vs raw", "encode us", "decode ms", "Mupdates/s", "graph ms");
+    const float percents[] = {0.1f, 1.0f, 5.0f, 25.0f};
+    for (float percent : percents) {
+        for (uint32_t messagesPerFrame : {1u, 4u}) {
+            double encodeMicroseconds = 0.0, decodeMilliseconds = 0.0, graphMilliseconds = 0.0;
+            uint64_t bytes = 0, updates = 0;
+            for (uint32_t frame = 0; frame < frameCount; ++frame) {
+                for (uint32_t m = 0; m < messagesPerFrame; ++m) {
+                    const auto t0 = BenchClock::now();
+                    std::vector<uint8_t> const & message = server.changes(percent / 100.0f);
+                    encodeMicroseconds += elapsedMicroseconds(t0, BenchClock::now());
+                    decoder.receive(message.data(), message.size());
+                    bytes += message.size();
+                }
+                const auto t0 = BenchClock::now();
+                updates += decoder.apply(sceneGraph);
+                const auto t1 = BenchClock::now();
+                sceneGraph.update(instances);
+                const auto t2 = BenchClock::now();
+                decodeMilliseconds += elapsedMicroseconds(t0, t1) * 1e-3;
+                graphMilliseconds += elapsedMicroseconds(t1, t2) * 1e-3;
+            }
+            const double bytesPerUpdate = double(bytes) / std::max<uint64_t>(updates, 1);
+            printf("%8.1f %8u %12.0f %10.2f %9.1fx %10.1f %12.3f %12.1f %10.3f\n", percent, messagesPerFrame,
+                   double(updates) / frameCount, bytesPerUpdate, RawBytesPerUpdate / bytesPerUpdate,
+                   encodeMicroseconds / (frameCount * messagesPerFrame), decodeMilliseconds / frameCount,
+                   updates / std::max(decodeMilliseconds * 1e3, 1e-6), graphMilliseconds / frameCount);
+        }
+        ok = checkStreamedState(server, decoder, "after streaming changes") && ok;
+    }
+
+    // The same stream through a socket, as fast as the server can send
+    const int listenFd = webSocketListen(0);
+    if (listenFd < 0) {
+        printf("Could not listen on a loopback port, skipping the socket run\n");
+        return ok ? 0 : 1;
+    }
+    const uint16_t port = webSocketPort(listenFd);
+    uint64_t sentMessages = 0;
+    std::thread serverThread([&]() {
+        WebSocketConnection client = webSocketAccept(listenFd);
+        std::vector<uint8_t> const & keyframe = server.keyframe();
+        bool connected = client.valid() && client.sendBinary(keyframe.data(), keyframe.size());
+        const auto start = BenchClock::now();
+        while (connected && elapsedMicroseconds(start, BenchClock::now()) < seconds * 1e6) {
+            std::vector<uint8_t> const & message = server.changes(0.01f);
+            connected = client.sendBinary(message.data(), message.size());
+            ++sentMessages;
+        }
+        client.close(true);
+    });
+
+    SceneStreamDecoder socketDecoder;
+    WebSocketConnection connection = webSocketConnect("127.0.0.1", port);
+    if (!connection.valid()) {
+        printf("MISMATCH: could not connect to the loopback server\n");
+        serverThread.join();
+        close(listenFd);
+        return 1;
+    }
+    std::vector<uint8_t> message;
+    SampleStats messagesPerFrame, decodeMilliseconds;
+    const auto start = BenchClock::now();
+    auto frameStart = start;
+    uint64_t bytes = 0;
+    auto applyFrame = [&]() {
+        socketDecoder.apply(sceneGraph);
+        sceneGraph.update(instances);
+        messagesPerFrame.add(socketDecoder.stats().frameMessages);
+        decodeMilliseconds.add(socketDecoder.stats().frameDecodeMilliseconds);
+    };
+    while (connection.receive(message)) {
+        socketDecoder.receive(message.data(), message.size());
+        bytes += message.size();
+        if (elapsedMicroseconds(frameStart, BenchClock::now()) >= 16667.0) {
+            applyFrame();
+            frameStart = BenchClock::now();
+        }
+    }
+    applyFrame();
+    const double elapsed = elapsedMicroseconds(start, BenchClock::now()) * 1e-6;
+    serverThread.join();
+    close(listenFd);
+
+    SceneStreamDecoder::Stats const & stats = socketDecoder.stats();
+    printf("loopback socket: %llu messages (%llu sent) in %.2f s, %.0f updates/s, %.1f MB/s, %.2f bytes/update\n",
+           (unsigned long long)stats.messages, (unsigned long long)sentMessages + 1, elapsed, stats.records / elapsed,
+           bytes / elapsed / (1024.0 * 1024.0), double(bytes) / std::max<uint64_t>(stats.records, 1));
+    messagesPerFrame.print("messages/frame", "msg");
+    decodeMilliseconds.print("decode", "ms ");
+    if (stats.messages != sentMessages + 1) {
+        printf("MISMATCH: received %llu messages, %llu were sent\n", (unsigned long long)stats.messages,
+               (unsigned long long)sentMessages + 1);
+        ok = false;
+    }
+    ok = checkStreamedState(server, socketDecoder, "after the socket run") && ok;
+    return ok ? 0 : 1;
+}
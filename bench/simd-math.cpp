@@ -0,0 +1,160 @@
+// SIMD math microbenchmarks: mat4 multiply, batched SoA point transform and
+// batched AABB-vs-frustum culling, each timed on the compiled SIMD path
+// (wasm simd128 or SSE) and on the scalar path.
+//
+// Every run first checks that both paths agree on the same random inputs
+// and exits with an error if they do not, so it doubles as a correctness
+// check of the SIMD code. Builds natively and with emcmake (run the .js
+// with node to measure the simd128 path).
+//
+//   bench-simd-math [--count N] [--repeat N]
+
+#include <cmath>
+#include <random>
+
+#include "bench-utils.h"
+#include "../src/simd-math.h"
+
+static bool nearlyEqual(float a, float b) {
+    return std::fabs(a - b) <= 1e-5f * std::max(1.0f, std::max(std::fabs(a), std::fabs(b)));
+}
+
+static Mat4 randomMatrix(std::mt19937& rng) {
+    std::uniform_real_distribution<float> value(-2.0f, 2.0f);
+    Mat4 m;
+    for (Vec4& column : m.columns) {
+        column = Vec4{value(rng), value(rng), value(rng), value(rng)};
+    }
+    return m;
+}
+
+// Time `repeat` calls of `body` and return the best run in microseconds,
+// the least disturbed by the rest of the system
+template <typename Body>
+static double bestOf(uint32_t repeat, Body&& body) {
+    double best = 1e30;
+    for (uint32_t r = 0; r < repeat; ++r) {
+        const auto t0 = BenchClock::now();
+        body();
+        best = std::min(best, elapsedMicroseconds(t0, BenchClock::now()));
+    }
+    return best;
+}
+
+static void printRow(const char* name, size_t count, double simdUs, double scalarUs) {
+    printf("%-20s %10zu %12.1f %12.1f %8.2fx %10.2f\n", name, count, simdUs, scalarUs, scalarUs / simdUs,
+           count / simdUs);
+}
+
+int main(int argc, char** argv) {
+    const size_t count = (size_t)argOr(argc, argv, "--count", 1 << 20);
+    const uint32_t repeat = (uint32_t)argOr(argc, argv, "--repeat", 20);
+
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> position(-20.0f, 20.0f);
+    std::uniform_real_distribution<float> extent(0.1f, 2.0f);
+
+    std::vector<float> x(count), y(count), z(count);
+    std::vector<float> minX(count), minY(count), minZ(count), maxX(count), maxY(count), maxZ(count);
+    for (size_t i = 0; i < count; ++i) {
+        x[i] = position(rng);
+        y[i] = position(rng);
+        z[i] = position(rng);
+        minX[i] = x[i] - extent(rng);
+        minY[i] = y[i] - extent(rng);
+        minZ[i] = z[i] - extent(rng);
+        maxX[i] = x[i] + extent(rng);
+        maxY[i] = y[i] + extent(rng);
+        maxZ[i] = z[i] + extent(rng);
+    }
+    const AabbArrays boxes = {minX.data(), minY.data(), minZ.data(), maxX.data(), maxY.data(), maxZ.data()};
+
+    const Mat4 transform = mat4Multiply(mat4Translation(1.0f, -2.0f, 0.5f),
+                                        mat4Multiply(mat4RotationZ(0.3f), mat4Scale(1.5f, 1.5f, 1.5f)));
+    const Mat4 viewProjection = mat4Multiply(mat4Orthographic(-10.0f, 10.0f, -10.0f, 10.0f, -10.0f, 10.0f),
+                                             mat4RotationZ(0.7f));
+    const Frustum frustum = frustumFromMatrix(viewProjection);
+
+    // Correctness: SIMD against scalar on the same inputs
+    bool ok = true;
+    for (int i = 0; i < 1000 && ok; ++i) {
+        const Mat4 a = randomMatrix(rng);
+        const Mat4 b = randomMatrix(rng);
+        const Mat4 simd = mat4Multiply(a, b);
+        const Mat4 scalar = mat4MultiplyScalar(a, b);
+        for (int c = 0; c < 4 && ok; ++c) {
+            ok = nearlyEqual(simd.columns[c].x, scalar.columns[c].x) && nearlyEqual(simd.columns[c].y, scalar.columns[c].y)
+                 && nearlyEqual(simd.columns[c].z, scalar.columns[c].z) && nearlyEqual(simd.columns[c].w, scalar.columns[c].w);
+        }
+    }
+    if (!ok) printf("MISMATCH: mat4Multiply\n");
+
+    std::vector<float> outX(count), outY(count), outZ(count);
+    std::vector<float> refX(count), refY(count), refZ(count);
+    transformPoints(transform, x.data(), y.data(), z.data(), outX.data(), outY.data(), outZ.data(), count);
+    transformPointsScalar(transform, x.data(), y.data(), z.data(), refX.data(), refY.data(), refZ.data(), count);
+    for (size_t i = 0; i < count; ++i) {
+        if (!nearlyEqual(outX[i], refX[i]) || !nearlyEqual(outY[i], refY[i]) || !nearlyEqual(outZ[i], refZ[i])) {
+            printf("MISMATCH: transformPoints at %zu\n", i);
+            ok = false;
+            break;
+        }
+    }
+
+    std::vector<uint8_t> visible(count), refVisible(count);
+    const size_t visibleCount = cullAabbs(frustum, boxes, count, visible.data());
+    const size_t refVisibleCount = cullAabbsScalar(frustum, boxes, count, refVisible.data());
+    if (visibleCount != refVisibleCount || visible != refVisible) {
+        printf("MISMATCH: cullAabbs (%zu visible, scalar %zu)\n", visibleCount, refVisibleCount);
+        ok = false;
+    }
+    // Sanity check of the frustum itself: a box around the origin is visible,
+    // one far outside the ortho volume is not
+    const float inside[6] = {-1, -1, -1, 1, 1, 1};
+    const float outside[6] = {50, 50, 0, 51, 51, 1};
+    uint8_t insideVisible = 0, outsideVisible = 1;
+    cullAabbsScalar(frustum, {&inside[0], &inside[1], &inside[2], &inside[3], &inside[4], &inside[5]}, 1, &insideVisible);
+    cullAabbsScalar(frustum, {&outside[0], &outside[1], &outside[2], &outside[3], &outside[4], &outside[5]}, 1, &outsideVisible);
+    if (insideVisible != 1 || outsideVisible != 0) {
+        printf("MISMATCH: frustumFromMatrix planes\n");
+        ok = false;
+    }
+
+    printf("backend %s  count %zu  best of %u  (%zu of %zu boxes visible)\n", simdMathBackend(), count, repeat,
+           visibleCount, count);
+    printf("%-20s %10s %12s %12s %9s %10s\n", "", "elements", "simd us", "scalar us", "speedup", "M/s simd");
+
+    const size_t matrixCount = count / 16;
+    std::vector<Mat4> matrices(matrixCount);
+    for (Mat4& m : matrices) m = randomMatrix(rng);
+    std::vector<Mat4> products(matrixCount);
+    const double mulSimd = bestOf(repeat, [&] {
+        for (size_t i = 0; i < matrixCount; ++i) products[i] = mat4Multiply(transform, matrices[i]);
+    });
+    const double mulScalar = bestOf(repeat, [&] {
+        for (size_t i = 0; i < matrixCount; ++i) products[i] = mat4MultiplyScalar(transform, matrices[i]);
+    });
+    printRow("mat4Multiply", matrixCount, mulSimd, mulScalar);
+
+    const double transformSimd = bestOf(repeat, [&] {
+        transformPoints(transform, x.data(), y.data(), z.data(), outX.data(), outY.data(), outZ.data(), count);
+    });
+    const double transformScalar = bestOf(repeat, [&] {
+        transformPointsScalar(transform, x.data(), y.data(), z.data(), outX.data(), outY.data(), outZ.data(), count);
+    });
+    printRow("transformPoints", count, transformSimd, transformScalar);
+
+    const double cullSimd = bestOf(repeat, [&] { cullAabbs(frustum, boxes, count, visible.data()); });
+    const double cullScalar = bestOf(repeat, [&] { cullAabbsScalar(frustum, boxes, count, visible.data()); });
+    printRow("cullAabbs", count, cullSimd, cullScalar);
+
+    // Keep the results alive so the loops are not optimized away
+    volatile float sink = products[matrixCount / 2].columns[1].y + outX[count / 2];
+    (void)sink;
+
+    if (!ok) {
+        printf("SIMD and scalar paths disagree\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+
+#include "../src/mesh-builder.h"
+
+inline uint32_t packColor(float r, float g, float b) {
+    auto channel = [](float v) { return uint32_t(std::clamp(v, 0.0f, 1.0f) * 255.0f + 0.5f); };
+    return channel(r) | channel(g) << 8 | channel(b) << 16 | 0xFFu << 24;
+}
+
+/**
+ * `tiles` x `tiles` chunks covering [-1, 1]^2, each a `grid` x `grid` quad
+ * patch of a height field colored by height. Chunks are ordered from the
+ * center out so that a streamed load fills the middle of the view first.
+ * Shared by the mesh benchmarks, which write it with buildMeshFile().
+ */
+inline std::vector<MeshBuildChunk> buildTerrainChunks(uint32_t tiles, uint32_t grid) {
+    struct Tile {
+        uint32_t x, y;
+        float distance;
+    };
+    std::vector<Tile> order;
+    for (uint32_t y = 0; y < tiles; ++y) {
+        for (uint32_t x = 0; x < tiles; ++x) {
+            const float cx = (x + 0.5f) / tiles - 0.5f;
+            const float cy = (y + 0.5f) / tiles - 0.5f;
+            order.push_back({x, y, cx * cx + cy * cy});
+        }
+    }
+    std::stable_sort(order.begin(), order.end(), [](Tile const & a, Tile const & b) { return a.distance < b.distance; });
+
+    std::vector<MeshBuildChunk> chunks(tiles * tiles);
+    const float tileSize = 2.0f / tiles;
+    for (uint32_t c = 0; c < tiles * tiles; ++c) {
+        const float originX = -1.0f + order[c].x * tileSize;
+        const float originY = -1.0f + order[c].y * tileSize;
+        std::vector<MeshVertex>& vertices = chunks[c].vertices;
+        vertices.resize((grid + 1) * (grid + 1));
+        for (uint32_t j = 0; j <= grid; ++j) {
+            for (uint32_t i = 0; i <= grid; ++i) {
+                const float x = originX + tileSize * i / grid;
+                const float y = originY + tileSize * j / grid;
+                const float h = 0.05f * std::sin(7.0f * x) * std::cos(5.0f * y) + 0.05f * std::sin(13.0f * (x + y));
+                const float t = (h + 0.1f) * 5.0f;
+                MeshVertex& v = vertices[j * (grid + 1) + i];
+                v.position[0] = x;
+                v.position[1] = y;
+                v.position[2] = h;
+                v.color = packColor(0.2f + 0.6f * t, 0.35f + 0.4f * t, 0.5f - 0.3f * t);
+            }
+        }
+        std::vector<uint32_t>& indices = chunks[c].indices;
+        indices.reserve(grid * grid * 6);
+        for (uint32_t j = 0; j < grid; ++j) {
+            for (uint32_t i = 0; i < grid; ++i) {
+                const uint32_t v0 = j * (grid + 1) + i;
+                const uint32_t v1 = v0 + 1;
+                const uint32_t v2 = v0 + grid + 1;
+                const uint32_t v3 = v2 + 1;
+                const uint32_t quad[6] = {v0, v1, v2, v1, v3, v2};
+                indices.insert(indices.end(), std::begin(quad), std::end(quad));
+            }
+        }
+    }
+    return chunks;
+}
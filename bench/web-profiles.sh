@@ -0,0 +1,50 @@
+#!/bin/sh
+# Web build profile comparison. Builds the web app once per variant:
+#   checked        SAFE_HEAP, assertions and exception catching (development)
+#   production-O3  no runtime checks, LTO, closure, wasm-opt -O3
+#   production-Oz  the same optimized for size
+# and records the raw and gzip size of the .wasm and .js of each (the
+# size-report target). With --browser it also runs every variant's benchmark
+# mode (?instances=N&frames=F&scale=1, full resolution so every variant
+# draws the same pixels) through emrun and records the startup line
+# (runtime = wasm download, compile and instantiate; first frame) and the
+# frame time line the page prints.
+#
+# Run from the repository root with emsdk activated:
+#
+#   bench/web-profiles.sh [--browser chrome] [--instances N] [--frames N] [--backend webgpu|webgl2]
+
+set -e
+
+BROWSER=""
+INSTANCES=10000
+FRAMES=300
+BACKEND=webgpu
+while [ $# -gt 0 ]; do
+    case "$1" in
+        --browser) BROWSER="$2"; shift 2 ;;
+        --instances) INSTANCES="$2"; shift 2 ;;
+        --frames) FRAMES="$2"; shift 2 ;;
+        --backend) BACKEND="$2"; shift 2 ;;
+        *) echo "unknown argument $1" >&2; exit 1 ;;
+    esac
+done
+
+for VARIANT in checked production-O3 production-Oz; do
+    case "$VARIANT" in
+        checked) FLAGS="-DWEB_BUILD_PROFILE=checked" ;;
+        production-*) FLAGS="-DWEB_BUILD_PROFILE=production -DWEB_OPTIMIZE_LEVEL=${VARIANT#production-}" ;;
+    esac
+    BUILD_DIR="build-web-$VARIANT"
+    echo "== $VARIANT"
+    emcmake cmake -S . -B "$BUILD_DIR" -DCMAKE_BUILD_TYPE=Release -DRENDERER_BACKEND="$BACKEND" $FLAGS > /dev/null
+    cmake --build "$BUILD_DIR" --target size-report 2>&1 | grep "^size "
+
+    if [ -n "$BROWSER" ]; then
+        # The page never exits by itself, emrun closes it after the timeout.
+        # Arguments after the page become its query string.
+        emrun --browser "$BROWSER" --timeout 60 --kill_exit \
+            "$BUILD_DIR/app-demo.html" "instances=$INSTANCES" "frames=$FRAMES" "scale=1" 2>&1 \
+            | grep -E "^(Startup|Benchmark)" || echo "no timings (did the page run?)"
+    fi
+done
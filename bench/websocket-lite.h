@@ -0,0 +1,382 @@
+#pragma once
+
+// Minimal blocking WebSocket (RFC 6455) over POSIX TCP sockets for the
+// native benchmarks: enough to stand in for the server the web app connects
+// to, and to be its client over loopback. No extensions, no TLS, messages
+// are sent in one frame.
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+inline void sha1(uint8_t const * data, size_t size, uint8_t digest[20]) {
+    uint32_t h[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+    auto rotl = [](uint32_t v, int n) { return (v << n) | (v >> (32 - n)); };
+
+    // Padded to a multiple of 64 bytes, bit length at the end
+    std::vector<uint8_t> message(data, data + size);
+    message.push_back(0x80);
+    while (message.size() % 64 != 56) {
+        message.push_back(0);
+    }
+    const uint64_t bits = uint64_t(size) * 8;
+    for (int i = 7; i >= 0; --i) {
+        message.push_back(uint8_t(bits >> (i * 8)));
+    }
+
+    for (size_t block = 0; block < message.size(); block += 64) {
+        uint32_t w[80];
+        for (int i = 0; i < 16; ++i) {
+            uint8_t const * p = &message[block + i * 4];
+            w[i] = uint32_t(p[0]) << 24 | uint32_t(p[1]) << 16 | uint32_t(p[2]) << 8 | p[3];
+        }
+        for (int i = 16; i < 80; ++i) {
+            w[i] = rotl(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+        }
+        uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+        for (int i = 0; i < 80; ++i) {
+            uint32_t f, k;
+            if (i < 20) {
+                f = (b & c) | (~b & d);
+                k = 0x5A827999;
+            } else if (i < 40) {
+                f = b ^ c ^ d;
+                k = 0x6ED9EBA1;
+            } else if (i < 60) {
+                f = (b & c) | (b & d) | (c & d);
+                k = 0x8F1BBCDC;
+            } else {
+                f = b ^ c ^ d;
+                k = 0xCA62C1D6;
+            }
+            const uint32_t t = rotl(a, 5) + f + e + k + w[i];
+            e = d;
+            d = c;
+            c = rotl(b, 30);
+            b = a;
+            a = t;
+        }
+        h[0] += a;
+        h[1] += b;
+        h[2] += c;
+        h[3] += d;
+        h[4] += e;
+    }
+    for (int i = 0; i < 20; ++i) {
+        digest[i] = uint8_t(h[i / 4] >> (24 - (i % 4) * 8));
+    }
+}
+
+inline std::string base64(uint8_t const * data, size_t size) {
+    static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string out;
+    for (size_t i = 0; i < size; i += 3) {
+        const uint32_t v = uint32_t(data[i]) << 16 | (i + 1 < size ? uint32_t(data[i + 1]) << 8 : 0)
+                | (i + 2 < size ? data[i + 2] : 0);
+        out += alphabet[(v >> 18) & 63];
+        out += alphabet[(v >> 12) & 63];
+        out += i + 1 < size ? alphabet[(v >> 6) & 63] : '=';
+        out += i + 2 < size ? alphabet[v & 63] : '=';
+    }
+    return out;
+}
+
+/**
+ * Sec-WebSocket-Accept answering a Sec-WebSocket-Key.
+ */
+inline std::string webSocketAcceptKey(std::string const & key) {
+    const std::string text = key + "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+    uint8_t digest[20];
+    sha1((uint8_t const *)text.data(), text.size(), digest);
+    return base64(digest, sizeof digest);
+}
+
+class WebSocketConnection {
+public:
+    WebSocketConnection() = default;
+    // Clients mask what they send, servers do not
+    WebSocketConnection(int fd, bool client) : m_fd(fd), m_client(client) {}
+    WebSocketConnection(WebSocketConnection&& other) noexcept : m_fd(other.m_fd), m_client(other.m_client) {
+        other.m_fd = -1;
+    }
+    WebSocketConnection& operator=(WebSocketConnection&& other) noexcept {
+        std::swap(m_fd, other.m_fd);
+        std::swap(m_client, other.m_client);
+        return *this;
+    }
+    ~WebSocketConnection() { close(); }
+
+    bool valid() const { return m_fd >= 0; }
+
+    bool sendBinary(void const * data, size_t size) { return sendFrame(0x2, (uint8_t const *)data, size); }
+
+    /**
+     * Block until the next whole message. Answers pings. Returns false once
+     * the peer closed the connection or it failed.
+     */
+    bool receive(std::vector<uint8_t>& message) {
+        message.clear();
+        for (;;) {
+            uint8_t header[2];
+            if (!receiveAll(header, 2)) {
+                return false;
+            }
+            const bool fin = (header[0] & 0x80) != 0;
+            const uint8_t opcode = header[0] & 0x0F;
+            uint64_t length = header[1] & 0x7F;
+            if (length >= 126) {
+                uint8_t extended[8];
+                const size_t bytes = length == 126 ? 2 : 8;
+                if (!receiveAll(extended, bytes)) {
+                    return false;
+                }
+                length = 0;
+                for (size_t i = 0; i < bytes; ++i) {
+                    length = length << 8 | extended[i];
+                }
+            }
+            uint8_t mask[4] = {};
+            if ((header[1] & 0x80) && !receiveAll(mask, 4)) {
+                return false;
+            }
+
+            const size_t offset = opcode == 0 ? message.size() : 0;
+            std::vector<uint8_t>& payload = opcode >= 0x8 ? m_control : message;
+            payload.resize(offset + length);
+            if (length > 0 && !receiveAll(&payload[offset], length)) {
+                return false;
+            }
+            if (header[1] & 0x80) {
+                for (uint64_t i = 0; i < length; ++i) {
+                    payload[offset + i] ^= mask[i % 4];
+                }
+            }
+
+            if (opcode == 0x8) {
+                sendFrame(0x8, m_control.data(), std::min<size_t>(m_control.size(), 2));
+                return false;
+            } else if (opcode == 0x9) {
+                sendFrame(0xA, m_control.data(), m_control.size());
+            } else if (opcode < 0x8 && fin) {
+                return true;
+            }
+        }
+    }
+
+    /**
+     * Close the connection, telling the peer if `notify`.
+     */
+    void close(bool notify = false) {
+        if (m_fd >= 0) {
+            if (notify) {
+                const uint8_t normalClosure[2] = {0x03, 0xE8};
+                sendFrame(0x8, normalClosure, 2);
+            }
+            ::close(m_fd);
+            m_fd = -1;
+        }
+    }
+
+private:
+    bool sendFrame(uint8_t opcode, uint8_t const * data, size_t size) {
+        m_frame.clear();
+        m_frame.push_back(0x80 | opcode);
+        const uint8_t masked = m_client ? 0x80 : 0;
+        if (size < 126) {
+            m_frame.push_back(masked | uint8_t(size));
+        } else if (size <= 0xFFFF) {
+            m_frame.push_back(masked | 126);
+            m_frame.push_back(uint8_t(size >> 8));
+            m_frame.push_back(uint8_t(size));
+        } else {
+            m_frame.push_back(masked | 127);
+            for (int i = 7; i >= 0; --i) {
+                m_frame.push_back(uint8_t(uint64_t(size) >> (i * 8)));
+            }
+        }
+        const size_t offset = m_frame.size() + (m_client ? 4 : 0);
+        if (m_client) {
+            // Any key works, it only protects proxies from crafted payloads
+            const uint8_t mask[4] = {0x12, 0x34, 0x56, 0x78};
+            m_frame.insert(m_frame.end(), mask, mask + 4);
+        }
+        m_frame.insert(m_frame.end(), data, data + size);
+        if (m_client) {
+            for (size_t i = 0; i < size; ++i) {
+                m_frame[offset + i] ^= m_frame[offset - 4 + i % 4];
+            }
+        }
+        return sendAll(m_frame.data(), m_frame.size());
+    }
+
+    bool sendAll(uint8_t const * data, size_t size) {
+        while (size > 0 && m_fd >= 0) {
+            const ssize_t sent = ::send(m_fd, data, size, MSG_NOSIGNAL);
+            if (sent <= 0) {
+                return false;
+            }
+            data += sent;
+            size -= size_t(sent);
+        }
+        return size == 0;
+    }
+
+    bool receiveAll(uint8_t* data, size_t size) {
+        while (size > 0 && m_fd >= 0) {
+            const ssize_t received = ::recv(m_fd, data, size, 0);
+            if (received <= 0) {
+                return false;
+            }
+            data += received;
+            size -= size_t(received);
+        }
+        return size == 0;
+    }
+
+    int m_fd = -1;
+    bool m_client = false;
+    std::vector<uint8_t> m_frame;
+    std::vector<uint8_t> m_control;
+};
+
+namespace websocket_detail {
+
+// The HTTP request or response, up to the blank line ending it, read a byte
+// at a time so that no frame bytes are consumed
+inline bool readHttpHeader(int fd, std::string& header) {
+    header.clear();
+    char c;
+    while (header.size() < 8192 && ::recv(fd, &c, 1, 0) == 1) {
+        header += c;
+        if (header.size() >= 4 && header.compare(header.size() - 4, 4, "\r\n\r\n") == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+inline std::string headerValue(std::string const & header, std::string name) {
+    std::string lower = header;
+    for (char& c : lower) {
+        c = (char)tolower((unsigned char)c);
+    }
+    for (char& c : name) {
+        c = (char)tolower((unsigned char)c);
+    }
+    const size_t at = lower.find("\r\n" + name + ":");
+    if (at == std::string::npos) {
+        return "";
+    }
+    size_t begin = at + name.size() + 3;
+    const size_t end = header.find("\r\n", begin);
+    while (begin < end && header[begin] == ' ') {
+        ++begin;
+    }
+    return header.substr(begin, end - begin);
+}
+
+inline void setNoDelay(int fd) {
+    const int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof one);
+}
+
+} // namespace websocket_detail
+
+/**
+ * Listening TCP socket on every interface, port 0 for any free one. -1 on
+ * failure.
+ */
+inline int webSocketListen(uint16_t port) {
+    const int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    const int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof one);
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(port);
+    if (bind(fd, (sockaddr*)&address, sizeof address) != 0 || listen(fd, 4) != 0) {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+inline uint16_t webSocketPort(int listenFd) {
+    sockaddr_in address = {};
+    socklen_t size = sizeof address;
+    getsockname(listenFd, (sockaddr*)&address, &size);
+    return ntohs(address.sin_port);
+}
+
+/**
+ * Wait for a client and complete its upgrade request. Invalid if the
+ * request was not a WebSocket one.
+ */
+inline WebSocketConnection webSocketAccept(int listenFd) {
+    const int fd = accept(listenFd, nullptr, nullptr);
+    if (fd < 0) {
+        return {};
+    }
+    WebSocketConnection connection(fd, false);
+    std::string request;
+    const std::string key = websocket_detail::readHttpHeader(fd, request)
+            ? websocket_detail::headerValue(request, "Sec-WebSocket-Key") : "";
+    if (key.empty()) {
+        const char badRequest[] = "HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\n\r\n";
+        ::send(fd, badRequest, sizeof badRequest - 1, MSG_NOSIGNAL);
+        return {};
+    }
+    const std::string response = "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+                                 "Sec-WebSocket-Accept: " + webSocketAcceptKey(key) + "\r\n\r\n";
+    if (::send(fd, response.data(), response.size(), MSG_NOSIGNAL) != (ssize_t)response.size()) {
+        return {};
+    }
+    websocket_detail::setNoDelay(fd);
+    return connection;
+}
+
+/**
+ * Connect to ws://host:port/ (host as an IPv4 address).
+ */
+inline WebSocketConnection webSocketConnect(char const * host, uint16_t port) {
+    const int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return {};
+    }
+    WebSocketConnection connection(fd, true);
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    if (inet_pton(AF_INET, host, &address.sin_addr) != 1 || ::connect(fd, (sockaddr*)&address, sizeof address) != 0) {
+        return {};
+    }
+    const std::string key = "dGhlIHNhbXBsZSBub25jZQ==";
+    const std::string request = "GET / HTTP/1.1\r\nHost: " + std::string(host) + ":" + std::to_string(port)
+            + "\r\nUpgrade: websocket\r\nConnection: Upgrade\r\nSec-WebSocket-Version: 13\r\nSec-WebSocket-Key: "
+            + key + "\r\n\r\n";
+    std::string response;
+    if (::send(fd, request.data(), request.size(), MSG_NOSIGNAL) != (ssize_t)request.size()
+            || !websocket_detail::readHttpHeader(fd, response) || response.compare(0, 12, "HTTP/1.1 101") != 0
+            || websocket_detail::headerValue(response, "Sec-WebSocket-Accept") != webSocketAcceptKey(key)) {
+        return {};
+    }
+    websocket_detail::setNoDelay(fd);
+    return connection;
+}
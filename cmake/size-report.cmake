@@ -0,0 +1,19 @@
+# Prints the raw and gzip size of the files given as -DFILES=a,b,... (commas,
+# a list would not survive the command line). Run by the size-report target:
+#
+#   cmake --build build-web --target size-report
+
+string(REPLACE "," ";" FILES "${FILES}")
+foreach(FILE IN LISTS FILES)
+    if (NOT EXISTS "${FILE}")
+        message(FATAL_ERROR "size-report: ${FILE} does not exist")
+    endif()
+    file(SIZE "${FILE}" RAW_SIZE)
+    # What a server sends with Content-Encoding: gzip
+    set(GZIP_FILE "${FILE}.size-report.gz")
+    file(ARCHIVE_CREATE OUTPUT "${GZIP_FILE}" PATHS "${FILE}" FORMAT raw COMPRESSION GZip COMPRESSION_LEVEL 9)
+    file(SIZE "${GZIP_FILE}" GZIP_SIZE)
+    file(REMOVE "${GZIP_FILE}")
+    get_filename_component(NAME "${FILE}" NAME)
+    message("size ${NAME} ${RAW_SIZE} bytes, gzip ${GZIP_SIZE} bytes")
+endforeach()
@@ -0,0 +1,44 @@
+// GpuCulling: tests each instance against the view planes and appends the
+// visible ones to a compacted copy plus the indirect draw arguments.
+// Plane equations are (a, b, d): a point (x, y) is inside when a*x + b*y + d >= 0.
+// Bindings 1-2 mirror the instanced renderer's, 3-4 receive the compacted copy.
+
+struct Params {
+    planes : array<vec4<f32>, 4>,
+    instanceCount : u32,
+    radiusScale : f32,
+};
+
+struct DrawArgs {
+    vertexCount : u32,
+    instanceCount : atomic<u32>,
+    firstVertex : u32,
+    firstInstance : u32,
+};
+
+@group(0) @binding(0) var<uniform> params : Params;
+@group(0) @binding(1) var<storage, read> transforms : array<vec4<f32>>;
+@group(0) @binding(2) var<storage, read> colors : array<u32>;
+@group(0) @binding(3) var<storage, read_write> visibleTransforms : array<vec4<f32>>;
+@group(0) @binding(4) var<storage, read_write> visibleColors : array<u32>;
+@group(0) @binding(5) var<storage, read_write> drawArgs : DrawArgs;
+
+// 64 is GpuCulling::WorkgroupSize
+@compute @workgroup_size(64) fn cs_main(@builtin(global_invocation_id) id : vec3<u32>) {
+    let index = id.x;
+    if (index >= params.instanceCount) {
+        return;
+    }
+    // x, y, scale, rotation
+    let t = transforms[index];
+    let center = vec3<f32>(t.xy, 1.0);
+    let radius = t.z * params.radiusScale;
+    for (var i = 0u; i < 4u; i++) {
+        if (dot(params.planes[i].xyz, center) < -radius) {
+            return;
+        }
+    }
+    let slot = atomicAdd(&drawArgs.instanceCount, 1u);
+    visibleTransforms[slot] = t;
+    visibleColors[slot] = colors[index];
+}
@@ -0,0 +1,38 @@
+// Instances of InstancedRenderer: transforms and colors are pulled from
+// storage buffers, the triangle corner comes from the vertex index.
+#include "view.wgsl"
+
+@group(0) @binding(0) var<storage, read> transforms : array<vec4<f32>>;
+@group(0) @binding(1) var<storage, read> colors : array<u32>;
+@group(1) @binding(0) var<uniform> view : View;
+
+struct VertexOutput {
+    @builtin(position) position : vec4<f32>,
+    @location(0) color : vec4<f32>,
+};
+
+@vertex fn vs_main(
+    @builtin(vertex_index) VertexIndex : u32,
+    @builtin(instance_index) InstanceIndex : u32
+) -> VertexOutput {
+    var pos = array<vec2<f32>, 3>(
+        vec2<f32>( 0.0,  0.5),
+        vec2<f32>(-0.5, -0.5),
+        vec2<f32>( 0.5, -0.5)
+    );
+    // x, y, scale, rotation
+    let t = transforms[InstanceIndex];
+    let c = cos(t.w);
+    let s = sin(t.w);
+    let p = pos[VertexIndex] * t.z;
+
+    var out : VertexOutput;
+    let world = vec2<f32>(t.x + c * p.x - s * p.y, t.y + s * p.x + c * p.y);
+    out.position = worldToClip(view, world);
+    out.color = unpack4x8unorm(colors[InstanceIndex]);
+    return out;
+}
+
+@fragment fn fs_main(in : VertexOutput) -> @location(0) vec4<f32> {
+    return in.color;
+}
@@ -0,0 +1,30 @@
+// Static meshes of MeshStream (see src/mesh-format.h). z is not used for
+// depth, there is no depth buffer.
+#include "view.wgsl"
+
+@group(0) @binding(0) var<uniform> view : View;
+
+#ifdef HEIGHT_SHADING
+// Brightness change per unit of height, set by the pipeline
+override heightShading : f32 = 1.0;
+#endif
+
+struct VertexOutput {
+    @builtin(position) position : vec4<f32>,
+    @location(0) color : vec4<f32>,
+};
+
+@vertex fn vs_main(@location(0) position : vec3<f32>, @location(1) color : vec4<f32>) -> VertexOutput {
+    var out : VertexOutput;
+    out.position = worldToClip(view, position.xy);
+#ifdef HEIGHT_SHADING
+    out.color = vec4<f32>(color.rgb * clamp(1.0 + position.z * heightShading, 0.0, 2.0), color.a);
+#else
+    out.color = color;
+#endif
+    return out;
+}
+
+@fragment fn fs_main(in : VertexOutput) -> @location(0) vec4<f32> {
+    return in.color;
+}
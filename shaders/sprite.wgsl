@@ -0,0 +1,44 @@
+// Sprites of SpriteBatcher: one instance per sprite, the quad corner comes
+// from the vertex index of a 4 vertex triangle strip.
+
+// Target pixels (origin top left, y down) to clip space:
+//     clip = pixel * scale + offset
+struct SpriteView {
+    scale : vec2<f32>,
+    offset : vec2<f32>,
+};
+
+@group(0) @binding(0) var<uniform> spriteView : SpriteView;
+@group(1) @binding(0) var atlasSampler : sampler;
+@group(1) @binding(1) var atlas : texture_2d<f32>;
+
+struct VertexOutput {
+    @builtin(position) position : vec4<f32>,
+    @location(0) uv : vec2<f32>,
+    @location(1) color : vec4<f32>,
+};
+
+@vertex fn vs_main(
+    @builtin(vertex_index) VertexIndex : u32,
+    @location(0) center : vec2<f32>,
+    @location(1) size : vec2<f32>,
+    @location(2) uvRect : vec4<f32>,
+    @location(3) color : vec4<f32>,
+    @location(4) rotation : f32
+) -> VertexOutput {
+    let corner = vec2<f32>(f32(VertexIndex & 1u), f32(VertexIndex >> 1u));
+    let local = (corner - 0.5) * size;
+    let c = cos(rotation);
+    let s = sin(rotation);
+    let pixel = center + vec2<f32>(c * local.x - s * local.y, s * local.x + c * local.y);
+
+    var out : VertexOutput;
+    out.position = vec4<f32>(pixel * spriteView.scale + spriteView.offset, 0.0, 1.0);
+    out.uv = mix(uvRect.xy, uvRect.zw, corner);
+    out.color = color;
+    return out;
+}
+
+@fragment fn fs_main(in : VertexOutput) -> @location(0) vec4<f32> {
+    return textureSample(atlas, atlasSampler, in.uv) * in.color;
+}
@@ -0,0 +1,31 @@
+// Upscale blit of DynamicResolution: stretches the rendered top-left part of
+// the offscreen target over the whole swap chain image with bilinear filtering.
+
+struct Upscale {
+    // Rendered size over texture size
+    uvScale : vec2<f32>,
+    // Last texel center of the rendered part, so filtering never reads past it
+    uvMax : vec2<f32>,
+};
+
+@group(0) @binding(0) var<uniform> upscale : Upscale;
+@group(0) @binding(1) var sourceSampler : sampler;
+@group(0) @binding(2) var source : texture_2d<f32>;
+
+struct VertexOutput {
+    @builtin(position) position : vec4<f32>,
+    @location(0) uv : vec2<f32>,
+};
+
+// One triangle covering the screen, uv is 0..1 over the visible part
+@vertex fn vs_main(@builtin(vertex_index) VertexIndex : u32) -> VertexOutput {
+    let uv = vec2<f32>(f32((VertexIndex << 1u) & 2u), f32(VertexIndex & 2u));
+    var out : VertexOutput;
+    out.position = vec4<f32>(uv.x * 2.0 - 1.0, 1.0 - uv.y * 2.0, 0.0, 1.0);
+    out.uv = uv;
+    return out;
+}
+
+@fragment fn fs_main(in : VertexOutput) -> @location(0) vec4<f32> {
+    return textureSample(source, sourceSampler, min(in.uv * upscale.uvScale, upscale.uvMax));
+}
@@ -0,0 +1,10 @@
+// 2D view shared by the scene shaders, ViewUniforms on the C++ side:
+//     clip = (world - center) * scale
+struct View {
+    center : vec2<f32>,
+    scale : vec2<f32>,
+};
+
+fn worldToClip(view : View, world : vec2<f32>) -> vec4<f32> {
+    return vec4<f32>((world - view.center) * view.scale, 0.0, 1.0);
+}
@@ -0,0 +1,157 @@
+#include "bind-group-cache.h"
+#include "frame-stats.h"
+#include "webgpu-renderer.h"
+
+#include <iostream>
+
+void BindGroupCache::init(WGPUDevice device) {
+    m_device = device;
+}
+
+WGPUBindGroupLayout BindGroupCache::getBindGroupLayout(WGPUBindGroupLayoutDescriptor const & desc) {
+    // Field by field, the label is not part of the state
+    m_key.clear();
+    m_key.add(desc.entryCount);
+    for (size_t i = 0; i < desc.entryCount; ++i) {
+        WGPUBindGroupLayoutEntry const & entry = desc.entries[i];
+        m_key.add(entry.binding);
+        m_key.add(entry.visibility);
+        m_key.add(entry.buffer.type);
+        m_key.add(entry.buffer.hasDynamicOffset);
+        m_key.add(entry.buffer.minBindingSize);
+        m_key.add(entry.sampler.type);
+        m_key.add(entry.texture.sampleType);
+        m_key.add(entry.texture.viewDimension);
+        m_key.add(entry.texture.multisampled);
+        m_key.add(entry.storageTexture.access);
+        m_key.add(entry.storageTexture.format);
+        m_key.add(entry.storageTexture.viewDimension);
+    }
+    auto it = m_bindGroupLayouts.find(m_key);
+    if (it != m_bindGroupLayouts.end()) {
+        ++m_stats.layoutHits;
+        return it->second.get();
+    }
+    ++m_stats.layoutMisses;
+    Handle<WGPUBindGroupLayout>& layout = m_bindGroupLayouts[m_key];
+    layout.reset(wgpuDeviceCreateBindGroupLayout(m_device, &desc));
+    return layout.get();
+}
+
+WGPUPipelineLayout BindGroupCache::getPipelineLayout(WGPUPipelineLayoutDescriptor const & desc) {
+    // Bind group layouts from this cache are equal when their handles are
+    m_key.clear();
+    m_key.add(desc.bindGroupLayoutCount);
+    for (size_t i = 0; i < desc.bindGroupLayoutCount; ++i) {
+        m_key.add(desc.bindGroupLayouts[i]);
+    }
+    auto it = m_pipelineLayouts.find(m_key);
+    if (it != m_pipelineLayouts.end()) {
+        ++m_stats.layoutHits;
+        return it->second.get();
+    }
+    ++m_stats.layoutMisses;
+    Handle<WGPUPipelineLayout>& layout = m_pipelineLayouts[m_key];
+    layout.reset(wgpuDeviceCreatePipelineLayout(m_device, &desc));
+    return layout.get();
+}
+
+WGPUSampler BindGroupCache::getSampler(WGPUSamplerDescriptor const & desc) {
+    m_key.clear();
+    m_key.add(desc.addressModeU);
+    m_key.add(desc.addressModeV);
+    m_key.add(desc.addressModeW);
+    m_key.add(desc.magFilter);
+    m_key.add(desc.minFilter);
+    m_key.add(desc.mipmapFilter);
+    m_key.add(desc.lodMinClamp);
+    m_key.add(desc.lodMaxClamp);
+    m_key.add(desc.compare);
+    m_key.add(desc.maxAnisotropy);
+    auto it = m_samplers.find(m_key);
+    if (it != m_samplers.end()) {
+        ++m_stats.samplerHits;
+        return it->second.get();
+    }
+    ++m_stats.samplerMisses;
+    Handle<WGPUSampler>& sampler = m_samplers[m_key];
+    sampler.reset(wgpuDeviceCreateSampler(m_device, &desc));
+    return sampler.get();
+}
+
+WGPUBindGroup BindGroupCache::getBindGroup(WGPUBindGroupDescriptor const & desc) {
+    m_key.clear();
+    m_key.add(desc.layout);
+    m_key.add(desc.entryCount);
+    for (size_t i = 0; i < desc.entryCount; ++i) {
+        WGPUBindGroupEntry const & entry = desc.entries[i];
+        m_key.add(entry.binding);
+        m_key.add(entry.buffer);
+        m_key.add(entry.offset);
+        m_key.add(entry.size);
+        m_key.add(entry.sampler);
+        m_key.add(entry.textureView);
+    }
+    auto it = m_bindGroups.find(m_key);
+    if (it != m_bindGroups.end()) {
+        it->second.lastUsedFrame = m_frame;
+        ++m_stats.bindGroupHits;
+        ++frameStats.bindGroupHits;
+        return it->second.bindGroup.get();
+    }
+    ++m_stats.bindGroupMisses;
+    ++frameStats.bindGroupMisses;
+
+    CachedBindGroup& cached = m_bindGroups[m_key];
+    cached.bindGroup.reset(wgpuDeviceCreateBindGroup(m_device, &desc));
+    cached.lastUsedFrame = m_frame;
+    for (size_t i = 0; i < desc.entryCount; ++i) {
+        WGPUBindGroupEntry const & entry = desc.entries[i];
+        if (entry.buffer) {
+            wgpuBufferReference(entry.buffer);
+            cached.buffers.emplace_back(entry.buffer);
+        }
+        if (entry.sampler) {
+            wgpuSamplerReference(entry.sampler);
+            cached.samplers.emplace_back(entry.sampler);
+        }
+        if (entry.textureView) {
+            wgpuTextureViewReference(entry.textureView);
+            cached.textureViews.emplace_back(entry.textureView);
+        }
+    }
+    return cached.bindGroup.get();
+}
+
+void BindGroupCache::endFrame() {
+    for (auto it = m_bindGroups.begin(); it != m_bindGroups.end();) {
+        if (m_frame - it->second.lastUsedFrame < EvictAfterFrames) {
+            ++it;
+            continue;
+        }
+        // Frames in flight may still use it
+        CachedBindGroup& cached = it->second;
+        deferredReleases.retire(std::move(cached.bindGroup));
+        for (Handle<WGPUBuffer>& buffer : cached.buffers) deferredReleases.retire(std::move(buffer));
+        for (Handle<WGPUSampler>& sampler : cached.samplers) deferredReleases.retire(std::move(sampler));
+        for (Handle<WGPUTextureView>& view : cached.textureViews) deferredReleases.retire(std::move(view));
+        it = m_bindGroups.erase(it);
+        ++m_stats.bindGroupsEvicted;
+    }
+    ++m_frame;
+}
+
+void BindGroupCache::printStats() const {
+    std::cout << "Bind group cache: "
+              << m_stats.layoutMisses << " layouts (" << m_stats.layoutHits << " hits), "
+              << m_stats.samplerMisses << " samplers (" << m_stats.samplerHits << " hits), "
+              << m_stats.bindGroupMisses << " bind groups (" << m_stats.bindGroupHits << " hits, "
+              << m_stats.bindGroupsEvicted << " evicted, " << m_bindGroups.size() << " cached)" << std::endl;
+}
+
+void BindGroupCache::clear() {
+    m_bindGroups.clear();
+    m_samplers.clear();
+    m_pipelineLayouts.clear();
+    m_bindGroupLayouts.clear();
+}
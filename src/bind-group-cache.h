@@ -0,0 +1,84 @@
+#pragma once
+
+#include <webgpu/webgpu.h>
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "hash.h"
+#include "webgpu-handles.h"
+
+/**
+ * Deduplicates bind group layouts, pipeline layouts and samplers by
+ * descriptor state, and bind groups by layout and bound resources.
+ *
+ * Layouts and samplers live as long as the cache. Bind groups are meant to
+ * be looked up every frame they are drawn with, instead of being created
+ * per draw: one that has not been looked up for EvictAfterFrames frames is
+ * retired to deferredReleases by endFrame(). A cached bind group keeps a
+ * reference on each buffer, sampler and view it binds, so a resource
+ * released by its owner cannot come back at the same handle and hit a
+ * bind group of the old one.
+ */
+class BindGroupCache {
+public:
+    static constexpr uint32_t EvictAfterFrames = 120;
+
+    struct Stats {
+        uint32_t layoutHits = 0;
+        uint32_t layoutMisses = 0;
+        uint32_t samplerHits = 0;
+        uint32_t samplerMisses = 0;
+        uint64_t bindGroupHits = 0;
+        uint64_t bindGroupMisses = 0;
+        uint64_t bindGroupsEvicted = 0;
+    };
+
+    void init(WGPUDevice device);
+
+    WGPUBindGroupLayout getBindGroupLayout(WGPUBindGroupLayoutDescriptor const & descriptor);
+    WGPUPipelineLayout getPipelineLayout(WGPUPipelineLayoutDescriptor const & descriptor);
+    WGPUSampler getSampler(WGPUSamplerDescriptor const & descriptor);
+
+    /**
+     * The bind group for `descriptor`, created on a miss. Only valid for
+     * encoding in the current frame: look it up again the next one.
+     */
+    WGPUBindGroup getBindGroup(WGPUBindGroupDescriptor const & descriptor);
+
+    /**
+     * Close the frame, retiring the bind groups it did not use for long.
+     */
+    void endFrame();
+
+    uint32_t bindGroupCount() const { return uint32_t(m_bindGroups.size()); }
+    Stats const & stats() const { return m_stats; }
+    void printStats() const;
+
+    /**
+     * Drop everything, e.g. before releasing the device. Nothing may use the
+     * returned objects afterwards.
+     */
+    void clear();
+
+private:
+    struct CachedBindGroup {
+        Handle<WGPUBindGroup> bindGroup;
+        // References keeping the bound handles from being reused
+        std::vector<Handle<WGPUBuffer>> buffers;
+        std::vector<Handle<WGPUSampler>> samplers;
+        std::vector<Handle<WGPUTextureView>> textureViews;
+        uint64_t lastUsedFrame = 0;
+    };
+
+    WGPUDevice m_device = nullptr;
+    std::unordered_map<CacheKey, Handle<WGPUBindGroupLayout>, CacheKeyHash> m_bindGroupLayouts;
+    std::unordered_map<CacheKey, Handle<WGPUPipelineLayout>, CacheKeyHash> m_pipelineLayouts;
+    std::unordered_map<CacheKey, Handle<WGPUSampler>, CacheKeyHash> m_samplers;
+    std::unordered_map<CacheKey, CachedBindGroup, CacheKeyHash> m_bindGroups;
+    // Reused by every lookup
+    CacheKey m_key;
+    uint64_t m_frame = 0;
+    Stats m_stats;
+};
@@ -0,0 +1,90 @@
+#include "draw-queue.h"
+#include "frame-stats.h"
+
+#include <algorithm>
+#include <numeric>
+#include <tuple>
+
+namespace {
+
+// Most expensive state first: a pipeline switch outweighs a bind group,
+// which outweighs a buffer
+bool drawsBefore(DrawItem const & a, DrawItem const & b) {
+    if (a.layer != b.layer) return a.layer < b.layer;
+    if (a.pipeline != b.pipeline) return std::less<WGPURenderPipeline>()(a.pipeline, b.pipeline);
+    for (uint32_t i = 0; i < DrawItem::MaxBindGroups; ++i) {
+        if (a.bindGroups[i] != b.bindGroups[i]) return std::less<WGPUBindGroup>()(a.bindGroups[i], b.bindGroups[i]);
+    }
+    return std::make_tuple(a.vertexBuffer, a.vertexOffset, a.indexBuffer, a.indexOffset)
+           < std::make_tuple(b.vertexBuffer, b.vertexOffset, b.indexBuffer, b.indexOffset);
+}
+
+} // namespace
+
+void DrawQueue::encode(WGPURenderPassEncoder pass) {
+    m_order.resize(m_items.size());
+    std::iota(m_order.begin(), m_order.end(), 0u);
+    if (m_sorting) {
+        std::stable_sort(m_order.begin(), m_order.end(),
+                         [this](uint32_t a, uint32_t b) { return drawsBefore(m_items[a], m_items[b]); });
+    }
+
+    // What the pass has bound, nothing at first
+    WGPURenderPipeline pipeline = nullptr;
+    WGPUBindGroup bindGroups[DrawItem::MaxBindGroups] = {};
+    uint32_t dynamicOffsets[DrawItem::MaxBindGroups] = {};
+    WGPUBuffer vertexBuffer = nullptr;
+    uint64_t vertexOffset = 0;
+    WGPUBuffer indexBuffer = nullptr;
+    uint64_t indexOffset = 0;
+
+    for (uint32_t index : m_order) {
+        DrawItem const & item = m_items[index];
+        if (item.pipeline != pipeline) {
+            wgpuRenderPassEncoderSetPipeline(pass, item.pipeline);
+            pipeline = item.pipeline;
+            ++frameStats.pipelineChanges;
+        }
+        for (uint32_t i = 0; i < DrawItem::MaxBindGroups; ++i) {
+            if (!item.bindGroups[i]) {
+                continue;
+            }
+            const bool dynamic = (item.dynamicOffsetMask >> i) & 1;
+            if (item.bindGroups[i] == bindGroups[i] && (!dynamic || item.dynamicOffsets[i] == dynamicOffsets[i])) {
+                continue;
+            }
+            wgpuRenderPassEncoderSetBindGroup(pass, i, item.bindGroups[i], dynamic ? 1 : 0,
+                                              dynamic ? &item.dynamicOffsets[i] : nullptr);
+            bindGroups[i] = item.bindGroups[i];
+            dynamicOffsets[i] = item.dynamicOffsets[i];
+            ++frameStats.bindGroupChanges;
+        }
+        if (item.vertexBuffer && (item.vertexBuffer != vertexBuffer || item.vertexOffset != vertexOffset)) {
+            wgpuRenderPassEncoderSetVertexBuffer(pass, 0, item.vertexBuffer, item.vertexOffset, item.vertexSize);
+            vertexBuffer = item.vertexBuffer;
+            vertexOffset = item.vertexOffset;
+            ++frameStats.bufferChanges;
+        }
+        if (item.indexBuffer) {
+            if (item.indexBuffer != indexBuffer || item.indexOffset != indexOffset) {
+                wgpuRenderPassEncoderSetIndexBuffer(pass, item.indexBuffer, WGPUIndexFormat_Uint32, item.indexOffset,
+                                                    item.indexSize);
+                indexBuffer = item.indexBuffer;
+                indexOffset = item.indexOffset;
+                ++frameStats.bufferChanges;
+            }
+            if (item.indirectBuffer) {
+                wgpuRenderPassEncoderDrawIndexedIndirect(pass, item.indirectBuffer, item.indirectOffset);
+            } else {
+                wgpuRenderPassEncoderDrawIndexed(pass, item.count, item.instanceCount, item.first, 0,
+                                                 item.firstInstance);
+            }
+        } else if (item.indirectBuffer) {
+            wgpuRenderPassEncoderDrawIndirect(pass, item.indirectBuffer, item.indirectOffset);
+        } else {
+            wgpuRenderPassEncoderDraw(pass, item.count, item.instanceCount, item.first, item.firstInstance);
+        }
+        ++frameStats.drawCalls;
+    }
+    m_items.clear();
+}
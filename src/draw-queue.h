@@ -0,0 +1,75 @@
+#pragma once
+
+#include <webgpu/webgpu.h>
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * One draw and the state it needs. Bind groups have at most one dynamic
+ * offset each, as everything here uses them.
+ */
+struct DrawItem {
+    static constexpr uint32_t MaxBindGroups = 4;
+
+    // Lower layers are encoded first whatever their state, e.g. opaque
+    // geometry under blended draws
+    uint32_t layer = 0;
+    WGPURenderPipeline pipeline = nullptr;
+    WGPUBindGroup bindGroups[MaxBindGroups] = {};
+    uint32_t dynamicOffsets[MaxBindGroups] = {};
+    // Bit i set when bindGroups[i] takes dynamicOffsets[i]
+    uint32_t dynamicOffsetMask = 0;
+    WGPUBuffer vertexBuffer = nullptr;
+    uint64_t vertexOffset = 0;
+    uint64_t vertexSize = 0;
+    // Null for non-indexed draws, indices are 32-bit
+    WGPUBuffer indexBuffer = nullptr;
+    uint64_t indexOffset = 0;
+    uint64_t indexSize = 0;
+    // Set for draws whose arguments the GPU writes, at indirectOffset: the
+    // four (or five when indexed) counts below are then ignored
+    WGPUBuffer indirectBuffer = nullptr;
+    uint64_t indirectOffset = 0;
+    // Vertices, or indices when indexed
+    uint32_t count = 0;
+    uint32_t instanceCount = 1;
+    uint32_t first = 0;
+    uint32_t firstInstance = 0;
+};
+
+/**
+ * Collects the draws of a render pass, then encodes them ordered by layer,
+ * pipeline, bind groups and buffers so that each state is set once per run
+ * of draws sharing it; calls that would set what is already bound are
+ * skipped. State changes and draws are counted in frameStats.
+ *
+ *     drawQueue.add(item);  // any number, any order
+ *     drawQueue.encode(pass);
+ *
+ * Draws with equal state keep the order they were added in. The items'
+ * storage is kept from frame to frame.
+ */
+class DrawQueue {
+public:
+    void add(DrawItem const & item) { m_items.push_back(item); }
+
+    /**
+     * Encode everything added since the last call into `pass` and empty the
+     * queue.
+     */
+    void encode(WGPURenderPassEncoder pass);
+
+    /**
+     * Off, draws go out in the order they were added (state changes are
+     * still deduplicated), to measure what sorting saves.
+     */
+    void setSorting(bool enabled) { m_sorting = enabled; }
+    bool sorting() const { return m_sorting; }
+    size_t size() const { return m_items.size(); }
+
+private:
+    std::vector<DrawItem> m_items;
+    std::vector<uint32_t> m_order;
+    bool m_sorting = true;
+};
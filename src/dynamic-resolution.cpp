@@ -0,0 +1,228 @@
+#include "dynamic-resolution.h"
+#include "webgpu-renderer.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// upscale.wgsl's Upscale
+struct UpscaleUniforms {
+    float uvScale[2];
+    float uvMax[2];
+};
+
+} // namespace
+
+void DynamicResolution::init(WGPUDevice device, WGPUTextureFormat colorFormat, DynamicResolutionSettings const & settings) {
+    m_device = device;
+    m_colorFormat = colorFormat;
+    m_settings = settings;
+    m_scale = settings.maxScale;
+
+    WGPUShaderModule shaderModule = shaderLibrary.getModule("upscale.wgsl");
+
+    WGPUBindGroupLayoutEntry layoutEntries[3] = {};
+    layoutEntries[0].binding = 0;
+    layoutEntries[0].visibility = WGPUShaderStage_Fragment;
+    layoutEntries[0].buffer.type = WGPUBufferBindingType_Uniform;
+    layoutEntries[0].buffer.minBindingSize = sizeof(UpscaleUniforms);
+    layoutEntries[1].binding = 1;
+    layoutEntries[1].visibility = WGPUShaderStage_Fragment;
+    layoutEntries[1].sampler.type = WGPUSamplerBindingType_Filtering;
+    layoutEntries[2].binding = 2;
+    layoutEntries[2].visibility = WGPUShaderStage_Fragment;
+    layoutEntries[2].texture.sampleType = WGPUTextureSampleType_Float;
+    layoutEntries[2].texture.viewDimension = WGPUTextureViewDimension_2D;
+    WGPUBindGroupLayoutDescriptor bindGroupLayoutDesc{};
+    bindGroupLayoutDesc.label = "upscale-layout";
+    bindGroupLayoutDesc.entryCount = 3;
+    bindGroupLayoutDesc.entries = layoutEntries;
+    m_bindGroupLayout = bindGroupCache.getBindGroupLayout(bindGroupLayoutDesc);
+
+    WGPUBindGroupLayout bindGroupLayout = m_bindGroupLayout;
+    WGPUPipelineLayoutDescriptor pipelineLayoutDesc{};
+    pipelineLayoutDesc.bindGroupLayoutCount = 1;
+    pipelineLayoutDesc.bindGroupLayouts = &bindGroupLayout;
+    m_pipelineLayout = bindGroupCache.getPipelineLayout(pipelineLayoutDesc);
+
+    WGPUVertexState vertex{};
+    vertex.module = shaderModule;
+    vertex.entryPoint = "vs_main";
+
+    WGPUColorTargetState colorTarget{};
+    colorTarget.format = colorFormat;
+    colorTarget.blend = nullptr;
+    colorTarget.writeMask = WGPUColorWriteMask_All;
+
+    WGPUFragmentState fragment{};
+    fragment.module = shaderModule;
+    fragment.entryPoint = "fs_main";
+    fragment.targetCount = 1;
+    fragment.targets = &colorTarget;
+
+    WGPUPrimitiveState primitiveState{};
+    primitiveState.topology = WGPUPrimitiveTopology_TriangleList;
+    primitiveState.stripIndexFormat = WGPUIndexFormat_Undefined;
+    primitiveState.frontFace = WGPUFrontFace_CCW;
+    primitiveState.cullMode = WGPUCullMode_None;
+
+    WGPUMultisampleState multisampleState{};
+    multisampleState.count = 1;
+    multisampleState.mask = 0xFFFFFFFF;
+
+    WGPURenderPipelineDescriptor pipelineDesc{};
+    pipelineDesc.label = "upscale-pipeline";
+    pipelineDesc.layout = m_pipelineLayout;
+    pipelineDesc.vertex = vertex;
+    pipelineDesc.fragment = &fragment;
+    pipelineDesc.primitive = primitiveState;
+    pipelineDesc.multisample = multisampleState;
+    m_pipeline = pipelineCache.getRenderPipeline(pipelineDesc);
+
+    WGPUSamplerDescriptor samplerDesc{};
+    samplerDesc.label = "upscale-sampler";
+    samplerDesc.addressModeU = WGPUAddressMode_ClampToEdge;
+    samplerDesc.addressModeV = WGPUAddressMode_ClampToEdge;
+    samplerDesc.addressModeW = WGPUAddressMode_ClampToEdge;
+    samplerDesc.magFilter = WGPUFilterMode_Linear;
+    samplerDesc.minFilter = WGPUFilterMode_Linear;
+    samplerDesc.mipmapFilter = WGPUMipmapFilterMode_Nearest;
+    samplerDesc.lodMinClamp = 0.0f;
+    samplerDesc.lodMaxClamp = 1.0f;
+    samplerDesc.maxAnisotropy = 1;
+    m_sampler = bindGroupCache.getSampler(samplerDesc);
+
+    WGPUBufferDescriptor uniformDesc{};
+    uniformDesc.label = "upscale-uniforms";
+    uniformDesc.usage = WGPUBufferUsage_Uniform | WGPUBufferUsage_CopyDst;
+    uniformDesc.size = sizeof(UpscaleUniforms);
+    m_uniformBuffer.reset(wgpuDeviceCreateBuffer(device, &uniformDesc));
+}
+
+void DynamicResolution::resize(uint32_t width, uint32_t height) {
+    if (width == 0 || height == 0 || (width == m_outputWidth && height == m_outputHeight)) {
+        return;
+    }
+    m_outputWidth = width;
+    m_outputHeight = height;
+
+    WGPUTextureDescriptor textureDesc{};
+    textureDesc.label = "dynamic-resolution-target";
+    textureDesc.usage = WGPUTextureUsage_RenderAttachment | WGPUTextureUsage_TextureBinding;
+    textureDesc.dimension = WGPUTextureDimension_2D;
+    textureDesc.size = {width, height, 1};
+    textureDesc.format = m_colorFormat;
+    textureDesc.mipLevelCount = 1;
+    textureDesc.sampleCount = 1;
+    // The frame being presented may still sample the old target
+    deferredReleases.retire(std::move(m_bindGroup));
+    deferredReleases.retire(std::move(m_view));
+    deferredReleases.retire(std::move(m_texture));
+    m_texture.reset(wgpuDeviceCreateTexture(m_device, &textureDesc));
+    m_view.reset(wgpuTextureCreateView(m_texture.get(), nullptr));
+
+    WGPUBindGroupEntry entries[3] = {};
+    entries[0].binding = 0;
+    entries[0].buffer = m_uniformBuffer.get();
+    entries[0].offset = 0;
+    entries[0].size = sizeof(UpscaleUniforms);
+    entries[1].binding = 1;
+    entries[1].sampler = m_sampler;
+    entries[2].binding = 2;
+    entries[2].textureView = m_view.get();
+    WGPUBindGroupDescriptor bindGroupDesc{};
+    bindGroupDesc.label = "upscale";
+    bindGroupDesc.layout = m_bindGroupLayout;
+    bindGroupDesc.entryCount = 3;
+    bindGroupDesc.entries = entries;
+    m_bindGroup.reset(wgpuDeviceCreateBindGroup(m_device, &bindGroupDesc));
+
+    applyScale(m_scale);
+}
+
+void DynamicResolution::setFixedScale(float scale) {
+    m_fixed = true;
+    applyScale(std::clamp(scale, 0.1f, 1.0f));
+}
+
+void DynamicResolution::applyScale(float scale) {
+    m_scale = scale;
+    m_renderWidth = std::max(1u, uint32_t(std::lround(m_outputWidth * scale)));
+    m_renderHeight = std::max(1u, uint32_t(std::lround(m_outputHeight * scale)));
+    m_uniformsDirty = true;
+    // Costs measured so far were at the old scale
+    m_smoothedCost = 0.0;
+    m_cooldown = m_settings.cooldownFrames;
+    m_onTimeFrames = 0;
+}
+
+void DynamicResolution::update(double gpuMilliseconds, double frameIntervalMilliseconds) {
+    if (m_fixed || m_outputWidth == 0) {
+        return;
+    }
+    if (m_cooldown > 0) {
+        --m_cooldown;
+        return;
+    }
+
+    const bool gpuTimed = gpuMilliseconds > 0.0;
+    const double cost = gpuTimed ? gpuMilliseconds : frameIntervalMilliseconds;
+    m_smoothedCost = m_smoothedCost == 0.0 ? cost : 0.8 * m_smoothedCost + 0.2 * cost;
+
+    // The render pass cost follows the pixel count, the square of the scale
+    float desired = m_scale;
+    if (gpuTimed) {
+        desired = m_scale * float(std::sqrt(m_settings.targetMilliseconds * m_settings.gpuBudget / m_smoothedCost));
+    } else if (m_smoothedCost > 1.2 * m_settings.targetMilliseconds) {
+        desired = m_scale * float(std::sqrt(m_settings.targetMilliseconds / m_smoothedCost));
+    } else if (++m_onTimeFrames >= 4 * m_settings.cooldownFrames) {
+        // On time, which may hide headroom: probe a step up
+        desired = m_scale * 1.1f;
+        m_onTimeFrames = 0;
+    }
+    desired = std::clamp(desired, m_settings.minScale, m_settings.maxScale);
+
+    const bool atBound = desired != m_scale && (desired == m_settings.minScale || desired == m_settings.maxScale);
+    if (std::fabs(desired - m_scale) > m_settings.hysteresis * m_scale || atBound) {
+        applyScale(desired);
+        ++m_scaleChanges;
+    }
+}
+
+void DynamicResolution::encodeUpscale(WGPUCommandEncoder encoder, WGPUTextureView output, WGPUQueue queue,
+                                      WGPURenderPassTimestampWrites const * timestampWrites) {
+    if (m_uniformsDirty && m_texture) {
+        UpscaleUniforms uniforms;
+        uniforms.uvScale[0] = float(m_renderWidth) / m_outputWidth;
+        uniforms.uvScale[1] = float(m_renderHeight) / m_outputHeight;
+        uniforms.uvMax[0] = (m_renderWidth - 0.5f) / m_outputWidth;
+        uniforms.uvMax[1] = (m_renderHeight - 0.5f) / m_outputHeight;
+        wgpuQueueWriteBuffer(queue, m_uniformBuffer.get(), 0, &uniforms, sizeof(uniforms));
+        m_uniformsDirty = false;
+    }
+
+    WGPURenderPassColorAttachment colorAttachment = {};
+    colorAttachment.view = output;
+#ifndef WEBGPU_BACKEND_WGPU
+    colorAttachment.depthSlice = UINT32_MAX;
+#endif // NOT WEBGPU_BACKEND_WGPU
+    colorAttachment.loadOp = WGPULoadOp_Clear;
+    colorAttachment.storeOp = WGPUStoreOp_Store;
+    colorAttachment.clearValue = {0.0f, 0.0f, 0.0f, 1.0f};
+
+    WGPURenderPassDescriptor renderPassDesc = {};
+    renderPassDesc.label = "Upscale-Pass";
+    renderPassDesc.colorAttachmentCount = 1;
+    renderPassDesc.colorAttachments = &colorAttachment;
+    renderPassDesc.timestampWrites = timestampWrites;
+
+    // Cleared even while compiling so the swap chain image is never undefined
+    Handle<WGPURenderPassEncoder> pass(wgpuCommandEncoderBeginRenderPass(encoder, &renderPassDesc));
+    if (m_pipeline->ready() && m_bindGroup) {
+        wgpuRenderPassEncoderSetPipeline(pass.get(), m_pipeline->get());
+        wgpuRenderPassEncoderSetBindGroup(pass.get(), 0, m_bindGroup.get(), 0, nullptr);
+        wgpuRenderPassEncoderDraw(pass.get(), 3, 1, 0, 0);
+    }
+    wgpuRenderPassEncoderEnd(pass.get());
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <webgpu/webgpu.h>
+
+#include <cstdint>
+
+#include "pipeline-cache.h"
+#include "webgpu-handles.h"
+
+/**
+ * Tuning of DynamicResolution.
+ */
+struct DynamicResolutionSettings {
+    // Frame time to hold, a 60 Hz display by default
+    double targetMilliseconds = 1000.0 / 60.0;
+    // Part of the frame the render pass may take on the GPU
+    double gpuBudget = 0.75;
+    float minScale = 0.5f;
+    float maxScale = 1.0f;
+    // Frames between two changes; GPU times arrive a few frames late
+    uint32_t cooldownFrames = 8;
+    // Changes smaller than this are ignored
+    float hysteresis = 0.05f;
+};
+
+/**
+ * Renders the scene into an offscreen target at a fraction of the output
+ * resolution and stretches it over the swap chain image, adjusting the
+ * fraction every few frames so the frame cost stays within a budget.
+ *
+ * The target is allocated at the full output size and the scene is drawn
+ * into its top-left renderWidth() x renderHeight() corner with a viewport,
+ * so changing the scale never reallocates anything; only resize() does.
+ *
+ * The cost driving the scale is the GPU time of the render pass when the
+ * profiler has timestamps. Without them only the frame interval is known,
+ * which cannot drop below the display refresh: the scale is lowered when
+ * frames run late and raised back slowly while they are on time.
+ */
+class DynamicResolution {
+public:
+    void init(WGPUDevice device, WGPUTextureFormat colorFormat, DynamicResolutionSettings const & settings = {});
+
+    /**
+     * Output (swap chain) size changed. Reallocates the offscreen target.
+     */
+    void resize(uint32_t width, uint32_t height);
+
+    /**
+     * Feed the cost of the last frame: the render pass GPU time in ms when
+     * known (0 otherwise) and the interval since the previous frame.
+     */
+    void update(double gpuMilliseconds, double frameIntervalMilliseconds);
+
+    /**
+     * Keep the scale fixed, e.g. for benchmarks or to compare quality.
+     */
+    void setFixedScale(float scale);
+
+    float scale() const { return m_scale; }
+    uint32_t outputWidth() const { return m_outputWidth; }
+    uint32_t outputHeight() const { return m_outputHeight; }
+    uint32_t renderWidth() const { return m_renderWidth; }
+    uint32_t renderHeight() const { return m_renderHeight; }
+    uint32_t scaleChanges() const { return m_scaleChanges; }
+
+    /**
+     * What the scene renders into, null before the first resize().
+     */
+    WGPUTextureView renderTarget() const { return m_view.get(); }
+
+    /**
+     * Stretch the rendered part of the target over `output` in a render pass
+     * of its own, only cleared while the pipeline compiles. `timestampWrites`
+     * goes into the pass descriptor, null when the pass is not profiled.
+     */
+    void encodeUpscale(WGPUCommandEncoder encoder, WGPUTextureView output, WGPUQueue queue,
+                       WGPURenderPassTimestampWrites const * timestampWrites = nullptr);
+
+private:
+    void applyScale(float scale);
+
+    WGPUDevice m_device = nullptr;
+    WGPUTextureFormat m_colorFormat = WGPUTextureFormat_Undefined;
+    DynamicResolutionSettings m_settings;
+    CachedRenderPipeline const * m_pipeline = nullptr;
+    // Owned by bindGroupCache
+    WGPUBindGroupLayout m_bindGroupLayout = nullptr;
+    WGPUPipelineLayout m_pipelineLayout = nullptr;
+    WGPUSampler m_sampler = nullptr;
+    Handle<WGPUBuffer> m_uniformBuffer;
+
+    Handle<WGPUTexture> m_texture;
+    Handle<WGPUTextureView> m_view;
+    Handle<WGPUBindGroup> m_bindGroup;
+    // The uniforms need writing before the next blit
+    bool m_uniformsDirty = true;
+
+    uint32_t m_outputWidth = 0;
+    uint32_t m_outputHeight = 0;
+    uint32_t m_renderWidth = 0;
+    uint32_t m_renderHeight = 0;
+    float m_scale = 1.0f;
+    bool m_fixed = false;
+    double m_smoothedCost = 0.0;
+    uint32_t m_cooldown = 0;
+    uint32_t m_onTimeFrames = 0;
+    uint32_t m_scaleChanges = 0;
+};
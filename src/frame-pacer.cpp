@@ -0,0 +1,101 @@
+#include "frame-pacer.h"
+#include "webgpu-utils.h"
+
+#include <algorithm>
+#include <chrono>
+
+static double cpuMilliseconds() {
+    using namespace std::chrono;
+    return duration<double, std::milli>(steady_clock::now().time_since_epoch()).count();
+}
+
+void FramePacer::init(uint32_t framesInFlight) {
+    m_framesInFlight = std::clamp(framesInFlight, 1u, MaxFramesInFlight);
+    for (Slot& slot : m_slots) {
+        slot.pending = false;
+    }
+    m_slot = 0;
+    m_frameIndex = 0;
+    m_frameOpen = false;
+    m_maxPending = 0;
+    m_waitStartMilliseconds = 0.0;
+    m_stats = {};
+}
+
+bool FramePacer::beginFrame([[maybe_unused]] WGPUDevice device) {
+    if (m_frameOpen) {
+        return true;
+    }
+
+    const uint32_t slot = uint32_t(m_frameIndex % m_framesInFlight);
+    if (m_slots[slot].pending) {
+        const double start = cpuMilliseconds();
+        if (m_waitStartMilliseconds == 0.0) {
+            m_waitStartMilliseconds = start;
+        }
+#ifdef __EMSCRIPTEN__
+        return false;
+#else
+        while (m_slots[slot].pending) {
+            pollEvents(device);
+        }
+#endif // __EMSCRIPTEN__
+    }
+    if (m_waitStartMilliseconds > 0.0) {
+        addWait(cpuMilliseconds() - m_waitStartMilliseconds);
+        ++m_stats.framesWaited;
+        m_waitStartMilliseconds = 0.0;
+    } else {
+        addWait(0.0);
+    }
+
+    m_slot = slot;
+    ++m_frameIndex;
+    ++m_stats.frames;
+    m_frameOpen = true;
+    return true;
+}
+
+void FramePacer::endFrame(WGPUQueue queue) {
+    if (!m_frameOpen) {
+        return;
+    }
+    m_frameOpen = false;
+
+    auto onQueueWorkDone = [](WGPUQueueWorkDoneStatus /* status */, void * pUserData) {
+        // Even on error (e.g. device lost) the GPU is no longer using the slot
+        reinterpret_cast<Slot*>(pUserData)->pending = false;
+    };
+    m_slots[m_slot].pending = true;
+    wgpuQueueOnSubmittedWorkDone(queue, onQueueWorkDone, (void*)&m_slots[m_slot]);
+    m_maxPending = std::max(m_maxPending, pendingFrames());
+}
+
+void FramePacer::waitIdle([[maybe_unused]] WGPUDevice device) {
+#ifndef __EMSCRIPTEN__
+    while (pendingFrames() > 0) {
+        pollEvents(device);
+    }
+#endif // NOT __EMSCRIPTEN__
+}
+
+uint32_t FramePacer::pendingFrames() const {
+    uint32_t count = 0;
+    for (Slot const & slot : m_slots) {
+        count += slot.pending ? 1 : 0;
+    }
+    return count;
+}
+
+void FramePacer::addWait(double milliseconds) {
+    m_stats.lastWaitMilliseconds = milliseconds;
+    m_stats.maxWaitMilliseconds = std::max(m_stats.maxWaitMilliseconds, milliseconds);
+    m_stats.totalWaitMilliseconds += milliseconds;
+    m_waitHistory[m_stats.frames % HistorySize] = milliseconds;
+    const uint64_t count = std::min<uint64_t>(m_stats.frames + 1, HistorySize);
+    double sum = 0.0;
+    for (uint64_t i = 0; i < count; ++i) {
+        sum += m_waitHistory[i];
+    }
+    m_stats.averageWaitMilliseconds = sum / count;
+}
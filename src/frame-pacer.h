@@ -0,0 +1,121 @@
+#pragma once
+
+#include <webgpu/webgpu.h>
+
+#include <cstdint>
+
+/**
+ * Bounds how many frames the CPU may be ahead of the GPU.
+ *
+ * Every frame is given one of framesInFlight() slots in turn. beginFrame()
+ * waits until the frame that last used the slot is done on the GPU
+ * (wgpuQueueOnSubmittedWorkDone, registered by endFrame()), so resources kept
+ * per slot (see PerFrame) can be rewritten without racing the GPU, while up
+ * to framesInFlight() - 1 earlier frames still execute in parallel.
+ *
+ *     if (framePacer.beginFrame(device)) {
+ *         PerFrameData& data = perFrameData[framePacer.frameSlot()];
+ *         ...encode, submit...
+ *         framePacer.endFrame(queue);
+ *     }
+ *
+ * The time beginFrame() spends waiting is the CPU wait of the frame: it stays
+ * at zero while the CPU is the bottleneck and grows when the GPU is.
+ */
+class FramePacer {
+public:
+    static constexpr uint32_t MaxFramesInFlight = 3;
+    static constexpr uint32_t DefaultFramesInFlight = 2;
+    // Number of frames the rolling average wait is taken over
+    static constexpr uint32_t HistorySize = 60;
+
+    struct Stats {
+        uint64_t frames = 0;
+        // Frames that found their slot still busy on the GPU
+        uint64_t framesWaited = 0;
+        double lastWaitMilliseconds = 0.0;
+        double averageWaitMilliseconds = 0.0;
+        double maxWaitMilliseconds = 0.0;
+        double totalWaitMilliseconds = 0.0;
+    };
+
+    /**
+     * 1 serializes the CPU and the GPU, 2 or 3 let them overlap. Only call
+     * while no frame is in flight.
+     */
+    void init(uint32_t framesInFlight = DefaultFramesInFlight);
+
+    /**
+     * Start a frame once its slot is free. Native builds block, polling the
+     * device. The web cannot block (work done callbacks come from the browser
+     * event loop), so there it returns false while the slot is busy and the
+     * caller skips this animation frame; the wait then spans those attempts.
+     * Calling it again before endFrame() returns true at once.
+     */
+    bool beginFrame(WGPUDevice device);
+
+    /**
+     * Close the frame after its last submit: the slot becomes free when the
+     * work submitted to `queue` up to now is done.
+     */
+    void endFrame(WGPUQueue queue);
+
+    /**
+     * Block until every submitted frame is done. Native builds only, the web
+     * returns at once.
+     */
+    void waitIdle(WGPUDevice device);
+
+    uint32_t framesInFlight() const { return m_framesInFlight; }
+    // Slot of the current frame, valid between beginFrame() and endFrame()
+    uint32_t frameSlot() const { return m_slot; }
+    // Frames begun so far, the current one included
+    uint64_t frameIndex() const { return m_frameIndex; }
+    // Frames submitted whose GPU work is not known to be done yet
+    uint32_t pendingFrames() const;
+    // Most frames ever pending at once, at most framesInFlight()
+    uint32_t maxPendingFrames() const { return m_maxPending; }
+    Stats const & stats() const { return m_stats; }
+
+private:
+    struct Slot {
+        bool pending = false;
+    };
+
+    void addWait(double milliseconds);
+
+    uint32_t m_framesInFlight = DefaultFramesInFlight;
+    Slot m_slots[MaxFramesInFlight];
+    uint32_t m_slot = 0;
+    uint64_t m_frameIndex = 0;
+    bool m_frameOpen = false;
+    uint32_t m_maxPending = 0;
+    // When the current frame first found its slot busy, 0 if it did not
+    double m_waitStartMilliseconds = 0.0;
+
+    double m_waitHistory[HistorySize] = {};
+    Stats m_stats;
+};
+
+/**
+ * One T per frame slot of the FramePacer, e.g. a readback buffer or a
+ * dynamic buffer rewritten every frame. The set of a slot is only used again
+ * once the frame that last used it is done on the GPU.
+ *
+ *     PerFrame<Readback> m_readbacks;
+ *     Readback& readback = m_readbacks[framePacer.frameSlot()];
+ */
+template <typename T>
+class PerFrame {
+public:
+    T& operator[](uint32_t slot) { return m_sets[slot]; }
+    T const & operator[](uint32_t slot) const { return m_sets[slot]; }
+
+    T* begin() { return m_sets; }
+    T* end() { return m_sets + FramePacer::MaxFramesInFlight; }
+    T const * begin() const { return m_sets; }
+    T const * end() const { return m_sets + FramePacer::MaxFramesInFlight; }
+
+private:
+    T m_sets[FramePacer::MaxFramesInFlight];
+};
@@ -0,0 +1,107 @@
+#include "frame-readback.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+void FrameReadback::init(WGPUDevice device, uint32_t width, uint32_t height, uint32_t ringSize) {
+    m_device = device;
+    m_width = width;
+    m_height = height;
+    m_paddedBytesPerRow = (width * 4 + 255) & ~255u;
+    m_pixels.assign(m_paddedBytesPerRow != width * 4 ? size_t(width) * height * 4 : 0, 0);
+
+    // Sized once, the map callbacks hold pointers to the slots
+    m_slots.clear();
+    m_slots.resize(std::max(ringSize, 1u));
+    for (Slot& slot : m_slots) {
+        WGPUBufferDescriptor bufferDesc{};
+        bufferDesc.label = "frame-readback";
+        bufferDesc.usage = WGPUBufferUsage_MapRead | WGPUBufferUsage_CopyDst;
+        bufferDesc.size = uint64_t(m_paddedBytesPerRow) * height;
+        bufferDesc.mappedAtCreation = false;
+        slot.owner = this;
+        slot.buffer.reset(wgpuDeviceCreateBuffer(device, &bufferDesc));
+    }
+    m_stats = {};
+}
+
+bool FrameReadback::capture(WGPUQueue queue, WGPUTexture source, uint64_t frameIndex) {
+    auto free = std::find_if(m_slots.begin(), m_slots.end(), [](Slot const & slot) { return !slot.inFlight; });
+    if (free == m_slots.end()) {
+        ++m_stats.ringFull;
+        return false;
+    }
+    TRACE_SCOPE("capture frame");
+    Slot& slot = *free;
+    slot.owner = this;
+    slot.frameIndex = frameIndex;
+    slot.captureTime = std::chrono::steady_clock::now();
+    slot.inFlight = true;
+
+    WGPUImageCopyTexture copySource{};
+    copySource.texture = source;
+    copySource.mipLevel = 0;
+    copySource.origin = {0, 0, 0};
+    copySource.aspect = WGPUTextureAspect_All;
+    WGPUImageCopyBuffer copyDestination{};
+    copyDestination.buffer = slot.buffer.get();
+    copyDestination.layout.offset = 0;
+    copyDestination.layout.bytesPerRow = m_paddedBytesPerRow;
+    copyDestination.layout.rowsPerImage = m_height;
+    const WGPUExtent3D copySize = {m_width, m_height, 1};
+
+    WGPUCommandEncoderDescriptor encoderDesc{};
+    encoderDesc.label = "frame-readback";
+    Handle<WGPUCommandEncoder> encoder(wgpuDeviceCreateCommandEncoder(m_device, &encoderDesc));
+    wgpuCommandEncoderCopyTextureToBuffer(encoder.get(), &copySource, &copyDestination, &copySize);
+    Handle<WGPUCommandBuffer> command(wgpuCommandEncoderFinish(encoder.get(), nullptr));
+    WGPUCommandBuffer commandBuffer = command.get();
+    wgpuQueueSubmit(queue, 1, &commandBuffer);
+
+    // Resolves once the copy above has executed, nothing waits for it here
+    wgpuBufferMapAsync(slot.buffer.get(), WGPUMapMode_Read, 0, size_t(m_paddedBytesPerRow) * m_height, onMapped,
+                       (void*)&slot);
+    ++m_stats.framesCaptured;
+    return true;
+}
+
+void FrameReadback::onMapped(WGPUBufferMapAsyncStatus status, void * pUserData) {
+    Slot& slot = *reinterpret_cast<Slot*>(pUserData);
+    FrameReadback& owner = *slot.owner;
+    if (status != WGPUBufferMapAsyncStatus_Success) {
+        std::cerr << "Frame readback " << slot.frameIndex << " could not be mapped: status " << status << std::endl;
+        ++owner.m_stats.mapFailures;
+        slot.inFlight = false;
+        return;
+    }
+
+    const uint32_t rowBytes = owner.m_width * 4;
+    const uint8_t* mapped = static_cast<uint8_t const *>(
+            wgpuBufferGetConstMappedRange(slot.buffer.get(), 0, size_t(owner.m_paddedBytesPerRow) * owner.m_height));
+    // Rows are only padded when the width is not a multiple of 64 texels
+    const uint8_t* pixels = mapped;
+    if (owner.m_paddedBytesPerRow != rowBytes) {
+        for (uint32_t y = 0; y < owner.m_height; ++y) {
+            memcpy(owner.m_pixels.data() + size_t(y) * rowBytes, mapped + size_t(y) * owner.m_paddedBytesPerRow,
+                   rowBytes);
+        }
+        pixels = owner.m_pixels.data();
+    }
+
+    const double latency = std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - slot.captureTime).count();
+    ++owner.m_stats.framesRead;
+    owner.m_stats.totalLatencyMilliseconds += latency;
+    owner.m_stats.maxLatencyMilliseconds = std::max(owner.m_stats.maxLatencyMilliseconds, latency);
+    if (owner.m_callback) {
+        owner.m_callback(slot.frameIndex, pixels);
+    }
+    wgpuBufferUnmap(slot.buffer.get());
+    slot.inFlight = false;
+}
+
+uint32_t FrameReadback::inFlight() const {
+    return (uint32_t)std::count_if(m_slots.begin(), m_slots.end(), [](Slot const & slot) { return slot.inFlight; });
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <webgpu/webgpu.h>
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "webgpu-handles.h"
+
+/**
+ * Reads rendered frames back to the CPU without waiting on the GPU.
+ *
+ * capture() copies a texture into one of a small ring of map-read buffers
+ * and starts mapping it; the frame's pixels reach the callback a few frames
+ * later, once the GPU is done with it. While every buffer is still in flight
+ * capture() refuses the frame: the caller either skips it or polls until
+ * inFlight() drops, which only waits for the oldest capture.
+ *
+ *     readback.init(device, width, height);
+ *     readback.setCallback([](uint64_t frame, uint8_t const * pixels) { ... });
+ *     submitCommand(encodeFrame(target.view.get()));
+ *     readback.capture(queue, target.texture.get(), frameIndex);
+ *
+ * Slots point back to their owner from the map callbacks, so the object
+ * must not move while inFlight() > 0.
+ */
+class FrameReadback {
+public:
+    static constexpr uint32_t DefaultRingSize = 3;
+
+    struct Stats {
+        uint64_t framesCaptured = 0;
+        uint64_t framesRead = 0;
+        // capture() calls refused because every buffer was in flight
+        uint64_t ringFull = 0;
+        uint64_t mapFailures = 0;
+        // CPU time from capture() to the pixels being available
+        double totalLatencyMilliseconds = 0.0;
+        double maxLatencyMilliseconds = 0.0;
+    };
+
+    /**
+     * `pixels` has height() rows of width() * 4 bytes, in the texture's
+     * format (BGRA or RGBA), and is only valid during the call.
+     */
+    using FrameCallback = std::function<void(uint64_t frameIndex, uint8_t const * pixels)>;
+
+    /**
+     * Readback of width x height textures with 4 bytes per texel.
+     */
+    void init(WGPUDevice device, uint32_t width, uint32_t height, uint32_t ringSize = DefaultRingSize);
+    void setCallback(FrameCallback callback) { m_callback = std::move(callback); }
+
+    /**
+     * Copy `source` (created with CopySrc) into a free buffer with a command
+     * buffer of its own, submitted right away, so call it after submitting the
+     * frame that rendered it. Returns false without copying when no buffer is
+     * free.
+     */
+    bool capture(WGPUQueue queue, WGPUTexture source, uint64_t frameIndex);
+
+    uint32_t inFlight() const;
+    uint32_t ringSize() const { return (uint32_t)m_slots.size(); }
+    uint32_t width() const { return m_width; }
+    uint32_t height() const { return m_height; }
+    Stats const & stats() const { return m_stats; }
+
+private:
+    struct Slot {
+        FrameReadback* owner = nullptr;
+        Handle<WGPUBuffer> buffer;
+        uint64_t frameIndex = 0;
+        std::chrono::steady_clock::time_point captureTime;
+        bool inFlight = false;
+    };
+
+    static void onMapped(WGPUBufferMapAsyncStatus status, void * pUserData);
+
+    WGPUDevice m_device = nullptr;
+    uint32_t m_width = 0;
+    uint32_t m_height = 0;
+    // Copies need rows aligned to 256 bytes, the callback gets them packed
+    // (through m_pixels when the width needs padding)
+    uint32_t m_paddedBytesPerRow = 0;
+    std::vector<Slot> m_slots;
+    std::vector<uint8_t> m_pixels;
+    FrameCallback m_callback;
+    Stats m_stats;
+};
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+
+/**
+ * Counters for the frame being encoded, reset at the start of encodeFrame().
+ */
+struct FrameStats {
+    uint64_t uploadBytes = 0;
+    uint32_t uploadCalls = 0;
+    uint32_t drawCalls = 0;
+    uint32_t instancesDrawn = 0;
+    // Render bundles (re-)recorded, 0 while the static scene is unchanged
+    uint32_t bundlesRecorded = 0;
+    // GPU culling: instances tested this frame, visible count read back from
+    // a few frames ago
+    uint32_t instancesTested = 0;
+    uint32_t instancesVisible = 0;
+    // Triangles of the mesh drawn at the selected levels of detail, and what
+    // drawing all of it at full detail would have cost
+    uint32_t meshTriangles = 0;
+    uint32_t meshTrianglesFullDetail = 0;
+    // State set in render passes, including what executing a render bundle
+    // sets (calls skipped because the state was already bound are not
+    // counted), and bind groups found in or added to bindGroupCache
+    uint32_t pipelineChanges = 0;
+    uint32_t bindGroupChanges = 0;
+    uint32_t bufferChanges = 0;
+    uint32_t bindGroupHits = 0;
+    uint32_t bindGroupMisses = 0;
+};
+
+extern FrameStats frameStats;
@@ -0,0 +1,215 @@
+#include "gpu-culling.h"
+#include "frame-stats.h"
+#include "webgpu-renderer.h"
+
+#include <cstring>
+
+void GpuCulling::init(WGPUDevice device) {
+    m_device = device;
+
+    WGPUShaderModule shaderModule = shaderLibrary.getModule("culling.wgsl");
+
+    // Explicit layout: the parameters live in the upload ring and are bound
+    // with a dynamic offset, which "auto" layouts cannot express
+    WGPUBindGroupLayoutEntry layoutEntries[6] = {};
+    for (uint32_t i = 0; i < 6; ++i) {
+        layoutEntries[i].binding = i;
+        layoutEntries[i].visibility = WGPUShaderStage_Compute;
+    }
+    layoutEntries[0].buffer.type = WGPUBufferBindingType_Uniform;
+    layoutEntries[0].buffer.hasDynamicOffset = true;
+    layoutEntries[0].buffer.minBindingSize = sizeof(Params);
+    layoutEntries[1].buffer.type = WGPUBufferBindingType_ReadOnlyStorage;
+    layoutEntries[2].buffer.type = WGPUBufferBindingType_ReadOnlyStorage;
+    layoutEntries[3].buffer.type = WGPUBufferBindingType_Storage;
+    layoutEntries[4].buffer.type = WGPUBufferBindingType_Storage;
+    layoutEntries[5].buffer.type = WGPUBufferBindingType_Storage;
+    WGPUBindGroupLayoutDescriptor bindGroupLayoutDesc{};
+    bindGroupLayoutDesc.label = "culling-layout";
+    bindGroupLayoutDesc.entryCount = 6;
+    bindGroupLayoutDesc.entries = layoutEntries;
+    m_cullBindGroupLayout = bindGroupCache.getBindGroupLayout(bindGroupLayoutDesc);
+
+    WGPUBindGroupLayout bindGroupLayout = m_cullBindGroupLayout;
+    WGPUPipelineLayoutDescriptor pipelineLayoutDesc{};
+    pipelineLayoutDesc.bindGroupLayoutCount = 1;
+    pipelineLayoutDesc.bindGroupLayouts = &bindGroupLayout;
+    WGPUPipelineLayout pipelineLayout = bindGroupCache.getPipelineLayout(pipelineLayoutDesc);
+
+    WGPUComputePipelineDescriptor pipelineDesc{};
+    pipelineDesc.label = "culling-pipeline";
+    pipelineDesc.layout = pipelineLayout;
+    pipelineDesc.compute.module = shaderModule;
+    pipelineDesc.compute.entryPoint = "cs_main";
+    m_pipeline.reset(wgpuDeviceCreateComputePipeline(device, &pipelineDesc));
+
+    WGPUBufferDescriptor drawArgsDesc{};
+    drawArgsDesc.label = "culling-draw-args";
+    drawArgsDesc.usage = WGPUBufferUsage_Storage | WGPUBufferUsage_Indirect | WGPUBufferUsage_CopyDst | WGPUBufferUsage_CopySrc;
+    drawArgsDesc.size = 4 * sizeof(uint32_t);
+    m_drawArgsBuffer.reset(wgpuDeviceCreateBuffer(device, &drawArgsDesc));
+
+    for (Readback& readback : m_readbacks) {
+        WGPUBufferDescriptor readbackDesc{};
+        readbackDesc.label = "culling-readback";
+        readbackDesc.usage = WGPUBufferUsage_MapRead | WGPUBufferUsage_CopyDst;
+        readbackDesc.size = sizeof(uint32_t);
+        readback.owner = this;
+        readback.buffer.reset(wgpuDeviceCreateBuffer(device, &readbackDesc));
+    }
+
+    // Largest distance from the instance origin to a triangle corner
+    m_params.radiusScale = 0.7072f;
+    setViewRect(-1.0f, -1.0f, 1.0f, 1.0f);
+    // Bind groups are built by the first encode(), against the renderer's
+    // buffers and the upload ring of that frame
+}
+
+void GpuCulling::setViewRect(float minX, float minY, float maxX, float maxY) {
+    const float planes[4][4] = {
+        { 1.0f,  0.0f, -minX, 0.0f},
+        {-1.0f,  0.0f,  maxX, 0.0f},
+        { 0.0f,  1.0f, -minY, 0.0f},
+        { 0.0f, -1.0f,  maxY, 0.0f},
+    };
+    memcpy(m_params.planes, planes, sizeof(planes));
+}
+
+void GpuCulling::rebuildBindGroups(UploadRing const & ring, InstancedRenderer const & renderer) {
+    m_boundTransforms = renderer.streamBuffer(InstanceStore::TransformStream);
+    m_boundRingGeneration = ring.generation();
+
+    if (renderer.capacity() > m_capacity) {
+        m_capacity = renderer.capacity();
+        for (uint32_t i = 0; i < InstanceStore::StreamCount; ++i) {
+            const auto stream = InstanceStore::Stream(i);
+            WGPUBufferDescriptor bufferDesc{};
+            bufferDesc.label = stream == InstanceStore::TransformStream ? "visible-transforms" : "visible-colors";
+            bufferDesc.usage = WGPUBufferUsage_Storage;
+            bufferDesc.size = m_capacity * InstanceStore::elementSize(stream);
+            deferredReleases.retire(std::move(m_visibleBuffers[i]));
+            m_visibleBuffers[i].reset(wgpuDeviceCreateBuffer(m_device, &bufferDesc));
+        }
+    }
+
+    auto bufferEntry = [](uint32_t binding, WGPUBuffer buffer, uint64_t size = 0) {
+        WGPUBindGroupEntry entry{};
+        entry.binding = binding;
+        entry.buffer = buffer;
+        entry.offset = 0;
+        entry.size = size ? size : wgpuBufferGetSize(buffer);
+        return entry;
+    };
+
+    const WGPUBindGroupEntry cullEntries[] = {
+        bufferEntry(0, ring.buffer(), sizeof(Params)),
+        bufferEntry(1, renderer.streamBuffer(InstanceStore::TransformStream)),
+        bufferEntry(2, renderer.streamBuffer(InstanceStore::ColorStream)),
+        bufferEntry(3, m_visibleBuffers[InstanceStore::TransformStream].get()),
+        bufferEntry(4, m_visibleBuffers[InstanceStore::ColorStream].get()),
+        bufferEntry(5, m_drawArgsBuffer.get()),
+    };
+    WGPUBindGroupDescriptor cullDesc{};
+    cullDesc.label = "culling";
+    cullDesc.layout = m_cullBindGroupLayout;
+    cullDesc.entryCount = sizeof(cullEntries) / sizeof(cullEntries[0]);
+    cullDesc.entries = cullEntries;
+    deferredReleases.retire(std::move(m_cullBindGroup));
+    m_cullBindGroup.reset(wgpuDeviceCreateBindGroup(m_device, &cullDesc));
+
+    // Same layout as the renderer's own bind group, pointing at the compacted data
+    const WGPUBindGroupEntry drawEntries[] = {
+        bufferEntry(0, m_visibleBuffers[InstanceStore::TransformStream].get()),
+        bufferEntry(1, m_visibleBuffers[InstanceStore::ColorStream].get()),
+    };
+    WGPUBindGroupDescriptor drawDesc{};
+    drawDesc.label = "visible-instances";
+    drawDesc.layout = renderer.bindGroupLayout();
+    drawDesc.entryCount = sizeof(drawEntries) / sizeof(drawEntries[0]);
+    drawDesc.entries = drawEntries;
+    deferredReleases.retire(std::move(m_drawBindGroup));
+    m_drawBindGroup.reset(wgpuDeviceCreateBindGroup(m_device, &drawDesc));
+}
+
+void GpuCulling::encode(UploadRing& ring, WGPUCommandEncoder encoder, InstancedRenderer const & renderer) {
+    if (renderer.streamBuffer(InstanceStore::TransformStream) != m_boundTransforms
+        || ring.generation() != m_boundRingGeneration) {
+        rebuildBindGroups(ring, renderer);
+    }
+
+    m_testedCount = renderer.instanceCount();
+    m_params.instanceCount = m_testedCount;
+    const uint32_t paramsOffset = ring.pushUniform(m_params);
+    // vertexCount, instanceCount (accumulated by the shader), firstVertex, firstInstance
+    const uint32_t drawArgs[4] = {3, 0, 0, 0};
+    UploadRing::Allocation drawArgsReset = ring.allocate(sizeof(drawArgs));
+    if (paramsOffset == UINT32_MAX || !drawArgsReset) {
+        // Ring full this frame: draw nothing rather than stale arguments
+        m_testedCount = 0;
+    } else {
+        memcpy(drawArgsReset.data, drawArgs, sizeof(drawArgs));
+        // A copy command, not a queue write: the reset travels with the ring's single write
+        wgpuCommandEncoderCopyBufferToBuffer(encoder, ring.buffer(), drawArgsReset.offset,
+                                             m_drawArgsBuffer.get(), 0, sizeof(drawArgs));
+    }
+
+    if (m_testedCount > 0) {
+        const uint32_t profilerSlot = gpuProfiler.beginPass("culling");
+        WGPUComputePassDescriptor passDesc{};
+        passDesc.label = "culling-pass";
+        passDesc.timestampWrites = gpuProfiler.computePassTimestampWrites(profilerSlot);
+        Handle<WGPUComputePassEncoder> pass(wgpuCommandEncoderBeginComputePass(encoder, &passDesc));
+        wgpuComputePassEncoderSetPipeline(pass.get(), m_pipeline.get());
+        wgpuComputePassEncoderSetBindGroup(pass.get(), 0, m_cullBindGroup.get(), 1, &paramsOffset);
+        wgpuComputePassEncoderDispatchWorkgroups(pass.get(), (m_testedCount + WorkgroupSize - 1) / WorkgroupSize, 1, 1);
+        wgpuComputePassEncoderEnd(pass.get());
+        gpuProfiler.endPass(profilerSlot);
+    }
+
+    // Keep the visible count of this frame, unless its readback is still being mapped
+    Readback& readback = m_readbacks[framePacer.frameSlot()];
+    if (!readback.inFlight) {
+        wgpuCommandEncoderCopyBufferToBuffer(encoder, m_drawArgsBuffer.get(), sizeof(uint32_t),
+                                             readback.buffer.get(), 0, sizeof(uint32_t));
+        readback.inFlight = true;
+        readback.copyPending = true;
+    }
+
+    frameStats.instancesTested = m_testedCount;
+    frameStats.instancesVisible = m_visibleCount;
+}
+
+void GpuCulling::draw(DrawQueue& queue, InstancedRenderer const & renderer) const {
+    if (m_testedCount == 0 || !renderer.renderPipeline()) {
+        return;
+    }
+    // In the layer of InstancedRenderer::draw(), with the compacted buffers
+    DrawItem item;
+    item.layer = 1;
+    item.pipeline = renderer.renderPipeline();
+    item.bindGroups[0] = m_drawBindGroup.get();
+    item.bindGroups[1] = renderer.viewBindGroup();
+    item.dynamicOffsets[1] = renderer.viewOffset();
+    item.dynamicOffsetMask = 1u << 1;
+    item.indirectBuffer = m_drawArgsBuffer.get();
+    queue.add(item);
+}
+
+void GpuCulling::afterSubmit() {
+    auto onReadbackMapped = [](WGPUBufferMapAsyncStatus status, void * pUserData) {
+        Readback& readback = *reinterpret_cast<Readback*>(pUserData);
+        if (status == WGPUBufferMapAsyncStatus_Success) {
+            const void* data = wgpuBufferGetConstMappedRange(readback.buffer.get(), 0, sizeof(uint32_t));
+            memcpy(&readback.owner->m_visibleCount, data, sizeof(uint32_t));
+            wgpuBufferUnmap(readback.buffer.get());
+        }
+        readback.inFlight = false;
+    };
+
+    for (Readback& readback : m_readbacks) {
+        if (readback.copyPending) {
+            readback.copyPending = false;
+            wgpuBufferMapAsync(readback.buffer.get(), WGPUMapMode_Read, 0, sizeof(uint32_t), onReadbackMapped, (void*)&readback);
+        }
+    }
+}
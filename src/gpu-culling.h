@@ -0,0 +1,88 @@
+#pragma once
+
+#include <webgpu/webgpu.h>
+
+#include "draw-queue.h"
+#include "frame-pacer.h"
+#include "instanced-renderer.h"
+#include "webgpu-handles.h"
+
+/**
+ * Compute-shader visibility culling for the InstancedRenderer.
+ *
+ * A compute pass tests every instance's bounding circle against the view
+ * planes, appends the visible ones to compacted transform/color buffers and
+ * bumps the instance count of a DrawIndirect argument buffer. The render pass
+ * then draws the compacted buffers with one indirect draw, so the CPU cost
+ * does not depend on the number of instances or on how many are visible.
+ *
+ * The visible count is read back through a map-read buffer per frame slot
+ * (see FramePacer) and is therefore a few frames old.
+ */
+class GpuCulling {
+public:
+    static constexpr uint32_t WorkgroupSize = 64;
+
+    void init(WGPUDevice device);
+
+    /**
+     * Cull against the world space rectangle visible on screen. The default
+     * is the clip space square the instanced shader draws into.
+     */
+    void setViewRect(float minX, float minY, float maxX, float maxY);
+
+    /**
+     * Record the culling compute pass. Must run before the render pass using
+     * draw(), after InstancedRenderer::upload() for the frame.
+     */
+    void encode(UploadRing& ring, WGPUCommandEncoder encoder, InstancedRenderer const & renderer);
+
+    /**
+     * Add the draw of the visible instances, one indirect draw, to `queue`.
+     */
+    void draw(DrawQueue& queue, InstancedRenderer const & renderer) const;
+
+    /**
+     * Start mapping the readback written this frame. Call after submit.
+     */
+    void afterSubmit();
+
+    uint32_t testedCount() const { return m_testedCount; }
+    uint32_t visibleCount() const { return m_visibleCount; }
+
+private:
+    struct Params {
+        float planes[4][4];
+        uint32_t instanceCount;
+        float radiusScale;
+        uint32_t padding[2];
+    };
+
+    struct Readback {
+        GpuCulling* owner = nullptr;
+        Handle<WGPUBuffer> buffer;
+        bool inFlight = false;
+        bool copyPending = false;
+    };
+
+    void rebuildBindGroups(UploadRing const & ring, InstancedRenderer const & renderer);
+
+    WGPUDevice m_device = nullptr;
+    Params m_params = {};
+    Handle<WGPUComputePipeline> m_pipeline;
+    // Owned by bindGroupCache
+    WGPUBindGroupLayout m_cullBindGroupLayout = nullptr;
+    Handle<WGPUBuffer> m_drawArgsBuffer;
+    Handle<WGPUBuffer> m_visibleBuffers[InstanceStore::StreamCount];
+    Handle<WGPUBindGroup> m_cullBindGroup;
+    Handle<WGPUBindGroup> m_drawBindGroup;
+    // Buffers the bind groups were built for, they change when the renderer
+    // or the upload ring grow
+    WGPUBuffer m_boundTransforms = nullptr;
+    uint32_t m_boundRingGeneration = 0;
+    uint64_t m_capacity = 0;
+
+    PerFrame<Readback> m_readbacks;
+    uint32_t m_testedCount = 0;
+    uint32_t m_visibleCount = 0;
+};
@@ -0,0 +1,151 @@
+#include "gpu-profiler.h"
+
+#include <chrono>
+#include <cstring>
+
+static double cpuMilliseconds() {
+    using namespace std::chrono;
+    return duration<double, std::milli>(steady_clock::now().time_since_epoch()).count();
+}
+
+void GpuProfiler::init(WGPUDevice device) {
+    if (!wgpuDeviceHasFeature(device, WGPUFeatureName_TimestampQuery)) {
+        return;
+    }
+
+    WGPUQuerySetDescriptor querySetDesc{};
+    querySetDesc.label = "pass-timestamps";
+    querySetDesc.type = WGPUQueryType_Timestamp;
+    querySetDesc.count = MaxPasses * 2;
+    m_querySet.reset(wgpuDeviceCreateQuerySet(device, &querySetDesc));
+
+    WGPUBufferDescriptor resolveDesc{};
+    resolveDesc.label = "timestamp-resolve";
+    resolveDesc.usage = WGPUBufferUsage_QueryResolve | WGPUBufferUsage_CopySrc;
+    resolveDesc.size = MaxPasses * 2 * sizeof(uint64_t);
+    m_resolveBuffer.reset(wgpuDeviceCreateBuffer(device, &resolveDesc));
+
+    for (Readback& readback : m_readbacks) {
+        WGPUBufferDescriptor readbackDesc{};
+        readbackDesc.label = "timestamp-readback";
+        readbackDesc.usage = WGPUBufferUsage_MapRead | WGPUBufferUsage_CopyDst;
+        readbackDesc.size = MaxPasses * 2 * sizeof(uint64_t);
+        readback.owner = this;
+        readback.buffer.reset(wgpuDeviceCreateBuffer(device, &readbackDesc));
+    }
+}
+
+void GpuProfiler::beginFrame(uint32_t frameSlot) {
+    m_frameSlot = frameSlot;
+    m_passCount = 0;
+}
+
+uint32_t GpuProfiler::beginPass(char const * name) {
+    if (m_passCount == MaxPasses) {
+        return UINT32_MAX;
+    }
+    const uint32_t slot = m_passCount++;
+    m_passNames[slot] = name;
+    m_cpuBeginMilliseconds[slot] = cpuMilliseconds();
+    return slot;
+}
+
+void GpuProfiler::endPass(uint32_t slot) {
+    if (slot >= m_passCount || usesTimestamps()) {
+        return;
+    }
+    addSample(m_passNames[slot], cpuMilliseconds() - m_cpuBeginMilliseconds[slot]);
+}
+
+WGPURenderPassTimestampWrites const * GpuProfiler::renderPassTimestampWrites(uint32_t slot) {
+    if (slot >= m_passCount || !usesTimestamps()) {
+        return nullptr;
+    }
+    // Only read while the pass is being begun, one at a time is enough
+    m_renderWrites.querySet = m_querySet.get();
+    m_renderWrites.beginningOfPassWriteIndex = slot * 2;
+    m_renderWrites.endOfPassWriteIndex = slot * 2 + 1;
+    return &m_renderWrites;
+}
+
+WGPUComputePassTimestampWrites const * GpuProfiler::computePassTimestampWrites(uint32_t slot) {
+    if (slot >= m_passCount || !usesTimestamps()) {
+        return nullptr;
+    }
+    m_computeWrites.querySet = m_querySet.get();
+    m_computeWrites.beginningOfPassWriteIndex = slot * 2;
+    m_computeWrites.endOfPassWriteIndex = slot * 2 + 1;
+    return &m_computeWrites;
+}
+
+void GpuProfiler::resolve(WGPUCommandEncoder encoder) {
+    if (!usesTimestamps() || m_passCount == 0) {
+        return;
+    }
+    Readback& readback = m_readbacks[m_frameSlot];
+    if (readback.inFlight) {
+        return;
+    }
+    const uint64_t size = m_passCount * 2 * sizeof(uint64_t);
+    wgpuCommandEncoderResolveQuerySet(encoder, m_querySet.get(), 0, m_passCount * 2, m_resolveBuffer.get(), 0);
+    wgpuCommandEncoderCopyBufferToBuffer(encoder, m_resolveBuffer.get(), 0, readback.buffer.get(), 0, size);
+    memcpy(readback.passNames, m_passNames, sizeof(m_passNames));
+    readback.passCount = m_passCount;
+    readback.inFlight = true;
+    readback.copyPending = true;
+}
+
+void GpuProfiler::afterSubmit() {
+    auto onReadbackMapped = [](WGPUBufferMapAsyncStatus status, void * pUserData) {
+        Readback& readback = *reinterpret_cast<Readback*>(pUserData);
+        if (status == WGPUBufferMapAsyncStatus_Success) {
+            const uint64_t size = readback.passCount * 2 * sizeof(uint64_t);
+            uint64_t timestamps[MaxPasses * 2];
+            memcpy(timestamps, wgpuBufferGetConstMappedRange(readback.buffer.get(), 0, size), size);
+            wgpuBufferUnmap(readback.buffer.get());
+            for (uint32_t i = 0; i < readback.passCount; ++i) {
+                const uint64_t begin = timestamps[2 * i];
+                const uint64_t end = timestamps[2 * i + 1];
+                // Timestamps are in nanoseconds; implementations may clamp or
+                // reset them, skip pairs that went backwards
+                if (end >= begin) {
+                    readback.owner->addSample(readback.passNames[i], double(end - begin) * 1e-6);
+                }
+            }
+        }
+        readback.inFlight = false;
+    };
+
+    for (Readback& readback : m_readbacks) {
+        if (readback.copyPending) {
+            readback.copyPending = false;
+            wgpuBufferMapAsync(readback.buffer.get(), WGPUMapMode_Read, 0, readback.passCount * 2 * sizeof(uint64_t),
+                               onReadbackMapped, (void*)&readback);
+        }
+    }
+}
+
+void GpuProfiler::addSample(char const * name, double milliseconds) {
+    PassTiming* timing = nullptr;
+    for (PassTiming& candidate : m_timings) {
+        if (strcmp(candidate.name, name) == 0) {
+            timing = &candidate;
+            break;
+        }
+    }
+    if (!timing) {
+        m_timings.emplace_back();
+        timing = &m_timings.back();
+        timing->name = name;
+    }
+
+    timing->lastMilliseconds = milliseconds;
+    timing->history[timing->sampleCount % HistorySize] = milliseconds;
+    ++timing->sampleCount;
+    const uint32_t count = timing->sampleCount < HistorySize ? timing->sampleCount : HistorySize;
+    double sum = 0.0;
+    for (uint32_t i = 0; i < count; ++i) {
+        sum += timing->history[i];
+    }
+    timing->averageMilliseconds = sum / count;
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <webgpu/webgpu.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "frame-pacer.h"
+#include "webgpu-handles.h"
+
+/**
+ * Per-pass GPU timing with timestamp queries.
+ *
+ * Each profiled pass gets a begin/end timestamp pair written through the
+ * pass descriptor's timestampWrites. The query set is resolved at the end of
+ * the frame and copied into a small ring of map-read buffers, so the times
+ * arrive a few frames late but nothing ever waits on the GPU. When every
+ * readback buffer is still busy the frame is simply not measured.
+ *
+ * Without the timestamp-query feature the profiler falls back to the CPU
+ * time spent encoding each pass, usesTimestamps() tells which one it is.
+ *
+ *     const uint32_t slot = gpuProfiler.beginPass("render");
+ *     passDesc.timestampWrites = gpuProfiler.renderPassTimestampWrites(slot);
+ *     ... encode the pass ...
+ *     gpuProfiler.endPass(slot);
+ */
+class GpuProfiler {
+public:
+    static constexpr uint32_t MaxPasses = 8;
+    // Number of frames the rolling average is taken over
+    static constexpr uint32_t HistorySize = 60;
+
+    struct PassTiming {
+        char const * name = nullptr;
+        double lastMilliseconds = 0.0;
+        double averageMilliseconds = 0.0;
+        double history[HistorySize] = {};
+        uint32_t sampleCount = 0;
+    };
+
+    /**
+     * Uses timestamps if `device` was created with the timestamp-query feature.
+     */
+    void init(WGPUDevice device);
+
+    /**
+     * `frameSlot` is FramePacer::frameSlot() of the frame being encoded.
+     */
+    void beginFrame(uint32_t frameSlot);
+
+    /**
+     * Start profiling a pass named `name`, which must be a string literal (or
+     * otherwise outlive the profiler). Returns UINT32_MAX when the frame
+     * already has MaxPasses passes, the other calls accept it and do nothing.
+     */
+    uint32_t beginPass(char const * name);
+    void endPass(uint32_t slot);
+
+    /**
+     * Timestamp writes for the descriptor of the pass started with
+     * beginPass(), null when timestamps are not available.
+     */
+    WGPURenderPassTimestampWrites const * renderPassTimestampWrites(uint32_t slot);
+    WGPUComputePassTimestampWrites const * computePassTimestampWrites(uint32_t slot);
+
+    /**
+     * Resolve this frame's timestamps into a free readback buffer. Call after
+     * the last profiled pass, before finishing the encoder.
+     */
+    void resolve(WGPUCommandEncoder encoder);
+
+    /**
+     * Start mapping the readback written this frame. Call after submit.
+     */
+    void afterSubmit();
+
+    bool usesTimestamps() const { return (bool)m_querySet; }
+    std::vector<PassTiming> const & timings() const { return m_timings; }
+
+private:
+    struct Readback {
+        GpuProfiler* owner = nullptr;
+        Handle<WGPUBuffer> buffer;
+        char const * passNames[MaxPasses] = {};
+        uint32_t passCount = 0;
+        bool inFlight = false;
+        bool copyPending = false;
+    };
+
+    void addSample(char const * name, double milliseconds);
+
+    Handle<WGPUQuerySet> m_querySet;
+    Handle<WGPUBuffer> m_resolveBuffer;
+    PerFrame<Readback> m_readbacks;
+    uint32_t m_frameSlot = 0;
+
+    char const * m_passNames[MaxPasses] = {};
+    double m_cpuBeginMilliseconds[MaxPasses] = {};
+    uint32_t m_passCount = 0;
+    WGPURenderPassTimestampWrites m_renderWrites = {};
+    WGPUComputePassTimestampWrites m_computeWrites = {};
+
+    std::vector<PassTiming> m_timings;
+};
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// FNV-1a, used to hash the keys of the pipeline/shader caches. Not
+// cryptographic, only needs to be stable and cheap.
+constexpr uint64_t HashSeed = 0xcbf29ce484222325ull;
+
+inline uint64_t hashBytes(void const * data, size_t size, uint64_t hash = HashSeed) {
+    const uint8_t* bytes = static_cast<uint8_t const *>(data);
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+inline uint64_t hashString(char const * str, uint64_t hash = HashSeed) {
+    if (!str) return hashBytes("", 1, hash);
+    for (; *str; ++str) {
+        hash ^= uint8_t(*str);
+        hash *= 0x100000001b3ull;
+    }
+    // Terminator, so that ("ab", "c") and ("a", "bc") differ
+    return hashBytes("", 1, hash);
+}
+
+inline uint64_t hashString(std::string const & str, uint64_t hash = HashSeed) {
+    return hashString(str.c_str(), hash);
+}
+
+template <typename T>
+inline uint64_t hashValue(T const & value, uint64_t hash = HashSeed) {
+    return hashBytes(&value, sizeof(T), hash);
+}
+
+/**
+ * Bytes identifying a cached object, appended field by field. Caches map
+ * these to their objects instead of the hash alone, so two descriptors
+ * whose hashes collide still get objects of their own:
+ *
+ *     key.clear();
+ *     key.add(desc.layout);
+ *     key.addString(desc.entryPoint);
+ *     auto it = map.find(key);  // std::unordered_map<CacheKey, T, CacheKeyHash>
+ *
+ * Reusing one key for every lookup keeps its storage, a hit allocates
+ * nothing.
+ */
+struct CacheKey {
+    std::string bytes;
+
+    void clear() { bytes.clear(); }
+
+    template <typename T>
+    void add(T const & value) {
+        bytes.append(reinterpret_cast<char const *>(&value), sizeof(T));
+    }
+
+    // Null adds the same as "", with a terminator like hashString()
+    void addString(char const * str) {
+        if (str) bytes.append(str);
+        bytes.push_back('\0');
+    }
+
+    bool operator==(CacheKey const & other) const { return bytes == other.bytes; }
+};
+
+struct CacheKeyHash {
+    size_t operator()(CacheKey const & key) const { return size_t(hashBytes(key.bytes.data(), key.bytes.size())); }
+};
@@ -0,0 +1,49 @@
+#include "instance-store.h"
+
+void InstanceStore::resize(uint32_t count) {
+    const uint32_t previousCount = m_count;
+    m_count = count;
+    m_transforms.resize(count);
+    m_colors.resize(count, 0xFFFFFFFF);
+
+    const uint32_t chunkCount = (count + ChunkSize - 1) / ChunkSize;
+    for (auto& dirty : m_dirtyChunks) {
+        dirty.resize(chunkCount, false);
+    }
+    if (count > previousCount) {
+        markDirty(TransformStream, previousCount, count);
+        markDirty(ColorStream, previousCount, count);
+    }
+}
+
+void InstanceStore::markDirty(Stream stream, uint32_t begin, uint32_t end) {
+    if (begin >= end) {
+        return;
+    }
+    std::vector<bool>& dirty = m_dirtyChunks[stream];
+    const uint32_t lastChunk = (end - 1) / ChunkSize;
+    for (uint32_t chunk = begin / ChunkSize; chunk <= lastChunk; ++chunk) {
+        dirty[chunk] = true;
+    }
+}
+
+void InstanceStore::markAllDirty() {
+    markDirty(TransformStream, 0, m_count);
+    markDirty(ColorStream, 0, m_count);
+}
+
+size_t InstanceStore::elementSize(Stream stream) {
+    switch (stream) {
+        case TransformStream: return sizeof(InstanceTransform);
+        case ColorStream: return sizeof(uint32_t);
+        default: return 0;
+    }
+}
+
+void const * InstanceStore::streamData(Stream stream) const {
+    switch (stream) {
+        case TransformStream: return m_transforms.data();
+        case ColorStream: return m_colors.data();
+        default: return nullptr;
+    }
+}
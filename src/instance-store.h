@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Per-instance 2D transform, laid out as the vec4<f32> the instanced vertex
+ * shader reads (position, uniform scale, rotation in radians).
+ */
+struct InstanceTransform {
+    float x = 0.0f;
+    float y = 0.0f;
+    float scale = 1.0f;
+    float rotation = 0.0f;
+};
+static_assert(sizeof(InstanceTransform) == 16, "InstanceTransform must match vec4<f32>");
+
+/**
+ * CPU-side instance data stored as structure of arrays: one array per
+ * attribute, each one laid out exactly like the matching GPU storage buffer so
+ * dirty ranges can be handed to wgpuQueueWriteBuffer without repacking.
+ *
+ * Dirtiness is tracked per chunk of `ChunkSize` instances and per stream, so
+ * animating a few objects uploads a few chunks, not the whole store.
+ */
+class InstanceStore {
+public:
+    static constexpr uint32_t ChunkSize = 1024;
+
+    enum Stream : uint32_t {
+        TransformStream = 0,
+        ColorStream,
+        StreamCount
+    };
+
+    void resize(uint32_t count);
+    uint32_t size() const { return m_count; }
+
+    void setTransform(uint32_t index, InstanceTransform const & transform) {
+        m_transforms[index] = transform;
+        markDirty(TransformStream, index, index + 1);
+    }
+
+    // Colors are packed RGBA8, red in the lowest byte (unpack4x8unorm order)
+    void setColor(uint32_t index, uint32_t rgba) {
+        m_colors[index] = rgba;
+        markDirty(ColorStream, index, index + 1);
+    }
+
+    /**
+     * Direct access for bulk updates, call markDirty() on what was written.
+     */
+    InstanceTransform* transforms() { return m_transforms.data(); }
+    uint32_t* colors() { return m_colors.data(); }
+    InstanceTransform const * transforms() const { return m_transforms.data(); }
+    uint32_t const * colors() const { return m_colors.data(); }
+
+    void markDirty(Stream stream, uint32_t begin, uint32_t end);
+    void markAllDirty();
+
+    static size_t elementSize(Stream stream);
+    void const * streamData(Stream stream) const;
+
+    /**
+     * Call `upload(stream, firstInstance, instanceCount)` once per run of
+     * consecutive dirty chunks, then clear the dirty state.
+     */
+    template <typename UploadFunction>
+    void consumeDirtyRanges(UploadFunction&& upload) {
+        for (uint32_t stream = 0; stream < StreamCount; ++stream) {
+            std::vector<bool>& dirty = m_dirtyChunks[stream];
+            const uint32_t chunkCount = (uint32_t)dirty.size();
+            uint32_t chunk = 0;
+            while (chunk < chunkCount) {
+                if (!dirty[chunk]) {
+                    ++chunk;
+                    continue;
+                }
+                const uint32_t firstChunk = chunk;
+                while (chunk < chunkCount && dirty[chunk]) {
+                    dirty[chunk] = false;
+                    ++chunk;
+                }
+                const uint32_t first = firstChunk * ChunkSize;
+                const uint32_t last = chunk * ChunkSize < m_count ? chunk * ChunkSize : m_count;
+                upload(Stream(stream), first, last - first);
+            }
+        }
+    }
+
+private:
+    uint32_t m_count = 0;
+    std::vector<InstanceTransform> m_transforms;
+    std::vector<uint32_t> m_colors;
+    std::vector<bool> m_dirtyChunks[StreamCount];
+};
@@ -0,0 +1,275 @@
+#include "instanced-renderer.h"
+#include "frame-stats.h"
+#include "webgpu-renderer.h"
+
+#include <algorithm>
+#include <cstring>
+
+void InstancedRenderer::init(WGPUDevice device, WGPUTextureFormat colorFormat) {
+    m_device = device;
+    m_colorFormat = colorFormat;
+
+    WGPUShaderModule shaderModule = shaderLibrary.getModule("instanced.wgsl");
+
+    WGPUBindGroupLayoutEntry layoutEntries[InstanceStore::StreamCount] = {};
+    for (uint32_t i = 0; i < InstanceStore::StreamCount; ++i) {
+        layoutEntries[i].binding = i;
+        layoutEntries[i].visibility = WGPUShaderStage_Vertex;
+        layoutEntries[i].buffer.type = WGPUBufferBindingType_ReadOnlyStorage;
+        layoutEntries[i].buffer.minBindingSize = 0;
+    }
+    WGPUBindGroupLayoutDescriptor bindGroupLayoutDesc{};
+    bindGroupLayoutDesc.label = "instances-layout";
+    bindGroupLayoutDesc.entryCount = InstanceStore::StreamCount;
+    bindGroupLayoutDesc.entries = layoutEntries;
+    m_bindGroupLayout = bindGroupCache.getBindGroupLayout(bindGroupLayoutDesc);
+
+    WGPUBindGroupLayoutEntry viewEntry{};
+    viewEntry.binding = 0;
+    viewEntry.visibility = WGPUShaderStage_Vertex;
+    viewEntry.buffer.type = WGPUBufferBindingType_Uniform;
+    viewEntry.buffer.hasDynamicOffset = true;
+    viewEntry.buffer.minBindingSize = sizeof(ViewUniforms);
+    WGPUBindGroupLayoutDescriptor viewLayoutDesc{};
+    viewLayoutDesc.label = "view-layout";
+    viewLayoutDesc.entryCount = 1;
+    viewLayoutDesc.entries = &viewEntry;
+    m_viewBindGroupLayout = bindGroupCache.getBindGroupLayout(viewLayoutDesc);
+
+    WGPUBlendState blend = {
+            .color = WGPUBlendComponent{
+                    .operation = WGPUBlendOperation_Add,
+                    .srcFactor = WGPUBlendFactor_One,
+                    .dstFactor = WGPUBlendFactor_One,
+            },
+            .alpha = WGPUBlendComponent{
+                    .operation = WGPUBlendOperation_Add,
+                    .srcFactor = WGPUBlendFactor_One,
+                    .dstFactor = WGPUBlendFactor_One,
+            },
+    };
+    WGPUColorTargetState colorTarget{};
+    colorTarget.format = colorFormat;
+    colorTarget.blend = &blend;
+    colorTarget.writeMask = WGPUColorWriteMask_All;
+
+    WGPUFragmentState fragment{};
+    fragment.module = shaderModule;
+    fragment.entryPoint = "fs_main";
+    fragment.targetCount = 1;
+    fragment.targets = &colorTarget;
+
+    WGPUVertexState vertex{};
+    vertex.module = shaderModule;
+    vertex.entryPoint = "vs_main";
+
+    const uint32_t whiteColor = 0xFFFFFFFF;
+
+    WGPUBindGroupLayout bindGroupLayouts[] = {m_bindGroupLayout, m_viewBindGroupLayout};
+    WGPUPipelineLayoutDescriptor pipelineLayoutDesc{};
+    pipelineLayoutDesc.bindGroupLayoutCount = 2;
+    pipelineLayoutDesc.bindGroupLayouts = bindGroupLayouts;
+    m_pipelineLayout = bindGroupCache.getPipelineLayout(pipelineLayoutDesc);
+
+    WGPUPrimitiveState primitiveState{};
+    primitiveState.topology = WGPUPrimitiveTopology_TriangleList;
+    primitiveState.stripIndexFormat = WGPUIndexFormat_Undefined;
+    primitiveState.frontFace = WGPUFrontFace_CCW;
+    primitiveState.cullMode = WGPUCullMode_None;
+
+    WGPUMultisampleState multisampleState{};
+    multisampleState.count = 1;
+    multisampleState.mask = whiteColor;
+
+    WGPURenderPipelineDescriptor pipelineDesc{};
+    pipelineDesc.label = "instanced-pipeline";
+    pipelineDesc.layout = m_pipelineLayout;
+    pipelineDesc.vertex = vertex;
+    pipelineDesc.fragment = &fragment;
+    pipelineDesc.primitive = primitiveState;
+    pipelineDesc.multisample = multisampleState;
+
+    // Compiled in the background, draw() skips until it is ready
+    m_pipeline = pipelineCache.getRenderPipeline(pipelineDesc);
+
+    WGPUBufferDescriptor viewBufferDesc{};
+    viewBufferDesc.label = "bundle-view";
+    viewBufferDesc.usage = WGPUBufferUsage_Uniform | WGPUBufferUsage_CopyDst;
+    viewBufferDesc.size = sizeof(ViewUniforms);
+    m_bundleViewBuffer.reset(wgpuDeviceCreateBuffer(device, &viewBufferDesc));
+
+    WGPUBindGroupEntry viewBindGroupEntry{};
+    viewBindGroupEntry.binding = 0;
+    viewBindGroupEntry.buffer = m_bundleViewBuffer.get();
+    viewBindGroupEntry.offset = 0;
+    viewBindGroupEntry.size = sizeof(ViewUniforms);
+    WGPUBindGroupDescriptor viewBindGroupDesc{};
+    viewBindGroupDesc.label = "bundle-view";
+    viewBindGroupDesc.layout = m_viewBindGroupLayout;
+    viewBindGroupDesc.entryCount = 1;
+    viewBindGroupDesc.entries = &viewBindGroupEntry;
+    m_bundleViewBindGroup.reset(wgpuDeviceCreateBindGroup(device, &viewBindGroupDesc));
+
+    reserve(InstanceStore::ChunkSize);
+}
+
+void InstancedRenderer::reserve(uint32_t capacity) {
+    if (capacity <= m_capacity) {
+        return;
+    }
+    // Grow geometrically so a slowly growing store does not reallocate every frame
+    m_capacity = std::max(capacity, m_capacity * 2);
+
+    WGPUBindGroupEntry entries[InstanceStore::StreamCount] = {};
+    for (uint32_t i = 0; i < InstanceStore::StreamCount; ++i) {
+        const auto stream = InstanceStore::Stream(i);
+        WGPUBufferDescriptor bufferDesc{};
+        bufferDesc.label = stream == InstanceStore::TransformStream ? "instance-transforms" : "instance-colors";
+        bufferDesc.usage = WGPUBufferUsage_Storage | WGPUBufferUsage_CopyDst;
+        bufferDesc.size = uint64_t(m_capacity) * InstanceStore::elementSize(stream);
+        bufferDesc.mappedAtCreation = false;
+
+        // Frames still in flight may read the old buffer
+        deferredReleases.retire(std::move(m_buffers[i]));
+        m_buffers[i].reset(wgpuDeviceCreateBuffer(m_device, &bufferDesc));
+
+        entries[i].binding = i;
+        entries[i].buffer = m_buffers[i].get();
+        entries[i].offset = 0;
+        entries[i].size = bufferDesc.size;
+    }
+
+    WGPUBindGroupDescriptor bindGroupDesc{};
+    bindGroupDesc.label = "instances";
+    bindGroupDesc.layout = m_bindGroupLayout;
+    bindGroupDesc.entryCount = InstanceStore::StreamCount;
+    bindGroupDesc.entries = entries;
+    deferredReleases.retire(std::move(m_bindGroup));
+    m_bindGroup.reset(wgpuDeviceCreateBindGroup(m_device, &bindGroupDesc));
+}
+
+uint64_t InstancedRenderer::upload(WGPUQueue queue, InstanceStore& store) {
+    if (store.size() > m_capacity) {
+        reserve(store.size());
+        // The new buffers start empty
+        store.markAllDirty();
+    }
+    m_count = store.size();
+
+    uint64_t uploadedBytes = 0;
+    store.consumeDirtyRanges([&](InstanceStore::Stream stream, uint32_t first, uint32_t count) {
+        const size_t elementSize = InstanceStore::elementSize(stream);
+        const uint8_t* data = static_cast<uint8_t const *>(store.streamData(stream)) + first * elementSize;
+        wgpuQueueWriteBuffer(queue, m_buffers[stream].get(), first * elementSize, data, count * elementSize);
+        uploadedBytes += count * elementSize;
+        ++frameStats.uploadCalls;
+    });
+    frameStats.uploadBytes += uploadedBytes;
+    return uploadedBytes;
+}
+
+void InstancedRenderer::setView(UploadRing& ring, ViewUniforms const & view) {
+    // Follows the ring when it grows into a new buffer
+    WGPUBindGroupEntry entry{};
+    entry.binding = 0;
+    entry.buffer = ring.buffer();
+    entry.offset = 0;
+    entry.size = sizeof(ViewUniforms);
+    WGPUBindGroupDescriptor bindGroupDesc{};
+    bindGroupDesc.label = "view";
+    bindGroupDesc.layout = m_viewBindGroupLayout;
+    bindGroupDesc.entryCount = 1;
+    bindGroupDesc.entries = &entry;
+    m_viewBindGroup = bindGroupCache.getBindGroup(bindGroupDesc);
+    const uint32_t offset = ring.pushUniform(view);
+    // Keep the previous frame's view rather than binding garbage if the ring is full
+    if (offset != UINT32_MAX) {
+        m_viewOffset = offset;
+    }
+}
+
+void InstancedRenderer::draw(DrawQueue& queue, uint32_t drawCount) const {
+    if (m_count == 0 || !renderPipeline()) {
+        return;
+    }
+    drawCount = std::clamp(drawCount, 1u, m_count);
+    DrawItem item;
+    item.layer = 1;
+    item.pipeline = renderPipeline();
+    item.bindGroups[0] = m_bindGroup.get();
+    item.bindGroups[1] = m_viewBindGroup;
+    item.dynamicOffsets[1] = m_viewOffset;
+    item.dynamicOffsetMask = 1u << 1;
+    item.count = 3;
+    const uint32_t perDraw = (m_count + drawCount - 1) / drawCount;
+    for (uint32_t first = 0; first < m_count; first += perDraw) {
+        item.instanceCount = std::min(perDraw, m_count - first);
+        item.firstInstance = first;
+        queue.add(item);
+    }
+    frameStats.instancesDrawn += m_count;
+}
+
+WGPURenderBundle InstancedRenderer::bundle(uint32_t drawCount) {
+    if (m_count == 0 || !renderPipeline()) {
+        return nullptr;
+    }
+    drawCount = std::clamp(drawCount, 1u, m_count);
+    const bool current = m_bundle && m_bundlePipeline == renderPipeline() && m_bundleBindGroup == m_bindGroup.get()
+                         && m_bundleCount == m_count && m_bundleDrawCount == drawCount;
+    if (!current) {
+        WGPURenderBundleEncoderDescriptor encoderDesc{};
+        encoderDesc.label = "instances-bundle-encoder";
+        encoderDesc.colorFormatCount = 1;
+        encoderDesc.colorFormats = &m_colorFormat;
+        encoderDesc.depthStencilFormat = WGPUTextureFormat_Undefined;
+        encoderDesc.sampleCount = 1;
+        Handle<WGPURenderBundleEncoder> encoder(wgpuDeviceCreateRenderBundleEncoder(m_device, &encoderDesc));
+        // The same draws as draw(), against the bundle's own view buffer
+        const uint32_t viewOffset = 0;
+        wgpuRenderBundleEncoderSetPipeline(encoder.get(), renderPipeline());
+        wgpuRenderBundleEncoderSetBindGroup(encoder.get(), 0, m_bindGroup.get(), 0, nullptr);
+        wgpuRenderBundleEncoderSetBindGroup(encoder.get(), 1, m_bundleViewBindGroup.get(), 1, &viewOffset);
+        // Fewer draws than asked for when they do not divide the instances
+        // evenly, e.g. 10 instances in 6 draws go by 2 in 5 draws
+        const uint32_t perDraw = (m_count + drawCount - 1) / drawCount;
+        m_bundleDraws = 0;
+        for (uint32_t first = 0; first < m_count; first += perDraw) {
+            wgpuRenderBundleEncoderDraw(encoder.get(), 3, std::min(perDraw, m_count - first), 0, first);
+            ++m_bundleDraws;
+        }
+
+        WGPURenderBundleDescriptor bundleDesc{};
+        bundleDesc.label = "instances-bundle";
+        deferredReleases.retire(std::move(m_bundle));
+        m_bundle.reset(wgpuRenderBundleEncoderFinish(encoder.get(), &bundleDesc));
+        m_bundlePipeline = renderPipeline();
+        m_bundleBindGroup = m_bindGroup.get();
+        m_bundleCount = m_count;
+        m_bundleDrawCount = drawCount;
+        ++frameStats.bundlesRecorded;
+    }
+
+    // Every execution sets the bundle's pipeline and both bind groups again,
+    // and leaves nothing bound in the pass after it
+    ++frameStats.pipelineChanges;
+    frameStats.bindGroupChanges += 2;
+    frameStats.drawCalls += m_bundleDraws;
+    frameStats.instancesDrawn += m_count;
+    return m_bundle.get();
+}
+
+void InstancedRenderer::invalidateBundle() {
+    deferredReleases.retire(std::move(m_bundle));
+}
+
+void InstancedRenderer::updateBundleView(WGPUQueue queue, ViewUniforms const & view) {
+    if (m_bundleViewWritten && memcmp(&m_bundleView, &view, sizeof(ViewUniforms)) == 0) {
+        return;
+    }
+    m_bundleView = view;
+    m_bundleViewWritten = true;
+    wgpuQueueWriteBuffer(queue, m_bundleViewBuffer.get(), 0, &m_bundleView, sizeof(ViewUniforms));
+    frameStats.uploadBytes += sizeof(ViewUniforms);
+    ++frameStats.uploadCalls;
+}
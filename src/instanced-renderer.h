@@ -0,0 +1,103 @@
+#pragma once
+
+#include <webgpu/webgpu.h>
+
+#include "draw-queue.h"
+#include "instance-store.h"
+#include "pipeline-cache.h"
+#include "scene.h"
+#include "upload-ring.h"
+#include "webgpu-handles.h"
+
+/**
+ * Draws every instance of an InstanceStore with a single draw call. The
+ * vertex shader pulls per-instance transforms and colors from storage
+ * buffers indexed by instance_index, so there is no per-object CPU work at
+ * draw time.
+ */
+class InstancedRenderer {
+public:
+    void init(WGPUDevice device, WGPUTextureFormat colorFormat);
+
+    /**
+     * Write the dirty ranges of `store` to the GPU buffers, growing them
+     * first when the store outgrew their capacity. Returns the bytes written.
+     */
+    uint64_t upload(WGPUQueue queue, InstanceStore& store);
+
+    /**
+     * Push this frame's view uniforms to the upload ring, they are bound with
+     * a dynamic offset by draw() and by other code through viewBindGroup()
+     * and viewOffset().
+     */
+    void setView(UploadRing& ring, ViewUniforms const & view);
+
+    /**
+     * Add the instances to `queue`, split into `drawCount` draws over
+     * consecutive instance ranges (one per object of a scene built from many
+     * draws), in layer 1 so that they blend over what layer 0 draws.
+     */
+    void draw(DrawQueue& queue, uint32_t drawCount = 1) const;
+
+    /**
+     * Same draws as draw(), recorded once into a render bundle and replayed
+     * with wgpuRenderPassEncoderExecuteBundles. The bundle is re-recorded only
+     * when the draw structure changes: instance count, buffers reallocated,
+     * pipeline or `drawCount`. Instance data written by upload() does not
+     * invalidate it. Returns null while the pipeline is compiling.
+     */
+    WGPURenderBundle bundle(uint32_t drawCount);
+    void invalidateBundle();
+
+    /**
+     * Bundles cannot see the per-frame dynamic offset of setView(), they
+     * bind a dedicated view buffer instead. Writes it only when `view`
+     * changed since the last call.
+     */
+    void updateBundleView(WGPUQueue queue, ViewUniforms const & view);
+
+    WGPUBindGroup viewBindGroup() const { return m_viewBindGroup; }
+    uint32_t viewOffset() const { return m_viewOffset; }
+
+    uint32_t instanceCount() const { return m_count; }
+    uint32_t capacity() const { return m_capacity; }
+    WGPUBuffer streamBuffer(InstanceStore::Stream stream) const { return m_buffers[stream].get(); }
+    /**
+     * Null while the pipeline cache is still compiling the pipeline.
+     */
+    WGPURenderPipeline renderPipeline() const { return m_pipeline ? m_pipeline->get() : nullptr; }
+    WGPUBindGroup bindGroup() const { return m_bindGroup.get(); }
+    WGPUBindGroupLayout bindGroupLayout() const { return m_bindGroupLayout; }
+    WGPUBindGroupLayout viewBindGroupLayout() const { return m_viewBindGroupLayout; }
+
+private:
+    void reserve(uint32_t capacity);
+
+    WGPUDevice m_device = nullptr;
+    WGPUTextureFormat m_colorFormat = WGPUTextureFormat_Undefined;
+    CachedRenderPipeline const * m_pipeline = nullptr;
+    // Owned by bindGroupCache
+    WGPUPipelineLayout m_pipelineLayout = nullptr;
+    WGPUBindGroupLayout m_bindGroupLayout = nullptr;
+    WGPUBindGroupLayout m_viewBindGroupLayout = nullptr;
+    // Looked up by setView() every frame
+    WGPUBindGroup m_viewBindGroup = nullptr;
+    uint32_t m_viewOffset = 0;
+    Handle<WGPUBuffer> m_buffers[InstanceStore::StreamCount];
+    Handle<WGPUBindGroup> m_bindGroup;
+    uint32_t m_capacity = 0;
+    uint32_t m_count = 0;
+
+    Handle<WGPUBuffer> m_bundleViewBuffer;
+    Handle<WGPUBindGroup> m_bundleViewBindGroup;
+    ViewUniforms m_bundleView;
+    bool m_bundleViewWritten = false;
+    Handle<WGPURenderBundle> m_bundle;
+    // What m_bundle was recorded with
+    WGPURenderPipeline m_bundlePipeline = nullptr;
+    WGPUBindGroup m_bundleBindGroup = nullptr;
+    uint32_t m_bundleCount = 0;
+    uint32_t m_bundleDrawCount = 0;
+    // Draws recorded, at most m_bundleDrawCount
+    uint32_t m_bundleDraws = 0;
+};
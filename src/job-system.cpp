@@ -0,0 +1,160 @@
+#include "job-system.h"
+
+#include <algorithm>
+
+JobSystem jobSystem;
+
+#ifdef JOB_SYSTEM_THREADS
+
+// Index of the calling thread's queue, 0 for the main thread
+static thread_local uint32_t currentQueueIndex = 0;
+
+void JobSystem::init(uint32_t workerCount) {
+    shutdown();
+    m_queues.clear();
+    for (uint32_t i = 0; i <= workerCount; ++i) {
+        m_queues.push_back(std::make_unique<JobQueue>());
+    }
+    m_running = true;
+    for (uint32_t i = 1; i <= workerCount; ++i) {
+        m_threads.emplace_back([this, i] { workerLoop(i); });
+    }
+}
+
+void JobSystem::shutdown() {
+    if (!m_running) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+        m_running = false;
+    }
+    m_wake.notify_all();
+    for (std::thread& thread : m_threads) {
+        thread.join();
+    }
+    m_threads.clear();
+}
+
+uint32_t JobSystem::workerCount() const {
+    return (uint32_t)m_threads.size();
+}
+
+uint32_t JobSystem::hardwareThreads() {
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+void JobSystem::parallelFor(uint32_t count, uint32_t grainSize, RangeFunction function, void* context) {
+    grainSize = std::max(1u, grainSize);
+    if (count == 0) {
+        return;
+    }
+    if (m_threads.empty() || count <= grainSize) {
+        function(context, 0, count);
+        m_jobsRun.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    const uint32_t jobCount = (count + grainSize - 1) / grainSize;
+    std::atomic<uint32_t> pending{jobCount};
+    const uint32_t queueIndex = currentQueueIndex;
+    {
+        JobQueue& queue = *m_queues[queueIndex];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        for (uint32_t begin = 0; begin < count; begin += grainSize) {
+            queue.jobs.push_back(Job{function, context, begin, std::min(begin + grainSize, count), &pending});
+        }
+    }
+    {
+        // Under the sleep mutex so a worker about to sleep cannot miss it
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+        m_queuedJobs.fetch_add(jobCount);
+    }
+    m_wake.notify_all();
+
+    // Help until our jobs are done, whoever ends up running them
+    while (pending.load(std::memory_order_acquire) > 0) {
+        if (!runOne(queueIndex)) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+bool JobSystem::popLocal(uint32_t queueIndex, Job& job) {
+    JobQueue& queue = *m_queues[queueIndex];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.jobs.empty()) {
+        return false;
+    }
+    job = queue.jobs.back();
+    queue.jobs.pop_back();
+    return true;
+}
+
+bool JobSystem::steal(uint32_t thiefIndex, Job& job) {
+    const uint32_t queueCount = (uint32_t)m_queues.size();
+    for (uint32_t offset = 1; offset < queueCount; ++offset) {
+        JobQueue& queue = *m_queues[(thiefIndex + offset) % queueCount];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (!queue.jobs.empty()) {
+            job = queue.jobs.front();
+            queue.jobs.pop_front();
+            m_jobsStolen.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool JobSystem::runOne(uint32_t queueIndex) {
+    Job job;
+    if (!popLocal(queueIndex, job) && !steal(queueIndex, job)) {
+        return false;
+    }
+    m_queuedJobs.fetch_sub(1, std::memory_order_relaxed);
+    job.function(job.context, job.begin, job.end);
+    m_jobsRun.fetch_add(1, std::memory_order_relaxed);
+    job.pending->fetch_sub(1, std::memory_order_release);
+    return true;
+}
+
+void JobSystem::workerLoop(uint32_t queueIndex) {
+    currentQueueIndex = queueIndex;
+    while (true) {
+        if (runOne(queueIndex)) {
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(m_sleepMutex);
+        m_wake.wait(lock, [this] { return !m_running || m_queuedJobs.load() > 0; });
+        if (!m_running) {
+            return;
+        }
+    }
+}
+
+JobSystem::Stats JobSystem::stats() const {
+    return Stats{m_jobsRun.load(), m_jobsStolen.load()};
+}
+
+void JobSystem::resetStats() {
+    m_jobsRun = 0;
+    m_jobsStolen = 0;
+}
+
+#else // NOT JOB_SYSTEM_THREADS
+
+void JobSystem::init(uint32_t /* workerCount */) {}
+void JobSystem::shutdown() {}
+uint32_t JobSystem::workerCount() const { return 0; }
+uint32_t JobSystem::hardwareThreads() { return 1; }
+
+void JobSystem::parallelFor(uint32_t count, uint32_t /* grainSize */, RangeFunction function, void* context) {
+    if (count > 0) {
+        function(context, 0, count);
+    }
+}
+
+JobSystem::Stats JobSystem::stats() const { return Stats{}; }
+void JobSystem::resetStats() {}
+
+#endif // JOB_SYSTEM_THREADS
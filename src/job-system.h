@@ -0,0 +1,106 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Threads exist natively and in web builds made with -pthread (ENABLE_PTHREADS),
+// otherwise every job runs inline on the calling thread
+#if !defined(__EMSCRIPTEN__) || defined(__EMSCRIPTEN_PTHREADS__)
+#  define JOB_SYSTEM_THREADS 1
+#  include <condition_variable>
+#  include <deque>
+#  include <mutex>
+#  include <thread>
+#endif
+
+/**
+ * Work-stealing scheduler for per-frame CPU work (scene update, culling,
+ * draw list building) so that the main thread is left with encoding and
+ * submitting.
+ *
+ * Each thread owns a job queue. parallelFor() splits a range into jobs on
+ * the caller's queue; owners pop from the back of their queue (most recent,
+ * cache-warm) and idle threads steal from the front of the others. The
+ * caller runs jobs too while it waits, so a nested parallelFor() from inside
+ * a job does not deadlock. Only the main thread and jobs may call it.
+ *
+ *     jobSystem.parallelFor(count, 1024, [&](uint32_t begin, uint32_t end) {
+ *         for (uint32_t i = begin; i < end; ++i) update(i);
+ *     });
+ */
+class JobSystem {
+public:
+    using RangeFunction = void (*)(void* context, uint32_t begin, uint32_t end);
+
+    struct Stats {
+        uint64_t jobsRun = 0;
+        uint64_t jobsStolen = 0;
+    };
+
+    ~JobSystem() { shutdown(); }
+
+    /**
+     * Start `workerCount` threads besides the caller. 0, or a build without
+     * threads, runs everything inline.
+     */
+    void init(uint32_t workerCount);
+    void shutdown();
+
+    uint32_t workerCount() const;
+
+    /**
+     * Threads the machine can run at once (including the main thread), 1
+     * without thread support.
+     */
+    static uint32_t hardwareThreads();
+
+    /**
+     * Call `function(begin, end)` over [0, count) in chunks of `grainSize`
+     * and return once every chunk ran.
+     */
+    template <typename Function>
+    void parallelFor(uint32_t count, uint32_t grainSize, Function&& function) {
+        parallelFor(count, grainSize, [](void* context, uint32_t begin, uint32_t end) {
+            (*static_cast<Function*>(context))(begin, end);
+        }, &function);
+    }
+    void parallelFor(uint32_t count, uint32_t grainSize, RangeFunction function, void* context);
+
+    Stats stats() const;
+    void resetStats();
+
+private:
+#ifdef JOB_SYSTEM_THREADS
+    struct Job {
+        RangeFunction function;
+        void* context;
+        uint32_t begin;
+        uint32_t end;
+        std::atomic<uint32_t>* pending;
+    };
+
+    struct JobQueue {
+        std::mutex mutex;
+        std::deque<Job> jobs;
+    };
+
+    bool popLocal(uint32_t queueIndex, Job& job);
+    bool steal(uint32_t thiefIndex, Job& job);
+    bool runOne(uint32_t queueIndex);
+    void workerLoop(uint32_t queueIndex);
+
+    // Queue 0 belongs to the main thread, queue i to worker i
+    std::vector<std::unique_ptr<JobQueue>> m_queues;
+    std::vector<std::thread> m_threads;
+    std::atomic<bool> m_running{false};
+    std::atomic<uint32_t> m_queuedJobs{0};
+    std::mutex m_sleepMutex;
+    std::condition_variable m_wake;
+    std::atomic<uint64_t> m_jobsRun{0};
+    std::atomic<uint64_t> m_jobsStolen{0};
+#endif // JOB_SYSTEM_THREADS
+};
+
+extern JobSystem jobSystem;
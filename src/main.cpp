@@ -0,0 +1,235 @@
+#include <emscripten.h>
+#include <emscripten/bind.h>
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "job-system.h"
+#include "renderer.h"
+#include "scene.h"
+#include "scene-socket.h"
+#include "trace.h"
+
+// Web entry point shared by both backends: startup metrics, the main loop
+// and the benchmark scene. The backend comes from createRenderer().
+
+std::unique_ptr<Renderer> renderer;
+
+// Startup timestamps (ms, emscripten_get_now) used to report time-to-first-frame
+double mainStartTime = 0.0;
+double rendererReadyTime = 0.0;
+bool firstFrameRendered = false;
+
+// Benchmark mode, enabled with ?instances=N[&frames=F] in the page URL
+uint32_t benchmarkInstances = 0;
+uint32_t benchmarkFrames = 600;
+// Frames skipped before measuring, they include uploads and shader compilation
+const uint32_t benchmarkWarmupFrames = 60;
+uint32_t benchmarkFrameIndex = 0;
+// With ?graph=P as well, the benchmark scene is a scene graph of the same
+// size in which P percent of the nodes move every frame; negative without it
+double benchmarkGraphPercent = -1.0;
+uint32_t animationFrame = 0;
+// With ?stream=ws://host:port as well, the scene graph follows the updates
+// that server sends instead of being animated here (bench-scene-stream
+// --serve is a stand-in server building the same graph)
+std::string sceneStreamUrl;
+SceneStreamDecoder sceneStream;
+double previousFrameTime = 0.0;
+std::vector<double> frameIntervals;
+std::vector<double> cpuFrameTimes;
+
+void reportTimeToFirstFrame() {
+    const double now = emscripten_get_now();
+    // Set by pre.js, same clock as emscripten_get_now()
+    const double scriptStartTime = EM_ASM_DOUBLE({ return Module["scriptStartTime"] || 0; });
+    printf("Startup (%s): runtime %.1f ms, renderer %.1f ms, first frame %.1f ms after main() (%.1f ms after page load)\n",
+           renderer->backendName(), mainStartTime - scriptStartTime, rendererReadyTime - mainStartTime,
+           now - mainStartTime, now);
+    // Keys are quoted so that closure (production builds) does not rename them
+    EM_ASM({
+        Module["timeToFirstFrame"] = $0;
+        Module["startupMetrics"] = {"runtimeMs": $1, "rendererMs": $2, "firstFrameMs": $0, "pageLoadMs": $3};
+    }, now - mainStartTime, mainStartTime - scriptStartTime, rendererReadyTime - mainStartTime, now);
+}
+
+double percentile(std::vector<double> samples, double p) {
+    if (samples.empty()) return 0.0;
+    const size_t index = std::min(samples.size() - 1, size_t(p * samples.size()));
+    std::nth_element(samples.begin(), samples.begin() + index, samples.end());
+    return samples[index];
+}
+
+double mean(std::vector<double> const & samples) {
+    double sum = 0.0;
+    for (double s : samples) sum += s;
+    return samples.empty() ? 0.0 : sum / samples.size();
+}
+
+void reportBenchmark() {
+    const double frameMs = mean(frameIntervals);
+    const double p99Ms = percentile(frameIntervals, 0.99);
+    const double cpuMs = mean(cpuFrameTimes);
+    printf("Benchmark (%s): %u instances, %u frames, frame %.2f ms (p99 %.2f ms), cpu %.3f ms\n",
+           renderer->backendName(), benchmarkInstances, benchmarkFrames, frameMs, p99Ms, cpuMs);
+    EM_ASM({
+        Module["benchmarkResult"] = {"backend": UTF8ToString($0), "instances": $1, "frameMs": $2, "p99Ms": $3, "cpuMs": $4};
+    }, renderer->backendName(), benchmarkInstances, frameMs, p99Ms, cpuMs);
+}
+
+void mainLoop() {
+    TRACE_SCOPE("renderFrame");
+    const double frameStart = emscripten_get_now();
+    if (benchmarkInstances > 0 && benchmarkGraphPercent >= 0.0) {
+        TRACE_SCOPE("update scene graph");
+        if (!sceneStreamUrl.empty()) {
+            // Everything that arrived since the last frame at once
+            sceneStream.apply(sceneGraph);
+        } else {
+            animateBenchmarkSceneGraph(float(benchmarkGraphPercent / 100.0), animationFrame++);
+        }
+        sceneGraph.update(instances);
+    } else if (benchmarkInstances > 0) {
+        animateBenchmarkScene();
+    }
+    const bool drawn = renderer->renderFrame();
+    const double frameEnd = emscripten_get_now();
+    // Presenting happens when control returns to the browser
+    TRACE_INSTANT("present");
+
+    if (!firstFrameRendered && drawn) {
+        firstFrameRendered = true;
+        reportTimeToFirstFrame();
+    }
+
+    if (benchmarkInstances > 0 && drawn && benchmarkFrameIndex < benchmarkWarmupFrames + benchmarkFrames) {
+        // The interval between main loop calls is the frame time the user sees,
+        // it includes waiting for vsync and the GPU
+        if (benchmarkFrameIndex >= benchmarkWarmupFrames) {
+            frameIntervals.push_back(frameStart - previousFrameTime);
+            cpuFrameTimes.push_back(frameEnd - frameStart);
+        }
+        if (++benchmarkFrameIndex == benchmarkWarmupFrames + benchmarkFrames) {
+            reportBenchmark();
+        }
+    }
+    previousFrameTime = frameStart;
+}
+
+void onRendererReady(bool success) {
+    if (!success) {
+        std::cerr << renderer->backendName() << " initialization failed" << std::endl;
+        return;
+    }
+    rendererReadyTime = emscripten_get_now();
+
+    if (benchmarkInstances > 0) {
+        if (benchmarkGraphPercent >= 0.0) {
+            buildBenchmarkSceneGraph(benchmarkInstances);
+            sceneGraph.update(instances);
+        } else {
+            buildBenchmarkScene(benchmarkInstances);
+        }
+        if (!sceneStreamUrl.empty()) {
+            connectSceneStream(sceneStreamUrl, sceneStream);
+        }
+        frameIntervals.reserve(benchmarkFrames);
+        cpuFrameTimes.reserve(benchmarkFrames);
+    } else {
+        // A single red triangle at the origin
+        instances.resize(1);
+        instances.setTransform(0, InstanceTransform{});
+        instances.setColor(0, 0xFF0000FF);
+    }
+
+    // Backends may call this from a browser callback, so the main loop must
+    // not simulate an infinite loop (that would unwind through JS).
+    emscripten_set_main_loop(mainLoop, 0, false);
+}
+
+/**
+ * Module.dumpTrace() writes the CPU trace to TraceDirectory (IndexedDB) and
+ * returns its path, or an empty string if tracing is compiled out. Read it
+ * back with FS.readFile(path, {encoding: "utf8"}).
+ */
+std::string dumpTrace() {
+    static int traceIndex = 0;
+    const std::string path = std::string(TraceDirectory) + "/trace-" + std::to_string(traceIndex++) + ".json";
+    if (!writeChromeTrace(path.c_str())) {
+        return "";
+    }
+    persistTraceStorage();
+    return path;
+}
+
+std::string rendererBackend() {
+    return renderer ? renderer->backendName() : "";
+}
+
+/**
+ * Module.getSceneStream() returns the scene updates received with ?stream=,
+ * e.g.
+ *     { connected: true, synced: true, messages: 5400, updates: 1998000, updatesPerSecond: 74000,
+ *       bytesPerUpdate: 6.5, messagesPerFrame: 4, maxMessagesPerFrame: 9, decodeMs: 0.21, errors: 0 }
+ * messagesPerFrame and decodeMs are those of the last frame.
+ */
+emscripten::val getSceneStream() {
+    SceneStreamDecoder::Stats const & stats = sceneStream.stats();
+    emscripten::val result = emscripten::val::object();
+    result.set("connected", sceneStreamConnected());
+    result.set("synced", sceneStream.synced());
+    result.set("messages", double(stats.messages));
+    result.set("updates", double(stats.records));
+    result.set("updatesPerSecond", sceneStream.updatesPerSecond());
+    result.set("bytesPerUpdate", stats.records > 0 ? double(stats.bytes) / stats.records : 0.0);
+    result.set("messagesPerFrame", stats.frameMessages);
+    result.set("maxMessagesPerFrame", stats.maxFrameMessages);
+    result.set("decodeMs", stats.frameDecodeMilliseconds);
+    result.set("errors", double(stats.errors));
+    return result;
+}
+
+EMSCRIPTEN_BINDINGS(app) {
+    emscripten::function("dumpTrace", &dumpTrace);
+    emscripten::function("rendererBackend", &rendererBackend);
+    emscripten::function("getSceneStream", &getSceneStream);
+}
+
+int main() {
+    mainStartTime = emscripten_get_now();
+    TRACE_INSTANT("main");
+    initTraceStorage();
+    // Scene updates run on the workers, the main thread encodes and submits
+    jobSystem.init(JobSystem::hardwareThreads() - 1);
+
+    benchmarkInstances = (uint32_t)EM_ASM_INT({
+        return parseInt(new URLSearchParams(location.search).get("instances")) || 0;
+    });
+    benchmarkFrames = (uint32_t)EM_ASM_INT({
+        return parseInt(new URLSearchParams(location.search).get("frames")) || $0;
+    }, benchmarkFrames);
+    benchmarkGraphPercent = EM_ASM_DOUBLE({
+        const graph = new URLSearchParams(location.search).get("graph");
+        return graph === null ? -1 : (parseFloat(graph) || 0);
+    });
+    emscripten::val stream = emscripten::val::global("URLSearchParams")
+            .new_(emscripten::val::global("location")["search"])
+            .call<emscripten::val>("get", std::string("stream"));
+    if (!stream.isNull()) {
+        sceneStreamUrl = stream.as<std::string>();
+        if (benchmarkInstances == 0) {
+            std::cerr << "?stream= needs ?instances=N, the size of the server's scene graph" << std::endl;
+        }
+        benchmarkGraphPercent = std::max(benchmarkGraphPercent, 0.0);
+    }
+
+    renderer = createRenderer();
+    // main() may return before the renderer is ready, the runtime stays alive
+    // (EXIT_RUNTIME is off) until it is.
+    renderer->init(onRendererReady);
+
+    return 0;
+}
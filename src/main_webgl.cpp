@@ -1,79 +1,215 @@
 #include <emscripten.h>
 #include <emscripten/html5.h>
-#include <GLES2/gl2.h>
+#include <GLES3/gl3.h>
+#include <algorithm>
 #include <cstdio>
+#include <cstring>
+#include <memory>
 
-GLuint program;
-GLuint vao;
+#include "renderer.h"
+#include "scene.h"
+#include "trace.h"
+
+// WebGL2 backend of the web app, the fallback for browsers without WebGPU.
+// It draws the shared scene the same way the WebGPU instanced renderer does:
+// one instanced draw, per-instance transforms and colors in vertex buffers
+// with divisor 1, the view in a uniform buffer, additive blending.
+
+// Attribute locations are fixed in the shader, nothing is looked up at runtime
+const char* vertexShaderSource = R"(#version 300 es
+    layout(location = 0) in vec2 corner;
+    // x, y, scale, rotation
+    layout(location = 1) in vec4 transform;
+    layout(location = 2) in vec4 color;
+
+    layout(std140) uniform View {
+        vec2 center;
+        vec2 scale;
+    } view;
+
+    out vec4 vColor;
 
-// Simple shader sources
-const char* vertexShaderSource = R"(
-    attribute vec4 position;
     void main() {
-        gl_Position = position;
+        float c = cos(transform.w);
+        float s = sin(transform.w);
+        vec2 p = corner * transform.z;
+        vec2 world = vec2(transform.x + c * p.x - s * p.y, transform.y + s * p.x + c * p.y);
+        gl_Position = vec4((world - view.center) * view.scale, 0.0, 1.0);
+        vColor = color;
     }
 )";
 
-const char* fragmentShaderSource = R"(
+const char* fragmentShaderSource = R"(#version 300 es
     precision mediump float;
+    in vec4 vColor;
+    out vec4 fragColor;
     void main() {
-        gl_FragColor = vec4(1.0, 0.0, 0.0, 1.0);
+        fragColor = vColor;
     }
 )";
 
+const GLuint viewBindingPoint = 0;
+
 GLuint createShader(GLenum type, const char* source) {
     GLuint shader = glCreateShader(type);
     glShaderSource(shader, 1, &source, nullptr);
     glCompileShader(shader);
+    GLint compiled = GL_FALSE;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+    if (!compiled) {
+        char log[1024];
+        glGetShaderInfoLog(shader, sizeof(log), nullptr, log);
+        printf("Shader compilation failed: %s\n", log);
+    }
     return shader;
 }
 
-void renderFrame() {
-    glClear(GL_COLOR_BUFFER_BIT);
-    glUseProgram(program);
-    glDrawArrays(GL_TRIANGLES, 0, 3);
-}
+class WebGL2Backend : public Renderer {
+public:
+    char const * backendName() const override { return "webgl2"; }
 
-int main() {
-    EmscriptenWebGLContextAttributes attrs;
-    emscripten_webgl_init_context_attributes(&attrs);
-    EMSCRIPTEN_WEBGL_CONTEXT_HANDLE context = emscripten_webgl_create_context("#canvas", &attrs);
-    emscripten_webgl_make_context_current(context);
-
-    // Create shaders
-    GLuint vertexShader = createShader(GL_VERTEX_SHADER, vertexShaderSource);
-    GLuint fragmentShader = createShader(GL_FRAGMENT_SHADER, fragmentShaderSource);
-
-    // Create and link program
-    program = glCreateProgram();
-    glAttachShader(program, vertexShader);
-    glAttachShader(program, fragmentShader);
-    glLinkProgram(program);
-
-    // Clean up shaders
-    glDeleteShader(vertexShader);
-    glDeleteShader(fragmentShader);
-
-    // Set up vertex data
-    float vertices[] = {
-        0.0f,  0.5f, 0.0f,
-        -0.5f, -0.5f, 0.0f,
-        0.5f, -0.5f, 0.0f
-    };
-
-    GLuint vbo;
-    glGenBuffers(1, &vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-
-    // Set up vertex attributes
-    GLint posAttrib = glGetAttribLocation(program, "position");
-    glVertexAttribPointer(posAttrib, 3, GL_FLOAT, GL_FALSE, 0, 0);
-    glEnableVertexAttribArray(posAttrib);
-
-    // Set up the render loop
-    emscripten_set_main_loop(renderFrame, 0, true);
-
-    return 0;
-}
+    void init(std::function<void(bool)> onReady) override {
+        EmscriptenWebGLContextAttributes attrs;
+        emscripten_webgl_init_context_attributes(&attrs);
+        attrs.majorVersion = 2;
+        attrs.minorVersion = 0;
+        // Matches the WebGPU swap chain, which has neither
+        attrs.depth = EM_FALSE;
+        attrs.antialias = EM_FALSE;
+        EMSCRIPTEN_WEBGL_CONTEXT_HANDLE context = emscripten_webgl_create_context("#canvas", &attrs);
+        if (context <= 0 || emscripten_webgl_make_context_current(context) != EMSCRIPTEN_RESULT_SUCCESS) {
+            printf("Could not create a WebGL2 context\n");
+            onReady(false);
+            return;
+        }
 
+        TRACE_SCOPE("initWebGL2");
+        GLuint vertexShader = createShader(GL_VERTEX_SHADER, vertexShaderSource);
+        GLuint fragmentShader = createShader(GL_FRAGMENT_SHADER, fragmentShaderSource);
+        m_program = glCreateProgram();
+        glAttachShader(m_program, vertexShader);
+        glAttachShader(m_program, fragmentShader);
+        glLinkProgram(m_program);
+        glDeleteShader(vertexShader);
+        glDeleteShader(fragmentShader);
+        GLint linked = GL_FALSE;
+        glGetProgramiv(m_program, GL_LINK_STATUS, &linked);
+        if (!linked) {
+            printf("Program link failed\n");
+            onReady(false);
+            return;
+        }
+        glUniformBlockBinding(m_program, glGetUniformBlockIndex(m_program, "View"), viewBindingPoint);
+
+        glGenBuffers(1, &m_viewBuffer);
+        glBindBuffer(GL_UNIFORM_BUFFER, m_viewBuffer);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(ViewUniforms), nullptr, GL_DYNAMIC_DRAW);
+        glBindBufferBase(GL_UNIFORM_BUFFER, viewBindingPoint, m_viewBuffer);
+
+        // Everything the draw needs is captured by the VAO once
+        glGenVertexArrays(1, &m_vao);
+        glBindVertexArray(m_vao);
+
+        const float corners[] = {
+            0.0f,  0.5f,
+            -0.5f, -0.5f,
+            0.5f, -0.5f,
+        };
+        glGenBuffers(1, &m_cornerBuffer);
+        glBindBuffer(GL_ARRAY_BUFFER, m_cornerBuffer);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
+        glEnableVertexAttribArray(0);
+
+        glGenBuffers(InstanceStore::StreamCount, m_instanceBuffers);
+        reserve(InstanceStore::ChunkSize);
+
+        glBindVertexArray(0);
+
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_ONE, GL_ONE);
+        glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+        onReady(true);
+    }
+
+    bool renderFrame() override {
+        {
+            TRACE_SCOPE("upload instances");
+            upload();
+        }
+
+        TRACE_SCOPE("draw");
+        glClear(GL_COLOR_BUFFER_BIT);
+        if (m_count > 0) {
+            glUseProgram(m_program);
+            glBindVertexArray(m_vao);
+            glDrawArraysInstanced(GL_TRIANGLES, 0, 3, m_count);
+            glBindVertexArray(0);
+        }
+        return true;
+    }
+
+private:
+    /**
+     * Grow the instance buffers to hold `capacity` instances and (re)point the
+     * VAO's per-instance attributes at them. The VAO must be bound.
+     */
+    void reserve(uint32_t capacity) {
+        m_capacity = std::max(capacity, m_capacity * 2);
+
+        glBindBuffer(GL_ARRAY_BUFFER, m_instanceBuffers[InstanceStore::TransformStream]);
+        glBufferData(GL_ARRAY_BUFFER, m_capacity * InstanceStore::elementSize(InstanceStore::TransformStream),
+                     nullptr, GL_DYNAMIC_DRAW);
+        glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, 0, nullptr);
+        glVertexAttribDivisor(1, 1);
+        glEnableVertexAttribArray(1);
+
+        // Packed RGBA8, red in the lowest byte: the bytes are already r, g, b, a
+        glBindBuffer(GL_ARRAY_BUFFER, m_instanceBuffers[InstanceStore::ColorStream]);
+        glBufferData(GL_ARRAY_BUFFER, m_capacity * InstanceStore::elementSize(InstanceStore::ColorStream),
+                     nullptr, GL_DYNAMIC_DRAW);
+        glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, 0, nullptr);
+        glVertexAttribDivisor(2, 1);
+        glEnableVertexAttribArray(2);
+    }
+
+    void upload() {
+        if (instances.size() > m_capacity) {
+            glBindVertexArray(m_vao);
+            reserve(instances.size());
+            glBindVertexArray(0);
+            // The new buffers start empty
+            instances.markAllDirty();
+        }
+        m_count = instances.size();
+
+        instances.consumeDirtyRanges([&](InstanceStore::Stream stream, uint32_t first, uint32_t count) {
+            const size_t elementSize = InstanceStore::elementSize(stream);
+            const uint8_t* data = static_cast<uint8_t const *>(instances.streamData(stream)) + first * elementSize;
+            glBindBuffer(GL_ARRAY_BUFFER, m_instanceBuffers[stream]);
+            glBufferSubData(GL_ARRAY_BUFFER, first * elementSize, count * elementSize, data);
+        });
+
+        // The view rarely changes, skip the upload when it did not
+        if (memcmp(&m_uploadedView, &view, sizeof(ViewUniforms)) != 0 || !m_viewUploaded) {
+            m_uploadedView = view;
+            m_viewUploaded = true;
+            glBindBuffer(GL_UNIFORM_BUFFER, m_viewBuffer);
+            glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(ViewUniforms), &m_uploadedView);
+        }
+    }
+
+    GLuint m_program = 0;
+    GLuint m_vao = 0;
+    GLuint m_cornerBuffer = 0;
+    GLuint m_instanceBuffers[InstanceStore::StreamCount] = {};
+    GLuint m_viewBuffer = 0;
+    ViewUniforms m_uploadedView;
+    bool m_viewUploaded = false;
+    uint32_t m_capacity = 0;
+    uint32_t m_count = 0;
+};
+
+std::unique_ptr<Renderer> createRenderer() {
+    return std::make_unique<WebGL2Backend>();
+}
@@ -2,136 +2,33 @@
 #include <webgpu/webgpu.h>
 #include <emscripten/html5_webgpu.h>
 #include <emscripten/html5.h>
-#include <emscripten/websocket.h>
 #include <emscripten/bind.h>
-#include <cstdlib>
+#include <algorithm>
+#include <cmath>
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
-#include <cassert>
-#include <vector>
+#include <memory>
+#include <string>
 
+#include "frame-stats.h"
+#include "mesh-fetch.h"
+#include "renderer.h"
 #include "webgpu-utils.h"
+#include "webgpu-renderer.h"
+#include "trace.h"
 
-WGPUInstance instance;
-WGPUDevice device;
-WGPUQueue queue;
-WGPUSwapChain swapChain;
-WGPURenderPipeline pipeline;
-
-// WGSL shaders
-
-void renderFrame() {
-    WGPUTextureView nextTexture = wgpuSwapChainGetCurrentTextureView(swapChain);
-    if (!nextTexture) {
-        printf("Cannot acquire next swap chain texture\n");
-        return;
-    }
-
-
-    WGPURenderPassColorAttachment colorAttachment = {};
-    colorAttachment.view = nextTexture;
-    colorAttachment.depthSlice = UINT32_MAX;
-    colorAttachment.loadOp = WGPULoadOp_Clear;
-    colorAttachment.storeOp = WGPUStoreOp_Store;
-    colorAttachment.clearValue = {0.0f, 0.0f, 0.0f, 1.0f};
+// WebGPU backend of the web app, the entry point is in main.cpp
 
-    WGPURenderPassDescriptor renderPassDesc = {};
-    renderPassDesc.label = "Render-Pass";
-    renderPassDesc.colorAttachmentCount = 1;
-    renderPassDesc.colorAttachments = &colorAttachment;
-
-    WGPUCommandEncoderDescriptor encoderDesc = {};
-    WGPUCommandEncoder encoder = wgpuDeviceCreateCommandEncoder(device, &encoderDesc);
-    WGPURenderPassEncoder pass = wgpuCommandEncoderBeginRenderPass(encoder, &renderPassDesc);
-    wgpuRenderPassEncoderSetPipeline(pass, pipeline);
-    wgpuRenderPassEncoderDraw(pass, 3, 1, 0, 0);
-    wgpuRenderPassEncoderEnd(pass);
-
-    WGPUCommandBuffer command = wgpuCommandEncoderFinish(encoder, nullptr);
-    wgpuQueueSubmit(queue, 1, &command);
-
-    wgpuCommandBufferRelease(command);
-    wgpuCommandEncoderRelease(encoder);
-}
-WGPUShaderModule createShaderModule(WGPUDevice device, std::string const &source, std::string const &name) {
-    WGPUShaderModuleWGSLDescriptor wgslDesc = {
-            .chain = WGPUChainedStruct{
-                    .next = nullptr,
-                    .sType = WGPUSType_ShaderModuleWGSLDescriptor,
-            },
-            .code = source.c_str(),
-    };
-    WGPUShaderModuleDescriptor desc = {
-            .nextInChain = &wgslDesc.chain,
-            .label = name.c_str(),
-    };
-
-    return wgpuDeviceCreateShaderModule(device, &desc);
-}
-
-bool initWebGPU() {
-	WGPUInstanceDescriptor desc = {};
-	desc.nextInChain = nullptr;
-
-	WGPUInstance instance = wgpuCreateInstance(nullptr);
-
-	if (!instance) {
-		std::cerr << "Could not initialize WebGPU!" << std::endl;
-		return false;
-	}
-
-	std::cout << "WGPU instance: " << instance << std::endl;
-
-	std::cout << "Requesting adapter..." << std::endl;
-	WGPURequestAdapterOptions adapterOpts = {};
-	adapterOpts.nextInChain = nullptr;
-	WGPUAdapter adapter = requestAdapterSync(instance, &adapterOpts);
-	std::cout << "Got adapter: " << adapter << std::endl;
-
-	inspectAdapter(adapter);
-
-	// We no longer need to use the instance once we have the adapter
-	wgpuInstanceRelease(instance);
-
-	std::cout << "Requesting device..." << std::endl;
-	WGPUDeviceDescriptor deviceDesc = {};
-	deviceDesc.nextInChain = nullptr;
-	deviceDesc.label = "My Device"; // anything works here, that's your call
-	deviceDesc.requiredFeatureCount = 0; // we do not require any specific feature
-	deviceDesc.requiredLimits = nullptr; // we do not require any specific limit
-	deviceDesc.defaultQueue.nextInChain = nullptr;
-	deviceDesc.defaultQueue.label = "The default queue";
-	// A function that is invoked whenever the device stops being available.
-	deviceDesc.deviceLostCallback = [](WGPUDeviceLostReason reason, char const* message, void* /* pUserData */) {
-		std::cout << "Device lost: reason " << reason;
-		if (message) std::cout << " (" << message << ")";
-		std::cout << std::endl;
-	};
-	device = requestDeviceSync(adapter, &deviceDesc);
-	std::cout << "Got device: " << device << std::endl;
-
-	// A function that is invoked whenever there is an error in the use of the device
-	auto onDeviceError = [](WGPUErrorType type, char const* message, void* /* pUserData */) {
-		std::cout << "Uncaptured device error: type " << type;
-		if (message) std::cout << " (" << message << ")";
-		std::cout << std::endl;
-	};
-	wgpuDeviceSetUncapturedErrorCallback(device, onDeviceError, nullptr /* pUserData */);
-
-	// We no longer need to access the adapter once we have the device
-	wgpuAdapterRelease(adapter);
-
-	// Display information about the device
-	inspectDevice(device);
-    return true;
-}
-
-void initWebGPUPipeline() {
-    queue = wgpuDeviceGetQueue(device);
-
-    WGPUInstanceDescriptor instanceDesc{};
-    instance = wgpuCreateInstance(nullptr);
+Handle<WGPUSurface> surface;
+Handle<WGPUSwapChain> swapChain;
+// The canvas' preferred format, known once the surface exists
+WGPUTextureFormat swapChainFormat = WGPUTextureFormat_Undefined;
+uint32_t swapChainWidth = 0;
+uint32_t swapChainHeight = 0;
 
+void initSurface() {
     WGPUSurfaceDescriptorFromCanvasHTMLSelector canvasDesc = {};
     canvasDesc.chain.sType = WGPUSType_SurfaceDescriptorFromCanvasHTMLSelector;
     canvasDesc.selector = "canvas";
@@ -139,103 +36,343 @@ void initWebGPUPipeline() {
     WGPUSurfaceDescriptor surfDesc = {};
     surfDesc.nextInChain = &canvasDesc.chain;
 
-    WGPUSurface surface = wgpuInstanceCreateSurface(instance, &surfDesc);
+    surface.reset(wgpuInstanceCreateSurface(instance, &surfDesc));
+    // BGRA8Unorm or RGBA8Unorm depending on the platform, anything else costs a copy
+    swapChainFormat = wgpuSurfaceGetPreferredFormat(surface.get(), nullptr);
+}
 
-    WGPURequestAdapterOptions adapterOpts{};
-    adapterOpts.compatibleSurface = surface;
+/**
+ * Match the swap chain to the canvas' displayed size in device pixels (CSS
+ * size times devicePixelRatio), recreating it when that changed. Polled every
+ * frame, which also catches layout changes that fire no resize event.
+ * Returns false while the canvas has no area, e.g. in a hidden tab.
+ */
+bool updateSwapChain() {
+    double cssWidth = 0.0;
+    double cssHeight = 0.0;
+    emscripten_get_element_css_size("#canvas", &cssWidth, &cssHeight);
+    const double pixelRatio = emscripten_get_device_pixel_ratio();
+    const uint32_t width = (uint32_t)std::lround(cssWidth * pixelRatio);
+    const uint32_t height = (uint32_t)std::lround(cssHeight * pixelRatio);
+    if (width == 0 || height == 0) {
+        return false;
+    }
+    if (swapChain && width == swapChainWidth && height == swapChainHeight) {
+        return true;
+    }
 
+    TRACE_SCOPE("recreate swap chain");
+    emscripten_set_canvas_element_size("#canvas", (int)width, (int)height);
     WGPUSwapChainDescriptor swapChainDesc = {
             .nextInChain = nullptr,
             .label = "swapchain",
             .usage = WGPUTextureUsage_RenderAttachment,
-            .format = WGPUTextureFormat_BGRA8Unorm,
-            .width = 800,
-            .height = 600,
+            .format = swapChainFormat,
+            .width = width,
+            .height = height,
+            // The only mode browsers offer, frames are paced by requestAnimationFrame
             .presentMode = WGPUPresentMode_Fifo,
     };
+    swapChain.reset(wgpuDeviceCreateSwapChain(device, surface.get(), &swapChainDesc));
+    swapChainWidth = width;
+    swapChainHeight = height;
+    dynamicResolution.resize(width, height);
+    spriteBatcher.setTargetSize(width, height);
+    return true;
+}
 
-    swapChain = wgpuDeviceCreateSwapChain(device, surface, &swapChainDesc);
-
-
-
-    auto vertexShaderModule = createShaderModule(device, R"(
-    @vertex fn main(
-        @builtin(vertex_index) VertexIndex : u32
-    ) -> @builtin(position) vec4<f32> {
-        var pos = array<vec2<f32>, 3>(
-            vec2<f32>( 0.0,  0.5),
-            vec2<f32>(-0.5, -0.5),
-            vec2<f32>( 0.5, -0.5)
-        );
-        return vec4<f32>(pos[VertexIndex], 0.0, 1.0);
-    })", "vertex-shader");
-
-
-    auto fragmentShaderModule = createShaderModule(device, R"(
-    @fragment fn main() -> @location(0) vec4<f32> {
-        return vec4<f32>(1.0, 0.0, 0.0, 1.0);
-    })", "fragment-shader");
-
-    WGPUBlendState blend = {
-            .color = WGPUBlendComponent{
-                    .operation = WGPUBlendOperation_Add,
-                    .srcFactor = WGPUBlendFactor_One,
-                    .dstFactor = WGPUBlendFactor_One,
-            },
-            .alpha = WGPUBlendComponent{
-                    .operation = WGPUBlendOperation_Add,
-                    .srcFactor = WGPUBlendFactor_One,
-                    .dstFactor = WGPUBlendFactor_One,
-            },
-    };
-    WGPUColorTargetState colorTarget{};
-    colorTarget.format = WGPUTextureFormat_BGRA8Unorm;
-    colorTarget.blend = &blend;
-    colorTarget.writeMask = WGPUColorWriteMask_All;
-
-    WGPUFragmentState fragment{};
-    fragment.module = fragmentShaderModule;
-    fragment.entryPoint = "main";
-    fragment.targetCount = 1;
-    fragment.targets = &colorTarget;
-
-    WGPUVertexState vertex{};
-    vertex.module = vertexShaderModule;
-    vertex.entryPoint = "main";
-
-    const uint32_t whiteColor = 0xFFFFFFFF;
-
-    WGPUPipelineLayoutDescriptor pipelineLayoutDesc{};
-    WGPUPipelineLayout pipelineLayout = wgpuDeviceCreatePipelineLayout(device, &pipelineLayoutDesc);
-
-    WGPUPrimitiveState primitiveState{};
-    primitiveState.topology = WGPUPrimitiveTopology_TriangleList;
-    primitiveState.stripIndexFormat = WGPUIndexFormat_Undefined;
-    primitiveState.frontFace = WGPUFrontFace_CCW;
-    primitiveState.cullMode = WGPUCullMode_None;
-
-    WGPUMultisampleState multisampleState{};
-    multisampleState.count = 1;
-    multisampleState.mask = whiteColor;
-
-    WGPURenderPipelineDescriptor pipelineDesc{};
-    pipelineDesc.label = "render-pipeline";
-    pipelineDesc.layout = pipelineLayout;
-    pipelineDesc.vertex = vertex;
-    pipelineDesc.fragment = &fragment;
-    pipelineDesc.primitive = primitiveState;
-    pipelineDesc.multisample = multisampleState;
-
-    pipeline = wgpuDeviceCreateRenderPipeline(device, &pipelineDesc);
+/**
+ * Value of `name` in the page's query string, empty if it is not there.
+ */
+std::string queryParameter(char const * name) {
+    emscripten::val params = emscripten::val::global("URLSearchParams").new_(
+            emscripten::val::global("location")["search"]);
+    emscripten::val value = params.call<emscripten::val>("get", std::string(name));
+    return value.isNull() ? std::string() : value.as<std::string>();
+}
 
+class WebGPUBackend : public Renderer {
+public:
+    char const * backendName() const override { return "webgpu"; }
+
+    void init(std::function<void(bool)> onReady) override {
+        WGPURequestAdapterOptions adapterOpts = {};
+        adapterOpts.nextInChain = nullptr;
+        // Adapter and device arrive through callbacks from the browser event loop
+        initWebGPUAsync(&adapterOpts, [this, onReady](bool success) {
+            if (!success) {
+                std::cerr << "WebGPU initialization failed" << std::endl;
+                onReady(false);
+                return;
+            }
+            {
+                TRACE_SCOPE("initSurface");
+                initSurface();
+            }
+            initWebGPUPipeline(swapChainFormat);
+            initFramePacer();
+            initDynamicResolution();
+            initMeshLod();
+            startMeshLoad();
+            onReady(true);
+        });
+    }
+
+    bool renderFrame() override {
+        if (!updateSwapChain()) {
+            return false;
+        }
+        // GPU-bound: every frame slot is still in flight, try again next animation frame
+        if (!framePacer.beginFrame(device)) {
+            return false;
+        }
+        updateResolutionScale();
+        sceneMesh.setViewportSize(dynamicResolution.renderWidth(), dynamicResolution.renderHeight());
+
+        Handle<WGPUTextureView> nextTexture;
+        {
+            // Blocks when the browser has no swap chain image to give, i.e. the
+            // previous frame is still being presented
+            TRACE_SCOPE("acquire swap chain texture");
+            nextTexture.reset(wgpuSwapChainGetCurrentTextureView(swapChain.get()));
+        }
+        if (!nextTexture) {
+            printf("Cannot acquire next swap chain texture\n");
+            return false;
+        }
+
+        Handle<WGPUCommandBuffer> command = encodeFrame(nextTexture.get());
+        {
+            TRACE_SCOPE("submit");
+            WGPUCommandBuffer commandBuffer = command.get();
+            wgpuQueueSubmit(queue, 1, &commandBuffer);
+        }
+        endFrame();
+
+        // Frames before the pipelines finished compiling only show the clear color
+        bool drawn = instancedRenderer.renderPipeline() != nullptr;
+        if (drawn && !m_pipelineStatsPrinted) {
+            m_pipelineStatsPrinted = true;
+            pipelineCache.printStats();
+            bindGroupCache.printStats();
+            shaderLibrary.printStats();
+        }
+        // With ?mesh=, the first frame is the first one showing part of the mesh
+        if (m_meshRequestTime > 0.0) {
+            if (sceneMesh.drawable() && m_meshFirstFrameTime == 0.0) {
+                m_meshFirstFrameTime = emscripten_get_now();
+                reportMeshLoad();
+            }
+            drawn = drawn && m_meshFirstFrameTime > 0.0;
+        }
+        return drawn;
+    }
+
+private:
+    /**
+     * ?framesInFlight=N lets the CPU run up to N frames ahead of the GPU
+     * (1 to 3, default 2).
+     */
+    void initFramePacer() {
+        const std::string framesInFlight = queryParameter("framesInFlight");
+        framePacer.init(framesInFlight.empty() ? FramePacer::DefaultFramesInFlight
+                                               : (uint32_t)std::atoi(framesInFlight.c_str()));
+    }
+
+    /**
+     * The scene renders at a scale of the canvas resolution that follows the
+     * frame cost, within ?targetMs= (default 60 Hz). ?scale=S fixes it
+     * instead, ?scale=1 renders at full resolution.
+     */
+    void initDynamicResolution() {
+        DynamicResolutionSettings settings;
+        const std::string targetMs = queryParameter("targetMs");
+        if (!targetMs.empty()) {
+            settings.targetMilliseconds = std::max(1.0, std::atof(targetMs.c_str()));
+        }
+        dynamicResolution.init(device, swapChainFormat, settings);
+        const std::string scale = queryParameter("scale");
+        if (!scale.empty()) {
+            dynamicResolution.setFixedScale((float)std::atof(scale.c_str()));
+        }
+        dynamicResolutionEnabled = true;
+    }
+
+    /**
+     * Feed the last frame's cost to the scale controller: the render pass GPU
+     * time when timestamps are available, otherwise the frame interval.
+     */
+    void updateResolutionScale() {
+        const double now = emscripten_get_now();
+        const double interval = m_lastFrameTime > 0.0 ? now - m_lastFrameTime : 0.0;
+        m_lastFrameTime = now;
+        double gpuMilliseconds = 0.0;
+        if (gpuProfiler.usesTimestamps()) {
+            for (GpuProfiler::PassTiming const & timing : gpuProfiler.timings()) {
+                if (std::strcmp(timing.name, "render") == 0) {
+                    gpuMilliseconds = timing.lastMilliseconds;
+                }
+            }
+        }
+        if (interval > 0.0) {
+            dynamicResolution.update(gpuMilliseconds, interval);
+        }
+    }
+
+    /**
+     * Mesh levels of detail may be off by ?lodError= pixels (default 1,
+     * ?lodError=0 draws full detail), ?meshletCulling=0 draws the parts of
+     * the mesh outside the view too.
+     */
+    void initMeshLod() {
+        const std::string lodError = queryParameter("lodError");
+        const std::string meshletCulling = queryParameter("meshletCulling");
+        sceneMesh.setLodSelection(lodError.empty() ? sceneMesh.maxErrorPixels() : (float)std::atof(lodError.c_str()),
+                                  meshletCulling != "0");
+    }
+
+    /**
+     * Stream the mesh named by ?mesh=URL in the page URL, if any.
+     */
+    void startMeshLoad() {
+        m_meshUrl = queryParameter("mesh");
+        if (m_meshUrl.empty()) {
+            return;
+        }
+        m_meshRequestTime = emscripten_get_now();
+        fetchMeshCached(m_meshUrl, sceneMesh, [this](bool success, bool fromCache) {
+            m_meshCompleteTime = emscripten_get_now();
+            m_meshFromCache = fromCache;
+            if (!success) {
+                std::cerr << "Could not load mesh " << m_meshUrl << std::endl;
+                // Do not hold the first frame back any longer
+                m_meshRequestTime = 0.0;
+                return;
+            }
+            reportMeshLoad();
+        });
+    }
+
+    // Prints once both the first mesh frame and the end of the load are known
+    void reportMeshLoad() const {
+        if (m_meshFirstFrameTime == 0.0 || m_meshCompleteTime == 0.0) {
+            return;
+        }
+        const double firstFrameMs = m_meshFirstFrameTime - m_meshRequestTime;
+        const double completeMs = m_meshCompleteTime - m_meshRequestTime;
+        printf("Mesh %s (%s cache): first chunk drawn %.1f ms, complete %.1f ms after the request, %u chunks, %.1f KB\n",
+               m_meshUrl.c_str(), m_meshFromCache ? "warm" : "cold", firstFrameMs, completeMs, sceneMesh.chunkCount(),
+               sceneMesh.bytesReceived() / 1024.0);
+        EM_ASM({
+            Module["meshLoad"] = {"cache": $0 ? "warm" : "cold", "firstChunkMs": $1, "completeMs": $2};
+        }, m_meshFromCache, firstFrameMs, completeMs);
+    }
+
+    bool m_pipelineStatsPrinted = false;
+    double m_lastFrameTime = 0.0;
+    std::string m_meshUrl;
+    // emscripten_get_now() times, 0 until they happen
+    double m_meshRequestTime = 0.0;
+    double m_meshFirstFrameTime = 0.0;
+    double m_meshCompleteTime = 0.0;
+    bool m_meshFromCache = false;
+};
+
+std::unique_ptr<Renderer> createRenderer() {
+    return std::make_unique<WebGPUBackend>();
 }
 
-int main() {
-    if (initWebGPU()) {
-        initWebGPUPipeline();
-        emscripten_set_main_loop(renderFrame, 0, true); 
+/**
+ * Rolling per-pass times for JS, e.g. Module.getPassTimings() returns
+ *     { render: { last: 0.21, average: 0.19 }, ... }
+ * in milliseconds. They are GPU times when gpuTimingSource() is "gpu", CPU
+ * encode times when the timestamp-query feature is missing.
+ */
+emscripten::val getPassTimings() {
+    emscripten::val result = emscripten::val::object();
+    for (GpuProfiler::PassTiming const & timing : gpuProfiler.timings()) {
+        emscripten::val entry = emscripten::val::object();
+        entry.set("last", timing.lastMilliseconds);
+        entry.set("average", timing.averageMilliseconds);
+        result.set(timing.name, entry);
     }
-    
-    return 0;
+    return result;
+}
+
+std::string gpuTimingSource() {
+    return gpuProfiler.usesTimestamps() ? "gpu" : "cpu";
 }
 
+/**
+ * Module.getDynamicResolution() returns the current render scale, e.g.
+ *     { scale: 0.8, width: 1229, height: 691, outputWidth: 1536, outputHeight: 864, changes: 3 }
+ * where width x height is the rendered part of the output resolution.
+ */
+emscripten::val getDynamicResolution() {
+    emscripten::val result = emscripten::val::object();
+    result.set("scale", dynamicResolution.scale());
+    result.set("width", dynamicResolution.renderWidth());
+    result.set("height", dynamicResolution.renderHeight());
+    result.set("outputWidth", dynamicResolution.outputWidth());
+    result.set("outputHeight", dynamicResolution.outputHeight());
+    result.set("changes", dynamicResolution.scaleChanges());
+    return result;
+}
+
+/**
+ * Module.getFramePacing() returns the frames in flight and the time the CPU
+ * waited for a free frame slot, in milliseconds, e.g.
+ *     { framesInFlight: 2, cpuWaitMs: 0, averageCpuWaitMs: 1.3, maxCpuWaitMs: 9.8, frames: 600, framesWaited: 41 }
+ * A growing wait means the GPU is the bottleneck.
+ */
+emscripten::val getFramePacing() {
+    FramePacer::Stats const & stats = framePacer.stats();
+    emscripten::val result = emscripten::val::object();
+    result.set("framesInFlight", framePacer.framesInFlight());
+    result.set("cpuWaitMs", stats.lastWaitMilliseconds);
+    result.set("averageCpuWaitMs", stats.averageWaitMilliseconds);
+    result.set("maxCpuWaitMs", stats.maxWaitMilliseconds);
+    result.set("frames", double(stats.frames));
+    result.set("framesWaited", double(stats.framesWaited));
+    return result;
+}
+
+/**
+ * Module.getMeshLod() returns the mesh triangles drawn last frame and what
+ * full detail would have drawn, e.g.
+ *     { triangles: 41200, fullDetailTriangles: 524288, maxErrorPixels: 1 }
+ */
+emscripten::val getMeshLod() {
+    emscripten::val result = emscripten::val::object();
+    result.set("triangles", frameStats.meshTriangles);
+    result.set("fullDetailTriangles", frameStats.meshTrianglesFullDetail);
+    result.set("maxErrorPixels", sceneMesh.maxErrorPixels());
+    return result;
+}
+
+/**
+ * Module.getStateChanges() returns what the last frame set in its render
+ * passes and how the bind group cache did, e.g.
+ *     { draws: 66, pipelineChanges: 3, bindGroupChanges: 5, bufferChanges: 128,
+ *       bindGroupHits: 3, bindGroupMisses: 0, cachedBindGroups: 4 }
+ */
+emscripten::val getStateChanges() {
+    emscripten::val result = emscripten::val::object();
+    result.set("draws", frameStats.drawCalls);
+    result.set("pipelineChanges", frameStats.pipelineChanges);
+    result.set("bindGroupChanges", frameStats.bindGroupChanges);
+    result.set("bufferChanges", frameStats.bufferChanges);
+    result.set("bindGroupHits", frameStats.bindGroupHits);
+    result.set("bindGroupMisses", frameStats.bindGroupMisses);
+    result.set("cachedBindGroups", bindGroupCache.bindGroupCount());
+    return result;
+}
+
+EMSCRIPTEN_BINDINGS(gpu_profiler) {
+    emscripten::function("getPassTimings", &getPassTimings);
+    emscripten::function("gpuTimingSource", &gpuTimingSource);
+    emscripten::function("getDynamicResolution", &getDynamicResolution);
+    emscripten::function("getFramePacing", &getFramePacing);
+    emscripten::function("getMeshLod", &getMeshLod);
+    emscripten::function("getStateChanges", &getStateChanges);
+}
@@ -0,0 +1,496 @@
+#include "mesh-builder.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+namespace {
+
+struct Vec3 {
+    float x, y, z;
+};
+
+Vec3 positionOf(MeshVertex const & vertex) {
+    return {vertex.position[0], vertex.position[1], vertex.position[2]};
+}
+
+float distance(Vec3 a, Vec3 b) {
+    return std::sqrt((a.x - b.x) * (a.x - b.x) + (a.y - b.y) * (a.y - b.y) + (a.z - b.z) * (a.z - b.z));
+}
+
+/**
+ * Sum of squared distances to a set of planes (Garland and Heckbert), as the
+ * upper half of a symmetric 4x4 matrix.
+ */
+struct Quadric {
+    double xx = 0, xy = 0, xz = 0, xw = 0, yy = 0, yz = 0, yw = 0, zz = 0, zw = 0, ww = 0;
+
+    void addPlane(double a, double b, double c, double d, double weight) {
+        xx += weight * a * a;
+        xy += weight * a * b;
+        xz += weight * a * c;
+        xw += weight * a * d;
+        yy += weight * b * b;
+        yz += weight * b * c;
+        yw += weight * b * d;
+        zz += weight * c * c;
+        zw += weight * c * d;
+        ww += weight * d * d;
+    }
+
+    void add(Quadric const & q) {
+        xx += q.xx;
+        xy += q.xy;
+        xz += q.xz;
+        xw += q.xw;
+        yy += q.yy;
+        yz += q.yz;
+        yw += q.yw;
+        zz += q.zz;
+        zw += q.zw;
+        ww += q.ww;
+    }
+
+    double error(Vec3 p) const {
+        return xx * p.x * p.x + 2 * xy * p.x * p.y + 2 * xz * p.x * p.z + 2 * xw * p.x + yy * p.y * p.y
+               + 2 * yz * p.y * p.z + 2 * yw * p.y + zz * p.z * p.z + 2 * zw * p.z + ww;
+    }
+};
+
+void addBounds(float boundsMin[3], float boundsMax[3], MeshVertex const & vertex) {
+    for (int k = 0; k < 3; ++k) {
+        boundsMin[k] = std::min(boundsMin[k], vertex.position[k]);
+        boundsMax[k] = std::max(boundsMax[k], vertex.position[k]);
+    }
+}
+
+void resetBounds(float boundsMin[3], float boundsMax[3]) {
+    for (int k = 0; k < 3; ++k) {
+        boundsMin[k] = INFINITY;
+        boundsMax[k] = -INFINITY;
+    }
+}
+
+} // namespace
+
+void optimizeVertexCache(uint32_t* indices, size_t indexCount, uint32_t vertexCount, uint32_t cacheSize) {
+    const uint32_t triangleCount = uint32_t(indexCount / 3);
+    if (triangleCount == 0) {
+        return;
+    }
+
+    // Triangles using each vertex
+    std::vector<uint32_t> offsets(vertexCount + 1, 0);
+    for (uint32_t i = 0; i < triangleCount * 3; ++i) {
+        ++offsets[indices[i] + 1];
+    }
+    for (uint32_t v = 0; v < vertexCount; ++v) {
+        offsets[v + 1] += offsets[v];
+    }
+    std::vector<uint32_t> adjacency(triangleCount * 3);
+    std::vector<uint32_t> cursor(offsets.begin(), offsets.end() - 1);
+    for (uint32_t i = 0; i < triangleCount * 3; ++i) {
+        adjacency[cursor[indices[i]]++] = i / 3;
+    }
+
+    // Triangles not emitted yet, per vertex
+    std::vector<uint32_t> live(vertexCount);
+    for (uint32_t v = 0; v < vertexCount; ++v) {
+        live[v] = offsets[v + 1] - offsets[v];
+    }
+    // Time each vertex last entered the cache, the clock ticks on misses
+    std::vector<uint32_t> cacheTime(vertexCount, 0);
+    std::vector<uint8_t> emitted(triangleCount, 0);
+    std::vector<uint32_t> deadEnds;
+    std::vector<uint32_t> candidates;
+    std::vector<uint32_t> result;
+    result.reserve(triangleCount * 3);
+    uint32_t time = cacheSize + 1;
+    uint32_t nextVertex = 0;
+
+    // Recently used vertices first, then any vertex with triangles left
+    auto skipDeadEnd = [&]() -> int64_t {
+        while (!deadEnds.empty()) {
+            const uint32_t v = deadEnds.back();
+            deadEnds.pop_back();
+            if (live[v] > 0) {
+                return v;
+            }
+        }
+        for (; nextVertex < vertexCount; ++nextVertex) {
+            if (live[nextVertex] > 0) {
+                return nextVertex;
+            }
+        }
+        return -1;
+    };
+
+    for (int64_t fan = skipDeadEnd(); fan >= 0;) {
+        // Emit every triangle around the fanning vertex
+        candidates.clear();
+        for (uint32_t a = offsets[fan]; a < offsets[fan + 1]; ++a) {
+            const uint32_t t = adjacency[a];
+            if (emitted[t]) {
+                continue;
+            }
+            emitted[t] = 1;
+            for (uint32_t k = 0; k < 3; ++k) {
+                const uint32_t v = indices[t * 3 + k];
+                result.push_back(v);
+                deadEnds.push_back(v);
+                candidates.push_back(v);
+                --live[v];
+                if (time - cacheTime[v] > cacheSize) {
+                    cacheTime[v] = time++;
+                }
+            }
+        }
+
+        // Next, the candidate that will still be cached once its own
+        // triangles are emitted, the oldest such one first
+        int64_t best = -1;
+        int64_t bestPriority = -1;
+        for (uint32_t v : candidates) {
+            if (live[v] == 0) {
+                continue;
+            }
+            int64_t priority = 0;
+            if (time - cacheTime[v] + 2 * live[v] <= cacheSize) {
+                priority = time - cacheTime[v];
+            }
+            if (priority > bestPriority) {
+                bestPriority = priority;
+                best = v;
+            }
+        }
+        fan = best >= 0 ? best : skipDeadEnd();
+    }
+    std::copy(result.begin(), result.end(), indices);
+}
+
+double vertexCacheMissRatio(uint32_t const * indices, size_t indexCount, uint32_t vertexCount, uint32_t cacheSize) {
+    const size_t triangleCount = indexCount / 3;
+    if (triangleCount == 0) {
+        return 0.0;
+    }
+    // Miss count when the vertex entered the cache, plus one (0: never)
+    std::vector<uint32_t> stamp(vertexCount, 0);
+    uint32_t misses = 0;
+    for (size_t i = 0; i < triangleCount * 3; ++i) {
+        const uint32_t v = indices[i];
+        if (stamp[v] == 0 || misses - stamp[v] >= cacheSize) {
+            stamp[v] = ++misses;
+        }
+    }
+    return double(misses) / triangleCount;
+}
+
+float simplifyByClustering(MeshVertex const * vertices, uint32_t vertexCount, std::vector<uint32_t> const & indices,
+                           float cellSize, std::vector<uint32_t>& out) {
+    out.clear();
+    const size_t triangleCount = indices.size() / 3;
+
+    // Open edges belong to one triangle, their vertices are locked
+    std::vector<uint64_t> edges;
+    edges.reserve(triangleCount * 3);
+    for (size_t t = 0; t < triangleCount; ++t) {
+        for (int k = 0; k < 3; ++k) {
+            const uint32_t a = indices[t * 3 + k];
+            const uint32_t b = indices[t * 3 + (k + 1) % 3];
+            edges.push_back(uint64_t(std::min(a, b)) << 32 | std::max(a, b));
+        }
+    }
+    std::sort(edges.begin(), edges.end());
+    std::vector<uint8_t> locked(vertexCount, 0);
+    for (size_t i = 0; i < edges.size();) {
+        size_t end = i + 1;
+        while (end < edges.size() && edges[end] == edges[i]) {
+            ++end;
+        }
+        if (end - i == 1) {
+            locked[edges[i] >> 32] = 1;
+            locked[edges[i] & 0xFFFFFFFF] = 1;
+        }
+        i = end;
+    }
+
+    // Planes of the triangles around each vertex, weighted by area
+    std::vector<Quadric> quadrics(vertexCount);
+    std::vector<uint8_t> used(vertexCount, 0);
+    Vec3 origin = {INFINITY, INFINITY, INFINITY};
+    for (size_t t = 0; t < triangleCount; ++t) {
+        const uint32_t i0 = indices[t * 3], i1 = indices[t * 3 + 1], i2 = indices[t * 3 + 2];
+        const Vec3 p0 = positionOf(vertices[i0]), p1 = positionOf(vertices[i1]), p2 = positionOf(vertices[i2]);
+        const double ux = p1.x - p0.x, uy = p1.y - p0.y, uz = p1.z - p0.z;
+        const double vx = p2.x - p0.x, vy = p2.y - p0.y, vz = p2.z - p0.z;
+        double nx = uy * vz - uz * vy, ny = uz * vx - ux * vz, nz = ux * vy - uy * vx;
+        const double length = std::sqrt(nx * nx + ny * ny + nz * nz);
+        for (uint32_t v : {i0, i1, i2}) {
+            used[v] = 1;
+            origin = {std::min(origin.x, vertices[v].position[0]), std::min(origin.y, vertices[v].position[1]),
+                      std::min(origin.z, vertices[v].position[2])};
+        }
+        if (length == 0.0) {
+            continue;
+        }
+        nx /= length;
+        ny /= length;
+        nz /= length;
+        const double d = -(nx * p0.x + ny * p0.y + nz * p0.z);
+        for (uint32_t v : {i0, i1, i2}) {
+            quadrics[v].addPlane(nx, ny, nz, d, 0.5 * length);
+        }
+    }
+
+    // One cluster per grid cell, and one per locked vertex
+    std::unordered_map<uint64_t, uint32_t> clusterOfCell;
+    std::vector<uint32_t> cluster(vertexCount, UINT32_MAX);
+    std::vector<Quadric> clusterQuadrics;
+    for (uint32_t v = 0; v < vertexCount; ++v) {
+        if (!used[v]) {
+            continue;
+        }
+        uint64_t key;
+        if (locked[v]) {
+            key = uint64_t(1) << 63 | v;
+        } else {
+            auto cell = [cellSize](float value, float min) {
+                return std::min<uint64_t>(uint64_t((value - min) / cellSize), (1u << 21) - 1);
+            };
+            key = cell(vertices[v].position[0], origin.x) << 42 | cell(vertices[v].position[1], origin.y) << 21
+                  | cell(vertices[v].position[2], origin.z);
+        }
+        auto inserted = clusterOfCell.emplace(key, uint32_t(clusterQuadrics.size()));
+        if (inserted.second) {
+            clusterQuadrics.emplace_back();
+        }
+        cluster[v] = inserted.first->second;
+        clusterQuadrics[cluster[v]].add(quadrics[v]);
+    }
+
+    // The member closest to every plane of the cluster represents it
+    std::vector<uint32_t> representative(clusterQuadrics.size(), UINT32_MAX);
+    std::vector<double> representativeError(clusterQuadrics.size(), INFINITY);
+    for (uint32_t v = 0; v < vertexCount; ++v) {
+        if (cluster[v] == UINT32_MAX) {
+            continue;
+        }
+        const double error = clusterQuadrics[cluster[v]].error(positionOf(vertices[v]));
+        if (error < representativeError[cluster[v]]) {
+            representativeError[cluster[v]] = error;
+            representative[cluster[v]] = v;
+        }
+    }
+    float maxError = 0.0f;
+    for (uint32_t v = 0; v < vertexCount; ++v) {
+        if (cluster[v] != UINT32_MAX) {
+            maxError = std::max(maxError, distance(positionOf(vertices[v]),
+                                                   positionOf(vertices[representative[cluster[v]]])));
+        }
+    }
+
+    // Triangles whose corners merged disappear, as do duplicates, which are
+    // found rotated to start at their smallest index (winding kept)
+    struct Triangle {
+        uint32_t v[3];
+        bool operator<(Triangle const & o) const { return std::lexicographical_compare(v, v + 3, o.v, o.v + 3); }
+        bool operator==(Triangle const & o) const { return std::equal(v, v + 3, o.v); }
+    };
+    std::vector<Triangle> triangles;
+    for (size_t t = 0; t < triangleCount; ++t) {
+        const uint32_t a = representative[cluster[indices[t * 3]]];
+        const uint32_t b = representative[cluster[indices[t * 3 + 1]]];
+        const uint32_t c = representative[cluster[indices[t * 3 + 2]]];
+        if (a == b || b == c || a == c) {
+            continue;
+        }
+        if (a < b && a < c) {
+            triangles.push_back({{a, b, c}});
+        } else if (b < c) {
+            triangles.push_back({{b, c, a}});
+        } else {
+            triangles.push_back({{c, a, b}});
+        }
+    }
+    std::sort(triangles.begin(), triangles.end());
+    triangles.erase(std::unique(triangles.begin(), triangles.end()), triangles.end());
+    out.reserve(triangles.size() * 3);
+    for (Triangle const & triangle : triangles) {
+        out.insert(out.end(), triangle.v, triangle.v + 3);
+    }
+    return maxError;
+}
+
+void buildMeshlets(MeshVertex const * vertices, uint32_t const * indices, size_t indexCount, uint32_t firstIndex,
+                   std::vector<MeshMeshlet>& out) {
+    const size_t end = indexCount - indexCount % 3;
+    std::vector<uint32_t> meshletVertices;
+    meshletVertices.reserve(MeshletMaxVertices);
+    size_t start = 0;
+
+    auto finish = [&](size_t meshletEnd) {
+        if (meshletEnd == start) {
+            return;
+        }
+        MeshMeshlet meshlet{};
+        meshlet.firstIndex = firstIndex + uint32_t(start);
+        meshlet.indexCount = uint32_t(meshletEnd - start);
+        resetBounds(meshlet.boundsMin, meshlet.boundsMax);
+        for (uint32_t v : meshletVertices) {
+            addBounds(meshlet.boundsMin, meshlet.boundsMax, vertices[v]);
+        }
+        out.push_back(meshlet);
+    };
+
+    for (size_t i = 0; i < end; i += 3) {
+        uint32_t added[3];
+        uint32_t addedCount = 0;
+        for (size_t k = i; k < i + 3; ++k) {
+            const uint32_t v = indices[k];
+            if (std::find(meshletVertices.begin(), meshletVertices.end(), v) == meshletVertices.end()
+                    && std::find(added, added + addedCount, v) == added + addedCount) {
+                added[addedCount++] = v;
+            }
+        }
+        if (meshletVertices.size() + addedCount > MeshletMaxVertices || (i - start) / 3 >= MeshletMaxTriangles) {
+            finish(i);
+            start = i;
+            meshletVertices.clear();
+            // The new meshlet also needs the vertices the last one had
+            addedCount = 0;
+            for (size_t k = i; k < i + 3; ++k) {
+                if (std::find(added, added + addedCount, indices[k]) == added + addedCount) {
+                    added[addedCount++] = indices[k];
+                }
+            }
+        }
+        meshletVertices.insert(meshletVertices.end(), added, added + addedCount);
+    }
+    finish(end);
+}
+
+std::vector<uint8_t> buildMeshFile(std::vector<MeshBuildChunk> const & chunks, MeshBuildOptions const & options,
+                                   MeshBuildStats* stats) {
+    const auto start = std::chrono::steady_clock::now();
+    MeshBuildStats result;
+    std::vector<MeshChunk> table(chunks.size());
+    std::vector<MeshLod> lods;
+    std::vector<MeshMeshlet> meshlets;
+    std::vector<std::vector<uint32_t>> chunkIndices(chunks.size());
+
+    MeshFileHeader header{};
+    resetBounds(header.boundsMin, header.boundsMax);
+    for (size_t c = 0; c < chunks.size(); ++c) {
+        MeshBuildChunk const & chunk = chunks[c];
+        const uint32_t vertexCount = (uint32_t)chunk.vertices.size();
+        std::vector<uint32_t> full(chunk.indices.begin(), chunk.indices.end() - chunk.indices.size() % 3);
+        const uint32_t triangleCount = uint32_t(full.size() / 3);
+        result.triangles += triangleCount;
+        result.missRatioBefore += vertexCacheMissRatio(full.data(), full.size(), vertexCount, options.cacheSize)
+                                  * triangleCount;
+
+        // Each level simplifies the full detail with cells twice as large as
+        // the one before, starting from about two edges
+        double edgeLength = 0.0;
+        for (size_t i = 0; i < full.size(); ++i) {
+            const uint32_t next = full[i - i % 3 + (i + 1) % 3];
+            edgeLength += distance(positionOf(chunk.vertices[full[i]]), positionOf(chunk.vertices[next]));
+        }
+        float cellSize = full.empty() ? 0.0f : float(2.0 * edgeLength / full.size());
+        std::vector<std::vector<uint32_t>> levels = {full};
+        std::vector<float> errors = {0.0f};
+        while (levels.size() < options.maxLods && levels.back().size() / 3 > options.minTriangles && cellSize > 0.0f) {
+            std::vector<uint32_t> simplified;
+            const float error = simplifyByClustering(chunk.vertices.data(), vertexCount, full, cellSize, simplified);
+            cellSize *= 2.0f;
+            if (simplified.empty() || simplified.size() > options.minReduction * levels.back().size()) {
+                break;
+            }
+            levels.push_back(std::move(simplified));
+            errors.push_back(std::max(error, errors.back()));
+        }
+
+        MeshChunk& entry = table[c];
+        entry.firstLod = (uint32_t)lods.size();
+        entry.lodCount = (uint32_t)levels.size();
+        std::vector<uint32_t>& indices = chunkIndices[c];
+        for (size_t level = 0; level < levels.size(); ++level) {
+            std::vector<uint32_t>& levelIndices = levels[level];
+            optimizeVertexCache(levelIndices.data(), levelIndices.size(), vertexCount, options.cacheSize);
+            if (level == 0) {
+                result.missRatioAfter += vertexCacheMissRatio(levelIndices.data(), levelIndices.size(), vertexCount,
+                                                              options.cacheSize) * triangleCount;
+            }
+            MeshLod lod{};
+            lod.firstIndex = (uint32_t)indices.size();
+            lod.indexCount = (uint32_t)levelIndices.size();
+            lod.firstMeshlet = (uint32_t)meshlets.size();
+            lod.error = errors[level];
+            buildMeshlets(chunk.vertices.data(), levelIndices.data(), levelIndices.size(), lod.firstIndex, meshlets);
+            lod.meshletCount = uint32_t(meshlets.size()) - lod.firstMeshlet;
+            lods.push_back(lod);
+            indices.insert(indices.end(), levelIndices.begin(), levelIndices.end());
+            result.lodTriangles += levelIndices.size() / 3;
+        }
+
+        entry.vertexCount = vertexCount;
+        entry.indexCount = (uint32_t)indices.size();
+        resetBounds(entry.boundsMin, entry.boundsMax);
+        for (MeshVertex const & vertex : chunk.vertices) {
+            addBounds(entry.boundsMin, entry.boundsMax, vertex);
+            addBounds(header.boundsMin, header.boundsMax, vertex);
+        }
+    }
+
+    // Payload: each chunk's vertices then all its levels' indices
+    uint32_t payloadSize = 0;
+    for (size_t c = 0; c < chunks.size(); ++c) {
+        table[c].vertexOffset = payloadSize;
+        table[c].indexOffset = meshAlignUp(payloadSize + table[c].vertexCount * uint32_t(sizeof(MeshVertex)));
+        payloadSize = meshChunkEnd(table[c]);
+    }
+
+    header.magic = MeshMagic;
+    header.version = MeshVersion;
+    header.chunkCount = (uint32_t)chunks.size();
+    header.vertexStride = sizeof(MeshVertex);
+    header.lodCount = (uint32_t)lods.size();
+    header.meshletCount = (uint32_t)meshlets.size();
+    header.payloadOffset = meshAlignUp(uint32_t(sizeof(MeshFileHeader) + table.size() * sizeof(MeshChunk)
+                                                + lods.size() * sizeof(MeshLod) + meshlets.size() * sizeof(MeshMeshlet)));
+    header.payloadSize = payloadSize;
+    if (chunks.empty()) {
+        std::fill(header.boundsMin, header.boundsMin + 3, 0.0f);
+        std::fill(header.boundsMax, header.boundsMax + 3, 0.0f);
+    }
+
+    std::vector<uint8_t> file(uint64_t(header.payloadOffset) + header.payloadSize, 0);
+    uint8_t* p = file.data();
+    memcpy(p, &header, sizeof header);
+    p += sizeof header;
+    memcpy(p, table.data(), table.size() * sizeof(MeshChunk));
+    p += table.size() * sizeof(MeshChunk);
+    memcpy(p, lods.data(), lods.size() * sizeof(MeshLod));
+    p += lods.size() * sizeof(MeshLod);
+    memcpy(p, meshlets.data(), meshlets.size() * sizeof(MeshMeshlet));
+    uint8_t* payload = file.data() + header.payloadOffset;
+    for (size_t c = 0; c < chunks.size(); ++c) {
+        memcpy(payload + table[c].vertexOffset, chunks[c].vertices.data(), chunks[c].vertices.size() * sizeof(MeshVertex));
+        memcpy(payload + table[c].indexOffset, chunkIndices[c].data(), chunkIndices[c].size() * sizeof(uint32_t));
+    }
+
+    result.chunks = (uint32_t)chunks.size();
+    result.lods = (uint32_t)lods.size();
+    result.meshlets = (uint32_t)meshlets.size();
+    if (result.triangles > 0) {
+        result.missRatioBefore /= double(result.triangles);
+        result.missRatioAfter /= double(result.triangles);
+    }
+    result.buildMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    if (stats) {
+        *stats = result;
+    }
+    return file;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "mesh-format.h"
+
+/**
+ * Offline processing writing .mesh files (see mesh-format.h): CPU only, used
+ * by the tools generating assets, not by the app loading them.
+ *
+ * For each chunk it builds a chain of levels of detail over the chunk's
+ * vertices, orders every level's triangles for the post-transform vertex
+ * cache and cuts it into meshlets with bounds:
+ *
+ *     std::vector<MeshBuildChunk> chunks = ...;
+ *     MeshBuildStats stats;
+ *     std::vector<uint8_t> file = buildMeshFile(chunks, MeshBuildOptions{}, &stats);
+ */
+
+struct MeshBuildChunk {
+    std::vector<MeshVertex> vertices;
+    std::vector<uint32_t> indices;
+};
+
+struct MeshBuildOptions {
+    // Levels per chunk, full detail included
+    uint32_t maxLods = 6;
+    // A level is kept if it has at most this fraction of the previous one's
+    // triangles, the chain ends at the first level that does not
+    float minReduction = 0.75f;
+    uint32_t minTriangles = 32;
+    uint32_t cacheSize = 16;
+};
+
+struct MeshBuildStats {
+    uint32_t chunks = 0;
+    uint32_t lods = 0;
+    uint32_t meshlets = 0;
+    // Full detail, and every level together
+    uint64_t triangles = 0;
+    uint64_t lodTriangles = 0;
+    // Average cache misses per triangle of the full detail levels, as given
+    // and once ordered (FIFO cache of MeshBuildOptions::cacheSize)
+    double missRatioBefore = 0.0;
+    double missRatioAfter = 0.0;
+    double buildMilliseconds = 0.0;
+};
+
+std::vector<uint8_t> buildMeshFile(std::vector<MeshBuildChunk> const & chunks, MeshBuildOptions const & options,
+                                   MeshBuildStats* stats = nullptr);
+
+/**
+ * Reorder the triangles in place so that consecutive ones share vertices
+ * still in a post-transform cache of `cacheSize` entries (Tipsify, Sander et
+ * al. 2007). Winding is kept.
+ */
+void optimizeVertexCache(uint32_t* indices, size_t indexCount, uint32_t vertexCount, uint32_t cacheSize);
+
+/**
+ * Vertices transformed per triangle with a FIFO cache of `cacheSize`
+ * entries: 3 without reuse, 0.5 at best on a regular grid.
+ */
+double vertexCacheMissRatio(uint32_t const * indices, size_t indexCount, uint32_t vertexCount, uint32_t cacheSize);
+
+/**
+ * Merge the vertices falling in the same cell of a grid of `cellSize` into
+ * the one of them that best keeps the surface (smallest plane quadric
+ * error), and write the triangles left to `out`, indexing the same
+ * vertices. Vertices on open edges keep their place so that neighbouring
+ * chunks at other levels still meet without cracks. Returns the farthest
+ * any vertex moved.
+ */
+float simplifyByClustering(MeshVertex const * vertices, uint32_t vertexCount, std::vector<uint32_t> const & indices,
+                           float cellSize, std::vector<uint32_t>& out);
+
+/**
+ * Cut `indexCount` indices into runs of consecutive triangles using at most
+ * MeshletMaxVertices vertices and MeshletMaxTriangles triangles, appended to
+ * `out` with `firstIndex` added to their offsets.
+ */
+void buildMeshlets(MeshVertex const * vertices, uint32_t const * indices, size_t indexCount, uint32_t firstIndex,
+                   std::vector<MeshMeshlet>& out);
@@ -0,0 +1,132 @@
+#include "mesh-fetch.h"
+
+#include <emscripten.h>
+#include <emscripten/bind.h>
+#include <cctype>
+#include <cstdio>
+#include <iostream>
+
+namespace {
+
+struct PendingFetch {
+    std::string url;
+    std::string cachePath;
+    MeshStream* mesh = nullptr;
+    std::function<void(bool, bool)> onDone;
+};
+PendingFetch pending;
+
+// One file per url, named after it
+std::string cachePathFor(std::string const & url) {
+    std::string name = url;
+    for (char& c : name) {
+        if (!isalnum((unsigned char)c) && c != '.' && c != '-') c = '_';
+    }
+    return std::string(MeshCacheDirectory) + "/" + name;
+}
+
+void startFetch(bool useCache) {
+    EM_ASM({
+        var url = UTF8ToString($0);
+        var path = UTF8ToString($1);
+        var useCache = $2;
+        var dir = UTF8ToString($3);
+        if (!Module["meshCacheReady"]) {
+            Module["meshCacheReady"] = new Promise(function(resolve) {
+                try {
+                    FS.mkdir(dir);
+                    FS.mount(IDBFS, {}, dir);
+                    FS.syncfs(true, function(err) {
+                        if (err) console.warn("Could not load " + dir + " from IndexedDB", err);
+                        resolve();
+                    });
+                } catch (e) {
+                    // Cached files then only live in MEMFS for this session
+                    console.warn("IDBFS unavailable, meshes are not cached", e);
+                    resolve();
+                }
+            });
+        }
+        Module["meshCacheReady"].then(async function() {
+            if (useCache && FS.analyzePath(path).exists) {
+                Module["meshFetchData"](FS.readFile(path));
+                Module["meshFetchEnd"](true, true);
+                return;
+            }
+            try {
+                var response = await fetch(url);
+                if (!response.ok) throw new Error(response.status + " " + response.statusText);
+                // Hand each network chunk over as it arrives
+                var reader = response.body.getReader();
+                for (;;) {
+                    var result = await reader.read();
+                    if (result.done) break;
+                    Module["meshFetchData"](result.value);
+                }
+                Module["meshFetchEnd"](true, false);
+            } catch (e) {
+                console.error("Could not fetch " + url, e);
+                Module["meshFetchEnd"](false, false);
+            }
+        });
+    }, pending.url.c_str(), pending.cachePath.c_str(), useCache, MeshCacheDirectory);
+}
+
+void meshFetchData(emscripten::val bytes) {
+    if (!pending.mesh) {
+        return;
+    }
+    const size_t size = bytes["length"].as<size_t>();
+    uint8_t* target = pending.mesh->reserve(size);
+    // Copied by the JS side straight into the staging file, no temporary vector
+    emscripten::val(emscripten::typed_memory_view(size, target)).call<void>("set", bytes);
+    pending.mesh->commit(size);
+}
+
+void meshFetchEnd(bool success, bool fromCache) {
+    if (!pending.mesh) {
+        return;
+    }
+    MeshStream& mesh = *pending.mesh;
+    success = success && mesh.complete();
+    if (!success && fromCache) {
+        std::cerr << "Cached " << pending.cachePath << " is invalid, fetching " << pending.url << std::endl;
+        remove(pending.cachePath.c_str());
+        mesh.reset();
+        startFetch(false);
+        return;
+    }
+    if (success && !fromCache) {
+        if (FILE* file = fopen(pending.cachePath.c_str(), "wb")) {
+            fwrite(mesh.fileBytes(), 1, mesh.bytesReceived(), file);
+            fclose(file);
+            EM_ASM({
+                FS.syncfs(false, function(err) {
+                    if (err) console.warn("Could not persist the mesh cache to IndexedDB", err);
+                });
+            });
+        }
+    }
+    mesh.releaseFileBytes();
+
+    std::function<void(bool, bool)> onDone = std::move(pending.onDone);
+    pending = PendingFetch();
+    onDone(success, fromCache);
+}
+
+} // namespace
+
+void fetchMeshCached(std::string const & url, MeshStream& mesh, std::function<void(bool, bool)> onDone) {
+    mesh.reset();
+    pending.url = url;
+    pending.cachePath = cachePathFor(url);
+    pending.mesh = &mesh;
+    pending.onDone = std::move(onDone);
+    startFetch(true);
+}
+
+EMSCRIPTEN_BINDINGS(mesh_fetch) {
+    // Called by the JS of startFetch()
+    emscripten::function("meshFetchData", &meshFetchData);
+    emscripten::function("meshFetchEnd", &meshFetchEnd);
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <functional>
+#include <string>
+
+#include "mesh-stream.h"
+
+// Web only: streams .mesh files over fetch() with an IndexedDB cache
+
+/**
+ * Directory backed by IndexedDB (IDBFS) holding downloaded meshes, so that
+ * later sessions load them without the network.
+ */
+constexpr char const * MeshCacheDirectory = "/assets";
+
+/**
+ * Load the .mesh file at `url` into `mesh`, which starts drawing chunks as
+ * they arrive. The bytes come from MeshCacheDirectory when an earlier
+ * session cached this url, otherwise from a streaming fetch() whose result
+ * is then cached. A cached copy that does not load is dropped and fetched
+ * again.
+ *
+ * `onDone(success, fromCache)` is called from the browser event loop once
+ * the whole file is in. One load at a time.
+ */
+void fetchMeshCached(std::string const & url, MeshStream& mesh, std::function<void(bool, bool)> onDone);
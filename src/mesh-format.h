@@ -0,0 +1,173 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Binary mesh file (.mesh): laid out so that the payload can be handed to
+ * wgpuQueueWriteBuffer as is, without parsing or repacking.
+ *
+ *     MeshFileHeader
+ *     MeshChunk[chunkCount]
+ *     MeshLod[lodCount]
+ *     MeshMeshlet[meshletCount]
+ *     padding to MeshAlignment
+ *     payload: for each chunk, MeshVertex[vertexCount] then uint32_t
+ *              indices[indexCount], each section padded to MeshAlignment
+ *
+ * Chunk offsets are relative to the payload, which is uploaded into one GPU
+ * buffer (vertex | index usage) at the same offsets. Chunks are stored in
+ * order and each one is self-contained (its indices start at 0), so a chunk
+ * can be drawn as soon as its last byte arrived: a streaming load renders
+ * the first chunks while the rest is still downloading.
+ *
+ * Since version 2 a chunk's indices may hold several levels of detail, one
+ * after the other over the same vertices (see MeshLod), each cut into
+ * meshlets that are culled on their own. src/mesh-builder.cpp writes them.
+ *
+ * Everything is little-endian, which covers wasm and every desktop target.
+ */
+
+constexpr uint32_t MeshMagic = 0x4853454D; // "MESH"
+constexpr uint32_t MeshVersion = 2;
+// Version 1 files have no levels of detail, they still load
+constexpr uint32_t MeshMinVersion = 1;
+// Keeps writeBuffer offsets and sizes multiples of 4 and vertices aligned
+constexpr uint32_t MeshAlignment = 16;
+
+struct MeshVertex {
+    float position[3];
+    // RGBA8, read as unorm8x4
+    uint32_t color;
+};
+static_assert(sizeof(MeshVertex) == 16, "MeshVertex is uploaded as is");
+
+struct MeshFileHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t chunkCount;
+    // sizeof(MeshVertex) of the writer, rejected if it differs
+    uint32_t vertexStride;
+    // Start of the payload from the start of the file, and its size in bytes
+    uint32_t payloadOffset;
+    uint32_t payloadSize;
+    float boundsMin[3];
+    float boundsMax[3];
+    // Entries of the MeshLod and MeshMeshlet tables, 0 in version 1
+    uint32_t lodCount;
+    uint32_t meshletCount;
+    uint32_t reserved[2];
+};
+static_assert(sizeof(MeshFileHeader) == 64, "MeshFileHeader is read as is");
+
+struct MeshChunk {
+    // Byte offsets from the start of the payload
+    uint32_t vertexOffset;
+    uint32_t vertexCount;
+    uint32_t indexOffset;
+    // Every level of detail included
+    uint32_t indexCount;
+    float boundsMin[3];
+    float boundsMax[3];
+    // Levels in the MeshLod table, full detail first. Without any (version 1)
+    // all the indices are drawn.
+    uint32_t firstLod;
+    uint32_t lodCount;
+};
+static_assert(sizeof(MeshChunk) == 48, "MeshChunk is read as is");
+
+/**
+ * One level of detail of a chunk: a range of its indices, ordered for the
+ * vertex cache and split into meshlets. Each level has fewer triangles and a
+ * larger error than the one before.
+ */
+struct MeshLod {
+    // In indices from the chunk's first one
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    // In the MeshMeshlet table
+    uint32_t firstMeshlet;
+    uint32_t meshletCount;
+    // Farthest a full detail vertex moved in this level, in mesh units
+    float error;
+    uint32_t reserved[3];
+};
+static_assert(sizeof(MeshLod) == 32, "MeshLod is read as is");
+
+/**
+ * Consecutive triangles of a level using at most MeshletMaxVertices
+ * vertices, with their bounds.
+ */
+struct MeshMeshlet {
+    // In indices from the chunk's first one
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    float boundsMin[3];
+    float boundsMax[3];
+};
+static_assert(sizeof(MeshMeshlet) == 32, "MeshMeshlet is read as is");
+
+constexpr uint32_t MeshletMaxVertices = 64;
+constexpr uint32_t MeshletMaxTriangles = 124;
+
+constexpr uint32_t meshAlignUp(uint32_t value) {
+    return (value + MeshAlignment - 1) & ~(MeshAlignment - 1);
+}
+
+/**
+ * End of the chunk's data from the start of the payload: the file is
+ * complete up to this chunk once payloadOffset + meshChunkEnd() bytes arrived.
+ */
+inline uint32_t meshChunkEnd(MeshChunk const & chunk) {
+    return meshAlignUp(chunk.indexOffset + chunk.indexCount * uint32_t(sizeof(uint32_t)));
+}
+
+/**
+ * Check the fixed part of a file before trusting its sizes.
+ */
+inline bool isValidMeshHeader(MeshFileHeader const & header) {
+    const uint64_t tablesEnd = sizeof(MeshFileHeader) + uint64_t(header.chunkCount) * sizeof(MeshChunk)
+                               + uint64_t(header.lodCount) * sizeof(MeshLod)
+                               + uint64_t(header.meshletCount) * sizeof(MeshMeshlet);
+    return header.magic == MeshMagic && header.version >= MeshMinVersion && header.version <= MeshVersion
+           && header.vertexStride == sizeof(MeshVertex) && header.payloadOffset % MeshAlignment == 0
+           && header.payloadSize % MeshAlignment == 0 && header.payloadOffset >= tablesEnd;
+}
+
+/**
+ * Check a chunk against the payload it points into, so a corrupt file
+ * cannot make the GPU read out of bounds. Index values are not checked,
+ * WebGPU bounds vertex fetches itself.
+ */
+inline bool isValidMeshChunk(MeshFileHeader const & header, MeshChunk const & chunk) {
+    const uint64_t vertexEnd = chunk.vertexOffset + uint64_t(chunk.vertexCount) * sizeof(MeshVertex);
+    const uint64_t indexEnd = chunk.indexOffset + uint64_t(chunk.indexCount) * sizeof(uint32_t);
+    return chunk.vertexOffset % MeshAlignment == 0 && chunk.indexOffset % MeshAlignment == 0
+           && (chunk.vertexCount > 0 || chunk.indexCount == 0) && vertexEnd <= chunk.indexOffset
+           && indexEnd <= header.payloadSize;
+}
+
+/**
+ * Check a chunk's levels and their meshlets against the chunk's indices and
+ * the tables, given whole.
+ */
+inline bool isValidMeshLods(MeshFileHeader const & header, MeshChunk const & chunk, MeshLod const * lods,
+                            MeshMeshlet const * meshlets) {
+    if (uint64_t(chunk.firstLod) + chunk.lodCount > header.lodCount) {
+        return false;
+    }
+    for (uint32_t i = chunk.firstLod; i < chunk.firstLod + chunk.lodCount; ++i) {
+        MeshLod const & lod = lods[i];
+        if (uint64_t(lod.firstIndex) + lod.indexCount > chunk.indexCount
+                || uint64_t(lod.firstMeshlet) + lod.meshletCount > header.meshletCount) {
+            return false;
+        }
+        for (uint32_t m = lod.firstMeshlet; m < lod.firstMeshlet + lod.meshletCount; ++m) {
+            if (meshlets[m].firstIndex < lod.firstIndex
+                    || uint64_t(meshlets[m].firstIndex) + meshlets[m].indexCount > uint64_t(lod.firstIndex) + lod.indexCount) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
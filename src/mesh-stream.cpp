@@ -0,0 +1,292 @@
+#include "mesh-stream.h"
+#include "frame-stats.h"
+#include "webgpu-renderer.h"
+#include "webgpu-utils.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+void MeshStream::init(WGPUDevice device, WGPUTextureFormat colorFormat, InstancedRenderer const & renderer) {
+    m_device = device;
+    m_maxPayloadSize = getDeviceLimits(device).maxBufferSize;
+
+    // Relief shading is a variant of the shader, its strength a pipeline constant
+    WGPUShaderModule shaderModule = shaderLibrary.getModule("mesh.wgsl", {"HEIGHT_SHADING"});
+
+    WGPUBindGroupLayout viewLayout = renderer.viewBindGroupLayout();
+    WGPUPipelineLayoutDescriptor pipelineLayoutDesc{};
+    pipelineLayoutDesc.bindGroupLayoutCount = 1;
+    pipelineLayoutDesc.bindGroupLayouts = &viewLayout;
+    m_pipelineLayout = bindGroupCache.getPipelineLayout(pipelineLayoutDesc);
+
+    WGPUVertexAttribute attributes[2] = {};
+    attributes[0].format = WGPUVertexFormat_Float32x3;
+    attributes[0].offset = offsetof(MeshVertex, position);
+    attributes[0].shaderLocation = 0;
+    attributes[1].format = WGPUVertexFormat_Unorm8x4;
+    attributes[1].offset = offsetof(MeshVertex, color);
+    attributes[1].shaderLocation = 1;
+    WGPUVertexBufferLayout vertexBuffer{};
+    vertexBuffer.arrayStride = sizeof(MeshVertex);
+    vertexBuffer.stepMode = WGPUVertexStepMode_Vertex;
+    vertexBuffer.attributeCount = 2;
+    vertexBuffer.attributes = attributes;
+
+    WGPUVertexState vertex{};
+    vertex.module = shaderModule;
+    vertex.entryPoint = "vs_main";
+    vertex.bufferCount = 1;
+    vertex.buffers = &vertexBuffer;
+    WGPUConstantEntry heightShading{};
+    heightShading.key = "heightShading";
+    heightShading.value = 4.0;
+    vertex.constantCount = 1;
+    vertex.constants = &heightShading;
+
+    // Opaque, drawn under the additive instances
+    WGPUColorTargetState colorTarget{};
+    colorTarget.format = colorFormat;
+    colorTarget.blend = nullptr;
+    colorTarget.writeMask = WGPUColorWriteMask_All;
+
+    WGPUFragmentState fragment{};
+    fragment.module = shaderModule;
+    fragment.entryPoint = "fs_main";
+    fragment.targetCount = 1;
+    fragment.targets = &colorTarget;
+
+    WGPUPrimitiveState primitiveState{};
+    primitiveState.topology = WGPUPrimitiveTopology_TriangleList;
+    primitiveState.stripIndexFormat = WGPUIndexFormat_Undefined;
+    primitiveState.frontFace = WGPUFrontFace_CCW;
+    primitiveState.cullMode = WGPUCullMode_None;
+
+    WGPUMultisampleState multisampleState{};
+    multisampleState.count = 1;
+    multisampleState.mask = 0xFFFFFFFF;
+
+    WGPURenderPipelineDescriptor pipelineDesc{};
+    pipelineDesc.label = "mesh-pipeline";
+    pipelineDesc.layout = m_pipelineLayout;
+    pipelineDesc.vertex = vertex;
+    pipelineDesc.fragment = &fragment;
+    pipelineDesc.primitive = primitiveState;
+    pipelineDesc.multisample = multisampleState;
+
+    m_pipeline = pipelineCache.getRenderPipeline(pipelineDesc);
+}
+
+void MeshStream::reset() {
+    m_bytes.clear();
+    m_received = 0;
+    m_headerRead = false;
+    m_failed = false;
+    m_header = {};
+    m_chunks.clear();
+    m_lods.clear();
+    m_meshlets.clear();
+    m_draws.clear();
+    m_chunksReady = 0;
+    // Frames in flight may still draw the previous mesh
+    deferredReleases.retire(std::move(m_buffer));
+}
+
+uint8_t* MeshStream::reserve(size_t size) {
+    // Once the header is in, m_bytes already holds the whole file
+    if (m_received + size > m_bytes.size()) {
+        m_bytes.resize(m_received + size);
+    }
+    return m_bytes.data() + m_received;
+}
+
+void MeshStream::commit(size_t size) {
+    m_received += size;
+    if (m_failed) {
+        return;
+    }
+    if (!m_headerRead) {
+        readHeader();
+    }
+    if (m_headerRead) {
+        uploadReadyChunks();
+    }
+}
+
+void MeshStream::append(void const * data, size_t size) {
+    memcpy(reserve(size), data, size);
+    commit(size);
+}
+
+void MeshStream::releaseFileBytes() {
+    m_bytes.clear();
+    m_bytes.shrink_to_fit();
+}
+
+void MeshStream::readHeader() {
+    if (m_received < sizeof(MeshFileHeader)) {
+        return;
+    }
+    memcpy(&m_header, m_bytes.data(), sizeof(MeshFileHeader));
+    if (!isValidMeshHeader(m_header)) {
+        std::cerr << "Invalid mesh file header" << std::endl;
+        m_failed = true;
+        return;
+    }
+    // The payload is allocated whole below, before it arrives: a corrupt
+    // size must fail the stream rather than abort on a huge allocation
+    if (m_header.payloadSize > m_maxPayloadSize) {
+        std::cerr << "Mesh payload of " << m_header.payloadSize << " bytes is over the "
+                  << m_maxPayloadSize << " bytes a buffer can hold" << std::endl;
+        m_failed = true;
+        return;
+    }
+    // The chunk table ends before the payload, wait for all of it
+    if (m_received < m_header.payloadOffset) {
+        return;
+    }
+
+    uint8_t const * tables = m_bytes.data() + sizeof(MeshFileHeader);
+    m_chunks.resize(m_header.chunkCount);
+    memcpy(m_chunks.data(), tables, m_chunks.size() * sizeof(MeshChunk));
+    tables += m_chunks.size() * sizeof(MeshChunk);
+    m_lods.resize(m_header.lodCount);
+    memcpy(m_lods.data(), tables, m_lods.size() * sizeof(MeshLod));
+    tables += m_lods.size() * sizeof(MeshLod);
+    m_meshlets.resize(m_header.meshletCount);
+    memcpy(m_meshlets.data(), tables, m_meshlets.size() * sizeof(MeshMeshlet));
+    uint32_t previousEnd = 0;
+    for (MeshChunk const & chunk : m_chunks) {
+        // Chunks must come in file order for streaming to make progress
+        if (!isValidMeshChunk(m_header, chunk) || chunk.vertexOffset < previousEnd
+                || !isValidMeshLods(m_header, chunk, m_lods.data(), m_meshlets.data())) {
+            std::cerr << "Invalid mesh chunk table" << std::endl;
+            m_chunks.clear();
+            m_lods.clear();
+            m_meshlets.clear();
+            m_failed = true;
+            return;
+        }
+        previousEnd = meshChunkEnd(chunk);
+    }
+
+    // The rest of the file is written in place from now on
+    m_bytes.resize(std::max<size_t>(m_bytes.size(), uint64_t(m_header.payloadOffset) + m_header.payloadSize));
+
+    WGPUBufferDescriptor bufferDesc{};
+    bufferDesc.label = "mesh";
+    bufferDesc.usage = WGPUBufferUsage_Vertex | WGPUBufferUsage_Index | WGPUBufferUsage_CopyDst;
+    bufferDesc.size = std::max<uint32_t>(m_header.payloadSize, MeshAlignment);
+    bufferDesc.mappedAtCreation = false;
+    deferredReleases.retire(std::move(m_buffer));
+    m_buffer.reset(wgpuDeviceCreateBuffer(m_device, &bufferDesc));
+    m_headerRead = true;
+}
+
+void MeshStream::uploadReadyChunks() {
+    const uint64_t payloadReceived = m_received - m_header.payloadOffset;
+    uint32_t ready = m_chunksReady;
+    while (ready < m_chunks.size() && meshChunkEnd(m_chunks[ready]) <= payloadReceived) {
+        ++ready;
+    }
+    if (ready == m_chunksReady) {
+        return;
+    }
+    // Chunks are contiguous in the payload: everything they completed goes in one write
+    const uint32_t begin = m_chunks[m_chunksReady].vertexOffset;
+    const uint32_t end = meshChunkEnd(m_chunks[ready - 1]);
+    wgpuQueueWriteBuffer(queue, m_buffer.get(), begin, m_bytes.data() + m_header.payloadOffset + begin, end - begin);
+    m_chunksReady = ready;
+}
+
+void MeshStream::setLodSelection(float maxErrorPixels, bool cull) {
+    m_maxErrorPixels = std::max(maxErrorPixels, 0.0f);
+    m_cull = cull;
+}
+
+void MeshStream::setViewportSize(uint32_t width, uint32_t height) {
+    m_viewportWidth = width;
+    m_viewportHeight = height;
+}
+
+void MeshStream::selectLods(ViewUniforms const & view) {
+    m_draws.clear();
+    // The view maps [center - 1 / scale, center + 1 / scale] to the viewport
+    const float halfWidth = 1.0f / std::fabs(view.scale[0]);
+    const float halfHeight = 1.0f / std::fabs(view.scale[1]);
+    const float viewMin[2] = {view.center[0] - halfWidth, view.center[1] - halfHeight};
+    const float viewMax[2] = {view.center[0] + halfWidth, view.center[1] + halfHeight};
+    auto visible = [&](float const boundsMin[3], float const boundsMax[3]) {
+        return !m_cull || (boundsMax[0] >= viewMin[0] && boundsMin[0] <= viewMax[0] && boundsMax[1] >= viewMin[1]
+                           && boundsMin[1] <= viewMax[1]);
+    };
+    const float pixelsPerUnit = 0.5f * std::max(m_viewportWidth / halfWidth, m_viewportHeight / halfHeight);
+    // Without a viewport size the error on screen is unknown
+    const bool fullDetail = m_maxErrorPixels == 0.0f || pixelsPerUnit == 0.0f;
+
+    for (uint32_t i = 0; i < m_chunksReady; ++i) {
+        MeshChunk const & chunk = m_chunks[i];
+        if (chunk.lodCount == 0) {
+            frameStats.meshTrianglesFullDetail += chunk.indexCount / 3;
+            if (chunk.indexCount > 0 && visible(chunk.boundsMin, chunk.boundsMax)) {
+                m_draws.push_back({i, 0, chunk.indexCount});
+            }
+            continue;
+        }
+        MeshLod const * lods = &m_lods[chunk.firstLod];
+        frameStats.meshTrianglesFullDetail += lods[0].indexCount / 3;
+        if (!visible(chunk.boundsMin, chunk.boundsMax)) {
+            continue;
+        }
+
+        // Errors grow with the level: the last one under the limit
+        uint32_t level = 0;
+        while (!fullDetail && level + 1 < chunk.lodCount && lods[level + 1].error * pixelsPerUnit <= m_maxErrorPixels) {
+            ++level;
+        }
+        MeshLod const & lod = lods[level];
+        if (!m_cull || lod.meshletCount == 0) {
+            m_draws.push_back({i, lod.firstIndex, lod.indexCount});
+            continue;
+        }
+        // Visible meshlets next to each other go in one draw
+        for (uint32_t m = lod.firstMeshlet; m < lod.firstMeshlet + lod.meshletCount; ++m) {
+            MeshMeshlet const & meshlet = m_meshlets[m];
+            if (!visible(meshlet.boundsMin, meshlet.boundsMax)) {
+                continue;
+            }
+            DrawRange* last = m_draws.empty() ? nullptr : &m_draws.back();
+            if (last && last->chunk == i && last->firstIndex + last->indexCount == meshlet.firstIndex) {
+                last->indexCount += meshlet.indexCount;
+            } else {
+                m_draws.push_back({i, meshlet.firstIndex, meshlet.indexCount});
+            }
+        }
+    }
+}
+
+void MeshStream::draw(DrawQueue& queue, InstancedRenderer const & renderer) const {
+    if (!drawable() || m_draws.empty()) {
+        return;
+    }
+    DrawItem item;
+    item.layer = 0;
+    item.pipeline = m_pipeline->get();
+    item.bindGroups[0] = renderer.viewBindGroup();
+    item.dynamicOffsets[0] = renderer.viewOffset();
+    item.dynamicOffsetMask = 1u << 0;
+    item.vertexBuffer = m_buffer.get();
+    item.indexBuffer = m_buffer.get();
+    for (DrawRange const & range : m_draws) {
+        MeshChunk const & chunk = m_chunks[range.chunk];
+        item.vertexOffset = chunk.vertexOffset;
+        item.vertexSize = uint64_t(chunk.vertexCount) * sizeof(MeshVertex);
+        item.indexOffset = chunk.indexOffset;
+        item.indexSize = uint64_t(chunk.indexCount) * sizeof(uint32_t);
+        item.count = range.indexCount;
+        item.first = range.firstIndex;
+        queue.add(item);
+        frameStats.meshTriangles += range.indexCount / 3;
+    }
+}
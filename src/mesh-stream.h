@@ -0,0 +1,127 @@
+#pragma once
+
+#include <webgpu/webgpu.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "instanced-renderer.h"
+#include "mesh-format.h"
+#include "pipeline-cache.h"
+#include "scene.h"
+#include "webgpu-handles.h"
+
+/**
+ * Loads a .mesh file (see mesh-format.h) from a stream of bytes arriving in
+ * arbitrary slices, and draws it.
+ *
+ * Incoming bytes are written straight into a staging copy of the file with
+ * reserve() / commit(). Each time a chunk's last byte arrives its vertices
+ * and indices go to the GPU buffer with one wgpuQueueWriteBuffer at their
+ * file offset, no parsing or repacking, and draw() starts drawing it.
+ *
+ * Chunks with levels of detail draw the coarsest level whose error, seen
+ * through the view, stays under a number of pixels. Chunks and meshlets
+ * outside the view are skipped.
+ */
+class MeshStream {
+public:
+    /**
+     * Create the pipeline. Drawing uses the renderer's view uniforms, so the
+     * mesh pans and zooms with the instances.
+     */
+    void init(WGPUDevice device, WGPUTextureFormat colorFormat, InstancedRenderer const & renderer);
+
+    /**
+     * Forget the current mesh before loading another one.
+     */
+    void reset();
+
+    /**
+     * Room for the next `size` bytes of the file, valid until commit(). A
+     * caller that has the bytes elsewhere can use append() instead.
+     */
+    uint8_t* reserve(size_t size);
+
+    /**
+     * `size` bytes were written to the last reserve(). Uploads the chunks
+     * they completed.
+     */
+    void commit(size_t size);
+    void append(void const * data, size_t size);
+
+    /**
+     * The header or a chunk did not validate, the rest of the stream is ignored.
+     */
+    bool failed() const { return m_failed; }
+    bool complete() const { return m_headerRead && m_chunksReady == m_chunks.size() && !m_failed; }
+    uint32_t chunkCount() const { return (uint32_t)m_chunks.size(); }
+    uint32_t chunksReady() const { return m_chunksReady; }
+    uint64_t bytesReceived() const { return m_received; }
+    /**
+     * draw() draws something: a chunk is uploaded and the pipeline compiled.
+     */
+    bool drawable() const { return m_chunksReady > 0 && m_pipeline && m_pipeline->ready(); }
+
+    /**
+     * The file as received, e.g. to cache it once complete(). Freed by
+     * releaseFileBytes(), the GPU buffer keeps the mesh.
+     */
+    uint8_t const * fileBytes() const { return m_bytes.data(); }
+    void releaseFileBytes();
+
+    /**
+     * Largest error a level of detail may show, in pixels of a viewport of
+     * the given size (0, or no viewport size, always draws full detail), and
+     * whether chunks and meshlets outside the view are skipped.
+     */
+    void setLodSelection(float maxErrorPixels, bool cull);
+    void setViewportSize(uint32_t width, uint32_t height);
+    float maxErrorPixels() const { return m_maxErrorPixels; }
+
+    /**
+     * Pick the level of each chunk uploaded so far and the index ranges to
+     * draw for `view`. Called by encodeFrame() before draw().
+     */
+    void selectLods(ViewUniforms const & view);
+
+    /**
+     * Add what selectLods() picked to `queue`, in layer 0: one indexed draw
+     * per run of visible meshlets.
+     */
+    void draw(DrawQueue& queue, InstancedRenderer const & renderer) const;
+
+private:
+    void readHeader();
+    void uploadReadyChunks();
+
+    WGPUDevice m_device = nullptr;
+    // The device's maxBufferSize, the mesh goes into one buffer
+    uint64_t m_maxPayloadSize = 0;
+    CachedRenderPipeline const * m_pipeline = nullptr;
+    // Owned by bindGroupCache
+    WGPUPipelineLayout m_pipelineLayout = nullptr;
+
+    std::vector<uint8_t> m_bytes;
+    uint64_t m_received = 0;
+    bool m_headerRead = false;
+    bool m_failed = false;
+    MeshFileHeader m_header{};
+    std::vector<MeshChunk> m_chunks;
+    std::vector<MeshLod> m_lods;
+    std::vector<MeshMeshlet> m_meshlets;
+    uint32_t m_chunksReady = 0;
+    Handle<WGPUBuffer> m_buffer;
+
+    struct DrawRange {
+        uint32_t chunk;
+        // In indices from the chunk's first one
+        uint32_t firstIndex;
+        uint32_t indexCount;
+    };
+    std::vector<DrawRange> m_draws;
+    float m_maxErrorPixels = 1.0f;
+    bool m_cull = true;
+    uint32_t m_viewportWidth = 0;
+    uint32_t m_viewportHeight = 0;
+};
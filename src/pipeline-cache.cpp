@@ -0,0 +1,191 @@
+#include "pipeline-cache.h"
+#include "webgpu-renderer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+static double nowMilliseconds() {
+    using namespace std::chrono;
+    return duration<double, std::milli>(steady_clock::now().time_since_epoch()).count();
+}
+
+static void addConstants(CacheKey& key, WGPUConstantEntry const * constants, size_t count) {
+    key.add(count);
+    for (size_t i = 0; i < count; ++i) {
+        key.addString(constants[i].key);
+        key.add(constants[i].value);
+    }
+}
+
+static void addBlendComponent(CacheKey& key, WGPUBlendComponent const & component) {
+    key.add(component.operation);
+    key.add(component.srcFactor);
+    key.add(component.dstFactor);
+}
+
+static void addStencilFace(CacheKey& key, WGPUStencilFaceState const & face) {
+    key.add(face.compare);
+    key.add(face.failOp);
+    key.add(face.depthFailOp);
+    key.add(face.passOp);
+}
+
+// Field by field: the descriptors are full of pointers and padding, so
+// comparing their bytes would never hit. Modules are keyed by identity,
+// getShaderModule() returns the same one for the same source.
+static void buildDescriptorKey(CacheKey& key, WGPURenderPipelineDescriptor const & desc) {
+    key.clear();
+    key.add(desc.layout);
+
+    WGPUVertexState const & vertex = desc.vertex;
+    key.add(vertex.module);
+    key.addString(vertex.entryPoint);
+    addConstants(key, vertex.constants, vertex.constantCount);
+    key.add(vertex.bufferCount);
+    for (size_t i = 0; i < vertex.bufferCount; ++i) {
+        WGPUVertexBufferLayout const & buffer = vertex.buffers[i];
+        key.add(buffer.arrayStride);
+        key.add(buffer.stepMode);
+        key.add(buffer.attributeCount);
+        for (size_t j = 0; j < buffer.attributeCount; ++j) {
+            key.add(buffer.attributes[j].format);
+            key.add(buffer.attributes[j].offset);
+            key.add(buffer.attributes[j].shaderLocation);
+        }
+    }
+
+    key.add(desc.primitive.topology);
+    key.add(desc.primitive.stripIndexFormat);
+    key.add(desc.primitive.frontFace);
+    key.add(desc.primitive.cullMode);
+
+    key.add(desc.depthStencil != nullptr);
+    if (WGPUDepthStencilState const * ds = desc.depthStencil) {
+        key.add(ds->format);
+        key.add(ds->depthWriteEnabled);
+        key.add(ds->depthCompare);
+        addStencilFace(key, ds->stencilFront);
+        addStencilFace(key, ds->stencilBack);
+        key.add(ds->stencilReadMask);
+        key.add(ds->stencilWriteMask);
+        key.add(ds->depthBias);
+        key.add(ds->depthBiasSlopeScale);
+        key.add(ds->depthBiasClamp);
+    }
+
+    key.add(desc.multisample.count);
+    key.add(desc.multisample.mask);
+    key.add(desc.multisample.alphaToCoverageEnabled);
+
+    key.add(desc.fragment != nullptr);
+    if (WGPUFragmentState const * fragment = desc.fragment) {
+        key.add(fragment->module);
+        key.addString(fragment->entryPoint);
+        addConstants(key, fragment->constants, fragment->constantCount);
+        key.add(fragment->targetCount);
+        for (size_t i = 0; i < fragment->targetCount; ++i) {
+            WGPUColorTargetState const & target = fragment->targets[i];
+            key.add(target.format);
+            key.add(target.writeMask);
+            key.add(target.blend != nullptr);
+            if (target.blend) {
+                addBlendComponent(key, target.blend->color);
+                addBlendComponent(key, target.blend->alpha);
+            }
+        }
+    }
+}
+
+void PipelineCache::init(WGPUDevice device) {
+    m_device = device;
+}
+
+WGPUShaderModule PipelineCache::getShaderModule(std::string const & source, std::string const & label) {
+    auto it = m_modules.find(source);
+    if (it != m_modules.end()) {
+        ++m_stats.moduleHits;
+        return it->second.get();
+    }
+    ++m_stats.moduleMisses;
+    const double start = nowMilliseconds();
+    WGPUShaderModule module = createShaderModule(m_device, source, label);
+    m_stats.moduleMilliseconds += nowMilliseconds() - start;
+    m_modules[source].reset(module);
+    return module;
+}
+
+CachedRenderPipeline const * PipelineCache::getRenderPipeline(WGPURenderPipelineDescriptor const & descriptor) {
+    buildDescriptorKey(m_key, descriptor);
+    auto it = m_pipelines.find(m_key);
+    if (it != m_pipelines.end()) {
+        ++m_stats.pipelineHits;
+        return it->second.get();
+    }
+    ++m_stats.pipelineMisses;
+
+    auto entry = std::make_unique<CachedRenderPipeline>();
+    entry->label = descriptor.label ? descriptor.label : "";
+    entry->requestTime = nowMilliseconds();
+    CachedRenderPipeline* entryPtr = entry.get();
+    m_pipelines[m_key] = std::move(entry);
+
+    ++m_stats.pipelinesPending;
+#ifdef WEBGPU_BACKEND_WGPU
+    // wgpu-native does not implement the async entry point, compile in place
+    WGPURenderPipeline pipeline = wgpuDeviceCreateRenderPipeline(m_device, &descriptor);
+    PendingCompilation pending{this, entryPtr};
+    onPipelineCreated(pipeline ? WGPUCreatePipelineAsyncStatus_Success : WGPUCreatePipelineAsyncStatus_ValidationError,
+                      pipeline, nullptr, &pending);
+#else
+    // Deleted by the callback, which may run long after this returns
+    auto* pending = new PendingCompilation{this, entryPtr};
+    wgpuDeviceCreateRenderPipelineAsync(m_device, &descriptor, onPipelineCreated, pending);
+#endif
+    return entryPtr;
+}
+
+void PipelineCache::onPipelineCreated(WGPUCreatePipelineAsyncStatus status, WGPURenderPipeline pipeline,
+                                      char const * message, void * pUserData) {
+    PendingCompilation const & pending = *static_cast<PendingCompilation*>(pUserData);
+    PipelineCache& cache = *pending.cache;
+    CachedRenderPipeline& entry = *pending.entry;
+#ifndef WEBGPU_BACKEND_WGPU
+    std::unique_ptr<PendingCompilation> owner(static_cast<PendingCompilation*>(pUserData));
+#endif
+
+    --cache.m_stats.pipelinesPending;
+    if (status != WGPUCreatePipelineAsyncStatus_Success || !pipeline) {
+        std::cout << "Could not create pipeline '" << entry.label << "'";
+        if (message) std::cout << ": " << message;
+        std::cout << std::endl;
+        entry.failed = true;
+        ++cache.m_stats.pipelinesFailed;
+        return;
+    }
+    entry.pipeline.reset(pipeline);
+
+    const double elapsed = nowMilliseconds() - entry.requestTime;
+    cache.m_stats.compileMilliseconds += elapsed;
+    cache.m_stats.maxCompileMilliseconds = std::max(cache.m_stats.maxCompileMilliseconds, elapsed);
+}
+
+void PipelineCache::printStats() const {
+    const uint32_t compiled = m_stats.pipelineMisses - m_stats.pipelinesPending - m_stats.pipelinesFailed;
+    std::cout << "Pipeline cache: "
+              << m_stats.moduleMisses << " shader modules (" << m_stats.moduleHits << " hits, "
+              << m_stats.moduleMilliseconds << " ms), "
+              << m_stats.pipelineMisses << " pipelines (" << m_stats.pipelineHits << " hits, "
+              << m_stats.pipelinesPending << " pending, " << m_stats.pipelinesFailed << " failed), "
+              << "compile " << m_stats.compileMilliseconds << " ms total";
+    if (compiled > 0) {
+        std::cout << ", " << m_stats.compileMilliseconds / compiled << " ms avg, "
+                  << m_stats.maxCompileMilliseconds << " ms max";
+    }
+    std::cout << std::endl;
+}
+
+void PipelineCache::clear() {
+    m_pipelines.clear();
+    m_modules.clear();
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <webgpu/webgpu.h>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include "hash.h"
+#include "webgpu-handles.h"
+
+/**
+ * A render pipeline owned by the PipelineCache. `pipeline` stays null until
+ * the asynchronous compilation has finished.
+ */
+struct CachedRenderPipeline {
+    Handle<WGPURenderPipeline> pipeline;
+    std::string label;
+    double requestTime = 0.0;
+    bool failed = false;
+
+    bool ready() const { return (bool)pipeline; }
+
+    /**
+     * The compiled pipeline, or `fallback` (possibly null) while it compiles.
+     */
+    WGPURenderPipeline get(WGPURenderPipeline fallback = nullptr) const {
+        return pipeline ? pipeline.get() : fallback;
+    }
+};
+
+/**
+ * Deduplicates shader modules by WGSL source and render pipelines by
+ * descriptor state (layout, modules, entry points, constants, vertex
+ * buffers, primitive, depth/stencil, multisample, targets and blending).
+ *
+ * New pipelines are compiled with wgpuDeviceCreateRenderPipelineAsync so
+ * adding materials does not stall the first frames; callers draw with a
+ * fallback (or skip the draw) until CachedRenderPipeline::ready().
+ * Everything returned stays owned by the cache for its whole lifetime.
+ */
+class PipelineCache {
+public:
+    struct Stats {
+        uint32_t moduleHits = 0;
+        uint32_t moduleMisses = 0;
+        // CPU time in wgpuDeviceCreateShaderModule (the browser may compile later)
+        double moduleMilliseconds = 0.0;
+        uint32_t pipelineHits = 0;
+        uint32_t pipelineMisses = 0;
+        uint32_t pipelinesPending = 0;
+        uint32_t pipelinesFailed = 0;
+        // Sum over pipelines of request-to-ready time, and the worst one
+        double compileMilliseconds = 0.0;
+        double maxCompileMilliseconds = 0.0;
+    };
+
+    void init(WGPUDevice device);
+
+    WGPUShaderModule getShaderModule(std::string const & source, std::string const & label);
+
+    /**
+     * Look the descriptor up, starting an asynchronous compilation on a miss.
+     * Shader modules are keyed by identity, so a module not obtained from
+     * getShaderModule() only matches itself.
+     */
+    CachedRenderPipeline const * getRenderPipeline(WGPURenderPipelineDescriptor const & descriptor);
+
+    Stats const & stats() const { return m_stats; }
+    void printStats() const;
+
+    /**
+     * Drop every module and pipeline, e.g. before releasing the device.
+     * Compilations still in flight must have completed.
+     */
+    void clear();
+
+private:
+    struct PendingCompilation {
+        PipelineCache* cache;
+        CachedRenderPipeline* entry;
+    };
+    static void onPipelineCreated(WGPUCreatePipelineAsyncStatus status, WGPURenderPipeline pipeline,
+                                  char const * message, void * pUserData);
+
+    WGPUDevice m_device = nullptr;
+    // By WGSL source
+    std::unordered_map<std::string, Handle<WGPUShaderModule>> m_modules;
+    // Entries are heap allocated, their address is handed to the async callback
+    std::unordered_map<CacheKey, std::unique_ptr<CachedRenderPipeline>, CacheKeyHash> m_pipelines;
+    // Reused by every lookup
+    CacheKey m_key;
+    Stats m_stats;
+};
@@ -1,3 +1,7 @@
+// When the JS glue started running, main() reports the time from here to
+// itself as the runtime startup (wasm download, compile and instantiate)
+Module["scriptStartTime"] = performance.now();
+
 // if (navigator.gpu) {
 //     console.log("WebGPU detected")
 //     WebGPUInit();
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+
+/**
+ * What the web entry point (main.cpp) needs from a rendering backend. Both
+ * backends draw the shared scene of scene.h; which one is linked is chosen
+ * with the RENDERER_BACKEND CMake option.
+ */
+class Renderer {
+public:
+    virtual ~Renderer() = default;
+
+    virtual char const * backendName() const = 0;
+
+    /**
+     * Create the context/device and everything needed to draw. `onReady` is
+     * called with the outcome, possibly before init() returns.
+     */
+    virtual void init(std::function<void(bool)> onReady) = 0;
+
+    /**
+     * Upload what changed in the scene and draw it to the canvas. Returns
+     * false for frames that could not show the scene yet (e.g. shaders still
+     * compiling) so startup metrics count the first real frame.
+     */
+    virtual bool renderFrame() = 0;
+};
+
+/**
+ * Defined by the linked backend: main_webgpu.cpp or main_webgl.cpp.
+ */
+std::unique_ptr<Renderer> createRenderer();
@@ -0,0 +1,268 @@
+#include "scene-graph.h"
+
+#include <algorithm>
+#include <cmath>
+#include <type_traits>
+
+void SceneGraph::clear() {
+    m_nodeAt.clear();
+    m_parent.clear();
+    m_subtreeEnd.clear();
+    m_local.clear();
+    m_world.clear();
+    m_worldCos.clear();
+    m_worldSin.clear();
+    m_color.clear();
+    m_drawn.clear();
+    m_dirty.clear();
+    m_firstInstance.assign(1, 0);
+    m_index.clear();
+    m_dirtyList.clear();
+    m_drawnCount = 0;
+    m_ordered = true;
+    m_fullUpdate = false;
+}
+
+SceneGraph::NodeId SceneGraph::addNode(NodeId parent, InstanceTransform const & local, uint32_t color, bool drawn) {
+    const uint32_t index = size();
+    const NodeId node = (NodeId)m_index.size();
+    const uint32_t parentIndex = parent == NoNode ? NoNode : m_index[parent];
+
+    // Appending keeps the depth-first order when the parent's subtree ends
+    // at the end of the arrays, as when building a hierarchy depth first
+    if (m_ordered && parentIndex != NoNode && m_subtreeEnd[parentIndex] != index) {
+        m_ordered = false;
+    }
+    if (m_ordered) {
+        // Leaves skip the cos and sin of their rotation, recompute a parent
+        // that was one so its first child reads them
+        if (parentIndex != NoNode && m_subtreeEnd[parentIndex] == parentIndex + 1) {
+            markDirty(parentIndex, TransformDirty);
+        }
+        for (uint32_t ancestor = parentIndex; ancestor != NoNode; ancestor = m_parent[ancestor]) {
+            m_subtreeEnd[ancestor] = index + 1;
+        }
+    }
+
+    m_index.push_back(index);
+    m_nodeAt.push_back(node);
+    m_parent.push_back(parentIndex);
+    m_subtreeEnd.push_back(index + 1);
+    m_local.push_back(local);
+    m_world.push_back(local);
+    m_worldCos.push_back(1.0f);
+    m_worldSin.push_back(0.0f);
+    m_color.push_back(color);
+    m_drawn.push_back(drawn ? 1 : 0);
+    m_dirty.push_back(0);
+    m_drawnCount += drawn ? 1 : 0;
+    m_firstInstance.push_back(m_drawnCount);
+    markDirty(index, DirtyFlags(TransformDirty | ColorDirty));
+    return node;
+}
+
+void SceneGraph::setLocal(NodeId node, InstanceTransform const & local) {
+    const uint32_t index = m_index[node];
+    m_local[index] = local;
+    markDirty(index, TransformDirty);
+}
+
+void SceneGraph::setColor(NodeId node, uint32_t rgba) {
+    const uint32_t index = m_index[node];
+    m_color[index] = rgba;
+    markDirty(index, ColorDirty);
+}
+
+SceneGraph::NodeId SceneGraph::parent(NodeId node) const {
+    const uint32_t parentIndex = m_parent[m_index[node]];
+    return parentIndex == NoNode ? NoNode : m_nodeAt[parentIndex];
+}
+
+uint32_t SceneGraph::instance(NodeId node) const {
+    const uint32_t index = m_index[node];
+    return m_drawn[index] ? m_firstInstance[index] : NoInstance;
+}
+
+void SceneGraph::markDirty(uint32_t index, DirtyFlags flag) {
+    if (m_dirty[index] == 0) {
+        m_dirtyList.push_back(index);
+    }
+    m_dirty[index] |= flag;
+}
+
+void SceneGraph::reorder() {
+    const uint32_t count = size();
+
+    // Children of each position, in the order they were added
+    std::vector<uint32_t> childStart(count + 1, 0);
+    for (uint32_t i = 0; i < count; ++i) {
+        if (m_parent[i] != NoNode) {
+            ++childStart[m_parent[i] + 1];
+        }
+    }
+    for (uint32_t i = 0; i < count; ++i) {
+        childStart[i + 1] += childStart[i];
+    }
+    std::vector<uint32_t> children(childStart[count]);
+    std::vector<uint32_t> cursor(childStart.begin(), childStart.end() - 1);
+    for (uint32_t i = 0; i < count; ++i) {
+        if (m_parent[i] != NoNode) {
+            children[cursor[m_parent[i]]++] = i;
+        }
+    }
+
+    // Depth-first, roots in the order they were added
+    std::vector<uint32_t> order;
+    order.reserve(count);
+    std::vector<uint32_t> stack;
+    for (uint32_t root = 0; root < count; ++root) {
+        if (m_parent[root] != NoNode) {
+            continue;
+        }
+        stack.push_back(root);
+        while (!stack.empty()) {
+            const uint32_t i = stack.back();
+            stack.pop_back();
+            order.push_back(i);
+            for (uint32_t c = childStart[i + 1]; c > childStart[i]; --c) {
+                stack.push_back(children[c - 1]);
+            }
+        }
+    }
+
+    std::vector<uint32_t> newIndex(count);
+    for (uint32_t i = 0; i < count; ++i) {
+        newIndex[order[i]] = i;
+    }
+    auto permute = [&order](auto& values) {
+        std::remove_reference_t<decltype(values)> sorted(values.size());
+        for (size_t i = 0; i < order.size(); ++i) {
+            sorted[i] = values[order[i]];
+        }
+        values.swap(sorted);
+    };
+    permute(m_nodeAt);
+    permute(m_parent);
+    permute(m_local);
+    permute(m_color);
+    permute(m_drawn);
+    for (uint32_t& parentIndex : m_parent) {
+        if (parentIndex != NoNode) {
+            parentIndex = newIndex[parentIndex];
+        }
+    }
+    for (uint32_t i = 0; i < count; ++i) {
+        m_index[m_nodeAt[i]] = i;
+    }
+
+    // Children come after their parent, so a backwards pass sees every
+    // subtree before the node owning it
+    for (uint32_t i = 0; i < count; ++i) {
+        m_subtreeEnd[i] = i + 1;
+    }
+    for (uint32_t i = count; i-- > 0;) {
+        if (m_parent[i] != NoNode) {
+            m_subtreeEnd[m_parent[i]] = std::max(m_subtreeEnd[m_parent[i]], m_subtreeEnd[i]);
+        }
+    }
+    for (uint32_t i = 0; i < count; ++i) {
+        m_firstInstance[i + 1] = m_firstInstance[i] + m_drawn[i];
+    }
+    m_ordered = true;
+}
+
+void SceneGraph::updateRange(uint32_t begin, uint32_t end, InstanceStore& instances) {
+    InstanceTransform* transforms = instances.transforms();
+    for (uint32_t i = begin; i < end; ++i) {
+        InstanceTransform const & local = m_local[i];
+        InstanceTransform& world = m_world[i];
+        const uint32_t parentIndex = m_parent[i];
+        if (parentIndex == NoNode) {
+            world = local;
+        } else {
+            InstanceTransform const & parentWorld = m_world[parentIndex];
+            const float c = m_worldCos[parentIndex];
+            const float s = m_worldSin[parentIndex];
+            world.x = parentWorld.x + parentWorld.scale * (c * local.x - s * local.y);
+            world.y = parentWorld.y + parentWorld.scale * (s * local.x + c * local.y);
+            world.scale = parentWorld.scale * local.scale;
+            world.rotation = parentWorld.rotation + local.rotation;
+        }
+        // Only parents need the rotation's cos and sin, most nodes are leaves
+        if (m_subtreeEnd[i] > i + 1) {
+            m_worldCos[i] = std::cos(world.rotation);
+            m_worldSin[i] = std::sin(world.rotation);
+        }
+        if (m_drawn[i]) {
+            transforms[m_firstInstance[i]] = world;
+        }
+    }
+    instances.markDirty(InstanceStore::TransformStream, m_firstInstance[begin], m_firstInstance[end]);
+}
+
+SceneGraph::Stats SceneGraph::update(InstanceStore& instances) {
+    Stats stats;
+    if (!m_ordered) {
+        reorder();
+        stats.reordered = true;
+    }
+    if (instances.size() != m_drawnCount) {
+        instances.resize(m_drawnCount);
+    }
+
+    const uint32_t count = size();
+    if (stats.reordered || m_fullUpdate) {
+        updateRange(0, count, instances);
+        uint32_t* colors = instances.colors();
+        for (uint32_t i = 0; i < count; ++i) {
+            if (m_drawn[i]) {
+                colors[m_firstInstance[i]] = m_color[i];
+            }
+        }
+        instances.markDirty(InstanceStore::ColorStream, 0, m_drawnCount);
+        // Positions from before a reorder are stale, everything was done anyway
+        std::fill(m_dirty.begin(), m_dirty.end(), uint8_t(0));
+        m_dirtyList.clear();
+        m_fullUpdate = false;
+        stats.nodesUpdated = count;
+        // The whole graph as one range
+        stats.subtreesUpdated = count > 0 ? 1 : 0;
+        stats.colorsUpdated = m_drawnCount;
+        return stats;
+    }
+
+    // In depth-first order a dirty subtree may contain later dirty nodes,
+    // which it recomputes anyway
+    uint32_t coveredEnd = 0;
+    auto updateNode = [&](uint32_t index) {
+        const uint8_t flags = m_dirty[index];
+        m_dirty[index] = 0;
+        if ((flags & ColorDirty) && m_drawn[index]) {
+            const uint32_t instance = m_firstInstance[index];
+            instances.colors()[instance] = m_color[index];
+            instances.markDirty(InstanceStore::ColorStream, instance, instance + 1);
+            ++stats.colorsUpdated;
+        }
+        if ((flags & TransformDirty) && index >= coveredEnd) {
+            coveredEnd = m_subtreeEnd[index];
+            updateRange(index, coveredEnd, instances);
+            stats.nodesUpdated += coveredEnd - index;
+            ++stats.subtreesUpdated;
+        }
+    };
+    if (m_dirtyList.size() > count / 16) {
+        // Many changes: scanning the flags in order beats sorting the list
+        for (uint32_t index = 0; index < count; ++index) {
+            if (m_dirty[index]) {
+                updateNode(index);
+            }
+        }
+    } else {
+        std::sort(m_dirtyList.begin(), m_dirtyList.end());
+        for (uint32_t index : m_dirtyList) {
+            updateNode(index);
+        }
+    }
+    m_dirtyList.clear();
+    return stats;
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "instance-store.h"
+
+/**
+ * Retained 2D scene graph feeding an InstanceStore.
+ *
+ * Nodes are kept as structure of arrays in depth-first order, so a parent
+ * always comes before its children and every subtree is a contiguous range
+ * of nodes. Drawn nodes map to instances in the same order, so the instances
+ * of a subtree are a contiguous range too.
+ *
+ * setLocal() only marks the node. update() then recomputes the world
+ * transforms of the marked subtrees, parent first, and writes them to the
+ * instance store, marking one dirty range per subtree. The cost follows the
+ * number of nodes that changed, not the size of the scene:
+ *
+ *     SceneGraph::NodeId car = sceneGraph.addNode(SceneGraph::NoNode, carTransform);
+ *     SceneGraph::NodeId wheel = sceneGraph.addNode(car, wheelOffset, 0xFF202020);
+ *     ...
+ *     sceneGraph.setLocal(car, movedTransform); // the wheels follow
+ *     sceneGraph.update(instances);             // before encoding the frame
+ *
+ * Adding a node keeps the order when the hierarchy is built depth first.
+ * Anything else, such as a child added to a parent built long before, makes
+ * the next update() sort the arrays again and recompute everything. Node
+ * ids stay valid across that.
+ */
+class SceneGraph {
+public:
+    using NodeId = uint32_t;
+    static constexpr NodeId NoNode = UINT32_MAX;
+    static constexpr uint32_t NoInstance = UINT32_MAX;
+
+    struct Stats {
+        // World transforms recomputed
+        uint32_t nodesUpdated = 0;
+        // Dirty subtrees recomputed, each one a range of instances marked dirty
+        uint32_t subtreesUpdated = 0;
+        uint32_t colorsUpdated = 0;
+        // Nodes were added since the last update, everything was recomputed
+        bool reordered = false;
+    };
+
+    void clear();
+
+    /**
+     * Add a node under `parent` (NoNode for a root) with a transform relative
+     * to it. Nodes that are not drawn only carry a transform for their children.
+     */
+    NodeId addNode(NodeId parent, InstanceTransform const & local, uint32_t color = 0xFFFFFFFF, bool drawn = true);
+
+    void setLocal(NodeId node, InstanceTransform const & local);
+    void setColor(NodeId node, uint32_t rgba);
+
+    /**
+     * Recompute everything on the next update(), e.g. to compare with the
+     * incremental path.
+     */
+    void markAllDirty() { m_fullUpdate = true; }
+
+    /**
+     * Bring the world transforms up to date and write those that changed to
+     * `instances`, which the graph owns: it is resized to drawnCount().
+     */
+    Stats update(InstanceStore& instances);
+
+    uint32_t size() const { return (uint32_t)m_nodeAt.size(); }
+    uint32_t drawnCount() const { return m_drawnCount; }
+
+    NodeId parent(NodeId node) const;
+    InstanceTransform const & local(NodeId node) const { return m_local[m_index[node]]; }
+    uint32_t color(NodeId node) const { return m_color[m_index[node]]; }
+    // As of the last update()
+    InstanceTransform const & world(NodeId node) const { return m_world[m_index[node]]; }
+    // Instance drawing the node as of the last update(), NoInstance if it is not drawn
+    uint32_t instance(NodeId node) const;
+
+private:
+    enum DirtyFlags : uint8_t {
+        TransformDirty = 1,
+        ColorDirty = 2,
+    };
+
+    void markDirty(uint32_t index, DirtyFlags flag);
+    void reorder();
+    void updateRange(uint32_t begin, uint32_t end, InstanceStore& instances);
+
+    // Per node, indexed by position in depth-first order
+    std::vector<NodeId> m_nodeAt;
+    // Position of the parent, NoNode for roots
+    std::vector<uint32_t> m_parent;
+    // One past the last position of the node's subtree
+    std::vector<uint32_t> m_subtreeEnd;
+    std::vector<InstanceTransform> m_local;
+    std::vector<InstanceTransform> m_world;
+    // cos and sin of the world rotation, reused by every child
+    std::vector<float> m_worldCos;
+    std::vector<float> m_worldSin;
+    std::vector<uint32_t> m_color;
+    std::vector<uint8_t> m_drawn;
+    std::vector<uint8_t> m_dirty;
+    // Drawn nodes before each position, size() + 1 entries: the instance of a
+    // drawn node and the instance range of a subtree
+    std::vector<uint32_t> m_firstInstance = std::vector<uint32_t>(1, 0);
+
+    // Position of each node id
+    std::vector<uint32_t> m_index;
+    // Positions marked since the last update, in no particular order
+    std::vector<uint32_t> m_dirtyList;
+    uint32_t m_drawnCount = 0;
+    bool m_ordered = true;
+    bool m_fullUpdate = false;
+};
@@ -0,0 +1,82 @@
+#include "scene-socket.h"
+
+#include <emscripten.h>
+#include <emscripten/websocket.h>
+#include <iostream>
+
+namespace {
+
+struct SceneSocket {
+    std::string url;
+    SceneStreamDecoder* decoder = nullptr;
+    EMSCRIPTEN_WEBSOCKET_T socket = 0;
+    bool open = false;
+};
+SceneSocket sceneSocket;
+
+void reconnect(void*);
+
+EM_BOOL onOpen(int, EmscriptenWebSocketOpenEvent const *, void*) {
+    std::cout << "Scene stream connected to " << sceneSocket.url << std::endl;
+    sceneSocket.open = true;
+    return EM_TRUE;
+}
+
+EM_BOOL onMessage(int, EmscriptenWebSocketMessageEvent const * event, void*) {
+    if (!event->isText) {
+        sceneSocket.decoder->receive(event->data, event->numBytes);
+    }
+    return EM_TRUE;
+}
+
+EM_BOOL onClose(int, EmscriptenWebSocketCloseEvent const * event, void*) {
+    std::cerr << "Scene stream closed (" << event->code << "), reconnecting" << std::endl;
+    sceneSocket.open = false;
+    emscripten_websocket_delete(sceneSocket.socket);
+    sceneSocket.socket = 0;
+    emscripten_async_call(reconnect, nullptr, 1000);
+    return EM_TRUE;
+}
+
+// Always followed by a close event
+EM_BOOL onError(int, EmscriptenWebSocketErrorEvent const *, void*) {
+    std::cerr << "Scene stream error on " << sceneSocket.url << std::endl;
+    return EM_TRUE;
+}
+
+bool open() {
+    EmscriptenWebSocketCreateAttributes attributes;
+    emscripten_websocket_init_create_attributes(&attributes);
+    attributes.url = sceneSocket.url.c_str();
+    const EMSCRIPTEN_WEBSOCKET_T socket = emscripten_websocket_new(&attributes);
+    if (socket <= 0) {
+        std::cerr << "Could not open a WebSocket to " << sceneSocket.url << std::endl;
+        return false;
+    }
+    sceneSocket.socket = socket;
+    emscripten_websocket_set_onopen_callback(socket, nullptr, onOpen);
+    emscripten_websocket_set_onmessage_callback(socket, nullptr, onMessage);
+    emscripten_websocket_set_onclose_callback(socket, nullptr, onClose);
+    emscripten_websocket_set_onerror_callback(socket, nullptr, onError);
+    return true;
+}
+
+void reconnect(void*) {
+    open();
+}
+
+} // namespace
+
+bool connectSceneStream(std::string const & url, SceneStreamDecoder& decoder) {
+    if (!emscripten_websocket_is_supported()) {
+        std::cerr << "WebSocket is not supported, no scene stream" << std::endl;
+        return false;
+    }
+    sceneSocket.url = url;
+    sceneSocket.decoder = &decoder;
+    return open();
+}
+
+bool sceneStreamConnected() {
+    return sceneSocket.open;
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <string>
+
+#include "scene-stream.h"
+
+// Web only: feeds a SceneStreamDecoder from a WebSocket
+
+/**
+ * Open a WebSocket to `url` (ws:// or wss://) and queue each binary message
+ * it receives into `decoder` as it arrives, from the browser event loop.
+ * Text messages are ignored. When the connection drops, it reconnects a
+ * second later. The server starts every connection with a keyframe.
+ *
+ * Returns false if the browser cannot open the socket.
+ */
+bool connectSceneStream(std::string const & url, SceneStreamDecoder& decoder);
+
+bool sceneStreamConnected();
@@ -0,0 +1,236 @@
+#include "scene-stream.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+static double cpuMilliseconds() {
+    using namespace std::chrono;
+    return duration<double, std::milli>(steady_clock::now().time_since_epoch()).count();
+}
+
+static int32_t quantize(float value, float step) {
+    return (int32_t)std::lrint(value / step);
+}
+
+// Rotations wrap: a turn is 65536 steps
+static int16_t quantizeRotation(float rotation) {
+    return (int16_t)(uint16_t)std::lrint(rotation / SceneStreamRotationStep);
+}
+
+static uint64_t zigzag(int64_t value) {
+    return (uint64_t(value) << 1) ^ uint64_t(value >> 63);
+}
+
+static int64_t unzigzag(uint64_t value) {
+    return int64_t(value >> 1) ^ -int64_t(value & 1);
+}
+
+static void writeVarint(std::vector<uint8_t>& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(uint8_t(value) | 0x80);
+        value >>= 7;
+    }
+    out.push_back(uint8_t(value));
+}
+
+static bool readVarint(uint8_t const *& p, uint8_t const * end, uint64_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 64 && p < end; shift += 7) {
+        const uint8_t byte = *p++;
+        value |= uint64_t(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void SceneStreamEncoder::reset(uint32_t nodeCount) {
+    m_sent.assign(nodeCount, SceneStreamNode{});
+    m_message.clear();
+    m_recordCount = 0;
+    m_previousNode = -1;
+    m_keyframe = false;
+}
+
+void SceneStreamEncoder::beginMessage(bool keyframe) {
+    m_message.resize(sizeof(SceneStreamHeader));
+    m_recordCount = 0;
+    m_previousNode = -1;
+    m_keyframe = keyframe;
+}
+
+void SceneStreamEncoder::update(uint32_t node, InstanceTransform const & local, uint32_t color) {
+    SceneStreamNode& sent = m_sent[node];
+    const SceneStreamNode q = {quantize(local.x, SceneStreamPositionStep), quantize(local.y, SceneStreamPositionStep),
+                               quantize(local.scale, SceneStreamScaleStep), quantizeRotation(local.rotation), color};
+    uint8_t fields = SceneStreamAllFields;
+    if (!m_keyframe) {
+        fields = (q.x != sent.x ? SceneStreamX : 0) | (q.y != sent.y ? SceneStreamY : 0)
+                | (q.scale != sent.scale ? SceneStreamScale : 0)
+                | (q.rotation != sent.rotation ? SceneStreamRotation : 0)
+                | (q.color != sent.color ? SceneStreamColor : 0);
+        if (fields == 0) {
+            return;
+        }
+    }
+
+    writeVarint(m_message, zigzag(int64_t(node) - m_previousNode - 1));
+    m_message.push_back(fields);
+    // Keyframes start from zero
+    const SceneStreamNode base = m_keyframe ? SceneStreamNode{} : sent;
+    if (fields & SceneStreamX) {
+        writeVarint(m_message, zigzag(int64_t(q.x) - base.x));
+    }
+    if (fields & SceneStreamY) {
+        writeVarint(m_message, zigzag(int64_t(q.y) - base.y));
+    }
+    if (fields & SceneStreamScale) {
+        writeVarint(m_message, zigzag(int64_t(q.scale) - base.scale));
+    }
+    if (fields & SceneStreamRotation) {
+        // The short way round
+        writeVarint(m_message, zigzag(int16_t(uint16_t(q.rotation - base.rotation))));
+    }
+    if (fields & SceneStreamColor) {
+        const size_t offset = m_message.size();
+        m_message.resize(offset + sizeof(uint32_t));
+        memcpy(&m_message[offset], &q.color, sizeof(uint32_t));
+    }
+    sent = q;
+    m_previousNode = node;
+    ++m_recordCount;
+}
+
+std::vector<uint8_t> const & SceneStreamEncoder::finishMessage() {
+    const SceneStreamHeader header = {SceneStreamMagic, SceneStreamVersion,
+                                      uint16_t(m_keyframe ? SceneStreamKeyframe : 0), nodeCount(), m_recordCount};
+    memcpy(m_message.data(), &header, sizeof header);
+    return m_message;
+}
+
+InstanceTransform SceneStreamEncoder::sentLocal(uint32_t node) const {
+    SceneStreamNode const & sent = m_sent[node];
+    return {sent.x * SceneStreamPositionStep, sent.y * SceneStreamPositionStep, sent.scale * SceneStreamScaleStep,
+            sent.rotation * SceneStreamRotationStep};
+}
+
+void SceneStreamDecoder::receive(void const * data, size_t size) {
+    if (m_firstMessageSeconds == 0.0) {
+        m_firstMessageSeconds = cpuMilliseconds() * 1e-3;
+    }
+    // Length prefixed, the buffer keeps its capacity from frame to frame
+    const uint32_t length = (uint32_t)size;
+    const size_t offset = m_pending.size();
+    m_pending.resize(offset + sizeof length + size);
+    memcpy(&m_pending[offset], &length, sizeof length);
+    memcpy(&m_pending[offset + sizeof length], data, size);
+    ++m_pendingMessages;
+}
+
+uint32_t SceneStreamDecoder::apply(SceneGraph& graph) {
+    const double start = cpuMilliseconds();
+    const uint64_t recordsBefore = m_stats.records;
+    for (size_t offset = 0; offset < m_pending.size();) {
+        uint32_t length;
+        memcpy(&length, &m_pending[offset], sizeof length);
+        offset += sizeof length;
+        decode(&m_pending[offset], length, graph);
+        offset += length;
+    }
+
+    m_stats.frameMessages = m_pendingMessages;
+    m_stats.frameRecords = uint32_t(m_stats.records - recordsBefore);
+    m_stats.frameDecodeMilliseconds = cpuMilliseconds() - start;
+    m_stats.decodeMilliseconds += m_stats.frameDecodeMilliseconds;
+    m_stats.maxFrameMessages = std::max(m_stats.maxFrameMessages, m_pendingMessages);
+    m_pending.clear();
+    m_pendingMessages = 0;
+    return m_stats.frameRecords;
+}
+
+bool SceneStreamDecoder::decode(uint8_t const * data, size_t size, SceneGraph& graph) {
+    ++m_stats.messages;
+    m_stats.bytes += size;
+    // What the client holds no longer matches the server after a bad
+    // message, deltas are dropped until the next keyframe
+    auto fail = [this]() {
+        ++m_stats.errors;
+        m_synced = false;
+        return false;
+    };
+
+    SceneStreamHeader header;
+    if (size < sizeof header) {
+        return fail();
+    }
+    memcpy(&header, data, sizeof header);
+    const bool keyframe = (header.flags & SceneStreamKeyframe) != 0;
+    if (header.magic != SceneStreamMagic || header.version != SceneStreamVersion || header.nodeCount != graph.size()
+            || (!keyframe && !m_synced)) {
+        return fail();
+    }
+
+    uint8_t const * p = data + sizeof header;
+    uint8_t const * end = data + size;
+    int64_t node = -1;
+    for (uint32_t record = 0; record < header.recordCount; ++record) {
+        uint64_t value;
+        if (!readVarint(p, end, value)) {
+            return fail();
+        }
+        node += unzigzag(value) + 1;
+        if (node < 0 || node >= header.nodeCount || p == end) {
+            return fail();
+        }
+        const uint8_t fields = *p++;
+
+        // Deltas apply to the quantized value the client holds, which the
+        // local transform stores exactly
+        InstanceTransform local = graph.local(SceneGraph::NodeId(node));
+        auto field = [&](float& target, float step) {
+            if (!readVarint(p, end, value)) {
+                return false;
+            }
+            const int64_t base = keyframe ? 0 : quantize(target, step);
+            target = float(int32_t(base + unzigzag(value))) * step;
+            return true;
+        };
+        if (((fields & SceneStreamX) && !field(local.x, SceneStreamPositionStep))
+                || ((fields & SceneStreamY) && !field(local.y, SceneStreamPositionStep))
+                || ((fields & SceneStreamScale) && !field(local.scale, SceneStreamScaleStep))) {
+            return fail();
+        }
+        if (fields & SceneStreamRotation) {
+            if (!readVarint(p, end, value)) {
+                return fail();
+            }
+            const int16_t base = keyframe ? 0 : quantizeRotation(local.rotation);
+            local.rotation = int16_t(uint16_t(base + unzigzag(value))) * SceneStreamRotationStep;
+        }
+        if (fields & (SceneStreamX | SceneStreamY | SceneStreamScale | SceneStreamRotation)) {
+            graph.setLocal(SceneGraph::NodeId(node), local);
+        }
+        if (fields & SceneStreamColor) {
+            if (end - p < (ptrdiff_t)sizeof(uint32_t)) {
+                return fail();
+            }
+            uint32_t color;
+            memcpy(&color, p, sizeof color);
+            p += sizeof color;
+            graph.setColor(SceneGraph::NodeId(node), color);
+        }
+        ++m_stats.records;
+    }
+    if (keyframe) {
+        m_synced = true;
+    }
+    return true;
+}
+
+double SceneStreamDecoder::updatesPerSecond() const {
+    const double elapsed = cpuMilliseconds() * 1e-3 - m_firstMessageSeconds;
+    return m_firstMessageSeconds > 0.0 && elapsed > 0.0 ? m_stats.records / elapsed : 0.0;
+}
@@ -0,0 +1,170 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "scene-graph.h"
+
+/**
+ * Binary scene update stream: a server pushes changes to the local transforms
+ * and colors of a scene graph both sides built the same way (same node ids).
+ *
+ *     SceneStreamHeader
+ *     record[recordCount]:
+ *         varint   zigzag(node - previous node - 1), previous starts at -1
+ *         uint8    field mask (SceneStreamField)
+ *         varint   zigzag(x), zigzag(y), zigzag(scale), zigzag(rotation),
+ *                  for the fields present, in that order
+ *         uint32   color, if present
+ *
+ * Values are quantized (SceneStreamPositionStep and friends). In a keyframe
+ * they are absolute and every field is present. Otherwise each one is the
+ * difference from the value the client already has, and only the fields
+ * that changed are sent, so a small move costs a few bytes. Rotations wrap
+ * at a full turn (16 bits). Records sorted by node make the node deltas 0 or
+ * small. WebSocket messages arrive complete and in order, so the client's
+ * state always matches what the server last sent.
+ *
+ * Everything is little-endian, which covers wasm and every desktop target.
+ */
+
+constexpr uint32_t SceneStreamMagic = 0x554E4353; // "SCNU"
+constexpr uint16_t SceneStreamVersion = 1;
+constexpr float SceneStreamPositionStep = 1.0f / 65536.0f;
+constexpr float SceneStreamScaleStep = 1.0f / 65536.0f;
+constexpr float SceneStreamRotationStep = 6.2831853f / 65536.0f;
+
+enum SceneStreamFlags : uint16_t {
+    SceneStreamKeyframe = 1,
+};
+
+enum SceneStreamField : uint8_t {
+    SceneStreamX = 1,
+    SceneStreamY = 2,
+    SceneStreamScale = 4,
+    SceneStreamRotation = 8,
+    SceneStreamColor = 16,
+    SceneStreamAllFields = 31,
+};
+
+struct SceneStreamHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t flags;
+    // Size of the graph the stream is for, rejected if it differs
+    uint32_t nodeCount;
+    uint32_t recordCount;
+};
+static_assert(sizeof(SceneStreamHeader) == 16, "SceneStreamHeader is read as is");
+
+/**
+ * Quantized state of a node, as sent.
+ */
+struct SceneStreamNode {
+    int32_t x = 0;
+    int32_t y = 0;
+    int32_t scale = 0;
+    int16_t rotation = 0;
+    uint32_t color = 0;
+};
+
+/**
+ * Server side: writes messages and remembers what each node was last sent
+ * as, to send differences from it.
+ *
+ *     encoder.reset(graph.size());
+ *     encoder.beginMessage(true); // the first message is a keyframe
+ *     for (each node) encoder.update(node, local, color);
+ *     send(encoder.finishMessage());
+ */
+class SceneStreamEncoder {
+public:
+    /**
+     * Forget what was sent; the next message must be a keyframe.
+     */
+    void reset(uint32_t nodeCount);
+
+    void beginMessage(bool keyframe);
+
+    /**
+     * Add the node's current state. Outside keyframes, nothing is written if
+     * it quantizes to what was last sent. Nodes should be added in
+     * increasing order, any order works but costs more bytes.
+     */
+    void update(uint32_t node, InstanceTransform const & local, uint32_t color);
+
+    /**
+     * The message, valid until the next beginMessage().
+     */
+    std::vector<uint8_t> const & finishMessage();
+
+    uint32_t nodeCount() const { return (uint32_t)m_sent.size(); }
+    // What the client holds for the node once it decoded everything sent
+    InstanceTransform sentLocal(uint32_t node) const;
+    uint32_t sentColor(uint32_t node) const { return m_sent[node].color; }
+
+private:
+    std::vector<SceneStreamNode> m_sent;
+    std::vector<uint8_t> m_message;
+    uint32_t m_recordCount = 0;
+    int64_t m_previousNode = -1;
+    bool m_keyframe = false;
+};
+
+/**
+ * Client side: messages are queued as they arrive (one copy into a buffer
+ * that is reused, no allocation once it reached its size) and applied
+ * together once per rendered frame, straight into the scene graph's local
+ * transforms and colors. A node changed by several messages of the frame is
+ * recomputed once by the next SceneGraph::update().
+ */
+class SceneStreamDecoder {
+public:
+    struct Stats {
+        uint64_t messages = 0;
+        uint64_t records = 0;
+        uint64_t bytes = 0;
+        // Messages rejected: bad header, wrong node count, truncated, or a
+        // delta before the first keyframe
+        uint64_t errors = 0;
+        double decodeMilliseconds = 0.0;
+        // Last apply()
+        uint32_t frameMessages = 0;
+        uint32_t frameRecords = 0;
+        double frameDecodeMilliseconds = 0.0;
+        uint32_t maxFrameMessages = 0;
+    };
+
+    /**
+     * Queue a message. `data` may be reused as soon as this returns.
+     */
+    void receive(void const * data, size_t size);
+
+    /**
+     * Decode every queued message into `graph`. Returns the records applied.
+     */
+    uint32_t apply(SceneGraph& graph);
+
+    /**
+     * Decode one message into `graph` right away. Returns false (and counts
+     * an error) if it is malformed, in which case the records before the
+     * problem were applied.
+     */
+    bool decode(uint8_t const * data, size_t size, SceneGraph& graph);
+
+    bool synced() const { return m_synced; }
+    Stats const & stats() const { return m_stats; }
+
+    /**
+     * Updates per second since the first message arrived.
+     */
+    double updatesPerSecond() const;
+
+private:
+    std::vector<uint8_t> m_pending;
+    uint32_t m_pendingMessages = 0;
+    bool m_synced = false;
+    double m_firstMessageSeconds = 0.0;
+    Stats m_stats;
+};
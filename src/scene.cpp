@@ -0,0 +1,84 @@
+#include "scene.h"
+#include "job-system.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+InstanceStore instances;
+ViewUniforms view;
+SceneGraph sceneGraph;
+
+// Middle level of the benchmark graph: the nodes animateBenchmarkSceneGraph() turns
+static std::vector<SceneGraph::NodeId> benchmarkGroups;
+static const uint32_t benchmarkFanOut = 10;
+
+void buildBenchmarkScene(uint32_t count, uint32_t seed) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> position(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> angle(0.0f, 6.2831853f);
+
+    instances.resize(count);
+    InstanceTransform* transforms = instances.transforms();
+    uint32_t* colors = instances.colors();
+    for (uint32_t i = 0; i < count; ++i) {
+        transforms[i] = InstanceTransform{position(rng), position(rng), 0.02f, angle(rng)};
+        colors[i] = 0xFF000000 | (rng() & 0x00FFFFFF);
+    }
+    instances.markAllDirty();
+}
+
+void animateBenchmarkScene() {
+    InstanceTransform* transforms = instances.transforms();
+    // Spread over the job system's workers, a no-op split without threads
+    jobSystem.parallelFor(instances.size(), 16 * 1024, [transforms](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; ++i) {
+            transforms[i].rotation += 0.01f;
+        }
+    });
+    instances.markDirty(InstanceStore::TransformStream, 0, instances.size());
+}
+
+void buildBenchmarkSceneGraph(uint32_t count, uint32_t seed) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> position(-1.0f, 1.0f);
+    const float orbit = 1.5f;
+
+    sceneGraph.clear();
+    benchmarkGroups.clear();
+    // Depth first, so the graph never needs to be sorted again
+    auto addChild = [&](SceneGraph::NodeId parent, uint32_t k) {
+        const float angle = 6.2831853f * k / benchmarkFanOut;
+        const InstanceTransform local{orbit * std::cos(angle), orbit * std::sin(angle), 0.3f, angle};
+        return sceneGraph.addNode(parent, local, 0xFF000000 | (rng() & 0x00FFFFFF));
+    };
+    while (sceneGraph.size() < count) {
+        const SceneGraph::NodeId root = sceneGraph.addNode(
+                SceneGraph::NoNode, InstanceTransform{position(rng), position(rng), 0.05f, 0.0f},
+                0xFF000000 | (rng() & 0x00FFFFFF));
+        for (uint32_t i = 0; i < benchmarkFanOut && sceneGraph.size() < count; ++i) {
+            const SceneGraph::NodeId group = addChild(root, i);
+            benchmarkGroups.push_back(group);
+            for (uint32_t j = 0; j < benchmarkFanOut && sceneGraph.size() < count; ++j) {
+                addChild(group, j);
+            }
+        }
+    }
+}
+
+void animateBenchmarkSceneGraph(float changedFraction, uint32_t frame) {
+    if (benchmarkGroups.empty() || changedFraction <= 0.0f) {
+        return;
+    }
+    // A group is itself and its children
+    const float groupSize = float(benchmarkFanOut + 1);
+    const uint32_t groupCount = std::max(1u, uint32_t(changedFraction * sceneGraph.size() / groupSize + 0.5f));
+    for (uint32_t i = 0; i < groupCount; ++i) {
+        const uint32_t hash = (i + 1) * 2654435761u ^ frame * 40503u;
+        const SceneGraph::NodeId group = benchmarkGroups[hash % benchmarkGroups.size()];
+        InstanceTransform local = sceneGraph.local(group);
+        local.rotation += 0.02f;
+        sceneGraph.setLocal(group, local);
+    }
+}
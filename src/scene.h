@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+
+#include "instance-store.h"
+#include "scene-graph.h"
+
+/**
+ * 2D view applied by the instanced vertex shader:
+ *     clip = (world - center) * scale
+ * Shared by the WebGPU and WebGL2 backends (uniform buffer in both).
+ */
+struct ViewUniforms {
+    float center[2] = {0.0f, 0.0f};
+    float scale[2] = {1.0f, 1.0f};
+};
+
+// Scene content drawn by whichever backend is linked
+extern InstanceStore instances;
+extern ViewUniforms view;
+// Hierarchical scenes write their world transforms into `instances`
+extern SceneGraph sceneGraph;
+
+/**
+ * Fill `instances` with `count` small randomly placed and colored triangles,
+ * the scene both backends are benchmarked on. Deterministic for a given seed.
+ */
+void buildBenchmarkScene(uint32_t count, uint32_t seed = 42);
+
+/**
+ * Rotate every instance of the benchmark scene a step, so each frame uploads
+ * the whole transform stream.
+ */
+void animateBenchmarkScene();
+
+/**
+ * Fill `sceneGraph` with about `count` nodes in groups of three levels: a
+ * randomly placed root, 10 children orbiting it and 10 grandchildren
+ * orbiting each child, all drawn. Deterministic for a given seed. The
+ * instances are written by the next sceneGraph.update(instances).
+ */
+void buildBenchmarkSceneGraph(uint32_t count, uint32_t seed = 42);
+
+/**
+ * Turn randomly chosen groups of the benchmark graph, whole subtrees at a
+ * time, until about `changedFraction` of the nodes moved. Deterministic for
+ * a given frame.
+ */
+void animateBenchmarkSceneGraph(float changedFraction, uint32_t frame);
@@ -0,0 +1,156 @@
+#include "shader-library.h"
+#include "webgpu-renderer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+static double nowMilliseconds() {
+    using namespace std::chrono;
+    return duration<double, std::milli>(steady_clock::now().time_since_epoch()).count();
+}
+
+void ShaderLibrary::init(std::string directory) {
+    m_directory = std::move(directory);
+}
+
+std::string const * ShaderLibrary::loadFile(std::string const & file) {
+    auto it = m_files.find(file);
+    if (it != m_files.end()) {
+        return &it->second;
+    }
+    std::ifstream stream(m_directory + "/" + file, std::ios::binary);
+    if (!stream) {
+        return nullptr;
+    }
+    std::stringstream contents;
+    contents << stream.rdbuf();
+    ++m_stats.filesLoaded;
+    return &(m_files[file] = contents.str());
+}
+
+bool ShaderLibrary::expand(std::string const & file, ShaderDefines const & defines,
+                           std::vector<std::string>& included, std::string& output) {
+    std::string const * source = loadFile(file);
+    if (!source) {
+        std::cerr << "Shader " << m_directory << "/" << file << " not found" << std::endl;
+        return false;
+    }
+
+    // One entry per open #ifdef/#ifndef: whether its lines are kept, and
+    // whether the enclosing block's are (for #else)
+    struct Block {
+        bool parentActive;
+        bool active;
+        bool inElse;
+    };
+    std::vector<Block> blocks;
+    auto error = [&](uint32_t line, char const * message) {
+        std::cerr << "Shader " << file << ":" << line << ": " << message << std::endl;
+        return false;
+    };
+
+    std::istringstream lines(*source);
+    std::string line;
+    uint32_t lineNumber = 0;
+    while (std::getline(lines, line)) {
+        ++lineNumber;
+        const bool active = blocks.empty() || blocks.back().active;
+        const size_t start = line.find_first_not_of(" \t");
+        if (start == std::string::npos || line[start] != '#') {
+            if (active) {
+                output += line;
+                output += '\n';
+            }
+            continue;
+        }
+
+        std::istringstream words(line.substr(start + 1));
+        std::string directive, argument;
+        words >> directive >> argument;
+        if (directive == "include") {
+            if (argument.size() < 2 || argument.front() != '"' || argument.back() != '"') {
+                return error(lineNumber, "expected #include \"file\"");
+            }
+            const std::string name = argument.substr(1, argument.size() - 2);
+            // Included once per variant, which also stops include cycles
+            if (active && std::find(included.begin(), included.end(), name) == included.end()) {
+                included.push_back(name);
+                if (!expand(name, defines, included, output)) {
+                    return false;
+                }
+            }
+        } else if (directive == "ifdef" || directive == "ifndef") {
+            if (argument.empty()) {
+                return error(lineNumber, "expected a define name");
+            }
+            const bool defined = std::find(defines.begin(), defines.end(), argument) != defines.end();
+            blocks.push_back({active, active && defined == (directive == "ifdef"), false});
+        } else if (directive == "else") {
+            if (blocks.empty() || blocks.back().inElse) {
+                return error(lineNumber, "#else without #ifdef");
+            }
+            Block& block = blocks.back();
+            block.active = block.parentActive && !block.active;
+            block.inElse = true;
+        } else if (directive == "endif") {
+            if (blocks.empty()) {
+                return error(lineNumber, "#endif without #ifdef");
+            }
+            blocks.pop_back();
+        } else {
+            return error(lineNumber, "unknown directive");
+        }
+    }
+    if (!blocks.empty()) {
+        return error(lineNumber, "missing #endif");
+    }
+    return true;
+}
+
+std::string ShaderLibrary::preprocess(std::string const & file, ShaderDefines const & defines) {
+    std::vector<std::string> included = {file};
+    std::string output;
+    return expand(file, defines, included, output) ? output : std::string();
+}
+
+WGPUShaderModule ShaderLibrary::getModule(std::string const & file, ShaderDefines const & defines) {
+    ShaderDefines sortedDefines = defines;
+    std::sort(sortedDefines.begin(), sortedDefines.end());
+    m_key.clear();
+    m_key.addString(file.c_str());
+    for (std::string const & define : sortedDefines) {
+        m_key.addString(define.c_str());
+    }
+    auto it = m_variants.find(m_key);
+    if (it != m_variants.end()) {
+        ++m_stats.variantHits;
+        return it->second;
+    }
+    ++m_stats.variantMisses;
+
+    const double start = nowMilliseconds();
+    const std::string source = preprocess(file, sortedDefines);
+    m_stats.preprocessMilliseconds += nowMilliseconds() - start;
+    if (source.empty()) {
+        return nullptr;
+    }
+    WGPUShaderModule module = pipelineCache.getShaderModule(source, file);
+    m_variants[m_key] = module;
+    return module;
+}
+
+void ShaderLibrary::printStats() const {
+    PipelineCache::Stats const & cache = pipelineCache.stats();
+    std::cout << "Shader library: " << m_stats.filesLoaded << " files, "
+              << m_stats.variantMisses << " variants (" << m_stats.variantHits << " hits), "
+              << cache.moduleMisses << " modules compiled in " << cache.moduleMilliseconds << " ms, "
+              << "preprocess " << m_stats.preprocessMilliseconds << " ms" << std::endl;
+}
+
+void ShaderLibrary::clear() {
+    m_variants.clear();
+    m_files.clear();
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <webgpu/webgpu.h>
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "hash.h"
+
+// Where the .wgsl files are read from: the source tree natively, the
+// embedded /shaders directory on the web (both set by CMake)
+#ifndef SHADER_DIRECTORY
+#define SHADER_DIRECTORY "shaders"
+#endif
+
+/**
+ * Feature defines of a shader variant, e.g. {"HEIGHT_SHADING"}. Order does
+ * not matter.
+ */
+using ShaderDefines = std::vector<std::string>;
+
+/**
+ * Loads WGSL from SHADER_DIRECTORY and turns (file, defines) variants into
+ * shader modules through the pipeline cache.
+ *
+ * Files go through a small preprocessor before compilation:
+ *     #include "file.wgsl"     inserted once per variant, relative to the directory
+ *     #ifdef NAME / #ifndef NAME / #else / #endif
+ * where NAME is one of the variant's defines. Anything a pipeline can tune
+ * without changing the code belongs in WGSL `override` constants instead,
+ * set through the `constants` of the pipeline stage: every specialization
+ * then shares one module and only the pipeline is compiled again.
+ */
+class ShaderLibrary {
+public:
+    struct Stats {
+        uint32_t filesLoaded = 0;
+        uint32_t variantHits = 0;
+        uint32_t variantMisses = 0;
+        // Time spent reading and preprocessing
+        double preprocessMilliseconds = 0.0;
+    };
+
+    void init(std::string directory = SHADER_DIRECTORY);
+
+    /**
+     * Module of `file` preprocessed with `defines`, null if it could not be
+     * loaded. Owned by the pipeline cache; variants whose preprocessed
+     * source comes out the same share one module.
+     */
+    WGPUShaderModule getModule(std::string const & file, ShaderDefines const & defines = {});
+
+    /**
+     * The source getModule() compiles, empty with an error printed if a file
+     * is missing or a directive is malformed.
+     */
+    std::string preprocess(std::string const & file, ShaderDefines const & defines);
+
+    Stats const & stats() const { return m_stats; }
+    /**
+     * Variant statistics with the module count and compile times of the
+     * pipeline cache.
+     */
+    void printStats() const;
+
+    void clear();
+
+private:
+    std::string const * loadFile(std::string const & file);
+    bool expand(std::string const & file, ShaderDefines const & defines, std::vector<std::string>& included,
+                std::string& output);
+
+    std::string m_directory;
+    // File contents by name, read once
+    std::unordered_map<std::string, std::string> m_files;
+    // Variant key (file and sorted defines) to module
+    std::unordered_map<CacheKey, WGPUShaderModule, CacheKeyHash> m_variants;
+    // Reused by every lookup
+    CacheKey m_key;
+    Stats m_stats;
+};
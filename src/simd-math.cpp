@@ -0,0 +1,229 @@
+#include "simd-math.h"
+
+#include <cmath>
+
+#if !defined(SIMD_MATH_FORCE_SCALAR) && defined(__wasm_simd128__)
+#  define SIMD_MATH_WASM 1
+#  include <wasm_simd128.h>
+#elif !defined(SIMD_MATH_FORCE_SCALAR) && (defined(__SSE2__) || defined(_M_X64))
+#  define SIMD_MATH_SSE 1
+#  include <emmintrin.h>
+#endif
+
+// Four lane float vector, the batched code below is written once against it
+#if defined(SIMD_MATH_WASM)
+using Float4 = v128_t;
+static inline Float4 load4(float const * p) { return wasm_v128_load(p); }
+static inline void store4(float* p, Float4 v) { wasm_v128_store(p, v); }
+static inline Float4 splat4(float v) { return wasm_f32x4_splat(v); }
+static inline Float4 add4(Float4 a, Float4 b) { return wasm_f32x4_add(a, b); }
+static inline Float4 mul4(Float4 a, Float4 b) { return wasm_f32x4_mul(a, b); }
+static inline Float4 lessThan4(Float4 a, Float4 b) { return wasm_f32x4_lt(a, b); }
+static inline Float4 or4(Float4 a, Float4 b) { return wasm_v128_or(a, b); }
+// Bit i set when lane i of `mask` is all ones
+static inline int laneMask4(Float4 mask) { return wasm_i32x4_bitmask(mask); }
+#elif defined(SIMD_MATH_SSE)
+using Float4 = __m128;
+static inline Float4 load4(float const * p) { return _mm_loadu_ps(p); }
+static inline void store4(float* p, Float4 v) { _mm_storeu_ps(p, v); }
+static inline Float4 splat4(float v) { return _mm_set1_ps(v); }
+static inline Float4 add4(Float4 a, Float4 b) { return _mm_add_ps(a, b); }
+static inline Float4 mul4(Float4 a, Float4 b) { return _mm_mul_ps(a, b); }
+static inline Float4 lessThan4(Float4 a, Float4 b) { return _mm_cmplt_ps(a, b); }
+static inline Float4 or4(Float4 a, Float4 b) { return _mm_or_ps(a, b); }
+static inline int laneMask4(Float4 mask) { return _mm_movemask_ps(mask); }
+#endif
+
+char const * simdMathBackend() {
+#if defined(SIMD_MATH_WASM)
+    return "wasm simd128";
+#elif defined(SIMD_MATH_SSE)
+    return "sse";
+#else
+    return "scalar";
+#endif
+}
+
+Mat4 mat4Identity() {
+    return mat4Scale(1.0f, 1.0f, 1.0f);
+}
+
+Mat4 mat4Translation(float x, float y, float z) {
+    Mat4 m = mat4Identity();
+    m.columns[3] = Vec4{x, y, z, 1.0f};
+    return m;
+}
+
+Mat4 mat4Scale(float x, float y, float z) {
+    Mat4 m;
+    m.columns[0].x = x;
+    m.columns[1].y = y;
+    m.columns[2].z = z;
+    m.columns[3].w = 1.0f;
+    return m;
+}
+
+Mat4 mat4RotationZ(float radians) {
+    const float c = std::cos(radians);
+    const float s = std::sin(radians);
+    Mat4 m = mat4Identity();
+    m.columns[0] = Vec4{c, s, 0.0f, 0.0f};
+    m.columns[1] = Vec4{-s, c, 0.0f, 0.0f};
+    return m;
+}
+
+Mat4 mat4Orthographic(float left, float right, float bottom, float top, float zNear, float zFar) {
+    Mat4 m;
+    m.columns[0].x = 2.0f / (right - left);
+    m.columns[1].y = 2.0f / (top - bottom);
+    m.columns[2].z = 1.0f / (zNear - zFar);
+    m.columns[3] = Vec4{(left + right) / (left - right), (top + bottom) / (bottom - top), zNear / (zNear - zFar), 1.0f};
+    return m;
+}
+
+static inline float component(Vec4 const & v, int i) {
+    return (&v.x)[i];
+}
+
+Mat4 mat4MultiplyScalar(Mat4 const & a, Mat4 const & b) {
+    Mat4 result;
+    for (int j = 0; j < 4; ++j) {
+        float* out = &result.columns[j].x;
+        for (int i = 0; i < 4; ++i) {
+            out[i] = 0.0f;
+            for (int k = 0; k < 4; ++k) {
+                out[i] += component(a.columns[k], i) * component(b.columns[j], k);
+            }
+        }
+    }
+    return result;
+}
+
+Mat4 mat4Multiply(Mat4 const & a, Mat4 const & b) {
+#if defined(SIMD_MATH_WASM) || defined(SIMD_MATH_SSE)
+    // Column j of the result is a linear combination of the columns of a
+    const Float4 a0 = load4(&a.columns[0].x);
+    const Float4 a1 = load4(&a.columns[1].x);
+    const Float4 a2 = load4(&a.columns[2].x);
+    const Float4 a3 = load4(&a.columns[3].x);
+    Mat4 result;
+    for (int j = 0; j < 4; ++j) {
+        Vec4 const & bj = b.columns[j];
+        Float4 column = mul4(a0, splat4(bj.x));
+        column = add4(column, mul4(a1, splat4(bj.y)));
+        column = add4(column, mul4(a2, splat4(bj.z)));
+        column = add4(column, mul4(a3, splat4(bj.w)));
+        store4(&result.columns[j].x, column);
+    }
+    return result;
+#else
+    return mat4MultiplyScalar(a, b);
+#endif
+}
+
+Vec4 mat4Transform(Mat4 const & m, Vec4 const & v) {
+    Vec4 result;
+    float* out = &result.x;
+    for (int i = 0; i < 4; ++i) {
+        out[i] = component(m.columns[0], i) * v.x + component(m.columns[1], i) * v.y
+               + component(m.columns[2], i) * v.z + component(m.columns[3], i) * v.w;
+    }
+    return result;
+}
+
+Frustum frustumFromMatrix(Mat4 const & m) {
+    // Rows of the matrix, planes are sums/differences of them (Gribb & Hartmann)
+    Vec4 rows[4];
+    for (int i = 0; i < 4; ++i) {
+        rows[i] = Vec4{component(m.columns[0], i), component(m.columns[1], i),
+                       component(m.columns[2], i), component(m.columns[3], i)};
+    }
+    auto plus = [](Vec4 const & a, Vec4 const & b) { return Vec4{a.x + b.x, a.y + b.y, a.z + b.z, a.w + b.w}; };
+    auto minus = [](Vec4 const & a, Vec4 const & b) { return Vec4{a.x - b.x, a.y - b.y, a.z - b.z, a.w - b.w}; };
+
+    Frustum frustum;
+    frustum.planes[0] = plus(rows[3], rows[0]);  // left
+    frustum.planes[1] = minus(rows[3], rows[0]); // right
+    frustum.planes[2] = plus(rows[3], rows[1]);  // bottom
+    frustum.planes[3] = minus(rows[3], rows[1]); // top
+    frustum.planes[4] = rows[2];                 // near, z >= 0 in WebGPU clip space
+    frustum.planes[5] = minus(rows[3], rows[2]); // far
+    return frustum;
+}
+
+void transformPointsScalar(Mat4 const & m, float const * x, float const * y, float const * z,
+                           float* outX, float* outY, float* outZ, size_t count) {
+    Vec4 const & c0 = m.columns[0];
+    Vec4 const & c1 = m.columns[1];
+    Vec4 const & c2 = m.columns[2];
+    Vec4 const & c3 = m.columns[3];
+    for (size_t i = 0; i < count; ++i) {
+        const float px = x[i], py = y[i], pz = z[i];
+        outX[i] = c0.x * px + c1.x * py + c2.x * pz + c3.x;
+        outY[i] = c0.y * px + c1.y * py + c2.y * pz + c3.y;
+        outZ[i] = c0.z * px + c1.z * py + c2.z * pz + c3.z;
+    }
+}
+
+void transformPoints(Mat4 const & m, float const * x, float const * y, float const * z,
+                     float* outX, float* outY, float* outZ, size_t count) {
+    size_t i = 0;
+#if defined(SIMD_MATH_WASM) || defined(SIMD_MATH_SSE)
+    const Float4 m00 = splat4(m.columns[0].x), m01 = splat4(m.columns[1].x), m02 = splat4(m.columns[2].x), m03 = splat4(m.columns[3].x);
+    const Float4 m10 = splat4(m.columns[0].y), m11 = splat4(m.columns[1].y), m12 = splat4(m.columns[2].y), m13 = splat4(m.columns[3].y);
+    const Float4 m20 = splat4(m.columns[0].z), m21 = splat4(m.columns[1].z), m22 = splat4(m.columns[2].z), m23 = splat4(m.columns[3].z);
+    for (; i + 4 <= count; i += 4) {
+        const Float4 px = load4(x + i);
+        const Float4 py = load4(y + i);
+        const Float4 pz = load4(z + i);
+        // Same operation order as the scalar path, so results match bit for bit
+        store4(outX + i, add4(add4(add4(mul4(m00, px), mul4(m01, py)), mul4(m02, pz)), m03));
+        store4(outY + i, add4(add4(add4(mul4(m10, px), mul4(m11, py)), mul4(m12, pz)), m13));
+        store4(outZ + i, add4(add4(add4(mul4(m20, px), mul4(m21, py)), mul4(m22, pz)), m23));
+    }
+#endif
+    transformPointsScalar(m, x + i, y + i, z + i, outX + i, outY + i, outZ + i, count - i);
+}
+
+size_t cullAabbsScalar(Frustum const & frustum, AabbArrays const & boxes, size_t count, uint8_t* visible) {
+    size_t visibleCount = 0;
+    for (size_t i = 0; i < count; ++i) {
+        bool outside = false;
+        for (Vec4 const & plane : frustum.planes) {
+            // The box corner furthest along the plane normal
+            const float px = plane.x > 0.0f ? boxes.maxX[i] : boxes.minX[i];
+            const float py = plane.y > 0.0f ? boxes.maxY[i] : boxes.minY[i];
+            const float pz = plane.z > 0.0f ? boxes.maxZ[i] : boxes.minZ[i];
+            outside = outside || plane.x * px + plane.y * py + plane.z * pz + plane.w < 0.0f;
+        }
+        visible[i] = outside ? 0 : 1;
+        visibleCount += visible[i];
+    }
+    return visibleCount;
+}
+
+size_t cullAabbs(Frustum const & frustum, AabbArrays const & boxes, size_t count, uint8_t* visible) {
+    size_t i = 0;
+    size_t visibleCount = 0;
+#if defined(SIMD_MATH_WASM) || defined(SIMD_MATH_SSE)
+    for (; i + 4 <= count; i += 4) {
+        Float4 outside = lessThan4(splat4(0.0f), splat4(0.0f));
+        for (Vec4 const & plane : frustum.planes) {
+            // The normal is the same for all four boxes, so is the choice of corner
+            const Float4 px = load4((plane.x > 0.0f ? boxes.maxX : boxes.minX) + i);
+            const Float4 py = load4((plane.y > 0.0f ? boxes.maxY : boxes.minY) + i);
+            const Float4 pz = load4((plane.z > 0.0f ? boxes.maxZ : boxes.minZ) + i);
+            const Float4 distance = add4(add4(add4(mul4(splat4(plane.x), px), mul4(splat4(plane.y), py)),
+                                              mul4(splat4(plane.z), pz)), splat4(plane.w));
+            outside = or4(outside, lessThan4(distance, splat4(0.0f)));
+        }
+        const int outsideMask = laneMask4(outside);
+        for (int lane = 0; lane < 4; ++lane) {
+            visible[i + lane] = (outsideMask >> lane) & 1 ? 0 : 1;
+            visibleCount += visible[i + lane];
+        }
+    }
+#endif
+    AabbArrays tail = {boxes.minX + i, boxes.minY + i, boxes.minZ + i, boxes.maxX + i, boxes.maxY + i, boxes.maxZ + i};
+    return visibleCount + cullAabbsScalar(frustum, tail, count - i, visible + i);
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Small CPU math layer for transforms and culling.
+ *
+ * Matrices are column-major and transform column vectors (p' = M * p), the
+ * same convention WGSL and GLSL use, so a Mat4 can be copied to a uniform
+ * buffer as is.
+ *
+ * The batched functions work on structure-of-arrays inputs (one array per
+ * component, any alignment) and process four elements per instruction with
+ * wasm simd128 (Emscripten build with -msimd128) or SSE (native x86), with a
+ * scalar tail. Each one has a *Scalar twin that is always compiled, used as
+ * the fallback and as the reference the SIMD path is checked against.
+ * Defining SIMD_MATH_FORCE_SCALAR (CMake: -DENABLE_SIMD=OFF) selects the
+ * scalar path everywhere.
+ */
+
+struct alignas(16) Vec4 {
+    float x = 0.0f;
+    float y = 0.0f;
+    float z = 0.0f;
+    float w = 0.0f;
+};
+
+struct alignas(16) Mat4 {
+    Vec4 columns[4];
+};
+
+/**
+ * Plane (nx, ny, nz, d) per Vec4, a point p is inside when
+ * nx * p.x + ny * p.y + nz * p.z + d >= 0.
+ */
+struct Frustum {
+    Vec4 planes[6];
+};
+
+/**
+ * Name of the compiled batched path: "wasm simd128", "sse" or "scalar".
+ */
+char const * simdMathBackend();
+
+Mat4 mat4Identity();
+Mat4 mat4Translation(float x, float y, float z);
+Mat4 mat4Scale(float x, float y, float z);
+Mat4 mat4RotationZ(float radians);
+/**
+ * Orthographic projection to WebGPU clip space (z in [0, 1]).
+ */
+Mat4 mat4Orthographic(float left, float right, float bottom, float top, float zNear, float zFar);
+
+Mat4 mat4Multiply(Mat4 const & a, Mat4 const & b);
+Mat4 mat4MultiplyScalar(Mat4 const & a, Mat4 const & b);
+Vec4 mat4Transform(Mat4 const & m, Vec4 const & v);
+
+/**
+ * Extract the six clip planes of a view-projection matrix (WebGPU clip
+ * space). Planes are not normalized, which is fine for inside/outside tests.
+ */
+Frustum frustumFromMatrix(Mat4 const & viewProjection);
+
+/**
+ * out = M * (x, y, z, 1) for `count` points, dropping w (affine M).
+ * The outputs may alias the inputs.
+ */
+void transformPoints(Mat4 const & m, float const * x, float const * y, float const * z,
+                     float* outX, float* outY, float* outZ, size_t count);
+void transformPointsScalar(Mat4 const & m, float const * x, float const * y, float const * z,
+                           float* outX, float* outY, float* outZ, size_t count);
+
+/**
+ * Axis aligned boxes given as min/max component arrays. Writes 1 to
+ * visible[i] when box i intersects the frustum (conservatively: boxes
+ * straddling a frustum corner may be reported visible), 0 otherwise.
+ * Returns the number of visible boxes.
+ */
+struct AabbArrays {
+    float const * minX;
+    float const * minY;
+    float const * minZ;
+    float const * maxX;
+    float const * maxY;
+    float const * maxZ;
+};
+size_t cullAabbs(Frustum const & frustum, AabbArrays const & boxes, size_t count, uint8_t* visible);
+size_t cullAabbsScalar(Frustum const & frustum, AabbArrays const & boxes, size_t count, uint8_t* visible);
@@ -0,0 +1,265 @@
+#include "sprite-batcher.h"
+#include "frame-stats.h"
+#include "webgpu-renderer.h"
+
+#include <algorithm>
+
+namespace {
+
+// sprite.wgsl's SpriteView
+struct SpriteViewUniforms {
+    float scale[2];
+    float offset[2];
+};
+
+} // namespace
+
+void SpriteBatcher::init(WGPUDevice device, WGPUQueue queue, WGPUTextureFormat colorFormat) {
+    m_atlas.init(device, queue);
+
+    WGPUShaderModule shaderModule = shaderLibrary.getModule("sprite.wgsl");
+
+    WGPUBindGroupLayoutEntry viewEntry{};
+    viewEntry.binding = 0;
+    viewEntry.visibility = WGPUShaderStage_Vertex;
+    viewEntry.buffer.type = WGPUBufferBindingType_Uniform;
+    viewEntry.buffer.hasDynamicOffset = true;
+    viewEntry.buffer.minBindingSize = sizeof(SpriteViewUniforms);
+    WGPUBindGroupLayoutDescriptor viewLayoutDesc{};
+    viewLayoutDesc.label = "sprite-view-layout";
+    viewLayoutDesc.entryCount = 1;
+    viewLayoutDesc.entries = &viewEntry;
+    m_viewBindGroupLayout = bindGroupCache.getBindGroupLayout(viewLayoutDesc);
+
+    WGPUBindGroupLayoutEntry atlasEntries[2] = {};
+    atlasEntries[0].binding = 0;
+    atlasEntries[0].visibility = WGPUShaderStage_Fragment;
+    atlasEntries[0].sampler.type = WGPUSamplerBindingType_Filtering;
+    atlasEntries[1].binding = 1;
+    atlasEntries[1].visibility = WGPUShaderStage_Fragment;
+    atlasEntries[1].texture.sampleType = WGPUTextureSampleType_Float;
+    atlasEntries[1].texture.viewDimension = WGPUTextureViewDimension_2D;
+    WGPUBindGroupLayoutDescriptor atlasLayoutDesc{};
+    atlasLayoutDesc.label = "sprite-atlas-layout";
+    atlasLayoutDesc.entryCount = 2;
+    atlasLayoutDesc.entries = atlasEntries;
+    m_atlasBindGroupLayout = bindGroupCache.getBindGroupLayout(atlasLayoutDesc);
+
+    WGPUBindGroupLayout bindGroupLayouts[] = {m_viewBindGroupLayout, m_atlasBindGroupLayout};
+    WGPUPipelineLayoutDescriptor pipelineLayoutDesc{};
+    pipelineLayoutDesc.bindGroupLayoutCount = 2;
+    pipelineLayoutDesc.bindGroupLayouts = bindGroupLayouts;
+    m_pipelineLayout = bindGroupCache.getPipelineLayout(pipelineLayoutDesc);
+
+    WGPUSamplerDescriptor samplerDesc{};
+    samplerDesc.label = "sprite-sampler";
+    samplerDesc.addressModeU = WGPUAddressMode_ClampToEdge;
+    samplerDesc.addressModeV = WGPUAddressMode_ClampToEdge;
+    samplerDesc.addressModeW = WGPUAddressMode_ClampToEdge;
+    samplerDesc.magFilter = WGPUFilterMode_Linear;
+    samplerDesc.minFilter = WGPUFilterMode_Linear;
+    samplerDesc.mipmapFilter = WGPUMipmapFilterMode_Nearest;
+    samplerDesc.lodMinClamp = 0.0f;
+    samplerDesc.lodMaxClamp = 1.0f;
+    samplerDesc.maxAnisotropy = 1;
+    m_sampler = bindGroupCache.getSampler(samplerDesc);
+
+    WGPUVertexAttribute attributes[5] = {};
+    attributes[0].format = WGPUVertexFormat_Float32x2;
+    attributes[0].offset = offsetof(Instance, center);
+    attributes[0].shaderLocation = 0;
+    attributes[1].format = WGPUVertexFormat_Float32x2;
+    attributes[1].offset = offsetof(Instance, size);
+    attributes[1].shaderLocation = 1;
+    attributes[2].format = WGPUVertexFormat_Float32x4;
+    attributes[2].offset = offsetof(Instance, uv);
+    attributes[2].shaderLocation = 2;
+    attributes[3].format = WGPUVertexFormat_Unorm8x4;
+    attributes[3].offset = offsetof(Instance, color);
+    attributes[3].shaderLocation = 3;
+    attributes[4].format = WGPUVertexFormat_Float32;
+    attributes[4].offset = offsetof(Instance, rotation);
+    attributes[4].shaderLocation = 4;
+    WGPUVertexBufferLayout vertexBuffer{};
+    vertexBuffer.arrayStride = sizeof(Instance);
+    vertexBuffer.stepMode = WGPUVertexStepMode_Instance;
+    vertexBuffer.attributeCount = 5;
+    vertexBuffer.attributes = attributes;
+
+    WGPUVertexState vertex{};
+    vertex.module = shaderModule;
+    vertex.entryPoint = "vs_main";
+    vertex.bufferCount = 1;
+    vertex.buffers = &vertexBuffer;
+
+    WGPUPrimitiveState primitiveState{};
+    primitiveState.topology = WGPUPrimitiveTopology_TriangleStrip;
+    primitiveState.stripIndexFormat = WGPUIndexFormat_Undefined;
+    primitiveState.frontFace = WGPUFrontFace_CCW;
+    primitiveState.cullMode = WGPUCullMode_None;
+
+    WGPUMultisampleState multisampleState{};
+    multisampleState.count = 1;
+    multisampleState.mask = 0xFFFFFFFF;
+
+    // Straight alpha, and additive weighted by alpha
+    const WGPUBlendFactor destinationFactors[] = {WGPUBlendFactor_OneMinusSrcAlpha, WGPUBlendFactor_One};
+    char const * labels[] = {"sprite-alpha-pipeline", "sprite-additive-pipeline"};
+    for (size_t i = 0; i < size_t(SpriteBlend::Count); ++i) {
+        WGPUBlendState blend = {
+                .color = WGPUBlendComponent{
+                        .operation = WGPUBlendOperation_Add,
+                        .srcFactor = WGPUBlendFactor_SrcAlpha,
+                        .dstFactor = destinationFactors[i],
+                },
+                .alpha = WGPUBlendComponent{
+                        .operation = WGPUBlendOperation_Add,
+                        .srcFactor = WGPUBlendFactor_One,
+                        .dstFactor = WGPUBlendFactor_OneMinusSrcAlpha,
+                },
+        };
+        WGPUColorTargetState colorTarget{};
+        colorTarget.format = colorFormat;
+        colorTarget.blend = &blend;
+        colorTarget.writeMask = WGPUColorWriteMask_All;
+
+        WGPUFragmentState fragment{};
+        fragment.module = shaderModule;
+        fragment.entryPoint = "fs_main";
+        fragment.targetCount = 1;
+        fragment.targets = &colorTarget;
+
+        WGPURenderPipelineDescriptor pipelineDesc{};
+        pipelineDesc.label = labels[i];
+        pipelineDesc.layout = m_pipelineLayout;
+        pipelineDesc.vertex = vertex;
+        pipelineDesc.fragment = &fragment;
+        pipelineDesc.primitive = primitiveState;
+        pipelineDesc.multisample = multisampleState;
+        m_pipelines[i] = pipelineCache.getRenderPipeline(pipelineDesc);
+    }
+}
+
+void SpriteBatcher::setTargetSize(uint32_t width, uint32_t height) {
+    m_targetWidth = float(std::max(width, 1u));
+    m_targetHeight = float(std::max(height, 1u));
+}
+
+void SpriteBatcher::add(Sprite const & sprite, AtlasRegion const & region) {
+    Instance instance;
+    instance.center[0] = sprite.x;
+    instance.center[1] = sprite.y;
+    instance.size[0] = sprite.width;
+    instance.size[1] = sprite.height;
+    std::copy(std::begin(region.uv), std::end(region.uv), instance.uv);
+    instance.color = sprite.color;
+    instance.rotation = sprite.rotation;
+
+    const uint64_t key = uint64_t(sprite.layer) << 56 | uint64_t(sprite.blend) << 48
+            | uint64_t(region.page & 0xFFFF) << 32 | m_instances.size();
+    m_instances.push_back(instance);
+    m_keys.push_back(key);
+}
+
+WGPUBindGroup SpriteBatcher::atlasBindGroup(uint32_t page) {
+    WGPUBindGroupEntry entries[2] = {};
+    entries[0].binding = 0;
+    entries[0].sampler = m_sampler;
+    entries[1].binding = 1;
+    entries[1].textureView = m_atlas.pageView(page);
+    WGPUBindGroupDescriptor bindGroupDesc{};
+    bindGroupDesc.label = "sprite-atlas";
+    bindGroupDesc.layout = m_atlasBindGroupLayout;
+    bindGroupDesc.entryCount = 2;
+    bindGroupDesc.entries = entries;
+    return bindGroupCache.getBindGroup(bindGroupDesc);
+}
+
+void SpriteBatcher::prepare(UploadRing& ring) {
+    m_batches.clear();
+    m_stats = {};
+    m_stats.sprites = (uint32_t)m_instances.size();
+    if (m_instances.empty()) {
+        return;
+    }
+
+    // The same layout and binding as the scene's view: the cache hands out
+    // the scene's bind group
+    WGPUBindGroupEntry entry{};
+    entry.binding = 0;
+    entry.buffer = ring.buffer();
+    entry.offset = 0;
+    entry.size = sizeof(SpriteViewUniforms);
+    WGPUBindGroupDescriptor bindGroupDesc{};
+    bindGroupDesc.label = "sprite-view";
+    bindGroupDesc.layout = m_viewBindGroupLayout;
+    bindGroupDesc.entryCount = 1;
+    bindGroupDesc.entries = &entry;
+    m_viewBindGroup = bindGroupCache.getBindGroup(bindGroupDesc);
+    const SpriteViewUniforms view = {{2.0f / m_targetWidth, -2.0f / m_targetHeight}, {-1.0f, 1.0f}};
+    const uint32_t viewOffset = ring.pushUniform(view);
+    const uint32_t count = (uint32_t)m_instances.size();
+    UploadRing::Allocation allocation = ring.allocate(uint64_t(count) * sizeof(Instance));
+    // The ring grows next frame, the sprites of this one are dropped
+    if (viewOffset == UINT32_MAX || !allocation) {
+        m_instances.clear();
+        m_keys.clear();
+        return;
+    }
+    m_viewOffset = viewOffset;
+    m_vertexBuffer = ring.buffer();
+    m_vertexOffset = allocation.offset;
+    m_vertexBytes = count * (uint32_t)sizeof(Instance);
+
+    std::sort(m_keys.begin(), m_keys.end());
+    Instance* out = static_cast<Instance*>(allocation.data);
+    for (uint32_t i = 0; i < count; ++i) {
+        const uint64_t key = m_keys[i];
+        out[i] = m_instances[uint32_t(key)];
+        // Layers only order the runs, a run continues across them when the state does
+        const auto blend = SpriteBlend(uint8_t(key >> 48));
+        const uint32_t page = uint32_t(key >> 32) & 0xFFFF;
+        if (m_batches.empty() || m_batches.back().blend != blend || m_batches.back().page != page) {
+            m_batches.push_back({blend, page, i, 0});
+        }
+        ++m_batches.back().count;
+    }
+    m_instances.clear();
+    m_keys.clear();
+}
+
+void SpriteBatcher::render(WGPURenderPassEncoder pass) {
+    if (m_batches.empty()) {
+        return;
+    }
+    wgpuRenderPassEncoderSetBindGroup(pass, 0, m_viewBindGroup, 1, &m_viewOffset);
+    wgpuRenderPassEncoderSetVertexBuffer(pass, 0, m_vertexBuffer, m_vertexOffset, m_vertexBytes);
+    ++frameStats.bindGroupChanges;
+    ++frameStats.bufferChanges;
+
+    WGPURenderPipeline boundPipeline = nullptr;
+    uint32_t boundPage = UINT32_MAX;
+    for (Batch const & batch : m_batches) {
+        WGPURenderPipeline pipeline = m_pipelines[size_t(batch.blend)]->get();
+        // Skipped while compiling
+        if (!pipeline) {
+            continue;
+        }
+        if (pipeline != boundPipeline) {
+            wgpuRenderPassEncoderSetPipeline(pass, pipeline);
+            boundPipeline = pipeline;
+            ++m_stats.pipelineChanges;
+            ++frameStats.pipelineChanges;
+        }
+        if (batch.page != boundPage) {
+            wgpuRenderPassEncoderSetBindGroup(pass, 1, atlasBindGroup(batch.page), 0, nullptr);
+            boundPage = batch.page;
+            ++m_stats.atlasChanges;
+            ++frameStats.bindGroupChanges;
+        }
+        wgpuRenderPassEncoderDraw(pass, 4, batch.count, 0, batch.first);
+        ++m_stats.draws;
+    }
+    m_batches.clear();
+    frameStats.drawCalls += m_stats.draws;
+}
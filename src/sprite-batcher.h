@@ -0,0 +1,131 @@
+#pragma once
+
+#include <webgpu/webgpu.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "pipeline-cache.h"
+#include "texture-atlas.h"
+#include "upload-ring.h"
+#include "webgpu-handles.h"
+
+enum class SpriteBlend : uint8_t {
+    Alpha,
+    Additive,
+    Count
+};
+
+/**
+ * A textured quad in target pixels, origin at the top left.
+ */
+struct Sprite {
+    // Center and size
+    float x = 0.0f;
+    float y = 0.0f;
+    float width = 0.0f;
+    float height = 0.0f;
+    // Radians, clockwise on screen
+    float rotation = 0.0f;
+    // RGBA8 multiplied with the texels
+    uint32_t color = 0xFFFFFFFF;
+    // Lower layers are drawn first
+    uint8_t layer = 0;
+    SpriteBlend blend = SpriteBlend::Alpha;
+};
+
+/**
+ * Immediate mode 2D sprites for UI and overlays, drawn over the scene.
+ *
+ * Sprites are added from anywhere during a frame. prepare() sorts them by
+ * layer, then by state (blend mode, atlas page), and streams one instance
+ * record per sprite through the upload ring as a vertex buffer. render()
+ * then issues one instanced draw per run of sprites sharing a state,
+ * changing the pipeline and the atlas bind group only between runs, so a
+ * frame of thousands of sprites takes as many draws as it has states.
+ *
+ * Within a layer, sprites are drawn grouped by state and in the order they
+ * were added within a group: sprites that must overlap in a given order
+ * across states go to different layers.
+ */
+class SpriteBatcher {
+public:
+    // One per sprite, vertex buffer with instance step mode
+    struct Instance {
+        float center[2];
+        float size[2];
+        float uv[4];
+        uint32_t color;
+        float rotation;
+    };
+    static_assert(sizeof(Instance) == 40, "Instance must match the vertex layout of sprite.wgsl");
+
+    struct Stats {
+        uint32_t sprites = 0;
+        uint32_t draws = 0;
+        uint32_t pipelineChanges = 0;
+        uint32_t atlasChanges = 0;
+    };
+
+    void init(WGPUDevice device, WGPUQueue queue, WGPUTextureFormat colorFormat);
+
+    TextureAtlas& atlas() { return m_atlas; }
+
+    /**
+     * Size of the target in pixels, the coordinate space of the sprites.
+     */
+    void setTargetSize(uint32_t width, uint32_t height);
+
+    void add(Sprite const & sprite, AtlasRegion const & region);
+    uint32_t pendingCount() const { return (uint32_t)m_instances.size(); }
+
+    /**
+     * Sort the sprites added since the last call and write them to `ring`.
+     * Call before the ring is flushed; the sprites are consumed.
+     */
+    void prepare(UploadRing& ring);
+
+    /**
+     * Draw what the last prepare() streamed.
+     */
+    void render(WGPURenderPassEncoder pass);
+
+    /**
+     * Counts of the last prepare() and render().
+     */
+    Stats const & stats() const { return m_stats; }
+
+private:
+    struct Batch {
+        SpriteBlend blend;
+        uint32_t page;
+        uint32_t first;
+        uint32_t count;
+    };
+
+    WGPUBindGroup atlasBindGroup(uint32_t page);
+
+    TextureAtlas m_atlas;
+    CachedRenderPipeline const * m_pipelines[size_t(SpriteBlend::Count)] = {};
+    // Owned by bindGroupCache, the bind groups are looked up every frame
+    WGPUBindGroupLayout m_viewBindGroupLayout = nullptr;
+    WGPUBindGroupLayout m_atlasBindGroupLayout = nullptr;
+    WGPUPipelineLayout m_pipelineLayout = nullptr;
+    WGPUSampler m_sampler = nullptr;
+    WGPUBindGroup m_viewBindGroup = nullptr;
+    uint32_t m_viewOffset = 0;
+    float m_targetWidth = 800.0f;
+    float m_targetHeight = 600.0f;
+
+    // Added this frame: instance records and their sort keys
+    // (layer, blend, page, index)
+    std::vector<Instance> m_instances;
+    std::vector<uint64_t> m_keys;
+
+    // Streamed by prepare()
+    std::vector<Batch> m_batches;
+    WGPUBuffer m_vertexBuffer = nullptr;
+    uint32_t m_vertexOffset = 0;
+    uint32_t m_vertexBytes = 0;
+    Stats m_stats;
+};
@@ -0,0 +1,114 @@
+#include "texture-atlas.h"
+
+#include <algorithm>
+#include <cstring>
+
+void TextureAtlas::init(WGPUDevice device, WGPUQueue queue, uint32_t pageSize) {
+    m_device = device;
+    m_queue = queue;
+    m_pageSize = pageSize;
+    m_pages.clear();
+    addPage();
+
+    const uint32_t white = 0xFFFFFFFF;
+    add(1, 1, &white, m_white);
+    // Sample the middle of the pixel, not its edge
+    m_white.uv[0] = m_white.uv[2] = (m_white.x + 0.5f) / m_pageSize;
+    m_white.uv[1] = m_white.uv[3] = (m_white.y + 0.5f) / m_pageSize;
+}
+
+void TextureAtlas::addPage() {
+    WGPUTextureDescriptor textureDesc{};
+    textureDesc.label = "atlas-page";
+    textureDesc.usage = WGPUTextureUsage_TextureBinding | WGPUTextureUsage_CopyDst;
+    textureDesc.dimension = WGPUTextureDimension_2D;
+    textureDesc.size = {m_pageSize, m_pageSize, 1};
+    textureDesc.format = WGPUTextureFormat_RGBA8Unorm;
+    textureDesc.mipLevelCount = 1;
+    textureDesc.sampleCount = 1;
+
+    Page page;
+    page.texture.reset(wgpuDeviceCreateTexture(m_device, &textureDesc));
+    page.view.reset(wgpuTextureCreateView(page.texture.get(), nullptr));
+    m_pages.push_back(std::move(page));
+}
+
+bool TextureAtlas::place(Page& page, uint32_t width, uint32_t height, uint32_t& x, uint32_t& y) {
+    // Best fit: the shelf with room whose height is wasted the least
+    Shelf* best = nullptr;
+    for (Shelf& shelf : page.shelves) {
+        if (shelf.height >= height && m_pageSize - shelf.used >= width
+                && (!best || shelf.height < best->height)) {
+            best = &shelf;
+        }
+    }
+    // A much taller shelf wastes more than opening a new one would
+    if (!best || (best->height > height + height / 2 && m_pageSize - page.top >= height)) {
+        if (m_pageSize - page.top < height) {
+            return false;
+        }
+        page.shelves.push_back({page.top, height, 0});
+        page.top += height;
+        best = &page.shelves.back();
+    }
+    x = best->used;
+    y = best->y;
+    best->used += width;
+    page.usedPixels += uint64_t(width) * height;
+    return true;
+}
+
+bool TextureAtlas::add(uint32_t width, uint32_t height, void const * pixels, AtlasRegion& region) {
+    const uint32_t paddedWidth = width + 2 * Border;
+    const uint32_t paddedHeight = height + 2 * Border;
+    if (width == 0 || height == 0 || paddedWidth > m_pageSize || paddedHeight > m_pageSize) {
+        return false;
+    }
+
+    uint32_t page = 0;
+    uint32_t x = 0;
+    uint32_t y = 0;
+    while (!place(m_pages[page], paddedWidth, paddedHeight, x, y)) {
+        if (++page == m_pages.size()) {
+            addPage();
+        }
+    }
+
+    // Border pixels repeat the nearest edge pixel
+    m_padded.resize(size_t(paddedWidth) * paddedHeight * 4);
+    const uint8_t* source = static_cast<uint8_t const *>(pixels);
+    for (uint32_t py = 0; py < paddedHeight; ++py) {
+        const uint32_t sy = std::min(std::max(py, Border) - Border, height - 1);
+        for (uint32_t px = 0; px < paddedWidth; ++px) {
+            const uint32_t sx = std::min(std::max(px, Border) - Border, width - 1);
+            memcpy(&m_padded[(size_t(py) * paddedWidth + px) * 4], source + (size_t(sy) * width + sx) * 4, 4);
+        }
+    }
+
+    WGPUImageCopyTexture destination{};
+    destination.texture = m_pages[page].texture.get();
+    destination.mipLevel = 0;
+    destination.origin = {x, y, 0};
+    destination.aspect = WGPUTextureAspect_All;
+    WGPUTextureDataLayout layout{};
+    layout.offset = 0;
+    layout.bytesPerRow = paddedWidth * 4;
+    layout.rowsPerImage = paddedHeight;
+    const WGPUExtent3D size = {paddedWidth, paddedHeight, 1};
+    wgpuQueueWriteTexture(m_queue, &destination, m_padded.data(), m_padded.size(), &layout, &size);
+
+    region.page = page;
+    region.x = x + Border;
+    region.y = y + Border;
+    region.width = width;
+    region.height = height;
+    region.uv[0] = float(region.x) / m_pageSize;
+    region.uv[1] = float(region.y) / m_pageSize;
+    region.uv[2] = float(region.x + width) / m_pageSize;
+    region.uv[3] = float(region.y + height) / m_pageSize;
+    return true;
+}
+
+float TextureAtlas::occupancy(uint32_t page) const {
+    return float(double(m_pages[page].usedPixels) / (double(m_pageSize) * m_pageSize));
+}
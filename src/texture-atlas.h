@@ -0,0 +1,87 @@
+#pragma once
+
+#include <webgpu/webgpu.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "webgpu-handles.h"
+
+/**
+ * Where an image of a TextureAtlas lives: the page and the pixel rectangle
+ * in it, and the same rectangle in texture coordinates.
+ */
+struct AtlasRegion {
+    uint32_t page = 0;
+    uint32_t x = 0;
+    uint32_t y = 0;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    // u0, v0, u1, v1
+    float uv[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+};
+
+/**
+ * Packs RGBA8 images into square texture pages at runtime, so that sprites
+ * using different images can be drawn by the same draw call.
+ *
+ * Each page is filled by shelves: rows as tall as the first image placed in
+ * them, where later images go to the shelf that wastes the least height. A
+ * new page is created when no shelf and no room for a new shelf is left.
+ * Images are stored with a one pixel border repeating their edge, so linear
+ * filtering at the edge of a region never picks up a neighbor.
+ */
+class TextureAtlas {
+public:
+    static constexpr uint32_t DefaultPageSize = 2048;
+    static constexpr uint32_t Border = 1;
+
+    /**
+     * Creates the first page and puts a 1x1 white image in it, see white().
+     */
+    void init(WGPUDevice device, WGPUQueue queue, uint32_t pageSize = DefaultPageSize);
+
+    /**
+     * Pack and upload a width x height image of tightly packed RGBA8 pixels.
+     * Returns false if it cannot fit in a page.
+     */
+    bool add(uint32_t width, uint32_t height, void const * pixels, AtlasRegion& region);
+
+    /**
+     * Region of a white pixel, for untextured (solid color) sprites.
+     */
+    AtlasRegion const & white() const { return m_white; }
+
+    uint32_t pageSize() const { return m_pageSize; }
+    uint32_t pageCount() const { return (uint32_t)m_pages.size(); }
+    WGPUTextureView pageView(uint32_t page) const { return m_pages[page].view.get(); }
+    /**
+     * Share of the page's pixels covered by images and their borders.
+     */
+    float occupancy(uint32_t page) const;
+
+private:
+    struct Shelf {
+        uint32_t y;
+        uint32_t height;
+        uint32_t used;
+    };
+    struct Page {
+        Handle<WGPUTexture> texture;
+        Handle<WGPUTextureView> view;
+        std::vector<Shelf> shelves;
+        uint32_t top = 0;
+        uint64_t usedPixels = 0;
+    };
+
+    void addPage();
+    bool place(Page& page, uint32_t width, uint32_t height, uint32_t& x, uint32_t& y);
+
+    WGPUDevice m_device = nullptr;
+    WGPUQueue m_queue = nullptr;
+    uint32_t m_pageSize = 0;
+    std::vector<Page> m_pages;
+    AtlasRegion m_white;
+    // Image with its border, reused between add() calls
+    std::vector<uint8_t> m_padded;
+};
@@ -0,0 +1,158 @@
+#include "trace.h"
+
+#ifdef __EMSCRIPTEN__
+#include <emscripten.h>
+#endif
+
+#ifdef ENABLE_TRACING
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+
+namespace {
+
+struct TraceEvent {
+    char const * name;
+    uint64_t begin;
+    // UINT32_MAX marks an instant event
+    uint32_t duration;
+};
+
+/**
+ * Single producer ring: only the owning thread writes events, the dump reads
+ * up to the published head.
+ */
+struct TraceRing {
+    TraceEvent events[TraceRingCapacity];
+    std::atomic<uint64_t> head{0};
+    uint32_t threadId = 0;
+
+    void push(TraceEvent const & event) {
+        const uint64_t index = head.load(std::memory_order_relaxed);
+        events[index & (TraceRingCapacity - 1)] = event;
+        head.store(index + 1, std::memory_order_release);
+    }
+};
+
+static_assert((TraceRingCapacity & (TraceRingCapacity - 1)) == 0, "TraceRingCapacity must be a power of two");
+
+// Rings are registered once per thread and never freed, a thread may exit
+// before the dump that wants its events
+std::atomic<TraceRing*> rings[TraceMaxThreads];
+std::atomic<uint32_t> ringCount{0};
+
+const auto traceEpoch = std::chrono::steady_clock::now();
+
+TraceRing* threadRing() {
+    thread_local TraceRing* ring = nullptr;
+    thread_local bool full = false;
+    if (!ring && !full) {
+        const uint32_t slot = ringCount.fetch_add(1, std::memory_order_relaxed);
+        if (slot >= TraceMaxThreads) {
+            // Too many threads: this one is not traced
+            full = true;
+            return nullptr;
+        }
+        ring = new TraceRing();
+        ring->threadId = slot + 1;
+        rings[slot].store(ring, std::memory_order_release);
+    }
+    return ring;
+}
+
+void writeJsonString(FILE* file, char const * str) {
+    fputc('"', file);
+    for (; *str; ++str) {
+        if (*str == '"' || *str == '\\') fputc('\\', file);
+        fputc(*str, file);
+    }
+    fputc('"', file);
+}
+
+} // namespace
+
+uint64_t traceNowMicroseconds() {
+    using namespace std::chrono;
+    return duration_cast<microseconds>(steady_clock::now() - traceEpoch).count();
+}
+
+void traceComplete(char const * name, uint64_t beginMicroseconds, uint64_t endMicroseconds) {
+    if (TraceRing* ring = threadRing()) {
+        ring->push(TraceEvent{name, beginMicroseconds, uint32_t(endMicroseconds - beginMicroseconds)});
+    }
+}
+
+void traceInstant(char const * name) {
+    if (TraceRing* ring = threadRing()) {
+        ring->push(TraceEvent{name, traceNowMicroseconds(), UINT32_MAX});
+    }
+}
+
+bool writeChromeTrace(char const * path) {
+    FILE* file = fopen(path, "w");
+    if (!file) {
+        printf("Could not open trace file %s\n", path);
+        return false;
+    }
+
+    fputs("{\"traceEvents\":[", file);
+    bool first = true;
+    uint64_t eventCount = 0;
+    const uint32_t threadCount = std::min(ringCount.load(std::memory_order_acquire), TraceMaxThreads);
+    for (uint32_t t = 0; t < threadCount; ++t) {
+        TraceRing const * ring = rings[t].load(std::memory_order_acquire);
+        if (!ring) {
+            continue;
+        }
+        const uint64_t head = ring->head.load(std::memory_order_acquire);
+        const uint64_t begin = head > TraceRingCapacity ? head - TraceRingCapacity : 0;
+        for (uint64_t i = begin; i < head; ++i) {
+            TraceEvent const & event = ring->events[i & (TraceRingCapacity - 1)];
+            fputs(first ? "\n" : ",\n", file);
+            first = false;
+            fputs("{\"name\":", file);
+            writeJsonString(file, event.name);
+            if (event.duration == UINT32_MAX) {
+                fprintf(file, ",\"ph\":\"i\",\"s\":\"t\",\"ts\":%llu", (unsigned long long)event.begin);
+            } else {
+                fprintf(file, ",\"ph\":\"X\",\"ts\":%llu,\"dur\":%u", (unsigned long long)event.begin, event.duration);
+            }
+            fprintf(file, ",\"pid\":1,\"tid\":%u}", ring->threadId);
+            ++eventCount;
+        }
+    }
+    fputs("\n]}\n", file);
+    const bool success = fclose(file) == 0;
+    printf("Wrote %llu trace events to %s\n", (unsigned long long)eventCount, path);
+    return success;
+}
+
+#endif // ENABLE_TRACING
+
+#ifdef __EMSCRIPTEN__
+void initTraceStorage() {
+    EM_ASM({
+        var dir = UTF8ToString($0);
+        try {
+            FS.mkdir(dir);
+            FS.mount(IDBFS, {}, dir);
+            FS.syncfs(true, function(err) {
+                if (err) console.warn("Could not load " + dir + " from IndexedDB", err);
+            });
+        } catch (e) {
+            // The directory still works, in memory only
+            console.warn("IDBFS unavailable, traces stay in MEMFS", e);
+        }
+    }, TraceDirectory);
+}
+
+void persistTraceStorage() {
+    EM_ASM({
+        FS.syncfs(false, function(err) {
+            if (err) console.warn("Could not persist traces to IndexedDB", err);
+        });
+    });
+}
+#endif // __EMSCRIPTEN__
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstdint>
+
+/**
+ * CPU tracing of the hot paths, exported as Chrome trace JSON (open it in
+ * chrome://tracing or ui.perfetto.dev).
+ *
+ *     void encodeFrame() {
+ *         TRACE_SCOPE("encodeFrame");
+ *         ...
+ *     }
+ *
+ * Every thread records into its own ring buffer, so recording takes no lock
+ * and costs two clock reads and a few stores. The rings keep the most recent
+ * events, a dump shows the last few thousand frames.
+ *
+ * Configuring with -DENABLE_TRACING=OFF compiles the TRACE_* macros to
+ * nothing and writeChromeTrace() to a stub returning false.
+ */
+
+#ifdef ENABLE_TRACING
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+// `name` must be a string literal, only its address is recorded
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(traceScope, __LINE__)(name)
+#define TRACE_INSTANT(name) traceInstant(name)
+
+// Per-thread ring size, a power of two
+constexpr uint32_t TraceRingCapacity = 16384;
+constexpr uint32_t TraceMaxThreads = 64;
+
+/**
+ * Microseconds since the first trace call of the process.
+ */
+uint64_t traceNowMicroseconds();
+
+void traceComplete(char const * name, uint64_t beginMicroseconds, uint64_t endMicroseconds);
+void traceInstant(char const * name);
+
+class TraceScope {
+public:
+    explicit TraceScope(char const * name) : m_name(name), m_begin(traceNowMicroseconds()) {}
+    ~TraceScope() { traceComplete(m_name, m_begin, traceNowMicroseconds()); }
+
+    TraceScope(TraceScope const &) = delete;
+    TraceScope& operator=(TraceScope const &) = delete;
+
+private:
+    char const * m_name;
+    uint64_t m_begin;
+};
+
+/**
+ * Write the events currently held by every thread's ring to `path`. Best
+ * called between frames: events recorded while the dump runs may be missing
+ * or, if a ring wraps during the dump, torn.
+ */
+bool writeChromeTrace(char const * path);
+
+#else // NOT ENABLE_TRACING
+
+#define TRACE_SCOPE(name) do {} while (0)
+#define TRACE_INSTANT(name) do {} while (0)
+
+inline bool writeChromeTrace(char const * /* path */) { return false; }
+
+#endif // ENABLE_TRACING
+
+#ifdef __EMSCRIPTEN__
+/**
+ * Directory backed by IndexedDB (IDBFS) where the web build writes traces,
+ * so that they survive the page. Falls back to MEMFS if IndexedDB is not
+ * available.
+ */
+constexpr char const * TraceDirectory = "/traces";
+
+/**
+ * Mount TraceDirectory and load what earlier sessions left there.
+ */
+void initTraceStorage();
+
+/**
+ * Flush TraceDirectory to IndexedDB, asynchronously.
+ */
+void persistTraceStorage();
+#endif // __EMSCRIPTEN__
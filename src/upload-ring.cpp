@@ -0,0 +1,107 @@
+#include "upload-ring.h"
+#include "frame-stats.h"
+#include "webgpu-renderer.h"
+#include "webgpu-utils.h"
+
+#include <iostream>
+
+static uint64_t alignUp(uint64_t value, uint64_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+void UploadRing::init(WGPUDevice device, uint64_t capacity, WGPUBufferUsageFlags usage) {
+    m_device = device;
+    m_usage = usage | WGPUBufferUsage_CopyDst | WGPUBufferUsage_CopySrc;
+    m_uniformAlignment = getDeviceLimits(device).minUniformBufferOffsetAlignment;
+    createBuffer(alignUp(capacity, m_uniformAlignment));
+}
+
+void UploadRing::createBuffer(uint64_t capacity) {
+    WGPUBufferDescriptor bufferDesc{};
+    bufferDesc.label = "upload-ring";
+    bufferDesc.usage = m_usage;
+    bufferDesc.size = capacity;
+    bufferDesc.mappedAtCreation = false;
+
+    // Commands of frames still in flight may reference the old buffer
+    deferredReleases.retire(std::move(m_buffer));
+    m_buffer.reset(wgpuDeviceCreateBuffer(m_device, &bufferDesc));
+    m_shadow.assign(capacity, 0);
+    m_capacity = capacity;
+    m_head = 0;
+    m_flushStart = 0;
+    m_wrapped = false;
+    ++m_generation;
+}
+
+void UploadRing::beginFrame() {
+    if (m_growRequested || m_lastFrameBytes > m_capacity / 2) {
+        createBuffer(m_capacity * 2);
+        m_growRequested = false;
+        m_overflowReported = false;
+    }
+    m_frameBytes = 0;
+    m_frameWrites = 0;
+}
+
+UploadRing::Allocation UploadRing::allocate(uint64_t size, uint32_t alignment) {
+    uint64_t offset = alignUp(m_head, alignment);
+    bool wraps = false;
+    if (offset + size > m_capacity) {
+        // Restart at the beginning, unless that is where unflushed data lives
+        wraps = true;
+        offset = 0;
+    }
+    // Once wrapped, the free space ends where the unflushed data starts
+    bool overflows = size > m_capacity;
+    if (m_wrapped) {
+        overflows = overflows || wraps || offset + size > m_flushStart;
+    } else if (wraps) {
+        overflows = overflows || offset + size > m_flushStart;
+    }
+    if (overflows) {
+        if (!m_overflowReported) {
+            std::cout << "Upload ring full (" << m_capacity << " bytes), growing next frame" << std::endl;
+            m_overflowReported = true;
+        }
+        m_growRequested = true;
+        return {};
+    }
+
+    const uint64_t end = alignUp(offset + size, 4);
+    if (wraps) {
+        // The tail left unused at the end of the buffer counts as used
+        m_frameBytes += m_capacity - m_head + end;
+        m_wrapEnd = m_head;
+        m_wrapped = true;
+    } else {
+        m_frameBytes += end - m_head;
+    }
+    m_head = end;
+
+    Allocation allocation;
+    allocation.data = m_shadow.data() + offset;
+    allocation.offset = (uint32_t)offset;
+    return allocation;
+}
+
+void UploadRing::flush(WGPUQueue queue) {
+    auto write = [&](uint64_t begin, uint64_t end) {
+        if (end > begin) {
+            wgpuQueueWriteBuffer(queue, m_buffer.get(), begin, m_shadow.data() + begin, end - begin);
+            ++m_frameWrites;
+            ++frameStats.uploadCalls;
+            frameStats.uploadBytes += end - begin;
+        }
+    };
+
+    if (m_wrapped) {
+        write(m_flushStart, m_wrapEnd);
+        write(0, m_head);
+    } else {
+        write(m_flushStart, m_head);
+    }
+    m_flushStart = m_head;
+    m_wrapped = false;
+    m_lastFrameBytes = m_frameBytes;
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <webgpu/webgpu.h>
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "webgpu-handles.h"
+
+/**
+ * Frame ring allocator for small per-frame data (uniforms, streamed vertices).
+ *
+ * One GPU buffer is suballocated front to back, wrapping around, with every
+ * allocation written to a CPU shadow copy first. flush() then sends the whole
+ * frame with a single wgpuQueueWriteBuffer (two when the frame wrapped), and
+ * uniform users bind the buffer once with a dynamic offset instead of
+ * creating a bind group per draw.
+ *
+ *     uploadRing.beginFrame();
+ *     uint32_t offset = uploadRing.pushUniform(objectUniforms);
+ *     wgpuRenderPassEncoderSetBindGroup(pass, 1, ringBindGroup, 1, &offset);
+ *     ...
+ *     uploadRing.flush(queue); // before submitting
+ */
+class UploadRing {
+public:
+    struct Allocation {
+        void* data = nullptr; // CPU staging memory, valid until flush()
+        uint32_t offset = 0;  // offset in buffer(), usable as a dynamic offset
+        explicit operator bool() const { return data != nullptr; }
+    };
+
+    /**
+     * `usage` is added to CopyDst | CopySrc. Uniform allocations are aligned
+     * to the device's minUniformBufferOffsetAlignment.
+     */
+    void init(WGPUDevice device, uint64_t capacity, WGPUBufferUsageFlags usage);
+
+    /**
+     * Start a frame. The buffer is replaced by a twice larger one between
+     * frames when the previous frame used more than half of it.
+     */
+    void beginFrame();
+
+    /**
+     * Reserve `size` bytes. Returns an empty allocation (and logs once) if
+     * the frame does not fit, the next beginFrame() grows the ring.
+     */
+    Allocation allocate(uint64_t size, uint32_t alignment = 4);
+
+    Allocation allocateUniform(uint64_t size) { return allocate(size, m_uniformAlignment); }
+
+    /**
+     * Copy `value` into a uniform allocation and return its offset, or
+     * UINT32_MAX if the ring is full.
+     */
+    template <typename T>
+    uint32_t pushUniform(T const & value) {
+        Allocation allocation = allocateUniform(sizeof(T));
+        if (!allocation) return UINT32_MAX;
+        memcpy(allocation.data, &value, sizeof(T));
+        return allocation.offset;
+    }
+
+    /**
+     * Write everything allocated since the last flush to the GPU buffer.
+     */
+    void flush(WGPUQueue queue);
+
+    WGPUBuffer buffer() const { return m_buffer.get(); }
+    uint64_t capacity() const { return m_capacity; }
+    uint32_t uniformAlignment() const { return m_uniformAlignment; }
+
+    /**
+     * Incremented whenever buffer() changes, so bind groups built on it can
+     * tell they must be recreated.
+     */
+    uint32_t generation() const { return m_generation; }
+
+    uint64_t frameBytes() const { return m_frameBytes; }
+    uint32_t frameWrites() const { return m_frameWrites; }
+
+private:
+    void createBuffer(uint64_t capacity);
+
+    WGPUDevice m_device = nullptr;
+    WGPUBufferUsageFlags m_usage = 0;
+    Handle<WGPUBuffer> m_buffer;
+    std::vector<uint8_t> m_shadow;
+    uint64_t m_capacity = 0;
+    uint32_t m_uniformAlignment = 256;
+    uint32_t m_generation = 0;
+
+    uint64_t m_head = 0;
+    uint64_t m_flushStart = 0;
+    // End of the first range when the data since the last flush wrapped around
+    uint64_t m_wrapEnd = 0;
+    bool m_wrapped = false;
+    bool m_overflowReported = false;
+    bool m_growRequested = false;
+
+    uint64_t m_frameBytes = 0;
+    uint64_t m_lastFrameBytes = 0;
+    uint32_t m_frameWrites = 0;
+};
@@ -0,0 +1,83 @@
+#include "webgpu-handles.h"
+
+#include <iostream>
+
+const char* handleTypeName(HandleType type) {
+    static const char* const names[HandleTypeCount] = {
+#define WGPU_HANDLE_NAME(Name) #Name,
+        WGPU_HANDLE_TYPES(WGPU_HANDLE_NAME)
+#undef WGPU_HANDLE_NAME
+    };
+    return type < HandleType::Count ? names[size_t(type)] : "Unknown";
+}
+
+void printLiveHandles() {
+    std::cout << "Live WebGPU handles:" << std::endl;
+    for (size_t i = 0; i < HandleTypeCount; ++i) {
+        if (liveHandleCounts[i] != 0) {
+            std::cout << " - " << handleTypeName(HandleType(i)) << ": " << liveHandleCounts[i] << std::endl;
+        }
+    }
+}
+
+DeferredReleaseQueue::~DeferredReleaseQueue() {
+    flush();
+}
+
+void DeferredReleaseQueue::endFrame(WGPUQueue queue) {
+    ++m_frameIndex;
+    if (m_pending.empty()) {
+        return;
+    }
+
+    auto batch = std::make_unique<Batch>();
+    batch->frame = m_frameIndex;
+    batch->objects.swap(m_pending);
+
+    auto onQueueWorkDone = [](WGPUQueueWorkDoneStatus /* status */, void * pUserData) {
+        // Even on error (e.g. device lost) the GPU is no longer using the objects
+        reinterpret_cast<Batch*>(pUserData)->gpuDone = true;
+    };
+    wgpuQueueOnSubmittedWorkDone(queue, onQueueWorkDone, (void*)batch.get());
+
+    m_batches.push_back(std::move(batch));
+}
+
+void DeferredReleaseQueue::collect() {
+    // Work done callbacks fire in submission order, so it is enough to look at
+    // the oldest batches
+    while (!m_batches.empty()) {
+        Batch& batch = *m_batches.front();
+        if (!batch.gpuDone || m_frameIndex - batch.frame < m_framesToKeep) {
+            break;
+        }
+        releaseBatch(batch);
+        m_batches.pop_front();
+    }
+}
+
+void DeferredReleaseQueue::flush() {
+    for (auto& batch : m_batches) {
+        releaseBatch(*batch);
+    }
+    m_batches.clear();
+
+    Batch pending;
+    pending.objects.swap(m_pending);
+    releaseBatch(pending);
+}
+
+size_t DeferredReleaseQueue::pendingCount() const {
+    size_t count = m_pending.size();
+    for (auto const & batch : m_batches) {
+        count += batch->objects.size();
+    }
+    return count;
+}
+
+void DeferredReleaseQueue::releaseBatch(Batch& batch) {
+    for (Retired const & object : batch.objects) {
+        object.release(object.raw);
+    }
+    batch.objects.clear();
+}
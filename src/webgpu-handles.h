@@ -0,0 +1,182 @@
+#pragma once
+
+#include <webgpu/webgpu.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <utility>
+#include <vector>
+
+// Every WebGPU object type the handle layer knows how to release
+#ifdef __EMSCRIPTEN__
+#  define WGPU_HANDLE_TYPES_PLATFORM(X) X(SwapChain)
+#else
+#  define WGPU_HANDLE_TYPES_PLATFORM(X)
+#endif // __EMSCRIPTEN__
+
+#define WGPU_HANDLE_TYPES(X) \
+    X(Adapter) X(BindGroup) X(BindGroupLayout) X(Buffer) X(CommandBuffer) \
+    X(CommandEncoder) X(ComputePassEncoder) X(ComputePipeline) X(Device) \
+    X(Instance) X(PipelineLayout) X(QuerySet) X(Queue) X(RenderBundle) \
+    X(RenderBundleEncoder) X(RenderPassEncoder) X(RenderPipeline) X(Sampler) \
+    X(ShaderModule) X(Surface) X(Texture) X(TextureView) \
+    WGPU_HANDLE_TYPES_PLATFORM(X)
+
+enum class HandleType : uint8_t {
+#define WGPU_HANDLE_ENUM(Name) Name,
+    WGPU_HANDLE_TYPES(WGPU_HANDLE_ENUM)
+#undef WGPU_HANDLE_ENUM
+    Count
+};
+
+constexpr size_t HandleTypeCount = size_t(HandleType::Count);
+
+/**
+ * Number of objects of each type currently owned through Handle<T> (or
+ * retired to a DeferredReleaseQueue and not released yet). Only touched from
+ * the thread issuing WebGPU calls.
+ */
+inline int64_t liveHandleCounts[HandleTypeCount] = {};
+
+const char* handleTypeName(HandleType type);
+
+/**
+ * Print the non-zero live counters, one type per line.
+ */
+void printLiveHandles();
+
+template <typename T> struct HandleTraits;
+
+#define WGPU_HANDLE_TRAITS(Name) \
+    template <> struct HandleTraits<WGPU##Name> { \
+        static constexpr HandleType type = HandleType::Name; \
+        static void release(WGPU##Name raw) { wgpu##Name##Release(raw); } \
+    };
+WGPU_HANDLE_TYPES(WGPU_HANDLE_TRAITS)
+#undef WGPU_HANDLE_TRAITS
+
+/**
+ * Release a raw handle previously detached from a Handle<T>.
+ */
+template <typename T>
+void releaseHandle(T raw) {
+    if (raw) {
+        HandleTraits<T>::release(raw);
+        --liveHandleCounts[size_t(HandleTraits<T>::type)];
+    }
+}
+
+/**
+ * Move-only owner of one WebGPU object reference, released on destruction.
+ *     Handle<WGPUShaderModule> module(wgpuDeviceCreateShaderModule(device, &desc));
+ */
+template <typename T>
+class Handle {
+public:
+    Handle() = default;
+    explicit Handle(T raw) : m_raw(raw) {
+        if (m_raw) ++liveHandleCounts[size_t(HandleTraits<T>::type)];
+    }
+    ~Handle() { releaseHandle(m_raw); }
+
+    Handle(Handle const &) = delete;
+    Handle& operator=(Handle const &) = delete;
+    Handle(Handle&& other) noexcept : m_raw(other.m_raw) { other.m_raw = nullptr; }
+    Handle& operator=(Handle&& other) noexcept {
+        if (this != &other) {
+            releaseHandle(m_raw);
+            m_raw = other.m_raw;
+            other.m_raw = nullptr;
+        }
+        return *this;
+    }
+
+    T get() const { return m_raw; }
+    explicit operator bool() const { return m_raw != nullptr; }
+
+    /**
+     * Give up ownership without releasing. The object stays counted as live
+     * until releaseHandle() is called on the returned value.
+     */
+    T detach() {
+        T raw = m_raw;
+        m_raw = nullptr;
+        return raw;
+    }
+
+    void reset(T raw = nullptr) { *this = Handle(raw); }
+
+private:
+    T m_raw = nullptr;
+};
+
+/**
+ * Objects retired during a frame are released only once the GPU has finished
+ * the work submitted in that frame (wgpuQueueOnSubmittedWorkDone) and at least
+ * `framesToKeep` frames have passed, so replacing a buffer or a pipeline never
+ * pulls it from under in-flight commands.
+ *
+ *     deferredReleases.retire(std::move(oldBuffer));
+ *     ...submit...
+ *     deferredReleases.endFrame(queue);
+ *     deferredReleases.collect();
+ */
+class DeferredReleaseQueue {
+public:
+    explicit DeferredReleaseQueue(uint32_t framesToKeep = 2) : m_framesToKeep(framesToKeep) {}
+    ~DeferredReleaseQueue();
+
+    DeferredReleaseQueue(DeferredReleaseQueue const &) = delete;
+    DeferredReleaseQueue& operator=(DeferredReleaseQueue const &) = delete;
+
+    template <typename T>
+    void retire(Handle<T> handle) {
+        if (T raw = handle.detach()) {
+            m_pending.push_back({(void*)raw, &releaseErased<T>});
+        }
+    }
+
+    /**
+     * Close the current frame: everything retired so far becomes releasable
+     * once the work submitted to `queue` up to now is done.
+     */
+    void endFrame(WGPUQueue queue);
+
+    /**
+     * Release the batches that are both finished on the GPU and old enough.
+     */
+    void collect();
+
+    /**
+     * Release everything immediately. Only safe once the queue is idle.
+     */
+    void flush();
+
+    size_t pendingCount() const;
+    uint64_t frameIndex() const { return m_frameIndex; }
+
+private:
+    struct Retired {
+        void* raw;
+        void (*release)(void*);
+    };
+    struct Batch {
+        uint64_t frame = 0;
+        bool gpuDone = false;
+        std::vector<Retired> objects;
+    };
+
+    template <typename T>
+    static void releaseErased(void* raw) { releaseHandle((T)raw); }
+
+    static void releaseBatch(Batch& batch);
+
+    uint32_t m_framesToKeep;
+    uint64_t m_frameIndex = 0;
+    std::vector<Retired> m_pending;
+    // Batches are heap allocated so that the pointer handed to the work done
+    // callback stays valid while the deque grows.
+    std::deque<std::unique_ptr<Batch>> m_batches;
+};
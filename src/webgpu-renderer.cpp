@@ -0,0 +1,286 @@
+#include "webgpu-renderer.h"
+#include "webgpu-utils.h"
+#include "frame-stats.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <iostream>
+#include <cstdint>
+#include <vector>
+
+WGPUInstance instance;
+WGPUDevice device;
+WGPUQueue queue;
+FramePacer framePacer;
+DeferredReleaseQueue deferredReleases;
+PipelineCache pipelineCache;
+BindGroupCache bindGroupCache;
+ShaderLibrary shaderLibrary;
+GpuProfiler gpuProfiler;
+DrawQueue drawQueue;
+InstancedRenderer instancedRenderer;
+MeshStream sceneMesh;
+SpriteBatcher spriteBatcher;
+UploadRing uploadRing;
+GpuCulling gpuCulling;
+bool gpuCullingEnabled = false;
+uint32_t sceneDrawCount = 1;
+bool renderBundlesEnabled = false;
+DynamicResolution dynamicResolution;
+bool dynamicResolutionEnabled = false;
+FrameStats frameStats;
+
+WGPUShaderModule createShaderModule(WGPUDevice device, std::string const &source, std::string const &name) {
+    WGPUShaderModuleWGSLDescriptor wgslDesc = {
+            .chain = WGPUChainedStruct{
+                    .next = nullptr,
+                    .sType = WGPUSType_ShaderModuleWGSLDescriptor,
+            },
+            .code = source.c_str(),
+    };
+    WGPUShaderModuleDescriptor desc = {
+            .nextInChain = &wgslDesc.chain,
+            .label = name.c_str(),
+    };
+
+    return wgpuDeviceCreateShaderModule(device, &desc);
+}
+
+// Optional features are requested when the adapter has them, the descriptor
+// points into this array
+static const WGPUFeatureName optionalFeatures[] = {WGPUFeatureName_TimestampQuery};
+
+static WGPUDeviceDescriptor makeDeviceDescriptor(std::vector<WGPUFeatureName> const & adapterFeatures) {
+	WGPUDeviceDescriptor deviceDesc = {};
+	deviceDesc.nextInChain = nullptr;
+	deviceDesc.label = "My Device"; // anything works here, that's your call
+	// Timestamp queries feed the GPU profiler, it falls back to CPU timing without them
+	const bool timestamps = std::find(adapterFeatures.begin(), adapterFeatures.end(),
+	                                  WGPUFeatureName_TimestampQuery) != adapterFeatures.end();
+	deviceDesc.requiredFeatureCount = timestamps ? 1 : 0;
+	deviceDesc.requiredFeatures = optionalFeatures;
+	deviceDesc.requiredLimits = nullptr; // we do not require any specific limit
+	deviceDesc.defaultQueue.nextInChain = nullptr;
+	deviceDesc.defaultQueue.label = "The default queue";
+	// A function that is invoked whenever the device stops being available.
+	deviceDesc.deviceLostCallback = [](WGPUDeviceLostReason reason, char const* message, void* /* pUserData */) {
+		std::cout << "Device lost: reason " << reason;
+		if (message) std::cout << " (" << message << ")";
+		std::cout << std::endl;
+	};
+	return deviceDesc;
+}
+
+static bool onDeviceAcquired(WGPUAdapter adapter, WGPUDevice newDevice) {
+	device = newDevice;
+	std::cout << "Got device: " << device << std::endl;
+
+	// We no longer need to access the adapter once we have the device
+	wgpuAdapterRelease(adapter);
+	if (!device) {
+		return false;
+	}
+
+	// A function that is invoked whenever there is an error in the use of the device
+	auto onDeviceError = [](WGPUErrorType type, char const* message, void* /* pUserData */) {
+		std::cout << "Uncaptured device error: type " << type;
+		if (message) std::cout << " (" << message << ")";
+		std::cout << std::endl;
+	};
+	wgpuDeviceSetUncapturedErrorCallback(device, onDeviceError, nullptr /* pUserData */);
+
+	// Display information about the device
+	inspectDevice(device);
+
+	queue = wgpuDeviceGetQueue(device);
+	return true;
+}
+
+static bool createInstance() {
+	// The instance is kept alive: the web build still needs it to create the
+	// canvas surface once the device is there.
+	instance = wgpuCreateInstance(nullptr);
+
+	if (!instance) {
+		std::cerr << "Could not initialize WebGPU!" << std::endl;
+		return false;
+	}
+
+	std::cout << "WGPU instance: " << instance << std::endl;
+	return true;
+}
+
+void initWebGPUAsync(WGPURequestAdapterOptions const * adapterOpts, std::function<void(bool)> onReady) {
+	if (!createInstance()) {
+		onReady(false);
+		return;
+	}
+
+	std::cout << "Requesting adapter..." << std::endl;
+	TRACE_INSTANT("request adapter");
+	requestAdapterAsync(instance, adapterOpts, [onReady](WGPUAdapter adapter) {
+		TRACE_INSTANT("adapter ready");
+		std::cout << "Got adapter: " << adapter << std::endl;
+		if (!adapter) {
+			onReady(false);
+			return;
+		}
+
+		const std::vector<WGPUFeatureName> features = inspectAdapter(adapter);
+
+		std::cout << "Requesting device..." << std::endl;
+		WGPUDeviceDescriptor deviceDesc = makeDeviceDescriptor(features);
+		requestDeviceAsync(adapter, &deviceDesc, [adapter, onReady](WGPUDevice newDevice) {
+			TRACE_INSTANT("device ready");
+			onReady(onDeviceAcquired(adapter, newDevice));
+		});
+	});
+}
+
+#ifndef __EMSCRIPTEN__
+bool initWebGPU(WGPURequestAdapterOptions const * adapterOpts) {
+	if (!createInstance()) {
+		return false;
+	}
+
+	std::cout << "Requesting adapter..." << std::endl;
+	WGPUAdapter adapter = requestAdapterSync(instance, adapterOpts);
+	std::cout << "Got adapter: " << adapter << std::endl;
+	if (!adapter) {
+		return false;
+	}
+
+	const std::vector<WGPUFeatureName> features = inspectAdapter(adapter);
+
+	std::cout << "Requesting device..." << std::endl;
+	WGPUDeviceDescriptor deviceDesc = makeDeviceDescriptor(features);
+	return onDeviceAcquired(adapter, requestDeviceSync(adapter, &deviceDesc));
+}
+#endif // NOT __EMSCRIPTEN__
+
+void initWebGPUPipeline(WGPUTextureFormat colorFormat) {
+    TRACE_SCOPE("initWebGPUPipeline");
+    pipelineCache.init(device);
+    bindGroupCache.init(device);
+    shaderLibrary.init();
+    gpuProfiler.init(device);
+    // Per-frame uniforms are tiny, the ring grows if a frame ever needs more
+    uploadRing.init(device, 64 * 1024, WGPUBufferUsage_Uniform | WGPUBufferUsage_Vertex | WGPUBufferUsage_Index);
+    instancedRenderer.init(device, colorFormat);
+    sceneMesh.init(device, colorFormat, instancedRenderer);
+    spriteBatcher.init(device, queue, colorFormat);
+    gpuCulling.init(device);
+}
+
+Handle<WGPUCommandBuffer> encodeFrame(WGPUTextureView target) {
+    TRACE_SCOPE("encodeFrame");
+    {
+        TRACE_SCOPE("wait for frame slot");
+        framePacer.beginFrame(device);
+    }
+    frameStats = {};
+    gpuProfiler.beginFrame(framePacer.frameSlot());
+    uploadRing.beginFrame();
+    // Queue writes are ordered before the command buffer submitted next
+    {
+        TRACE_SCOPE("upload instances");
+        instancedRenderer.upload(queue, instances);
+    }
+    const bool useBundle = renderBundlesEnabled && !gpuCullingEnabled;
+    if (useBundle) {
+        instancedRenderer.updateBundleView(queue, view);
+    }
+    // The mesh binds the per-frame view even when the instances use the bundle's
+    if (!useBundle || sceneMesh.chunksReady() > 0) {
+        instancedRenderer.setView(uploadRing, view);
+    }
+    {
+        TRACE_SCOPE("select mesh lods");
+        sceneMesh.selectLods(view);
+    }
+    {
+        TRACE_SCOPE("stream sprites");
+        spriteBatcher.prepare(uploadRing);
+    }
+
+    const bool scaled = dynamicResolutionEnabled && dynamicResolution.renderTarget();
+    WGPURenderPassColorAttachment colorAttachment = {};
+    colorAttachment.view = scaled ? dynamicResolution.renderTarget() : target;
+#ifndef WEBGPU_BACKEND_WGPU
+    colorAttachment.depthSlice = UINT32_MAX;
+#endif // NOT WEBGPU_BACKEND_WGPU
+    colorAttachment.loadOp = WGPULoadOp_Clear;
+    colorAttachment.storeOp = WGPUStoreOp_Store;
+    colorAttachment.clearValue = {0.0f, 0.0f, 0.0f, 1.0f};
+
+    WGPURenderPassDescriptor renderPassDesc = {};
+    renderPassDesc.label = "Render-Pass";
+    renderPassDesc.colorAttachmentCount = 1;
+    renderPassDesc.colorAttachments = &colorAttachment;
+
+    WGPUCommandEncoderDescriptor encoderDesc = {};
+    Handle<WGPUCommandEncoder> encoder(wgpuDeviceCreateCommandEncoder(device, &encoderDesc));
+    if (gpuCullingEnabled) {
+        gpuCulling.setViewRect(view.center[0] - 1.0f / view.scale[0], view.center[1] - 1.0f / view.scale[1],
+                               view.center[0] + 1.0f / view.scale[0], view.center[1] + 1.0f / view.scale[1]);
+        TRACE_SCOPE("encode culling");
+        gpuCulling.encode(uploadRing, encoder.get(), instancedRenderer);
+    }
+
+    TRACE_SCOPE("encode render pass");
+    const uint32_t renderSlot = gpuProfiler.beginPass("render");
+    renderPassDesc.timestampWrites = gpuProfiler.renderPassTimestampWrites(renderSlot);
+    Handle<WGPURenderPassEncoder> pass(wgpuCommandEncoderBeginRenderPass(encoder.get(), &renderPassDesc));
+    if (scaled) {
+        // Only the top-left corner of the target is drawn, the clear covers the rest
+        const uint32_t width = dynamicResolution.renderWidth();
+        const uint32_t height = dynamicResolution.renderHeight();
+        wgpuRenderPassEncoderSetViewport(pass.get(), 0.0f, 0.0f, float(width), float(height), 0.0f, 1.0f);
+        wgpuRenderPassEncoderSetScissorRect(pass.get(), 0, 0, width, height);
+    }
+    // The opaque mesh goes under the additive instances, in a lower layer
+    sceneMesh.draw(drawQueue, instancedRenderer);
+    if (gpuCullingEnabled) {
+        gpuCulling.draw(drawQueue, instancedRenderer);
+    } else if (!useBundle) {
+        instancedRenderer.draw(drawQueue, sceneDrawCount);
+    }
+    {
+        TRACE_SCOPE("encode draws");
+        drawQueue.encode(pass.get());
+    }
+    if (useBundle) {
+        WGPURenderBundle bundle = instancedRenderer.bundle(sceneDrawCount);
+        if (bundle) {
+            wgpuRenderPassEncoderExecuteBundles(pass.get(), 1, &bundle);
+        }
+    }
+    spriteBatcher.render(pass.get());
+    wgpuRenderPassEncoderEnd(pass.get());
+    gpuProfiler.endPass(renderSlot);
+
+    if (scaled) {
+        TRACE_SCOPE("encode upscale");
+        const uint32_t upscaleSlot = gpuProfiler.beginPass("upscale");
+        dynamicResolution.encodeUpscale(encoder.get(), target, queue, gpuProfiler.renderPassTimestampWrites(upscaleSlot));
+        gpuProfiler.endPass(upscaleSlot);
+    }
+
+    // Everything allocated from the ring this frame goes out in one write
+    uploadRing.flush(queue);
+    gpuProfiler.resolve(encoder.get());
+
+    return Handle<WGPUCommandBuffer>(wgpuCommandEncoderFinish(encoder.get(), nullptr));
+}
+
+void endFrame() {
+    TRACE_SCOPE("endFrame");
+    framePacer.endFrame(queue);
+    gpuProfiler.afterSubmit();
+    if (gpuCullingEnabled) {
+        gpuCulling.afterSubmit();
+    }
+    bindGroupCache.endFrame();
+    deferredReleases.endFrame(queue);
+    deferredReleases.collect();
+}
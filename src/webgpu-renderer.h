@@ -0,0 +1,103 @@
+#pragma once
+
+#include <webgpu/webgpu.h>
+
+#include "bind-group-cache.h"
+#include "draw-queue.h"
+#include "dynamic-resolution.h"
+#include "frame-pacer.h"
+#include "gpu-culling.h"
+#include "gpu-profiler.h"
+#include "instance-store.h"
+#include "instanced-renderer.h"
+#include "mesh-stream.h"
+#include "pipeline-cache.h"
+#include "scene.h"
+#include "shader-library.h"
+#include "sprite-batcher.h"
+#include "upload-ring.h"
+#include "webgpu-handles.h"
+
+#include <functional>
+#include <string>
+
+// Global WebGPU state shared by the web entry point and the native benchmarks
+extern WGPUInstance instance;
+extern WGPUDevice device;
+extern WGPUQueue queue;
+// Frames in flight: encodeFrame() waits for a free frame slot, endFrame()
+// closes it
+extern FramePacer framePacer;
+// Objects replaced at runtime are retired here and released a few frames later
+extern DeferredReleaseQueue deferredReleases;
+// Shader modules and render pipelines, shared by everything drawing
+extern PipelineCache pipelineCache;
+// Bind group and pipeline layouts, samplers, and bind groups looked up per frame
+extern BindGroupCache bindGroupCache;
+// WGSL files and their variants, compiled through pipelineCache
+extern ShaderLibrary shaderLibrary;
+// Per-pass GPU times (timestamp queries, or CPU encode time without them)
+extern GpuProfiler gpuProfiler;
+// The scene's draws of the frame, sorted by state when the render pass is encoded
+extern DrawQueue drawQueue;
+// Draws every instance of the scene (see scene.h)
+extern InstancedRenderer instancedRenderer;
+// Static geometry loaded from a .mesh file, drawn under the instances
+extern MeshStream sceneMesh;
+// 2D sprites added during the frame, drawn over the scene
+extern SpriteBatcher spriteBatcher;
+// Per-frame uniforms and streamed vertices, written once per frame
+extern UploadRing uploadRing;
+// When enabled, instances go through a compute culling pass and one indirect draw
+extern GpuCulling gpuCulling;
+extern bool gpuCullingEnabled;
+// Number of draws the instances are split into, one per object of the scene
+extern uint32_t sceneDrawCount;
+// Replay the scene's draws from a render bundle recorded once instead of
+// encoding them every frame. Ignored while GPU culling is enabled.
+extern bool renderBundlesEnabled;
+// When enabled, encodeFrame() renders the scene into dynamicResolution's
+// scaled target and upscales it into the frame's target. Set up by the caller.
+extern DynamicResolution dynamicResolution;
+extern bool dynamicResolutionEnabled;
+
+WGPUShaderModule createShaderModule(WGPUDevice device, std::string const &source, std::string const &name);
+
+/**
+ * Create the instance, then request the adapter and the device without
+ * blocking. `onReady` is called with true once `device` and `queue` are
+ * usable, or with false if any step failed.
+ */
+void initWebGPUAsync(WGPURequestAdapterOptions const * adapterOpts, std::function<void(bool)> onReady);
+
+#ifndef __EMSCRIPTEN__
+/**
+ * Blocking version of initWebGPUAsync for native builds. The adapter options
+ * are forwarded as is, so a caller can ask for a fallback (software) adapter.
+ */
+bool initWebGPU(WGPURequestAdapterOptions const * adapterOpts);
+#endif // NOT __EMSCRIPTEN__
+
+/**
+ * Create the render pipelines drawing into targets of the given color format.
+ */
+void initWebGPUPipeline(WGPUTextureFormat colorFormat);
+
+/**
+ * Upload the dirty instance data, record one frame into `target` and return
+ * the finished command buffer. The frame first waits for its slot in
+ * framePacer; on the web, where that cannot block, the caller must have
+ * started it with framePacer.beginFrame() already. With dynamicResolutionEnabled the scene goes
+ * through the scaled offscreen target first and `target` only receives the
+ * upscale blit.
+ * Submitting is left to the caller so that encode and submit can be timed
+ * separately.
+ */
+Handle<WGPUCommandBuffer> encodeFrame(WGPUTextureView target);
+
+/**
+ * Per-frame bookkeeping once the command buffer of encodeFrame() has been
+ * submitted: closes the frame slot, starts readbacks and releases retired
+ * objects that are done.
+ */
+void endFrame();
@@ -26,23 +26,12 @@
 
 #include "webgpu-utils.h"
 
-#ifdef __EMSCRIPTEN__
-#  include <emscripten.h>
-#endif // __EMSCRIPTEN__
-
 #include <iostream>
 #include <vector>
+#include <memory>
 #include <cassert>
 
-WGPUAdapter requestAdapterSync(WGPUInstance instance, WGPURequestAdapterOptions const * options) {
-	// A simple structure holding the local information shared with the
-	// onAdapterRequestEnded callback.
-	struct UserData {
-		WGPUAdapter adapter = nullptr;
-		bool requestEnded = false;
-	};
-	UserData userData;
-
+void requestAdapterAsync(WGPUInstance instance, WGPURequestAdapterOptions const * options, AdapterCallback onAdapter) {
 	// Callback called by wgpuInstanceRequestAdapter when the request returns
 	// This is a C++ lambda function, but could be any function defined in the
 	// global scope. It must be non-capturing (the brackets [] are empty) so
@@ -50,15 +39,15 @@ WGPUAdapter requestAdapterSync(WGPUInstance instance, WGPURequestAdapterOptions
 	// wgpuInstanceRequestAdapter expects (WebGPU being a C API). The workaround
 	// is to convey what we want to capture through the pUserData pointer,
 	// provided as the last argument of wgpuInstanceRequestAdapter and received
-	// by the callback as its last argument.
+	// by the callback as its last argument. Here we convey the continuation
+	// itself, moved to the heap and deleted once it has been called.
 	auto onAdapterRequestEnded = [](WGPURequestAdapterStatus status, WGPUAdapter adapter, char const * message, void * pUserData) {
-		UserData& userData = *reinterpret_cast<UserData*>(pUserData);
-		if (status == WGPURequestAdapterStatus_Success) {
-			userData.adapter = adapter;
-		} else {
-			std::cout << "Could not get WebGPU adapter: " << message << std::endl;
+		std::unique_ptr<AdapterCallback> onAdapter(reinterpret_cast<AdapterCallback*>(pUserData));
+		if (status != WGPURequestAdapterStatus_Success) {
+			std::cout << "Could not get WebGPU adapter: " << (message ? message : "") << std::endl;
+			adapter = nullptr;
 		}
-		userData.requestEnded = true;
+		(*onAdapter)(adapter);
 	};
 
 	// Call to the WebGPU request adapter procedure
@@ -66,22 +55,32 @@ WGPUAdapter requestAdapterSync(WGPUInstance instance, WGPURequestAdapterOptions
 		instance /* equivalent of navigator.gpu */,
 		options,
 		onAdapterRequestEnded,
-		(void*)&userData
+		(void*)new AdapterCallback(std::move(onAdapter))
 	);
+}
 
-	// We wait until userData.requestEnded gets true
-#ifdef __EMSCRIPTEN__
-	while (!userData.requestEnded) {
-		emscripten_sleep(100);
+#ifndef __EMSCRIPTEN__
+WGPUAdapter requestAdapterSync(WGPUInstance instance, WGPURequestAdapterOptions const * options) {
+	WGPUAdapter result = nullptr;
+	bool requestEnded = false;
+	requestAdapterAsync(instance, options, [&](WGPUAdapter adapter) {
+		result = adapter;
+		requestEnded = true;
+	});
+
+#ifdef WEBGPU_BACKEND_DAWN
+	while (!requestEnded) {
+		wgpuInstanceProcessEvents(instance);
 	}
-#endif // __EMSCRIPTEN__
+#endif // WEBGPU_BACKEND_DAWN
 
-	assert(userData.requestEnded);
+	assert(requestEnded);
 
-	return userData.adapter;
+	return result;
 }
+#endif // NOT __EMSCRIPTEN__
 
-void inspectAdapter(WGPUAdapter adapter) {
+std::vector<WGPUFeatureName> inspectAdapter(WGPUAdapter adapter) {
 #ifndef __EMSCRIPTEN__
 	WGPUSupportedLimits supportedLimits = {};
 	supportedLimits.nextInChain = nullptr;
@@ -140,42 +139,41 @@ void inspectAdapter(WGPUAdapter adapter) {
 	std::cout << " - adapterType: 0x" << properties.adapterType << std::endl;
 	std::cout << " - backendType: 0x" << properties.backendType << std::endl;
 	std::cout << std::dec; // Restore decimal numbers
+	return features;
 }
 
-WGPUDevice requestDeviceSync(WGPUAdapter adapter, WGPUDeviceDescriptor const * descriptor) {
-	struct UserData {
-		WGPUDevice device = nullptr;
-		bool requestEnded = false;
-	};
-	UserData userData;
-
+void requestDeviceAsync(WGPUAdapter adapter, WGPUDeviceDescriptor const * descriptor, DeviceCallback onDevice) {
 	auto onDeviceRequestEnded = [](WGPURequestDeviceStatus status, WGPUDevice device, char const * message, void * pUserData) {
-		UserData& userData = *reinterpret_cast<UserData*>(pUserData);
-		if (status == WGPURequestDeviceStatus_Success) {
-			userData.device = device;
-		} else {
-			std::cout << "Could not get WebGPU device: " << message << std::endl;
+		std::unique_ptr<DeviceCallback> onDevice(reinterpret_cast<DeviceCallback*>(pUserData));
+		if (status != WGPURequestDeviceStatus_Success) {
+			std::cout << "Could not get WebGPU device: " << (message ? message : "") << std::endl;
+			device = nullptr;
 		}
-		userData.requestEnded = true;
+		(*onDevice)(device);
 	};
 
 	wgpuAdapterRequestDevice(
 		adapter,
 		descriptor,
 		onDeviceRequestEnded,
-		(void*)&userData
+		(void*)new DeviceCallback(std::move(onDevice))
 	);
+}
 
-#ifdef __EMSCRIPTEN__
-	while (!userData.requestEnded) {
-		emscripten_sleep(100);
-	}
-#endif // __EMSCRIPTEN__
+#ifndef __EMSCRIPTEN__
+WGPUDevice requestDeviceSync(WGPUAdapter adapter, WGPUDeviceDescriptor const * descriptor) {
+	WGPUDevice result = nullptr;
+	bool requestEnded = false;
+	requestDeviceAsync(adapter, descriptor, [&](WGPUDevice device) {
+		result = device;
+		requestEnded = true;
+	});
 
-	assert(userData.requestEnded);
+	assert(requestEnded);
 
-	return userData.device;
+	return result;
 }
+#endif // NOT __EMSCRIPTEN__
 
 void inspectDevice(WGPUDevice device) {
 	std::vector<WGPUFeatureName> features;
@@ -228,4 +226,50 @@ void inspectDevice(WGPUDevice device) {
 		std::cout << " - maxComputeWorkgroupSizeZ: " << limits.limits.maxComputeWorkgroupSizeZ << std::endl;
 		std::cout << " - maxComputeWorkgroupsPerDimension: " << limits.limits.maxComputeWorkgroupsPerDimension << std::endl;
 	}
-}
\ No newline at end of file
+}
+
+WGPULimits getDeviceLimits(WGPUDevice device) {
+	WGPUSupportedLimits limits = {};
+	limits.nextInChain = nullptr;
+
+#ifdef WEBGPU_BACKEND_DAWN
+	bool success = wgpuDeviceGetLimits(device, &limits) == WGPUStatus_Success;
+#else
+	bool success = wgpuDeviceGetLimits(device, &limits);
+#endif
+
+	if (!success) {
+		// Defaults guaranteed by the WebGPU specification
+		limits.limits.minUniformBufferOffsetAlignment = 256;
+		limits.limits.minStorageBufferOffsetAlignment = 256;
+		limits.limits.maxUniformBufferBindingSize = 65536;
+		limits.limits.maxStorageBufferBindingSize = 134217728;
+		limits.limits.maxBufferSize = 268435456;
+	}
+	return limits.limits;
+}
+
+void pollEvents([[maybe_unused]] WGPUDevice device) {
+#if defined(WEBGPU_BACKEND_DAWN)
+	wgpuDeviceTick(device);
+#elif defined(WEBGPU_BACKEND_WGPU)
+	wgpuDevicePoll(device, false, nullptr);
+#endif
+}
+
+#ifndef __EMSCRIPTEN__
+void waitForQueueIdle(WGPUDevice device, WGPUQueue queue) {
+	bool workDone = false;
+	auto onQueueWorkDone = [](WGPUQueueWorkDoneStatus status, void * pUserData) {
+		if (status != WGPUQueueWorkDoneStatus_Success) {
+			std::cout << "Queue work finished with status: " << status << std::endl;
+		}
+		*reinterpret_cast<bool*>(pUserData) = true;
+	};
+	wgpuQueueOnSubmittedWorkDone(queue, onQueueWorkDone, (void*)&workDone);
+
+	while (!workDone) {
+		pollEvents(device);
+	}
+}
+#endif // NOT __EMSCRIPTEN__
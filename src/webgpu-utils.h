@@ -28,11 +28,37 @@
 
 #include <webgpu/webgpu.h>
 
+#include <functional>
+#include <vector>
+
+using AdapterCallback = std::function<void(WGPUAdapter)>;
+using DeviceCallback = std::function<void(WGPUDevice)>;
+
+/**
+ * Request a WebGPU adapter without blocking, `onAdapter` is called with the
+ * adapter (or nullptr on failure) once the request ends, so that
+ *     requestAdapterAsync(instance, options, onAdapter);
+ * is roughly equivalent to
+ *     navigator.gpu.requestAdapter(options).then(onAdapter);
+ * On the web the callback fires from the browser event loop, which is what
+ * lets the app start without ASYNCIFY.
+ */
+void requestAdapterAsync(WGPUInstance instance, WGPURequestAdapterOptions const * options, AdapterCallback onAdapter);
+
+/**
+ * Request a WebGPU device without blocking, `onDevice` is called with the
+ * device (or nullptr on failure) once the request ends.
+ * It is very similar to requestAdapterAsync
+ */
+void requestDeviceAsync(WGPUAdapter adapter, WGPUDeviceDescriptor const * descriptor, DeviceCallback onDevice);
+
+#ifndef __EMSCRIPTEN__
 /**
  * Utility function to get a WebGPU adapter, so that
  *     WGPUAdapter adapter = requestAdapter(options);
  * is roughly equivalent to
  *     const adapter = await navigator.gpu.requestAdapter(options);
+ * Native only: blocking the browser thread would need ASYNCIFY.
  */
 WGPUAdapter requestAdapterSync(WGPUInstance instance, WGPURequestAdapterOptions const * options);
 
@@ -44,14 +70,37 @@ WGPUAdapter requestAdapterSync(WGPUInstance instance, WGPURequestAdapterOptions
  * It is very similar to requestAdapter
  */
 WGPUDevice requestDeviceSync(WGPUAdapter adapter, WGPUDeviceDescriptor const * descriptor);
+#endif // NOT __EMSCRIPTEN__
 
 /**
  * An example of how we can inspect the capabilities of the hardware through
- * the adapter object.
+ * the adapter object. Returns the adapter features it printed, so that the
+ * caller can decide which optional ones to request.
  */
-void inspectAdapter(WGPUAdapter adapter);
+std::vector<WGPUFeatureName> inspectAdapter(WGPUAdapter adapter);
 
 /**
  * Display information about a device
  */
-void inspectDevice(WGPUDevice device);
\ No newline at end of file
+void inspectDevice(WGPUDevice device);
+
+/**
+ * Limits of a device, e.g. the offset alignments to use when suballocating
+ * buffers. Falls back to the WebGPU defaults if they cannot be queried.
+ */
+WGPULimits getDeviceLimits(WGPUDevice device);
+
+/**
+ * Give the native backend a chance to fire pending callbacks (device
+ * requests, buffer mapping, submitted work done). On the web this is done by
+ * the browser event loop between frames, so it is a no-op there.
+ */
+void pollEvents(WGPUDevice device);
+
+#ifndef __EMSCRIPTEN__
+/**
+ * Block until every command buffer submitted to the queue so far has been
+ * executed. Only available natively, a browser cannot wait synchronously.
+ */
+void waitForQueueIdle(WGPUDevice device, WGPUQueue queue);
+#endif // NOT __EMSCRIPTEN__